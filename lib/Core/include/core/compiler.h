@@ -6,4 +6,22 @@
 
 #if !defined(OT_COMPILER_MSVC)
 #  define OT_COMPILER_MSVC 0
+#endif
+
+// SIMD instruction sets available to the build. Defining OT_SIMD_DISABLE forces the scalar fallbacks
+#if !defined(OT_SIMD_DISABLE)
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define OT_SIMD_SSE2 1
+#  endif
+#  if defined(__AVX__)
+#    define OT_SIMD_AVX 1
+#  endif
+#endif
+
+#if !defined(OT_SIMD_SSE2)
+#  define OT_SIMD_SSE2 0
+#endif
+
+#if !defined(OT_SIMD_AVX)
+#  define OT_SIMD_AVX 0
 #endif
\ No newline at end of file
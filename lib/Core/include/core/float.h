@@ -38,7 +38,7 @@ namespace ot
 	// bits_error represents the number of bits of "error" in the computation
 	inline int float_cmp(float lhs, float rhs, int bits_error)
 	{
-		float const epsilon = (static_cast<float>(std::pow(2, bits_error)) - 1.0f) * FLT_EPSILON;
+		float const epsilon = (std::ldexp(1.0f, bits_error) - 1.0f) * FLT_EPSILON;
 		return detail::float_cmp(lhs, rhs, epsilon);
 	}
 
@@ -83,7 +83,7 @@ namespace ot
 	// bits_error represents the number of bits of "error" in the computation
 	inline int float_cmp(double lhs, double rhs, int bits_error)
 	{
-		double const epsilon = (std::pow(2, bits_error) - 1.0) * DBL_EPSILON;
+		double const epsilon = (std::ldexp(1.0, bits_error) - 1.0) * DBL_EPSILON;
 		return detail::float_cmp(lhs, rhs, epsilon);
 	}
 
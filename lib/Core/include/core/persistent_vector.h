@@ -0,0 +1,192 @@
+#pragma once
+
+#include "core/size_t.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <span>
+#include <unordered_set>
+#include <iterator>
+
+namespace ot
+{
+	// Vector with structural sharing: copies share their storage, and writing to an element only copies the nodes on its path
+	// Elements are stored in fixed-size chunks, at the leaves of a tree of branches with the same fan-out
+	// Copies are O(1), reads walk the depth of the tree, writes copy O(log n) nodes only while they are shared
+	// The elements of a chunk are contiguous: iterating walks the tree once per chunk, and linear passes can read whole chunks as spans with get_chunks
+	template<typename T, size_t ChunkBits = 5>
+	class persistent_vector
+	{
+		static constexpr size_t chunk_size = size_t(1) << ChunkBits;
+		static constexpr size_t chunk_mask = chunk_size - 1;
+
+		struct leaf
+		{
+			std::array<T, chunk_size> values{};
+		};
+
+		struct branch
+		{
+			std::array<std::shared_ptr<void>, chunk_size> children;
+		};
+
+		std::shared_ptr<void> root;
+		size_t count = 0;
+		size_t shift = 0; // bits of the index consumed by branches above the leaves
+
+		[[nodiscard]] size_t get_capacity() const noexcept { return size_t(1) << (shift + ChunkBits); }
+
+		// Returns the values of the chunk holding the element
+		[[nodiscard]] T const* get_chunk_values(size_t i) const noexcept
+		{
+			void const* n = root.get();
+			for (size_t level = shift; level > 0; level -= ChunkBits)
+				n = static_cast<branch const*>(n)->children[(i >> level) & chunk_mask].get();
+			return static_cast<leaf const*>(n)->values.data();
+		}
+
+		template<typename Node>
+		static Node& make_unique_node(std::shared_ptr<void>& n)
+		{
+			if (n == nullptr)
+				n = std::make_shared<Node>();
+			else if (n.use_count() != 1)
+				n = std::make_shared<Node>(*static_cast<Node const*>(n.get()));
+			return *static_cast<Node*>(n.get());
+		}
+
+		[[nodiscard]] static size_t count_node_bytes(void const* n, size_t level, std::unordered_set<void const*>& counted_nodes)
+		{
+			// A node seen before is shared, and so is everything under it
+			if (n == nullptr || !counted_nodes.insert(n).second)
+				return 0;
+
+			if (level == 0)
+				return sizeof(leaf);
+
+			size_t bytes = sizeof(branch);
+			for (std::shared_ptr<void> const& child : static_cast<branch const*>(n)->children)
+				bytes += count_node_bytes(child.get(), level - ChunkBits, counted_nodes);
+			return bytes;
+		}
+
+	public:
+		// Walks the tree only when entering a chunk
+		class const_iterator
+		{
+			persistent_vector const* v = nullptr;
+			size_t i = 0;
+			T const* chunk = nullptr; // values of the chunk holding the element, null past the end
+
+			void enter_chunk() noexcept { chunk = i < v->count ? v->get_chunk_values(i) : nullptr; }
+
+		public:
+			using difference_type = ptrdiff_t;
+			using value_type = T;
+
+			const_iterator() = default;
+			const_iterator(persistent_vector const& v, size_t i) noexcept : v(&v), i(i) { enter_chunk(); }
+
+			[[nodiscard]] T const& operator*() const noexcept { return chunk[i & chunk_mask]; }
+			const_iterator& operator++() noexcept
+			{
+				++i;
+				if ((i & chunk_mask) == 0)
+					enter_chunk();
+				return *this;
+			}
+			[[nodiscard]] const_iterator operator++(int) noexcept { auto const copy = *this; ++*this; return copy; }
+			[[nodiscard]] bool operator==(const_iterator const& rhs) const noexcept { return i == rhs.i; }
+		};
+
+		// Yields each chunk as a span over its elements, the last one only covering the elements of the vector
+		class chunk_iterator
+		{
+			persistent_vector const* v = nullptr;
+			size_t start = 0; // index of the first element of the chunk
+
+		public:
+			using difference_type = ptrdiff_t;
+			using value_type = std::span<T const>;
+
+			chunk_iterator() = default;
+			chunk_iterator(persistent_vector const& v, size_t start) noexcept : v(&v), start(start) {}
+
+			[[nodiscard]] std::span<T const> operator*() const noexcept { return { v->get_chunk_values(start), std::min(chunk_size, v->count - start) }; }
+			chunk_iterator& operator++() noexcept { start += chunk_size; return *this; }
+			[[nodiscard]] chunk_iterator operator++(int) noexcept { auto const copy = *this; start += chunk_size; return copy; }
+			[[nodiscard]] bool operator==(chunk_iterator const& rhs) const noexcept { return start == rhs.start; }
+		};
+
+		struct chunk_range
+		{
+			chunk_iterator first;
+			chunk_iterator last;
+
+			[[nodiscard]] chunk_iterator begin() const noexcept { return first; }
+			[[nodiscard]] chunk_iterator end() const noexcept { return last; }
+		};
+
+		[[nodiscard]] size_t size() const noexcept { return count; }
+		[[nodiscard]] bool empty() const noexcept { return count == 0; }
+
+		[[nodiscard]] const_iterator begin() const noexcept { return { *this, 0 }; }
+		[[nodiscard]] const_iterator end() const noexcept { return { *this, count }; }
+		[[nodiscard]] chunk_range get_chunks() const noexcept { return { { *this, 0 }, { *this, (count + chunk_mask) & ~chunk_mask } }; }
+
+		// Vectors of up to a chunk of elements have no branches, and are indexed without walking the tree
+		[[nodiscard]] T const& operator[](size_t i) const noexcept { return get_chunk_values(i)[i & chunk_mask]; }
+
+		// Returns a reference to the element which is not shared with any other vector
+		// Nodes on the path of the element are copied if they were shared
+		[[nodiscard]] T& get_mutable(size_t i)
+		{
+			std::shared_ptr<void>* n = &root;
+			for (size_t level = shift; level > 0; level -= ChunkBits)
+				n = &make_unique_node<branch>(*n).children[(i >> level) & chunk_mask];
+			return make_unique_node<leaf>(*n).values[i & chunk_mask];
+		}
+
+		void set(size_t i, T value) { get_mutable(i) = std::move(value); }
+
+		void push_back(T value)
+		{
+			if (count == get_capacity())
+			{
+				// Full tree: it becomes the first child of a new root
+				auto new_root = std::make_shared<branch>();
+				new_root->children[0] = std::move(root);
+				root = std::move(new_root);
+				shift += ChunkBits;
+			}
+
+			get_mutable(count) = std::move(value);
+			++count;
+		}
+
+		// Shrinking keeps the storage of the removed elements until they are overwritten
+		void resize(size_t new_size, T const& value = T{})
+		{
+			if (new_size < count)
+				count = new_size;
+
+			while (count < new_size)
+				push_back(value);
+		}
+
+		void clear() noexcept
+		{
+			root.reset();
+			count = 0;
+			shift = 0;
+		}
+
+		// Bytes of the nodes of the vector. Nodes already in 'counted_nodes' are shared with a vector counted before, and are skipped
+		// This allows measuring the memory of many versions of a vector together
+		[[nodiscard]] size_t count_bytes(std::unordered_set<void const*>& counted_nodes) const
+		{
+			return count_node_bytes(root.get(), shift, counted_nodes);
+		}
+	};
+}
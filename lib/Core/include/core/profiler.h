@@ -0,0 +1,79 @@
+#pragma once
+
+#include "core/size_t.h"
+#include "core/stdint.h"
+
+#include <iosfwd>
+#include <span>
+#include <vector>
+
+// Defining OT_PROFILER_DISABLE compiles the zones and frame marks out
+#if !defined(OT_PROFILER_DISABLE)
+#  define OT_PROFILER 1
+#else
+#  define OT_PROFILER 0
+#endif
+
+namespace ot::profiler
+{
+	// A timed scope of a thread. Times are in nanoseconds since the profiler started
+	struct zone
+	{
+		char const* name; // must outlive the profiler, like a string literal
+		int64_t start;
+		int64_t end;
+		uint32_t lane; // ring the zone was recorded in
+		uint32_t depth; // number of zones of the lane the zone is nested in
+	};
+
+	// Each thread records its zones into a ring of its own, new zones overwriting the oldest ones
+	// Rings of exited threads are reused by new threads, so that short-lived workers don't add a ring each. A ring is a lane of the timeline rather than a thread
+	inline constexpr size_t max_lane_zone_count = size_t(1) << 15;
+	inline constexpr size_t max_frame_count = 256;
+
+	[[nodiscard]] int64_t now() noexcept;
+
+	class scoped_zone
+	{
+		char const* name;
+		int64_t start;
+
+	public:
+		explicit scoped_zone(char const* name) noexcept;
+		scoped_zone(scoped_zone const&) = delete;
+		scoped_zone& operator=(scoped_zone const&) = delete;
+		~scoped_zone();
+	};
+
+	// Names the lane of the calling thread in the views and traces
+	void set_thread_name(char const* name) noexcept;
+
+	// Marks the start of a frame, once per frame from the main loop
+	void mark_frame() noexcept;
+
+	// Nothing is recorded while paused, so that the last frames can be looked at
+	void set_paused(bool paused) noexcept;
+	[[nodiscard]] bool is_paused() noexcept;
+
+	// Replaces the content of 'starts' with the starts of the last frames, oldest first
+	void get_frames(std::vector<int64_t>& starts);
+	// Appends the zones of every lane overlapping [from, to), in no particular order
+	void get_zones(int64_t from, int64_t to, std::vector<zone>& zones);
+	[[nodiscard]] size_t get_lane_count();
+	// Null when no thread using the lane was named
+	[[nodiscard]] char const* get_lane_name(uint32_t lane);
+
+	// Writes the zones in the Chrome trace event format, which chrome://tracing and Perfetto open
+	void write_chrome_trace(std::ostream& out, std::span<zone const> zones);
+}
+
+#define OT_PROFILER_CONCAT_IMPL(a, b) a##b
+#define OT_PROFILER_CONCAT(a, b) OT_PROFILER_CONCAT_IMPL(a, b)
+
+#if OT_PROFILER
+#  define OT_PROFILE_ZONE(name) ::ot::profiler::scoped_zone const OT_PROFILER_CONCAT(ot_profile_zone_, __LINE__)(name)
+#  define OT_PROFILE_FRAME() ::ot::profiler::mark_frame()
+#else
+#  define OT_PROFILE_ZONE(name) ((void)0)
+#  define OT_PROFILE_FRAME() ((void)0)
+#endif
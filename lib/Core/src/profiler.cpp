@@ -0,0 +1,245 @@
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+namespace ot::profiler
+{
+	namespace
+	{
+		using clock = std::chrono::steady_clock;
+
+		// Only its thread writes into a lane, readers copy the zones and drop the ones which could have been overwritten meanwhile
+		struct lane
+		{
+			std::unique_ptr<zone[]> zones{ new zone[max_lane_zone_count] };
+			std::atomic<uint64_t> next_zone{ 0 };
+			std::atomic<char const*> name{ nullptr };
+			uint32_t index = 0;
+			uint32_t depth = 0; // only touched by the thread using the lane
+			bool used = false; // guarded by the mutex of the profiler
+		};
+
+		struct profiler_data
+		{
+			clock::time_point const origin = clock::now();
+			std::mutex mutex; // locked when a thread takes or gives back a lane, and to list the lanes
+			std::vector<std::unique_ptr<lane>> lanes;
+			std::vector<uint64_t> copied_indices; // of the zones copied out of a lane, kept for its memory
+			std::array<std::atomic<int64_t>, max_frame_count> frames{};
+			std::atomic<uint64_t> next_frame{ 0 };
+			std::atomic<bool> paused{ false };
+		};
+
+		profiler_data& get_data()
+		{
+			static profiler_data data;
+			return data;
+		}
+
+		lane& take_lane()
+		{
+			profiler_data& data = get_data();
+			std::scoped_lock const lock(data.mutex);
+
+			auto const free_lane = std::ranges::find(data.lanes, false, [](std::unique_ptr<lane> const& l) { return l->used; });
+			if (free_lane != data.lanes.end())
+			{
+				(*free_lane)->used = true;
+				(*free_lane)->depth = 0;
+				return **free_lane;
+			}
+
+			lane& l = *data.lanes.emplace_back(new lane);
+			l.index = static_cast<uint32_t>(data.lanes.size() - 1);
+			l.used = true;
+			return l;
+		}
+
+		// Gives the lane back when the thread exits
+		struct thread_lane
+		{
+			lane& l = take_lane();
+
+			~thread_lane()
+			{
+				profiler_data& data = get_data();
+				std::scoped_lock const lock(data.mutex);
+				l.used = false;
+			}
+		};
+
+		lane& get_thread_lane()
+		{
+			thread_local thread_lane tl;
+			return tl.l;
+		}
+
+		void write_escaped(std::ostream& out, char const* s)
+		{
+			for (; *s != '\0'; ++s)
+			{
+				if (*s == '"' || *s == '\\')
+					out << '\\';
+				out << *s;
+			}
+		}
+	}
+
+	int64_t now() noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - get_data().origin).count();
+	}
+
+	scoped_zone::scoped_zone(char const* name) noexcept
+		: name(name)
+		, start(now())
+	{
+		++get_thread_lane().depth;
+	}
+
+	scoped_zone::~scoped_zone()
+	{
+		lane& l = get_thread_lane();
+		uint32_t const depth = --l.depth;
+		if (get_data().paused.load(std::memory_order_relaxed))
+			return;
+
+		uint64_t const index = l.next_zone.load(std::memory_order_relaxed);
+		l.zones[index % max_lane_zone_count] = { name, start, now(), l.index, depth };
+		l.next_zone.store(index + 1, std::memory_order_release);
+	}
+
+	void set_thread_name(char const* name) noexcept
+	{
+		get_thread_lane().name.store(name, std::memory_order_relaxed);
+	}
+
+	void mark_frame() noexcept
+	{
+		profiler_data& data = get_data();
+		if (data.paused.load(std::memory_order_relaxed))
+			return;
+
+		uint64_t const index = data.next_frame.load(std::memory_order_relaxed);
+		data.frames[index % max_frame_count].store(now(), std::memory_order_relaxed);
+		data.next_frame.store(index + 1, std::memory_order_release);
+	}
+
+	void set_paused(bool paused) noexcept
+	{
+		get_data().paused.store(paused, std::memory_order_relaxed);
+	}
+
+	bool is_paused() noexcept
+	{
+		return get_data().paused.load(std::memory_order_relaxed);
+	}
+
+	void get_frames(std::vector<int64_t>& starts)
+	{
+		profiler_data const& data = get_data();
+		uint64_t const end = data.next_frame.load(std::memory_order_acquire);
+		uint64_t const begin = end > max_frame_count ? end - max_frame_count : 0;
+
+		starts.clear();
+		for (uint64_t i = begin; i != end; ++i)
+			starts.push_back(data.frames[i % max_frame_count].load(std::memory_order_relaxed));
+	}
+
+	void get_zones(int64_t from, int64_t to, std::vector<zone>& zones)
+	{
+		profiler_data& data = get_data();
+		std::scoped_lock const lock(data.mutex);
+
+		for (std::unique_ptr<lane> const& l : data.lanes)
+		{
+			uint64_t const end = l->next_zone.load(std::memory_order_acquire);
+			uint64_t const begin = end > max_lane_zone_count ? end - max_lane_zone_count : 0;
+
+			// Zones are in the order they ended, so the walk back from the newest stops at the first zone ending before the range
+			size_t const first_copied = zones.size();
+			data.copied_indices.clear();
+			for (uint64_t i = end; i > begin; --i)
+			{
+				zone const& z = l->zones[(i - 1) % max_lane_zone_count];
+				if (z.end <= from)
+					break;
+
+				if (z.start < to)
+				{
+					zones.push_back(z);
+					data.copied_indices.push_back(i - 1);
+				}
+			}
+
+			// The thread may have written over the oldest copied zones meanwhile, including the zone it was writing when the copy ended
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t const after = l->next_zone.load(std::memory_order_relaxed);
+			uint64_t const first_valid = after >= max_lane_zone_count ? after - max_lane_zone_count + 1 : 0;
+			auto const overwritten = std::ranges::find_if(data.copied_indices, [first_valid](uint64_t i) { return i < first_valid; });
+			zones.resize(first_copied + static_cast<size_t>(overwritten - data.copied_indices.begin()));
+		}
+	}
+
+	size_t get_lane_count()
+	{
+		profiler_data& data = get_data();
+		std::scoped_lock const lock(data.mutex);
+		return data.lanes.size();
+	}
+
+	char const* get_lane_name(uint32_t lane)
+	{
+		profiler_data& data = get_data();
+		std::scoped_lock const lock(data.mutex);
+		if (lane >= data.lanes.size())
+			return nullptr;
+		return data.lanes[lane]->name.load(std::memory_order_relaxed);
+	}
+
+	void write_chrome_trace(std::ostream& out, std::span<zone const> zones)
+	{
+		auto const flags = out.flags();
+		auto const precision = out.precision();
+		out.setf(std::ios::fixed, std::ios::floatfield);
+		out.precision(3);
+
+		out << "{\"traceEvents\":[";
+		bool first = true;
+
+		size_t const lane_count = get_lane_count();
+		for (uint32_t l = 0; l < lane_count; ++l)
+		{
+			char const* const name = get_lane_name(l);
+			if (name == nullptr)
+				continue;
+
+			out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << l << ",\"args\":{\"name\":\"";
+			write_escaped(out, name);
+			out << "\"}}";
+			first = false;
+		}
+
+		// Complete events, in microseconds
+		for (zone const& z : zones)
+		{
+			out << (first ? "\n" : ",\n") << "{\"name\":\"";
+			write_escaped(out, z.name);
+			out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << z.lane
+				<< ",\"ts\":" << static_cast<double>(z.start) / 1000.0
+				<< ",\"dur\":" << static_cast<double>(z.end - z.start) / 1000.0 << "}";
+			first = false;
+		}
+
+		out << "\n]}\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+}
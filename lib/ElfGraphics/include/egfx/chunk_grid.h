@@ -0,0 +1,149 @@
+#pragma once
+
+#include "egfx/mesh_definition.fwd.h"
+#include "egfx/mesh_buffer.h"
+
+#include "math/transform_matrix.h"
+#include "math/aabb.h"
+
+#include "core/size_t.h"
+#include "core/stdint.h"
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ot::egfx
+{
+	// Cell of a regular grid in world space
+	struct chunk_coord
+	{
+		int32_t x;
+		int32_t y;
+		int32_t z;
+
+		[[nodiscard]] bool operator==(chunk_coord const& rhs) const noexcept = default;
+	};
+
+	// Returns the cell of the grid holding the point. Cells include their lowest bound
+	[[nodiscard]] chunk_coord get_chunk_coord(math::point3f p, float chunk_size) noexcept;
+
+	struct chunk_coord_hash
+	{
+		[[nodiscard]] size_t operator()(chunk_coord const& cell) const noexcept;
+	};
+
+	enum class chunk_part_id : uint32_t { none = 0xFFFFFFFF };
+
+	// A mesh placed in the world, to be merged with the other parts of its chunk
+	// The material is opaque to the grid, parts of a chunk with the same material are merged into one submesh
+	struct chunk_part
+	{
+		std::shared_ptr<mesh_definition const> mesh;
+		math::transform_matrix transform;
+		uint64_t material = 0;
+	};
+
+	// Parts of a chunk with the same material, placed in world space
+	struct chunk_submesh
+	{
+		uint64_t material = 0;
+		std::vector<submesh_part> parts;
+	};
+
+	// Sorts meshes into the cells of a world-space grid, so that each chunk can be drawn as one mesh with a merged submesh per material
+	// A part belongs to the cell holding the center of its world bounds, the merged geometry of a chunk can reach out of its cell
+	// Changes are tracked per chunk, so that only the buffers of the chunks whose parts changed are built again
+	class chunk_grid
+	{
+	public:
+		struct chunk
+		{
+			chunk_coord cell;
+			std::vector<chunk_part_id> parts;
+		};
+
+		static constexpr float default_chunk_size = 32.f;
+
+	private:
+		struct part_slot
+		{
+			chunk_part part;
+			chunk_coord cell{};
+			bool used = false;
+		};
+
+		float chunk_size;
+		std::vector<part_slot> parts; // by part id
+		std::vector<chunk_part_id> free_ids;
+		std::unordered_map<chunk_coord, chunk, chunk_coord_hash> chunks;
+		std::vector<chunk_coord> dirty_chunks;
+		std::unordered_set<chunk_coord, chunk_coord_hash> dirty_chunk_set; // keeps 'dirty_chunks' without duplicates
+		std::unordered_set<chunk_coord, chunk_coord_hash> shrunk_chunk_set; // dirty chunks which lost parts
+
+		[[nodiscard]] part_slot const& get_slot(chunk_part_id id) const;
+		[[nodiscard]] chunk_coord get_part_cell(chunk_part const& part) const;
+		void insert(chunk_part_id id);
+		void erase(chunk_part_id id);
+		void mark_dirty(chunk_coord const& cell);
+
+	public:
+		explicit chunk_grid(float chunk_size = default_chunk_size);
+
+		// Throws std::invalid_argument for parts without a mesh
+		chunk_part_id add(chunk_part part);
+		// Throws std::invalid_argument for unknown parts
+		void remove(chunk_part_id id);
+		// Replaces the mesh, transform or material of a part, which can move it to another chunk
+		void set(chunk_part_id id, chunk_part part);
+		void clear();
+
+		[[nodiscard]] bool contains(chunk_part_id id) const noexcept;
+		[[nodiscard]] chunk_part const& get_part(chunk_part_id id) const { return get_slot(id).part; }
+		[[nodiscard]] chunk_coord const& get_part_chunk(chunk_part_id id) const { return get_slot(id).cell; }
+		// Returns null when no part is in the chunk
+		[[nodiscard]] chunk const* find_chunk(chunk_coord const& cell) const noexcept;
+
+		[[nodiscard]] float get_chunk_size() const noexcept { return chunk_size; }
+		[[nodiscard]] size_t get_part_count() const noexcept { return parts.size() - free_ids.size(); }
+		// Number of chunks holding parts, one mesh each
+		[[nodiscard]] size_t get_chunk_count() const noexcept { return chunks.size(); }
+
+		// Chunks whose parts changed since the last call to clear_dirty_chunks, including the chunks which were emptied
+		[[nodiscard]] std::span<chunk_coord const> get_dirty_chunks() const noexcept { return dirty_chunks; }
+		[[nodiscard]] bool is_chunk_dirty(chunk_coord const& cell) const noexcept { return dirty_chunk_set.contains(cell); }
+		// Whether the dirty chunk lost parts, removed or moved to another chunk. Until built again, its merged geometry still holds them
+		[[nodiscard]] bool has_lost_parts(chunk_coord const& cell) const noexcept { return shrunk_chunk_set.contains(cell); }
+		void clear_dirty_chunks() noexcept;
+
+		// Groups the parts of the chunk by material, in increasing material order, each part placed in world space by its transform
+		// Empty when the chunk has no parts. The parts point to the meshes of the grid, and are only valid until the grid changes
+		[[nodiscard]] std::vector<chunk_submesh> make_submeshes(chunk_coord const& cell) const;
+	};
+
+	// Orders the builds of the dirty chunks of a grid, so that they can be spread over several updates
+	// Chunks which lost parts come first and are urgent: until they are built, the parts removed from them are still drawn
+	class chunk_build_queue
+	{
+		std::deque<chunk_coord> urgent_cells;
+		std::deque<chunk_coord> other_cells; // may hold chunks already popped as urgent, which are skipped
+		std::unordered_map<chunk_coord, bool, chunk_coord_hash> queued; // whether each queued chunk is urgent
+
+	public:
+		// Queues the dirty chunks of the grid behind the chunks already waiting, or in front of them when they lost parts, then clears the dirty chunks of the grid
+		void take_dirty_chunks(chunk_grid& grid);
+		// Returns the next chunk to build, or nothing when every chunk was popped
+		[[nodiscard]] std::optional<chunk_coord> pop();
+		void clear() noexcept;
+
+		// Whether the next chunk lost parts and should be built whatever the budget
+		[[nodiscard]] bool is_next_urgent() const noexcept { return !urgent_cells.empty(); }
+		[[nodiscard]] bool contains(chunk_coord const& cell) const noexcept { return queued.contains(cell); }
+		[[nodiscard]] size_t size() const noexcept { return queued.size(); }
+		[[nodiscard]] bool empty() const noexcept { return queued.empty(); }
+	};
+}
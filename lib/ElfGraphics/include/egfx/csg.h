@@ -0,0 +1,128 @@
+#pragma once
+
+#include "egfx/mesh_definition.fwd.h"
+
+#include "math/vector3.h"
+#include "math/plane.h"
+#include "math/transform_matrix.h"
+#include "math/aabb.h"
+#include "math/unit/time.h"
+
+#include "core/size_t.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Constructive solid geometry over convex brushes
+namespace ot::egfx::csg
+{
+	enum class operation
+	{
+		add, // the volume of the brush becomes solid
+		subtract, // the volume of the brush becomes empty
+		intersect, // only the solid within the volume of the brush stays solid
+	};
+
+	struct brush
+	{
+		std::shared_ptr<mesh_definition const> mesh;
+		math::transform_matrix transform = math::transform_matrix::identity();
+		operation op = operation::add;
+	};
+
+	// Convex polygon of the surface of the result, on a face of one of the brushes
+	struct polygon
+	{
+		std::vector<math::point3f> vertices; // counter-clockwise around the normal of the plane
+		math::plane plane; // faces away from the solid
+		size_t brush; // index of the brush the polygon lies on, or its id for the incremental_evaluator
+		face::id face; // face of the brush the polygon lies on
+	};
+
+	// Distance under which points are considered on a plane, in world units
+	inline constexpr float plane_epsilon = 1e-4f;
+
+	// Applies the operations of the brushes in order, starting from empty space, and returns the polygons bounding the resulting solid
+	// Only brushes whose bounds overlap are tested against each other. Brushes are processed on 'thread_count' threads (0 for one per hardware thread)
+	// Where faces of several brushes coincide, the resulting polygon is only produced for the last of these brushes
+	[[nodiscard]] std::vector<polygon> evaluate(std::span<brush const> brushes, size_t thread_count = 0);
+
+	// Faces of a brush in world space
+	struct world_brush
+	{
+		std::vector<math::plane> planes;
+		std::vector<std::vector<math::point3f>> face_vertices;
+		math::aabb bounds;
+	};
+
+	enum class brush_id : uint64_t {};
+
+	// Keeps the result of 'evaluate' up to date as brushes are added, moved and removed, brushes being applied in increasing id order
+	// Brushes whose bounds overlap depend on each other: changing a brush only re-evaluates it and the brushes it overlaps before or after the change,
+	// except for intersections which affect every brush. Re-evaluation is deferred to 'update', which can be spread over several frames
+	class incremental_evaluator
+	{
+		struct brush_state
+		{
+			operation op;
+			world_brush world;
+			std::vector<brush_id> neighbours; // brushes whose bounds overlap this one, in increasing id order
+			std::vector<polygon> polygons;
+			bool dirty;
+		};
+
+		float cell_size;
+		std::map<brush_id, brush_state> brushes;
+		std::unordered_map<uint64_t, std::vector<brush_id>> cells; // brushes whose bounds overlap each cell of a sparse grid
+		std::vector<brush_id> large_brushes; // brushes overlapping too many cells to be in the grid
+		std::set<brush_id> intersections;
+		std::deque<brush_id> dirty_brushes; // may hold removed or already evaluated brushes, which are skipped
+		size_t dirty_count = 0;
+		std::vector<brush_id> updated_brushes;
+
+		void mark_dirty(brush_id id, brush_state& state);
+		void mark_all_dirty();
+		void add_to_grid(brush_id id, math::aabb const& bounds);
+		void remove_from_grid(brush_id id, math::aabb const& bounds);
+		[[nodiscard]] std::vector<brush_id> find_overlapping(brush_id id, math::aabb const& bounds) const;
+		void unlink(brush_id id, brush_state& state);
+
+	public:
+		// Bounds are indexed in a grid of cubes of 'cell_size', which should be around the size of the common brushes
+		explicit incremental_evaluator(float cell_size = 8.f);
+
+		// Adds the brush, or replaces the brush with the same id
+		void set_brush(brush_id id, brush const& b);
+		void remove_brush(brush_id id);
+		void clear();
+
+		[[nodiscard]] bool contains(brush_id id) const { return brushes.contains(id); }
+		[[nodiscard]] size_t size() const noexcept { return brushes.size(); }
+
+		// Re-evaluates the brushes affected by the changes since the last update, stopping once 'budget' has elapsed
+		// At least one brush is evaluated per call so that the result always progresses. Returns whether every brush is up to date
+		bool update(math::milliseconds budget);
+		bool update();
+
+		// Number of brushes waiting to be re-evaluated
+		[[nodiscard]] size_t get_dirty_count() const noexcept { return dirty_count; }
+		[[nodiscard]] bool is_up_to_date() const noexcept { return dirty_count == 0; }
+
+		// The polygons of the result lying on the faces of the brush, as of its last evaluation
+		[[nodiscard]] std::span<polygon const> get_polygons(brush_id id) const;
+		// Every polygon of the result, in brush order
+		[[nodiscard]] std::vector<polygon> get_result() const;
+		// The brushes whose polygons depend on the brush, and which the polygons of the brush depend on
+		[[nodiscard]] std::span<brush_id const> get_neighbours(brush_id id) const;
+
+		// Brushes evaluated or removed since the last call to 'clear_updated_brushes', possibly several times
+		[[nodiscard]] std::span<brush_id const> get_updated_brushes() const noexcept { return updated_brushes; }
+		void clear_updated_brushes() noexcept { updated_brushes.clear(); }
+	};
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace ot::egfx::imgui::profiler_window
+{
+	// Timeline of the zones recorded during one of the last frames, with the times of these frames and an export to a Chrome trace
+	void draw(bool* enabled);
+}
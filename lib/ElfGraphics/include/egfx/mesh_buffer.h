@@ -0,0 +1,159 @@
+#pragma once
+
+#include "egfx/mesh_definition.fwd.h"
+#include "egfx/material.h"
+
+#include "math/vector3.h"
+#include "math/vector2.h"
+#include "math/aabb.h"
+#include "math/transform_matrix.h"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+#include <span>
+
+namespace ot::egfx
+{
+	// Vertex format of the render meshes. Vertices are not shared between faces, so that each face gets its own normal
+	struct render_vertex
+	{
+		math::point3f position;
+		math::vector3f normal;
+		math::point2f uv;
+	};
+
+	enum class index_format
+	{
+		uint16,
+		uint32,
+	};
+
+	// A definition placed in the space of the render mesh
+	struct submesh_part
+	{
+		mesh_definition const* mesh = nullptr;
+		std::optional<math::transform_matrix> transform; // none for definitions already in the space of the mesh
+
+		submesh_part(mesh_definition const* mesh) noexcept
+			: mesh(mesh)
+		{
+
+		}
+
+		submesh_part(mesh_definition const* mesh, math::transform_matrix const& transform) noexcept
+			: mesh(mesh)
+			, transform(transform)
+		{
+
+		}
+	};
+
+	// Geometry of a single submesh of a render mesh. Every part is drawn with the material of the submesh
+	struct submesh_definition
+	{
+		std::vector<submesh_part> parts;
+		material_handle_t material{};
+		// Share the vertices of face corners which have the same attributes, and order triangles for the vertex cache
+		// Slower to build, so it should be kept for geometry that changes rarely
+		bool weld_vertices = false;
+	};
+
+	// Size of the vertex and index buffers of a submesh
+	struct submesh_buffer_layout
+	{
+		size_t vertex_count = 0;
+		size_t index_count = 0;
+		index_format format = index_format::uint16;
+
+		[[nodiscard]] size_t get_index_size() const noexcept { return format == index_format::uint16 ? sizeof(uint16_t) : sizeof(uint32_t); }
+		[[nodiscard]] size_t get_vertex_buffer_size() const noexcept { return vertex_count * sizeof(render_vertex); }
+		[[nodiscard]] size_t get_index_buffer_size() const noexcept { return index_count * get_index_size(); }
+	};
+
+	// Highest vertex count a 16-bit index buffer can address. 0xFFFF is left out, as some render systems reserve it for primitive restart
+	inline constexpr size_t max_16bit_vertex_count = 0xFFFF;
+
+	// Counts the vertices and indices of the triangulated parts, and picks the smallest index format that can address all the vertices
+	[[nodiscard]] submesh_buffer_layout get_submesh_buffer_layout(std::span<submesh_part const> parts);
+
+	// Writes the parts as fan-shaped triangle lists, one after the other
+	// 'vertices' must hold exactly layout.vertex_count elements, and 'indices' exactly layout.get_index_buffer_size() bytes
+	void write_submesh_buffers(std::span<submesh_part const> parts, submesh_buffer_layout const& layout, std::span<render_vertex> vertices, std::span<std::byte> indices);
+
+	// Indexed triangles of a submesh, kept on the CPU until written to render buffers
+	struct triangle_list
+	{
+		std::vector<render_vertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	// Triangulates the parts, welding face corners which have the same position, normal and uv into a single vertex
+	// Indices are ordered for the post-transform vertex cache
+	[[nodiscard]] triangle_list make_welded_triangle_list(std::span<submesh_part const> parts);
+
+	// Reorders the triangles to make better use of the post-transform vertex cache, using Tom Forsyth's linear-speed algorithm
+	// The winding of each triangle is kept
+	void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count);
+
+	// Average cache miss ratio: vertex shader invocations per triangle, simulated for a FIFO cache of the given size
+	[[nodiscard]] float get_acmr(std::span<uint32_t const> indices, size_t cache_size);
+
+	// Returns the layout of the buffers for the list, picking the smallest index format that can address all the vertices
+	[[nodiscard]] submesh_buffer_layout get_submesh_buffer_layout(triangle_list const& list);
+
+	// Copies the list to the buffers. Like the other overload, the buffers must match the layout exactly
+	void write_submesh_buffers(triangle_list const& list, submesh_buffer_layout const& layout, std::span<render_vertex> vertices, std::span<std::byte> indices);
+
+	// Returns the bounds of the vertices of the list
+	[[nodiscard]] math::aabb get_triangle_bounds(triangle_list const& list);
+
+	// Position of the vertices and indices of a face in the render buffers
+	struct face_buffer_range
+	{
+		size_t vertex_start = 0;
+		size_t vertex_capacity = 0;
+		size_t index_start = 0;
+		size_t index_capacity = 0;
+	};
+
+	// Placement of the faces of a mesh_definition in render buffers, with spare room so that edited faces can be rewritten in place
+	// Unused room is filled with degenerate triangles, which the hardware discards
+	class face_buffer_map
+	{
+		std::vector<face_buffer_range> ranges; // by face id
+		submesh_buffer_layout layout; // capacity of the buffers
+		size_t used_vertex_count = 0;
+		size_t used_index_count = 0;
+
+		[[nodiscard]] bool try_append(size_t face_vertex_count);
+
+	public:
+		// Number of vertices a face can gain before the buffers must be rebuilt
+		static constexpr size_t face_vertex_slack = 4;
+		// Fraction of the buffers kept at the end for new faces
+		static constexpr float spare_capacity = 0.5f;
+
+		face_buffer_map() = default;
+		explicit face_buffer_map(mesh_definition const& m);
+
+		[[nodiscard]] submesh_buffer_layout const& get_layout() const noexcept { return layout; }
+		[[nodiscard]] size_t get_face_count() const noexcept { return ranges.size(); }
+		[[nodiscard]] face_buffer_range const& get_range(face::id f) const { return ranges[static_cast<size_t>(f)]; }
+
+		// Places the faces of the mesh which changed, appending new faces in the spare room
+		// Returns false when a face does not fit anymore, in which case the buffers must be rebuilt with a new map
+		[[nodiscard]] bool update(mesh_definition const& m, std::span<face::id const> changed_faces);
+	};
+
+	// Writes every face of the mesh in its range of the map. Room after the faces is filled with degenerate triangles
+	// 'vertices' and 'indices' are whole buffers, of the size given by the layout of the map
+	void write_submesh_buffers(mesh_definition const& m, face_buffer_map const& map, std::span<render_vertex> vertices, std::span<std::byte> indices);
+
+	// Writes a face over its whole range, filling room after the face with degenerate triangles
+	// 'vertices' and 'indices' only cover the range of the face
+	void write_face_buffers(face::cref face, face_buffer_range const& range, index_format format, std::span<render_vertex> vertices, std::span<std::byte> indices);
+
+	// Returns the bounds containing every part of every submesh
+	[[nodiscard]] math::aabb get_submesh_bounds(std::span<submesh_definition const> submeshes);
+}
@@ -24,4 +24,5 @@ namespace ot::egfx
 	}
 
 	class mesh_definition;
+	class mesh_definition_cache;
 }
@@ -7,13 +7,16 @@
 #include "math/plane.h"
 #include "math/aabb.h"
 #include "math/line.h"
+#include "math/fixed_point.h"
 #include "core/size_t.h"
 #include "core/iterator/arrow_proxy.h"
 #include "core/expected.h"
+#include "core/persistent_vector.h"
 
 #include <vector>
 #include <span>
 #include <numbers>
+#include <unordered_set>
 
 namespace ot::egfx
 {	
@@ -46,6 +49,25 @@ namespace ot::egfx
 		};
 	}
 
+	// How the texture coordinates of a face are projected from the positions of its corners
+	enum class uv_projection
+	{
+		cubic, // onto the axis-aligned plane closest to the face, so that neighbouring faces facing the same way line up
+		planar, // onto the plane of the face itself, which does not stretch the texture on sloped faces
+	};
+
+	// Texture alignment of a face. The projected coordinates are rotated, then scaled, then offset
+	struct uv_mapping
+	{
+		uv_projection projection = uv_projection::cubic;
+		math::vector2f offset{ 0.f, 0.f };
+		math::vector2f scale{ 1.f, 1.f };
+		float rotation = 0.f; // in radians
+
+		// Returns the texture coordinates of a point on a face with the given normal
+		[[nodiscard]] math::point2f project(math::point3f p, math::vector3f face_normal) const noexcept;
+	};
+
 	namespace detail
 	{
 		template<typename RefType>
@@ -72,10 +94,6 @@ namespace ot::egfx
 		class face_vertex_range;
 
 		class const_face_vertex_range;
-
-		struct vertex_data;
-		struct half_edge_data;
-		struct face_data;
 	}
 
 	namespace vertex
@@ -102,10 +120,6 @@ namespace ot::egfx
 			// Get the position in the mesh's local space of the vertex
 			[[nodiscard]] math::point3f get_position() const;
 
-			// Get the UV coordinates of the vertex
-			// TODO: need a UV per face, using a Cubic projection
-			[[nodiscard]] math::point2f get_uv() const;
-
 			// Returns a range of the half-edges around the given vertex
 			[[nodiscard]] auto get_half_edges() const -> detail::const_half_edge_range<detail::vertex_half_edge_iteration>;
 
@@ -196,6 +210,9 @@ namespace ot::egfx
 			// Returns the line from the source vertex to the target vertex
 			[[nodiscard]] math::line get_line() const;
 
+			// Returns the texture coordinates of the face corner the half-edge leaves from
+			[[nodiscard]] math::point2f get_uv() const;
+
 			// Returns whether the half-edge is the "primary" unit in the pair.
 			// Mostly useful for traversing each edge once
 			[[nodiscard]] bool is_primary() const;
@@ -252,6 +269,9 @@ namespace ot::egfx
 			// Returns the line from the source vertex to the target vertex
 			[[nodiscard]] math::line get_line() const;
 
+			// Returns the texture coordinates of the face corner the half-edge leaves from
+			[[nodiscard]] math::point2f get_uv() const;
+
 			// Returns whether the half-edge is the "primary" unit in the pair.
 			// Mostly useful for traversing each edge once
 			[[nodiscard]] bool is_primary() const;
@@ -295,8 +315,6 @@ namespace ot::egfx
 			mesh_definition const* m;
 			id f;
 
-			detail::face_data const& get_face_data() const noexcept;
-
 		public:
 			using id_type = id;
 			using mesh_type = mesh_definition const;
@@ -326,6 +344,9 @@ namespace ot::egfx
 			// Returns the plane parallel to the face
 			[[nodiscard]] math::plane get_plane() const;
 
+			// Returns how the texture coordinates of the corners of the face are computed
+			[[nodiscard]] uv_mapping const& get_uv_mapping() const;
+
 			// Returns whether the point is on the face. 
 			// The point must be in the local coordinates of the mesh definition
 			[[nodiscard]] bool is_on_face(math::point3f p) const;
@@ -350,8 +371,6 @@ namespace ot::egfx
 			mesh_definition* m;
 			id f;
 
-			detail::face_data& get_face_data() const noexcept;
-
 		public:
 			using id_type = id;
 			using mesh_type = mesh_definition;
@@ -384,6 +403,12 @@ namespace ot::egfx
 			// Returns the plane parallel to the face
 			[[nodiscard]] math::plane get_plane() const { return as_const().get_plane(); }
 
+			// Returns how the texture coordinates of the corners of the face are computed
+			[[nodiscard]] uv_mapping const& get_uv_mapping() const { return as_const().get_uv_mapping(); }
+
+			// Recomputes the texture coordinates of the corners of the face with the new mapping, and marks the face dirty
+			void set_uv_mapping(uv_mapping const& mapping) const;
+
 			// Returns whether the point is on the face. 
 			// The point must be in the local coordinates of the mesh definition
 			[[nodiscard]] bool is_on_face(math::point3f p) const { return as_const().is_on_face(p); }
@@ -409,32 +434,70 @@ namespace ot::egfx
 		};
 	}
 
+	// How the vertices of a mesh constructed from planes are placed
+	enum class vertex_precision
+	{
+		floating, // where the planes meet, within floating point error
+		snapped, // planes and vertices snapped to the grids of math/fixed_point.h, so that equal brushes get bitwise equal vertices whatever transforms built their planes
+	};
+
 	// A mesh representing a three-dimensional manifold formed of faces, vertices, and pairs of half-edges between each vertex
 	// 
 	class mesh_definition
 	{
-		using vertex_data = detail::vertex_data;
-		using half_edge_data = detail::half_edge_data;
-		using face_data = detail::face_data;
+		// Element attributes are stored as a structure of arrays, indexed by element id
+		// The arrays are persistent vectors: a copy of the mesh shares all its chunks with the original, and an edit only copies the chunks it writes to
+		// This keeps the versions of a brush held by the undo history cheap
+		persistent_vector<math::point3f> vertex_positions;
+		persistent_vector<half_edge::id> vertex_first_edges; // arbitrary half-edge leaving the vertex
+
+		persistent_vector<vertex::id> half_edge_vertices; // vertex at the tip of the half edge
+		persistent_vector<face::id> half_edge_faces; // the face this half-edge borders
+		persistent_vector<half_edge::id> half_edge_twins; // other half-edge in the pair
+		persistent_vector<half_edge::id> half_edge_nexts; // the next half-edge along the face
+		persistent_vector<math::point2f> half_edge_uvs; // texture coordinates of the face corner the half-edge leaves from, kept up to date with the face's uv mapping
+
+		persistent_vector<half_edge::id> face_first_edges; // arbitrary half-edge along the face
+		persistent_vector<vertex::id> face_first_vertices; // source vertex of the face's first half-edge, cached to avoid the hop through the twin
+		persistent_vector<math::vector3f> face_normals;
+		persistent_vector<uv_mapping> face_uv_mappings;
 
-		std::vector<vertex_data> vertices;
-		std::vector<half_edge_data> half_edges;
-		std::vector<face_data> faces;
 		math::aabb bounds{};
 
+		// Faces whose vertices changed since the last call to clear_dirty_faces, without duplicates
+		std::vector<face::id> dirty_faces;
+
 		// Accessors
-		[[nodiscard]] half_edge_data& get_half_edge_data(half_edge::id id) { return half_edges[static_cast<size_t>(id)]; }
-		[[nodiscard]] half_edge_data const& get_half_edge_data(half_edge::id id) const { return half_edges[static_cast<size_t>(id)]; }
-		[[nodiscard]] vertex_data& get_vertex_data(vertex::id id) { return vertices[static_cast<size_t>(id)]; }
-		[[nodiscard]] vertex_data const& get_vertex_data(vertex::id id) const { return vertices[static_cast<size_t>(id)]; }
-		[[nodiscard]] face_data& get_face_data(face::id id) { return faces[static_cast<size_t>(id)]; }
-		[[nodiscard]] face_data const& get_face_data(face::id id) const { return faces[static_cast<size_t>(id)]; }
+		[[nodiscard]] math::point3f get_vertex_position(vertex::id id) const { return vertex_positions[static_cast<size_t>(id)]; }
+		[[nodiscard]] half_edge::id get_vertex_first_edge(vertex::id id) const { return vertex_first_edges[static_cast<size_t>(id)]; }
+		[[nodiscard]] vertex::id get_half_edge_vertex(half_edge::id id) const { return half_edge_vertices[static_cast<size_t>(id)]; }
+		[[nodiscard]] face::id get_half_edge_face(half_edge::id id) const { return half_edge_faces[static_cast<size_t>(id)]; }
+		[[nodiscard]] half_edge::id get_half_edge_twin(half_edge::id id) const { return half_edge_twins[static_cast<size_t>(id)]; }
+		[[nodiscard]] half_edge::id get_half_edge_next(half_edge::id id) const { return half_edge_nexts[static_cast<size_t>(id)]; }
+		[[nodiscard]] math::point2f get_half_edge_uv(half_edge::id id) const { return half_edge_uvs[static_cast<size_t>(id)]; }
+		[[nodiscard]] half_edge::id get_face_first_edge(face::id id) const { return face_first_edges[static_cast<size_t>(id)]; }
+		[[nodiscard]] vertex::id get_face_first_vertex(face::id id) const { return face_first_vertices[static_cast<size_t>(id)]; }
+		[[nodiscard]] math::vector3f get_face_normal(face::id id) const { return face_normals[static_cast<size_t>(id)]; }
+		[[nodiscard]] uv_mapping const& get_face_uv_mapping(face::id id) const { return face_uv_mappings[static_cast<size_t>(id)]; }
+
+		// Allocation of new elements, keeping every attribute array of the element the same size
+		vertex::id add_vertex(math::point3f position, half_edge::id first_edge);
+		half_edge::id add_half_edge();
+		face::id add_face(math::vector3f normal, uv_mapping const& mapping = {});
+		void set_face_first_edge(face::id face, half_edge::id first_edge);
+		void mark_face_dirty(face::id face);
+
+		// Texture coordinates are only computed when corners are added or a mapping changes, so that render data can be rebuilt without projecting again
+		void update_half_edge_uv(half_edge::id id);
+		void update_face_uvs(face::id id);
 
 	public:
 		mesh_definition() = default;
 		// Constructs a mesh from a sequence of planes
-		// The mesh will have as many faces as the number of input planes, and the faces will preserve the same order as the plane with the same normal
-		mesh_definition(std::span<const math::plane> planes);
+		// The mesh will have a face per distinct input plane, and the faces will preserve the same order as the plane with the same normal
+		// Coplanar planes, such as the planes of the halves of a split face, make a single face, the first of them
+		// With snapped precision, corners are classified with exact predicates, and vertices are found by hashing their snapped positions
+		mesh_definition(std::span<const math::plane> planes, vertex_precision precision = vertex_precision::floating);
 
 		[[nodiscard]] vertex::cref get_vertex(vertex::id id) const noexcept { return { *this, id }; }
 		[[nodiscard]] vertex::ref get_vertex(vertex::id id) noexcept { return { *this, id }; }
@@ -450,6 +513,21 @@ namespace ot::egfx
 		[[nodiscard]] auto get_faces() noexcept -> detail::ref_range<face::ref>;
 		[[nodiscard]] math::aabb get_bounds() const noexcept { return bounds; }
 
+		// Faces which had vertices added or removed since the last call to clear_dirty_faces, including new faces
+		// Allows render data to be updated only for the faces an edit touched
+		[[nodiscard]] std::span<face::id const> get_dirty_faces() const noexcept { return dirty_faces; }
+		void clear_dirty_faces() noexcept { dirty_faces.clear(); }
+
+		// Attribute streams, indexed by element id. Useful for passes over every element of the mesh
+		// They are persistent vectors rather than spans: linear passes should read them chunk by chunk through get_chunks, each chunk being contiguous
+		// Indexing walks the tree of chunks, which takes no hop for meshes of up to 32 elements per stream and one up to 1024
+		[[nodiscard]] persistent_vector<math::point3f> const& get_vertex_positions() const noexcept { return vertex_positions; }
+		[[nodiscard]] persistent_vector<math::vector3f> const& get_face_normals() const noexcept { return face_normals; }
+
+		// Returns the bytes used by the elements of the mesh, skipping the chunks in 'counted_chunks'. The chunks of the mesh are added to the set
+		// Counting many versions of a mesh with the same set gives the memory they actually use together
+		[[nodiscard]] size_t count_bytes(std::unordered_set<void const*>& counted_chunks) const;
+
 		// Special range returning only a single half-edge per edge
 		// Useful for traversing each edge only once
 		[[nodiscard]] auto get_edges() const noexcept -> detail::const_half_edge_range<detail::edge_iteration>;
@@ -480,10 +558,11 @@ namespace ot::egfx
 		friend class face::cref;
 		friend class face::ref;
 
-		struct point_intersection;
-		static std::vector<point_intersection> find_intersections(std::span<const math::plane> planes, std::vector<vertex_data>& vertices, std::vector<half_edge_data>& half_edges);
-		static void resolve_edge_directions(std::span<const math::plane> planes, std::span<point_intersection const> intersections, std::span<half_edge_data> half_edges, std::span<face_data> faces);
-		static void update_bounds(math::aabb& bounds, std::span<vertex_data const> vertices);
+		struct face_polygon;
+		// 'fixed_planes' are the snapped planes with snapped precision, and empty otherwise
+		static std::vector<face_polygon> clip_face_polygons(std::span<const math::plane> planes, std::span<math::fixed_plane const> fixed_planes);
+		void link_face_polygons(std::span<face_polygon const> polygons, vertex_precision precision);
+		static void update_bounds(math::aabb& bounds, persistent_vector<math::point3f> const& positions);
 	};
 
 	namespace detail
@@ -701,7 +780,7 @@ namespace ot::egfx
 			{
 				auto& self = static_cast<derived&>(*this);
 
-				auto const next = self.m->get_half_edge_data(self.current).next;
+				auto const next = self.m->get_half_edge_next(self.current);
 				if (next == self.first)
 				{
 					self.current = half_edge::id::none;
@@ -731,7 +810,7 @@ namespace ot::egfx
 			{
 				auto& self = static_cast<derived&>(*this);
 
-				auto const next = self.m->get_half_edge_data(self.m->get_half_edge_data(self.current).twin).next;
+				auto const next = self.m->get_half_edge_next(self.m->get_half_edge_twin(self.current));
 				if (next == self.first)
 				{
 					self.current = half_edge::id::none;
@@ -916,56 +995,36 @@ namespace ot::egfx
 			[[nodiscard]] iterator begin() const noexcept { return { *m, first, first }; }
 			[[nodiscard]] iterator end() const noexcept { return { *m, first, half_edge::id::none }; }
 		};
-
-		struct vertex_data
-		{
-			math::point3f position;
-			half_edge::id first_edge;
-		};
-
-		struct half_edge_data
-		{
-			vertex::id vertex; // vertex at the tip of the half edge
-			face::id face; // the face this half-edge borders
-			half_edge::id twin; // other half-edge in the pair
-			half_edge::id next; // the next half-edge along the face
-		};
-
-		struct face_data
-		{
-			half_edge::id first_edge; // arbitrary half-edge along the face
-			math::vector3f normal;
-		};
 	}
 
 	inline auto mesh_definition::get_vertices() const noexcept -> detail::ref_range<vertex::cref>
 	{
-		return { *this, vertex::id(0), vertex::id(vertices.size()) };
+		return { *this, vertex::id(0), vertex::id(vertex_positions.size()) };
 	}
 
 	inline auto mesh_definition::get_vertices() noexcept -> detail::ref_range<vertex::ref>
 	{
-		return { *this, vertex::id(0), vertex::id(vertices.size()) };
+		return { *this, vertex::id(0), vertex::id(vertex_positions.size()) };
 	}
 
 	inline auto mesh_definition::get_faces() const noexcept -> detail::ref_range<face::cref>
 	{
-		return { *this, face::id(0), face::id(faces.size()) };
+		return { *this, face::id(0), face::id(face_normals.size()) };
 	}
 
 	inline auto mesh_definition::get_faces() noexcept -> detail::ref_range<face::ref>
 	{
-		return { *this, face::id(0), face::id(faces.size()) };
+		return { *this, face::id(0), face::id(face_normals.size()) };
 	}
 
 	inline auto mesh_definition::get_half_edges() const noexcept -> detail::ref_range<half_edge::cref>
 	{
-		return { *this, half_edge::id(0), half_edge::id(half_edges.size()) };
+		return { *this, half_edge::id(0), half_edge::id(half_edge_nexts.size()) };
 	}
 
 	inline auto mesh_definition::get_half_edges() noexcept -> detail::ref_range<half_edge::ref>
 	{
-		return { *this, half_edge::id(0), half_edge::id(half_edges.size()) };
+		return { *this, half_edge::id(0), half_edge::id(half_edge_nexts.size()) };
 	}
 
 	inline auto mesh_definition::get_edges() const noexcept -> detail::const_half_edge_range<detail::edge_iteration>
@@ -977,12 +1036,12 @@ namespace ot::egfx
 	{
 		inline math::point3f cref::get_position() const
 		{
-			return m->get_vertex_data(vertex_id).position;
+			return m->get_vertex_position(vertex_id);
 		}
 
 		inline auto cref::get_half_edges() const -> detail::const_half_edge_range<detail::vertex_half_edge_iteration>
 		{
-			return { *m, m->get_vertex_data(vertex_id).first_edge };
+			return { *m, m->get_vertex_first_edge(vertex_id) };
 		}
 
 		inline math::point3f ref::get_position() const
@@ -992,7 +1051,7 @@ namespace ot::egfx
 
 		inline auto ref::get_half_edges() const -> detail::half_edge_range<detail::vertex_half_edge_iteration>
 		{
-			return { *m, m->get_vertex_data(v).first_edge };
+			return { *m, m->get_vertex_first_edge(v) };
 		}
 	}
 
@@ -1000,22 +1059,22 @@ namespace ot::egfx
 	{
 		inline vertex::cref cref::get_source_vertex() const
 		{
-			return { *m, m->get_half_edge_data(m->get_half_edge_data(e).twin).vertex };
+			return { *m, m->get_half_edge_vertex(m->get_half_edge_twin(e)) };
 		}
 
 		inline vertex::cref cref::get_target_vertex() const
 		{
-			return { *m, m->get_half_edge_data(e).vertex };
+			return { *m, m->get_half_edge_vertex(e) };
 		}
 
 		inline cref cref::get_twin() const
 		{
-			return { *m, m->get_half_edge_data(e).twin };
+			return { *m, m->get_half_edge_twin(e) };
 		}
 
 		inline face::cref cref::get_face() const
 		{
-			return { *m, m->get_half_edge_data(e).face };
+			return { *m, m->get_half_edge_face(e) };
 		}
 
 		inline math::line cref::get_line() const
@@ -1023,36 +1082,41 @@ namespace ot::egfx
 			return { get_source_vertex().get_position(), get_target_vertex().get_position() };
 		}
 
+		inline math::point2f cref::get_uv() const
+		{
+			return m->get_half_edge_uv(e);
+		}
+
 		inline bool cref::is_primary() const
 		{
 			// As an arbitrary discriminator, the primary half-edge is the one with the smallest face id
 			half_edge::cref const twin = get_twin();
-			return m->get_half_edge_data(get_id()).face < m->get_half_edge_data(twin.get_id()).face;
+			return m->get_half_edge_face(get_id()) < m->get_half_edge_face(twin.get_id());
 		}
 
 		inline half_edge::cref cref::get_next() const
 		{
-			return m->get_half_edge(m->get_half_edge_data(e).next);
+			return m->get_half_edge(m->get_half_edge_next(e));
 		}
 
 		inline vertex::ref ref::get_source_vertex() const
 		{
-			return { *m, m->get_half_edge_data(m->get_half_edge_data(e).twin).vertex };
+			return { *m, m->get_half_edge_vertex(m->get_half_edge_twin(e)) };
 		}
 
 		inline vertex::ref ref::get_target_vertex() const
 		{
-			return { *m, m->get_half_edge_data(e).vertex };
+			return { *m, m->get_half_edge_vertex(e) };
 		}
 
 		inline ref ref::get_twin() const
 		{
-			return { *m, m->get_half_edge_data(e).twin };
+			return { *m, m->get_half_edge_twin(e) };
 		}
 
 		inline face::ref ref::get_face() const
 		{
-			return m->get_face(m->get_half_edge_data(e).face);
+			return m->get_face(m->get_half_edge_face(e));
 		}
 
 		inline math::line ref::get_line() const
@@ -1060,6 +1124,11 @@ namespace ot::egfx
 			return as_const().get_line();
 		}
 
+		inline math::point2f ref::get_uv() const
+		{
+			return as_const().get_uv();
+		}
+
 		inline bool ref::is_primary() const
 		{
 			return as_const().is_primary();
@@ -1067,7 +1136,7 @@ namespace ot::egfx
 
 		inline half_edge::ref ref::get_next() const
 		{
-			return m->get_half_edge(m->get_half_edge_data(e).next);
+			return m->get_half_edge(m->get_half_edge_next(e));
 		}
 	}
 
@@ -1075,12 +1144,17 @@ namespace ot::egfx
 	{
 		inline auto cref::get_half_edges() const -> detail::const_half_edge_range<detail::face_half_edge_iteration>
 		{
-			return { *m, m->get_face_data(f).first_edge };
+			return { *m, m->get_face_first_edge(f) };
 		}
 
 		inline auto cref::get_vertices() const -> detail::const_face_vertex_range
 		{
-			return { *m, m->get_face_data(f).first_edge };
+			return { *m, m->get_face_first_edge(f) };
+		}
+
+		inline uv_mapping const& cref::get_uv_mapping() const
+		{
+			return m->get_face_uv_mapping(f);
 		}
 
 		inline size_t cref::get_vertex_count() const
@@ -1091,12 +1165,12 @@ namespace ot::egfx
 
 		inline auto ref::get_half_edges() const -> detail::half_edge_range<detail::face_half_edge_iteration>
 		{
-			return { *m, m->get_face_data(f).first_edge };
+			return { *m, m->get_face_first_edge(f) };
 		}
 
 		inline auto ref::get_vertices() const -> detail::face_vertex_range
 		{
-			return { *m, m->get_face_data(f).first_edge };
+			return { *m, m->get_face_first_edge(f) };
 		}
 
 		inline size_t ref::get_vertex_count() const
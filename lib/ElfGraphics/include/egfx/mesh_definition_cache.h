@@ -0,0 +1,59 @@
+#pragma once
+
+#include "egfx/mesh_definition.fwd.h"
+
+#include "math/plane.h"
+
+#include "core/size_t.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace ot::egfx
+{
+	// Shares the definitions of meshes built from the same set of planes, whatever their order
+	// Definitions are held weakly: the cache never keeps a definition alive, and the entries of destroyed definitions are pruned as the cache grows
+	// Safe to use from several threads at once
+	class mesh_definition_cache
+	{
+		struct key_hash
+		{
+			[[nodiscard]] size_t operator()(std::vector<math::plane> const& planes) const noexcept;
+		};
+
+		struct key_equal
+		{
+			[[nodiscard]] bool operator()(std::vector<math::plane> const& lhs, std::vector<math::plane> const& rhs) const noexcept;
+		};
+
+		mutable std::mutex mutex;
+		std::unordered_map<std::vector<math::plane>, std::weak_ptr<mesh_definition const>, key_hash, key_equal> entries; // keyed by canonical plane sets
+		size_t next_prune_size;
+		std::atomic<size_t> hits = 0;
+		std::atomic<size_t> misses = 0;
+
+		void prune_expired();
+
+	public:
+		struct statistics
+		{
+			size_t hits; // definitions shared with a previous call
+			size_t misses; // definitions built
+			size_t entries; // distinct plane sets remembered, some of which may have been destroyed
+		};
+
+		mesh_definition_cache();
+
+		// The definition built from the planes, shared with every live definition built by the cache from the same planes
+		// Planes are compared exactly, after sorting them. The faces of the definition are in the sorted order, not the order of 'planes'. Throws std::invalid_argument when the planes do not form a mesh, like the constructor of mesh_definition
+		[[nodiscard]] std::shared_ptr<mesh_definition const> get(std::span<math::plane const> planes);
+
+		[[nodiscard]] statistics get_statistics() const;
+		void reset_statistics() noexcept;
+		void clear();
+	};
+}
@@ -55,6 +55,9 @@ namespace ot::egfx
 
 			// Gets the number of graphics objects attached to this node
 			[[nodiscard]] size_t get_object_count() const noexcept;
+
+			// Returns whether the node and its objects are static
+			[[nodiscard]] bool is_static() const noexcept;
 		};
 	}
 
@@ -134,6 +137,13 @@ namespace ot::egfx
 
 		// Sets a user pointer (ie: application wrapper) in the node
 		void set_user_ptr(void* user_ptr) const;
+
+		// Static nodes and their objects are skipped by the scene update every frame, their transforms and bounds being only updated after they change
+		// A static node keeps the transform derived from its parent when it last changed: its parents must not move while it is static
+		void set_static(bool is_static) const;
+
+		// Shows or hides the objects attached to the node. Children keep their own visibility
+		void set_visible(bool visible) const;
 	};
 
 	class node : public detail::node_const_impl<node>
@@ -199,6 +209,12 @@ namespace ot::egfx
 
 		// Sets a user pointer (ie: application wrapper) in the node
 		void set_user_ptr(void* user_ptr);
+
+		// See node_ref::set_static
+		void set_static(bool is_static);
+
+		// See node_ref::set_visible
+		void set_visible(bool visible);
 	};
 
 	node create_child_node(node_ref parent);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "egfx/chunk_grid.h"
+#include "egfx/material.h"
+#include "egfx/mesh_definition.fwd.h"
+#include "egfx/scene.fwd.h"
+
+#include "math/transform_matrix.h"
+#include "math/unit/time.h"
+
+#include "core/uptr.h"
+
+#include <memory>
+#include <span>
+
+namespace ot::egfx
+{
+	class chunked_meshes_impl;
+
+	// Meshes which do not move, merged by the chunks of a chunk_grid into one static item per chunk, with a welded submesh per material
+	// Draw calls grow with the number of chunks and the materials in each, instead of the number of meshes
+	// Changes are pushed to the scene by 'update', which builds again only the chunks whose parts changed. It should be called once per frame before rendering
+	// Until its chunk is built again, a chunk keeps drawing its previous parts and the added parts are not drawn by it
+	class chunked_meshes
+	{
+		uptr<chunked_meshes_impl, fwd_delete<chunked_meshes_impl>> pimpl;
+
+	public:
+		explicit chunked_meshes(scene& s, float chunk_size = chunk_grid::default_chunk_size);
+		chunked_meshes(chunked_meshes&&) noexcept;
+		chunked_meshes& operator=(chunked_meshes&&) noexcept;
+		~chunked_meshes();
+
+		chunk_part_id add(std::shared_ptr<mesh_definition const> mesh, math::transform_matrix const& transform, material_handle_t const& material);
+		// Throws std::invalid_argument for unknown parts
+		void remove(chunk_part_id id);
+		void set(chunk_part_id id, std::shared_ptr<mesh_definition const> mesh, math::transform_matrix const& transform, material_handle_t const& material);
+		void clear();
+
+		// Builds every changed chunk
+		void update();
+		// Builds the changed chunks until 'budget' is spent, in the order of chunk_build_queue. At least one chunk is built per call, the others wait for the next calls
+		// The chunks which lost parts are all built, whatever the budget
+		// Returns whether every changed chunk was built
+		bool update(math::milliseconds budget);
+		// Whether the parts of the chunk changed since it was last built
+		[[nodiscard]] bool is_pending(chunk_coord const& cell) const noexcept;
+		[[nodiscard]] size_t get_pending_count() const noexcept;
+
+		// Hides the chunks which are not in 'visible', and shows the others. Rebuilt chunks stay hidden, new chunks are shown
+		// Returns the number of hidden chunks
+		size_t set_visible_chunks(std::span<chunk_coord const> visible);
+		void show_all_chunks();
+
+		[[nodiscard]] chunk_grid const& get_grid() const noexcept;
+		// Number of draw calls for the built chunks, one per submesh
+		[[nodiscard]] size_t get_draw_count() const noexcept;
+	};
+}
+
+extern template struct ot::fwd_delete<ot::egfx::chunked_meshes_impl>;
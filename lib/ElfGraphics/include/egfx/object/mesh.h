@@ -5,8 +5,10 @@
 #include "egfx/mesh_definition.fwd.h"
 #include "egfx/object/object.h"
 #include "egfx/material.h"
+#include "egfx/mesh_buffer.h"
 
 #include <string>
+#include <span>
 
 namespace ot::egfx
 {
@@ -22,11 +24,13 @@ namespace ot::egfx
 	class mesh
 	{
 		alignas(void*) std::byte storage_mesh[2 * sizeof(void*)];
+		face_buffer_map face_map; // empty until the mesh is first updated, and for meshes with many submeshes
 
 		friend void detail::init_mesh_impl(mesh&, void*) noexcept;
 		friend void const* detail::get_mesh_ptr_impl(mesh const&) noexcept;
 
 		void destroy_mesh() noexcept;
+		void reload_patchable_mesh(mesh_definition const& mesh);
 	public:
 		mesh() noexcept;
 		mesh(mesh const&) = delete;
@@ -37,6 +41,10 @@ namespace ot::egfx
 
 		std::string const& get_mesh_name() const noexcept;
 		void reload_mesh(mesh_definition const& mesh);
+		void reload_mesh(std::span<submesh_definition const> submeshes);
+		// Rewrites the faces marked dirty in the definition, in place. Reloads the whole mesh when they do not fit the buffers anymore
+		// Meshes start in tight immutable buffers, and move to buffers with spare room for each face on their first update
+		void update_mesh(mesh_definition const& mesh);
 	};
 
 	// An item is a graphics object under a node that wraps a shared mesh, with additional properties for the instance
@@ -80,6 +88,13 @@ namespace ot::egfx
 
 	extern template item_cref ref_cast<item_cref>(object_ref);
 
+	// Creates a mesh with a single submesh in tight immutable buffers, until it is first updated
 	[[nodiscard]] mesh create_mesh(std::string const& name, mesh_definition const& mesh);
+	// Creates a mesh with one submesh per definition, uploading all the geometry at once
+	[[nodiscard]] mesh create_mesh(std::string const& name, std::span<submesh_definition const> submeshes);
+	// The item is static when its node is, see node_ref::set_static
+	// Ogre-next's HLMS draws consecutive static items sharing a mesh and a material with a single instanced call
 	item_ref add_item(node_ref owner, mesh const& m);
+	// Detaches the item from its node and destroys it. The mesh it wraps is left untouched
+	void remove_item(item_ref item);
 }
@@ -0,0 +1,240 @@
+#include "egfx/chunk_grid.h"
+
+#include "egfx/mesh_definition.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace ot::egfx
+{
+	chunk_coord get_chunk_coord(math::point3f p, float chunk_size) noexcept
+	{
+		return {
+			static_cast<int32_t>(std::floor(p.x / chunk_size)),
+			static_cast<int32_t>(std::floor(p.y / chunk_size)),
+			static_cast<int32_t>(std::floor(p.z / chunk_size)),
+		};
+	}
+
+	size_t chunk_coord_hash::operator()(chunk_coord const& cell) const noexcept
+	{
+		uint64_t h = static_cast<uint32_t>(cell.x) * 0x9E3779B97F4A7C15ull;
+		h ^= static_cast<uint32_t>(cell.y) * 0xC2B2AE3D27D4EB4Full;
+		h ^= static_cast<uint32_t>(cell.z) * 0x165667B19E3779F9ull;
+		return static_cast<size_t>(h ^ (h >> 32));
+	}
+
+	chunk_grid::chunk_grid(float chunk_size)
+		: chunk_size(chunk_size)
+	{
+		if (!(chunk_size > 0.f))
+			throw std::invalid_argument("Chunks must have a positive size");
+	}
+
+	auto chunk_grid::get_slot(chunk_part_id id) const -> part_slot const&
+	{
+		size_t const index = static_cast<size_t>(id);
+		if (index >= parts.size() || !parts[index].used)
+			throw std::invalid_argument("Unknown chunk part");
+		return parts[index];
+	}
+
+	chunk_coord chunk_grid::get_part_cell(chunk_part const& part) const
+	{
+		math::point3f const center = transform(part.mesh->get_bounds().position, part.transform);
+		return get_chunk_coord(center, chunk_size);
+	}
+
+	void chunk_grid::insert(chunk_part_id id)
+	{
+		part_slot& slot = parts[static_cast<size_t>(id)];
+		slot.cell = get_part_cell(slot.part);
+
+		chunk& c = chunks[slot.cell];
+		c.cell = slot.cell;
+		c.parts.push_back(id);
+		mark_dirty(slot.cell);
+	}
+
+	void chunk_grid::erase(chunk_part_id id)
+	{
+		chunk_coord const cell = parts[static_cast<size_t>(id)].cell;
+		auto const found = chunks.find(cell);
+		assert(found != chunks.end());
+
+		std::vector<chunk_part_id>& chunk_parts = found->second.parts;
+		auto const it = std::find(chunk_parts.begin(), chunk_parts.end(), id);
+		assert(it != chunk_parts.end());
+		*it = chunk_parts.back();
+		chunk_parts.pop_back();
+
+		if (chunk_parts.empty())
+			chunks.erase(found);
+		mark_dirty(cell);
+		shrunk_chunk_set.insert(cell);
+	}
+
+	void chunk_grid::mark_dirty(chunk_coord const& cell)
+	{
+		if (dirty_chunk_set.insert(cell).second)
+			dirty_chunks.push_back(cell);
+	}
+
+	void chunk_grid::clear_dirty_chunks() noexcept
+	{
+		dirty_chunks.clear();
+		dirty_chunk_set.clear();
+		shrunk_chunk_set.clear();
+	}
+
+	chunk_part_id chunk_grid::add(chunk_part part)
+	{
+		if (part.mesh == nullptr)
+			throw std::invalid_argument("Chunk parts must have a mesh");
+
+		chunk_part_id id;
+		if (!free_ids.empty())
+		{
+			id = free_ids.back();
+			free_ids.pop_back();
+		}
+		else
+		{
+			id = static_cast<chunk_part_id>(parts.size());
+			parts.emplace_back();
+		}
+
+		part_slot& slot = parts[static_cast<size_t>(id)];
+		slot.part = std::move(part);
+		slot.used = true;
+		insert(id);
+		return id;
+	}
+
+	void chunk_grid::remove(chunk_part_id id)
+	{
+		(void)get_slot(id);
+		erase(id);
+
+		part_slot& slot = parts[static_cast<size_t>(id)];
+		slot = {};
+		free_ids.push_back(id);
+	}
+
+	void chunk_grid::set(chunk_part_id id, chunk_part part)
+	{
+		if (part.mesh == nullptr)
+			throw std::invalid_argument("Chunk parts must have a mesh");
+
+		(void)get_slot(id);
+		erase(id);
+		parts[static_cast<size_t>(id)].part = std::move(part);
+		insert(id);
+	}
+
+	void chunk_grid::clear()
+	{
+		// The meshes of every chunk must be destroyed
+		for (auto const& [cell, c] : chunks)
+		{
+			mark_dirty(cell);
+			shrunk_chunk_set.insert(cell);
+		}
+
+		parts.clear();
+		free_ids.clear();
+		chunks.clear();
+	}
+
+	bool chunk_grid::contains(chunk_part_id id) const noexcept
+	{
+		size_t const index = static_cast<size_t>(id);
+		return index < parts.size() && parts[index].used;
+	}
+
+	auto chunk_grid::find_chunk(chunk_coord const& cell) const noexcept -> chunk const*
+	{
+		auto const found = chunks.find(cell);
+		return found != chunks.end() ? &found->second : nullptr;
+	}
+
+	std::vector<chunk_submesh> chunk_grid::make_submeshes(chunk_coord const& cell) const
+	{
+		chunk const* const c = find_chunk(cell);
+		if (c == nullptr)
+			return {};
+
+		std::vector<chunk_part_id> sorted_ids = c->parts;
+		std::sort(sorted_ids.begin(), sorted_ids.end(), [this](chunk_part_id lhs, chunk_part_id rhs)
+		{
+			uint64_t const lhs_material = parts[static_cast<size_t>(lhs)].part.material;
+			uint64_t const rhs_material = parts[static_cast<size_t>(rhs)].part.material;
+			return lhs_material != rhs_material ? lhs_material < rhs_material : lhs < rhs;
+		});
+
+		std::vector<chunk_submesh> submeshes;
+		for (chunk_part_id const id : sorted_ids)
+		{
+			chunk_part const& part = parts[static_cast<size_t>(id)].part;
+			if (submeshes.empty() || submeshes.back().material != part.material)
+				submeshes.push_back({ part.material, {} });
+			submeshes.back().parts.push_back({ part.mesh.get(), part.transform });
+		}
+		return submeshes;
+	}
+
+	void chunk_build_queue::take_dirty_chunks(chunk_grid& grid)
+	{
+		for (chunk_coord const& cell : grid.get_dirty_chunks())
+		{
+			bool const urgent = grid.has_lost_parts(cell);
+			auto const [it, inserted] = queued.try_emplace(cell, urgent);
+			if (inserted)
+			{
+				(urgent ? urgent_cells : other_cells).push_back(cell);
+			}
+			else if (urgent && !it->second)
+			{
+				// Its place in 'other_cells' is skipped once popped
+				it->second = true;
+				urgent_cells.push_back(cell);
+			}
+		}
+		grid.clear_dirty_chunks();
+	}
+
+	std::optional<chunk_coord> chunk_build_queue::pop()
+	{
+		if (!urgent_cells.empty())
+		{
+			chunk_coord const cell = urgent_cells.front();
+			urgent_cells.pop_front();
+			queued.erase(cell);
+			return cell;
+		}
+
+		while (!other_cells.empty())
+		{
+			chunk_coord const cell = other_cells.front();
+			other_cells.pop_front();
+
+			auto const found = queued.find(cell);
+			if (found != queued.end() && !found->second)
+			{
+				queued.erase(found);
+				return cell;
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	void chunk_build_queue::clear() noexcept
+	{
+		urgent_cells.clear();
+		other_cells.clear();
+		queued.clear();
+	}
+}
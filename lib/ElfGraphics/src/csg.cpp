@@ -0,0 +1,657 @@
+#include "egfx/csg.h"
+
+#include "egfx/mesh_definition.h"
+
+#include "math/plane_batch.h"
+
+#include "core/uptr.h"
+#include "core/profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+namespace ot::egfx::csg
+{
+	namespace
+	{
+		// Where a fragment of a face lies relative to the volume of another brush
+		enum class category
+		{
+			outside,
+			inside,
+			touching_aligned, // on a face of the brush, with the same normal
+			touching_opposite, // on a face of the brush, with the opposite normal
+		};
+
+		// Part of a face of a brush, with its category relative to each neighbour of the brush tested so far
+		struct fragment
+		{
+			std::vector<math::point3f> vertices;
+			std::vector<category> categories;
+		};
+
+		world_brush make_world_brush(brush const& b)
+		{
+			world_brush result;
+			bool first_vertex = true;
+			for (face::cref const f : b.mesh->get_faces())
+			{
+				result.planes.push_back(transform(f.get_plane(), b.transform));
+
+				std::vector<math::point3f>& vertices = result.face_vertices.emplace_back();
+				for (vertex::cref const v : f.get_vertices())
+				{
+					math::point3f const p = transform(v.get_position(), b.transform);
+					vertices.push_back(p);
+
+					if (first_vertex)
+						result.bounds = { p, {} };
+					else
+						result.bounds.merge(p);
+					first_vertex = false;
+				}
+			}
+			return result;
+		}
+
+		bool overlaps(math::aabb const& lhs, math::aabb const& rhs) noexcept
+		{
+			math::vector3f const distance = lhs.position - rhs.position;
+			math::vector3f const reach = lhs.half_size + rhs.half_size;
+			return std::abs(distance.x) <= reach.x + plane_epsilon
+				&& std::abs(distance.y) <= reach.y + plane_epsilon
+				&& std::abs(distance.z) <= reach.z + plane_epsilon;
+		}
+
+		// For each brush, the other brushes whose bounds overlap it, in increasing order. Found with a sweep along x
+		std::vector<std::vector<size_t>> find_neighbours(std::span<world_brush const> brushes)
+		{
+			std::vector<size_t> order(brushes.size());
+			for (size_t i = 0; i < order.size(); ++i)
+				order[i] = i;
+			std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return brushes[lhs].bounds.min().x < brushes[rhs].bounds.min().x; });
+
+			std::vector<std::vector<size_t>> neighbours(brushes.size());
+			std::vector<size_t> active;
+			for (size_t const i : order)
+			{
+				float const min_x = brushes[i].bounds.min().x - plane_epsilon;
+				std::erase_if(active, [&](size_t j) { return brushes[j].bounds.max().x < min_x; });
+
+				for (size_t const j : active)
+				{
+					if (overlaps(brushes[i].bounds, brushes[j].bounds))
+					{
+						neighbours[i].push_back(j);
+						neighbours[j].push_back(i);
+					}
+				}
+				active.push_back(i);
+			}
+
+			for (std::vector<size_t>& n : neighbours)
+				std::sort(n.begin(), n.end());
+			return neighbours;
+		}
+
+		// Splits the convex polygon along the plane. Either side is left empty if nothing of the polygon is on it
+		void split(std::span<math::point3f const> vertices, math::plane const& p, std::vector<float>& distances, std::vector<math::point3f>& front, std::vector<math::point3f>& back)
+		{
+			front.clear();
+			back.clear();
+
+			distances.resize(vertices.size());
+			math::distances_to(p, vertices, distances);
+
+			bool const has_front = std::any_of(distances.begin(), distances.end(), [](float d) { return d > plane_epsilon; });
+			bool const has_back = std::any_of(distances.begin(), distances.end(), [](float d) { return d < -plane_epsilon; });
+			if (!has_front)
+			{
+				back.assign(vertices.begin(), vertices.end());
+				return;
+			}
+			if (!has_back)
+			{
+				front.assign(vertices.begin(), vertices.end());
+				return;
+			}
+
+			size_t const count = vertices.size();
+			for (size_t k = 0; k < count; ++k)
+			{
+				size_t const k_next = (k + 1) % count;
+				float const d = distances[k];
+				float const d_next = distances[k_next];
+
+				if (d >= -plane_epsilon)
+					front.push_back(vertices[k]);
+				if (d <= plane_epsilon)
+					back.push_back(vertices[k]);
+
+				// Edges going strictly from one side to the other get a new vertex on the plane
+				if ((d > plane_epsilon && d_next < -plane_epsilon) || (d < -plane_epsilon && d_next > plane_epsilon))
+				{
+					math::point3f const intersection = math::find_distance_ray_intersection(vertices[k], d, vertices[k_next], d_next);
+					front.push_back(intersection);
+					back.push_back(intersection);
+				}
+			}
+
+			if (front.size() < 3)
+				front.clear();
+			if (back.size() < 3)
+				back.clear();
+		}
+
+		// Scratch buffers of a worker thread
+		struct scratch
+		{
+			std::vector<float> distances;
+			std::vector<math::point3f> front;
+			std::vector<math::point3f> back;
+		};
+
+		// Splits the fragment into the parts outside the brush and the part inside or touching it, appending them to 'result'
+		void categorize(fragment&& f, world_brush const& other, math::vector3f normal, scratch& s, std::vector<fragment>& result)
+		{
+			std::optional<category> touching;
+			for (math::plane const& p : other.planes)
+			{
+				split(f.vertices, p, s.distances, s.front, s.back);
+				if (!s.front.empty() && !s.back.empty())
+				{
+					fragment& outside = result.emplace_back(fragment{ s.front, f.categories });
+					outside.categories.push_back(category::outside);
+					f.vertices.swap(s.back);
+				}
+				else if (!s.front.empty())
+				{
+					f.categories.push_back(category::outside);
+					result.push_back(ot::as_movable(f));
+					return;
+				}
+				else if (std::all_of(s.distances.begin(), s.distances.end(), [](float d) { return d >= -plane_epsilon; }))
+				{
+					// Every vertex is on the plane
+					touching = dot_product(normal, p.normal) > 0.f ? category::touching_aligned : category::touching_opposite;
+				}
+			}
+
+			f.categories.push_back(touching.value_or(category::inside));
+			result.push_back(ot::as_movable(f));
+		}
+
+		// A brush that can change the solid on the faces of the brush being evaluated
+		struct relevant_brush
+		{
+			operation op;
+			size_t neighbour; // index in the neighbours of the evaluated brush, or no_neighbour for the evaluated brush itself
+		};
+
+		constexpr size_t no_neighbour = static_cast<size_t>(-1);
+
+		// Whether the solid exists, after every operation, just behind or just in front of the fragment
+		bool is_solid(std::span<relevant_brush const> relevant_brushes, fragment const& f, bool behind) noexcept
+		{
+			bool solid = false;
+			for (relevant_brush const& b : relevant_brushes)
+			{
+				bool inside = behind;
+				if (b.neighbour != no_neighbour)
+				{
+					switch (f.categories[b.neighbour])
+					{
+					case category::inside: inside = true; break;
+					case category::outside: inside = false; break;
+					case category::touching_aligned: inside = behind; break;
+					case category::touching_opposite: inside = !behind; break;
+					}
+				}
+
+				switch (b.op)
+				{
+				case operation::add: solid = solid || inside; break;
+				case operation::subtract: solid = solid && !inside; break;
+				case operation::intersect: solid = solid && inside; break;
+				}
+			}
+			return solid;
+		}
+
+		// Brushes not reaching the evaluated one leave the solid as is on its faces, except intersections which empty it
+		// Only the evaluated brush and its neighbours after the last such intersection matter
+		template<typename Key, typename Intersections>
+		std::optional<Key> find_last_unreached_intersection(Intersections const& intersections, Key evaluated, std::span<Key const> neighbours)
+		{
+			for (auto it = intersections.rbegin(); it != intersections.rend(); ++it)
+			{
+				if (*it != evaluated && !std::binary_search(neighbours.begin(), neighbours.end(), *it))
+					return *it;
+			}
+			return std::nullopt;
+		}
+
+		// Neighbour of the evaluated brush, in brush order
+		struct neighbour_brush
+		{
+			world_brush const* brush;
+			operation op;
+			bool relevant;
+		};
+
+		// Appends to 'result' the polygons on the faces of the brush. 'first_later_neighbour' is the index of the first neighbour after the brush
+		void evaluate_brush(world_brush const& b, operation op, bool relevant, std::span<neighbour_brush const> neighbours, size_t first_later_neighbour, size_t brush_index, scratch& s, std::vector<polygon>& result)
+		{
+			std::vector<relevant_brush> relevant_brushes;
+			for (size_t n = 0; n < neighbours.size(); ++n)
+			{
+				if (n == first_later_neighbour && relevant)
+					relevant_brushes.push_back({ op, no_neighbour });
+				if (neighbours[n].relevant)
+					relevant_brushes.push_back({ neighbours[n].op, n });
+			}
+			if (first_later_neighbour == neighbours.size() && relevant)
+				relevant_brushes.push_back({ op, no_neighbour });
+
+			std::vector<fragment> fragments;
+			std::vector<fragment> next_fragments;
+			for (size_t face_index = 0; face_index < b.planes.size(); ++face_index)
+			{
+				math::plane const& face_plane = b.planes[face_index];
+
+				fragments.clear();
+				fragments.push_back({ b.face_vertices[face_index], {} });
+				for (neighbour_brush const& n : neighbours)
+				{
+					next_fragments.clear();
+					for (fragment& f : fragments)
+						categorize(ot::as_movable(f), *n.brush, face_plane.normal, s, next_fragments);
+					fragments.swap(next_fragments);
+				}
+
+				for (fragment& f : fragments)
+				{
+					// Brushes after this one whose faces coincide with a fragment produce it instead
+					bool const coincides_with_later_brush = std::any_of(f.categories.begin() + first_later_neighbour, f.categories.end(), [](category c)
+					{
+						return c == category::touching_aligned || c == category::touching_opposite;
+					});
+					if (coincides_with_later_brush)
+						continue;
+
+					// The fragment is on the surface where the solid differs on either side of it
+					bool const solid_behind = is_solid(relevant_brushes, f, true);
+					bool const solid_in_front = is_solid(relevant_brushes, f, false);
+					if (solid_behind == solid_in_front)
+						continue;
+
+					polygon& p = result.emplace_back(polygon{ ot::as_movable(f.vertices), face_plane, brush_index, face::id(face_index) });
+					if (!solid_behind)
+					{
+						// The surface of a carved volume faces into the brush
+						std::reverse(p.vertices.begin(), p.vertices.end());
+						p.plane = { -p.plane.normal, -p.plane.distance };
+					}
+				}
+			}
+		}
+
+		// Packs the coordinates of a grid cell, 21 bits each
+		uint64_t get_cell_key(int64_t x, int64_t y, int64_t z) noexcept
+		{
+			constexpr uint64_t mask = (uint64_t(1) << 21) - 1;
+			return (uint64_t(x) & mask) | ((uint64_t(y) & mask) << 21) | ((uint64_t(z) & mask) << 42);
+		}
+
+		struct cell_range
+		{
+			int64_t min[3];
+			int64_t max[3];
+
+			[[nodiscard]] uint64_t get_cell_count() const noexcept
+			{
+				return uint64_t(max[0] - min[0] + 1) * uint64_t(max[1] - min[1] + 1) * uint64_t(max[2] - min[2] + 1);
+			}
+
+			template<typename Callback>
+			void for_each_cell(Callback cb) const
+			{
+				for (int64_t x = min[0]; x <= max[0]; ++x)
+					for (int64_t y = min[1]; y <= max[1]; ++y)
+						for (int64_t z = min[2]; z <= max[2]; ++z)
+							cb(get_cell_key(x, y, z));
+			}
+		};
+
+		cell_range get_cell_range(math::aabb const& bounds, float cell_size) noexcept
+		{
+			math::point3f const min = bounds.min();
+			math::point3f const max = bounds.max();
+			auto const to_cell = [cell_size](float v) { return static_cast<int64_t>(std::floor(v / cell_size)); };
+			return {
+				{ to_cell(min.x - plane_epsilon), to_cell(min.y - plane_epsilon), to_cell(min.z - plane_epsilon) },
+				{ to_cell(max.x + plane_epsilon), to_cell(max.y + plane_epsilon), to_cell(max.z + plane_epsilon) },
+			};
+		}
+
+		// Brushes covering more cells are tested against every change instead
+		constexpr uint64_t max_brush_cell_count = 64;
+	}
+
+	std::vector<polygon> evaluate(std::span<brush const> brushes, size_t thread_count)
+	{
+		std::vector<world_brush> world_brushes;
+		world_brushes.reserve(brushes.size());
+		for (brush const& b : brushes)
+		{
+			assert(b.mesh != nullptr);
+			world_brushes.push_back(make_world_brush(b));
+		}
+
+		std::vector<std::vector<size_t>> const neighbours = find_neighbours(world_brushes);
+
+		std::vector<size_t> intersections;
+		for (size_t i = 0; i < brushes.size(); ++i)
+		{
+			if (brushes[i].op == operation::intersect)
+				intersections.push_back(i);
+		}
+
+		// Brushes are handed out one at a time, each producing its own polygons, which keeps the result in the order of the brushes
+		std::vector<std::vector<polygon>> brush_polygons(brushes.size());
+		std::atomic<size_t> next_brush = 0;
+		std::atomic<bool> failed = false;
+		std::exception_ptr first_exception;
+
+		auto const evaluate_brushes = [&]
+		{
+			OT_PROFILE_ZONE("csg::evaluate_brushes");
+			scratch s;
+			std::vector<neighbour_brush> neighbour_brushes;
+			for (size_t i = next_brush++; i < brushes.size() && !failed; i = next_brush++)
+			{
+				try
+				{
+					std::optional<size_t> const unreached = find_last_unreached_intersection<size_t>(intersections, i, neighbours[i]);
+					neighbour_brushes.clear();
+					for (size_t const n : neighbours[i])
+						neighbour_brushes.push_back({ &world_brushes[n], brushes[n].op, !unreached || n > *unreached });
+
+					size_t const first_later_neighbour = static_cast<size_t>(std::upper_bound(neighbours[i].begin(), neighbours[i].end(), i) - neighbours[i].begin());
+					evaluate_brush(world_brushes[i], brushes[i].op, !unreached || i > *unreached, neighbour_brushes, first_later_neighbour, i, s, brush_polygons[i]);
+				}
+				catch (...)
+				{
+					// Only the first failing thread writes the exception
+					if (!failed.exchange(true))
+						first_exception = std::current_exception();
+					return;
+				}
+			}
+		};
+
+		if (thread_count == 0)
+			thread_count = std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+		thread_count = std::max(size_t(1), std::min(thread_count, brushes.size()));
+
+		// The calling thread takes part in the work
+		std::vector<std::jthread> workers;
+		for (size_t t = 1; t < thread_count; ++t)
+			workers.emplace_back(evaluate_brushes);
+		evaluate_brushes();
+		workers.clear();
+
+		if (first_exception)
+			std::rethrow_exception(first_exception);
+
+		std::vector<polygon> result;
+		for (std::vector<polygon>& polygons : brush_polygons)
+			std::move(polygons.begin(), polygons.end(), std::back_inserter(result));
+		return result;
+	}
+
+	incremental_evaluator::incremental_evaluator(float cell_size)
+		: cell_size(cell_size)
+	{
+		if (!(cell_size > 0.f))
+			throw std::invalid_argument("The cell size must be positive");
+	}
+
+	void incremental_evaluator::mark_dirty(brush_id id, brush_state& state)
+	{
+		if (state.dirty)
+			return;
+
+		state.dirty = true;
+		++dirty_count;
+		dirty_brushes.push_back(id);
+	}
+
+	void incremental_evaluator::mark_all_dirty()
+	{
+		for (auto& [id, state] : brushes)
+			mark_dirty(id, state);
+	}
+
+	void incremental_evaluator::add_to_grid(brush_id id, math::aabb const& bounds)
+	{
+		cell_range const range = get_cell_range(bounds, cell_size);
+		if (range.get_cell_count() > max_brush_cell_count)
+		{
+			large_brushes.push_back(id);
+			return;
+		}
+
+		range.for_each_cell([&](uint64_t key) { cells[key].push_back(id); });
+	}
+
+	void incremental_evaluator::remove_from_grid(brush_id id, math::aabb const& bounds)
+	{
+		cell_range const range = get_cell_range(bounds, cell_size);
+		if (range.get_cell_count() > max_brush_cell_count)
+		{
+			std::erase(large_brushes, id);
+			return;
+		}
+
+		range.for_each_cell([&](uint64_t key)
+		{
+			auto const it = cells.find(key);
+			assert(it != cells.end());
+			std::erase(it->second, id);
+			if (it->second.empty())
+				cells.erase(it);
+		});
+	}
+
+	std::vector<brush_id> incremental_evaluator::find_overlapping(brush_id id, math::aabb const& bounds) const
+	{
+		std::vector<brush_id> candidates = large_brushes;
+		cell_range const range = get_cell_range(bounds, cell_size);
+		if (range.get_cell_count() > max_brush_cell_count)
+		{
+			for (auto const& [other_id, other] : brushes)
+				candidates.push_back(other_id);
+		}
+		else
+		{
+			range.for_each_cell([&](uint64_t key)
+			{
+				auto const it = cells.find(key);
+				if (it != cells.end())
+					candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+			});
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+		std::erase_if(candidates, [&](brush_id other_id)
+		{
+			return other_id == id || !overlaps(bounds, brushes.at(other_id).world.bounds);
+		});
+		return candidates;
+	}
+
+	void incremental_evaluator::unlink(brush_id id, brush_state& state)
+	{
+		for (brush_id const n : state.neighbours)
+		{
+			brush_state& neighbour = brushes.at(n);
+			auto const it = std::lower_bound(neighbour.neighbours.begin(), neighbour.neighbours.end(), id);
+			assert(it != neighbour.neighbours.end() && *it == id);
+			neighbour.neighbours.erase(it);
+			mark_dirty(n, neighbour);
+		}
+		state.neighbours.clear();
+		remove_from_grid(id, state.world.bounds);
+	}
+
+	void incremental_evaluator::set_brush(brush_id id, brush const& b)
+	{
+		assert(b.mesh != nullptr);
+		world_brush world = make_world_brush(b);
+
+		auto const [it, added] = brushes.try_emplace(id, brush_state{ b.op, {}, {}, {}, false });
+		brush_state& state = it->second;
+		bool const was_intersection = !added && state.op == operation::intersect;
+		if (!added)
+			unlink(id, state);
+
+		// The brushes overlapping before and after the change are the ones whose polygons may change
+		std::vector<brush_id> neighbours = find_overlapping(id, world.bounds);
+		for (brush_id const n : neighbours)
+		{
+			brush_state& neighbour = brushes.at(n);
+			neighbour.neighbours.insert(std::upper_bound(neighbour.neighbours.begin(), neighbour.neighbours.end(), id), id);
+			mark_dirty(n, neighbour);
+		}
+
+		add_to_grid(id, world.bounds);
+		state.op = b.op;
+		state.world = ot::as_movable(world);
+		state.neighbours = ot::as_movable(neighbours);
+		mark_dirty(id, state);
+
+		if (b.op == operation::intersect)
+			intersections.insert(id);
+		else
+			intersections.erase(id);
+
+		if (was_intersection || b.op == operation::intersect)
+			mark_all_dirty();
+	}
+
+	void incremental_evaluator::remove_brush(brush_id id)
+	{
+		auto const it = brushes.find(id);
+		if (it == brushes.end())
+			throw std::invalid_argument("No brush with this id");
+
+		unlink(id, it->second);
+		if (it->second.dirty)
+			--dirty_count;
+		bool const was_intersection = it->second.op == operation::intersect;
+		brushes.erase(it);
+		updated_brushes.push_back(id);
+
+		if (was_intersection)
+		{
+			intersections.erase(id);
+			mark_all_dirty();
+		}
+	}
+
+	void incremental_evaluator::clear()
+	{
+		for (auto const& [id, state] : brushes)
+			updated_brushes.push_back(id);
+
+		brushes.clear();
+		cells.clear();
+		large_brushes.clear();
+		intersections.clear();
+		dirty_brushes.clear();
+		dirty_count = 0;
+	}
+
+	bool incremental_evaluator::update(math::milliseconds budget)
+	{
+		using clock = std::chrono::steady_clock;
+		auto const start = clock::now();
+
+		scratch s;
+		std::vector<neighbour_brush> neighbour_brushes;
+		bool first = true;
+		while (!dirty_brushes.empty())
+		{
+			if (!first && clock::now() - start >= budget)
+				break;
+
+			brush_id const id = dirty_brushes.front();
+			dirty_brushes.pop_front();
+
+			auto const it = brushes.find(id);
+			if (it == brushes.end() || !it->second.dirty)
+				continue;
+
+			brush_state& state = it->second;
+			std::span<brush_id const> const neighbours = state.neighbours;
+			std::optional<brush_id> const unreached = find_last_unreached_intersection(intersections, id, neighbours);
+			neighbour_brushes.clear();
+			for (brush_id const n : neighbours)
+			{
+				brush_state const& neighbour = brushes.at(n);
+				neighbour_brushes.push_back({ &neighbour.world, neighbour.op, !unreached || n > *unreached });
+			}
+
+			size_t const first_later_neighbour = static_cast<size_t>(std::upper_bound(neighbours.begin(), neighbours.end(), id) - neighbours.begin());
+			std::vector<polygon> polygons;
+			evaluate_brush(state.world, state.op, !unreached || id > *unreached, neighbour_brushes, first_later_neighbour, static_cast<size_t>(id), s, polygons);
+
+			state.polygons = ot::as_movable(polygons);
+			state.dirty = false;
+			--dirty_count;
+			updated_brushes.push_back(id);
+			first = false;
+		}
+
+		return is_up_to_date();
+	}
+
+	bool incremental_evaluator::update()
+	{
+		return update(math::milliseconds(std::numeric_limits<float>::infinity()));
+	}
+
+	std::span<polygon const> incremental_evaluator::get_polygons(brush_id id) const
+	{
+		auto const it = brushes.find(id);
+		if (it == brushes.end())
+			throw std::invalid_argument("No brush with this id");
+		return it->second.polygons;
+	}
+
+	std::vector<polygon> incremental_evaluator::get_result() const
+	{
+		std::vector<polygon> result;
+		for (auto const& [id, state] : brushes)
+			result.insert(result.end(), state.polygons.begin(), state.polygons.end());
+		return result;
+	}
+
+	std::span<brush_id const> incremental_evaluator::get_neighbours(brush_id id) const
+	{
+		auto const it = brushes.find(id);
+		if (it == brushes.end())
+			throw std::invalid_argument("No brush with this id");
+		return it->second.neighbours;
+	}
+}
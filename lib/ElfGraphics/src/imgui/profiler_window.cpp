@@ -0,0 +1,236 @@
+#include "egfx/imgui/profiler_window.h"
+
+#include "core/profiler.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ot::egfx::imgui::profiler_window
+{
+	namespace
+	{
+		const ImVec2 k_default_size(760, 480);
+		constexpr float k_lane_label_width = 80.f;
+		constexpr char const* k_trace_path = "profile.json";
+
+		struct zone_total
+		{
+			char const* name;
+			int64_t duration;
+			size_t count;
+		};
+
+		// Kept between frames for their memory
+		std::vector<int64_t> frames;
+		std::vector<profiler::zone> zones;
+		std::vector<zone_total> totals;
+		std::vector<uint32_t> lane_rows; // first row of each lane in the timeline
+		std::array<float, profiler::max_frame_count> frame_durations;
+
+		int selected_frame = -1; // index in 'frames', the latest complete frame when negative
+		std::string export_result;
+
+		[[nodiscard]] float to_ms(int64_t ns)
+		{
+			return static_cast<float>(static_cast<double>(ns) / 1000000.0);
+		}
+
+		// Zones with the same name get the same color. Names are literals, their address is enough
+		[[nodiscard]] ImU32 get_zone_color(char const* name)
+		{
+			size_t const hash = std::hash<void const*>()(name);
+			float const hue = static_cast<float>(hash % 360) / 360.f;
+			float r, g, b;
+			ImGui::ColorConvertHSVtoRGB(hue, 0.5f, 0.8f, r, g, b);
+			return ImGui::ColorConvertFloat4ToU32(ImVec4(r, g, b, 1.f));
+		}
+
+		void export_trace()
+		{
+			std::vector<profiler::zone> trace;
+			profiler::get_zones(frames.front(), profiler::now(), trace);
+
+			std::ofstream out(k_trace_path);
+			if (!out)
+			{
+				export_result = std::string("Could not open ") + k_trace_path;
+				return;
+			}
+
+			profiler::write_chrome_trace(out, trace);
+			export_result = std::to_string(trace.size()) + " zones written to " + k_trace_path;
+		}
+
+		void draw_frames(size_t frame_count)
+		{
+			for (size_t i = 0; i < frame_count; ++i)
+				frame_durations[i] = to_ms(frames[i + 1] - frames[i]);
+
+			ImGui::PlotHistogram("##Frames", frame_durations.data(), static_cast<int>(frame_count), 0, "Frame times (ms)", 0.f, FLT_MAX, ImVec2(-1.f, 60.f));
+
+			// Picking a frame pauses the recording, or it would scroll away
+			if (ImGui::IsItemClicked())
+			{
+				float const x = ImGui::GetMousePos().x - ImGui::GetItemRectMin().x;
+				float const width = ImGui::GetItemRectSize().x;
+				selected_frame = std::clamp(static_cast<int>(x / width * static_cast<float>(frame_count)), 0, static_cast<int>(frame_count) - 1);
+				profiler::set_paused(true);
+			}
+
+			if (!profiler::is_paused() || selected_frame < 0 || selected_frame >= static_cast<int>(frame_count))
+				selected_frame = static_cast<int>(frame_count) - 1;
+
+			if (profiler::is_paused())
+				ImGui::SliderInt("Frame", &selected_frame, 0, static_cast<int>(frame_count) - 1);
+		}
+
+		void draw_timeline(int64_t from, int64_t to)
+		{
+			// Each lane takes as many rows as its deepest zone
+			size_t const lane_count = profiler::get_lane_count();
+			lane_rows.assign(lane_count + 1, 0);
+			for (profiler::zone const& z : zones)
+				lane_rows[z.lane + 1] = std::max(lane_rows[z.lane + 1], z.depth + 1);
+			for (size_t l = 0; l < lane_count; ++l)
+				lane_rows[l + 1] += lane_rows[l];
+
+			float const row_height = ImGui::GetTextLineHeightWithSpacing();
+			ImVec2 const origin = ImGui::GetCursorScreenPos();
+			float const width = std::max(ImGui::GetContentRegionAvail().x - k_lane_label_width, 1.f);
+			float const height = static_cast<float>(lane_rows.back()) * row_height;
+			ImDrawList* const draw_list = ImGui::GetWindowDrawList();
+			ImU32 const text_color = ImGui::GetColorU32(ImGuiCol_Text);
+
+			for (size_t l = 0; l < lane_count; ++l)
+			{
+				if (lane_rows[l + 1] == lane_rows[l])
+					continue;
+
+				char const* const name = profiler::get_lane_name(static_cast<uint32_t>(l));
+				std::string const label = name != nullptr ? std::string(name) : "Thread " + std::to_string(l);
+				draw_list->AddText(ImVec2(origin.x, origin.y + static_cast<float>(lane_rows[l]) * row_height), text_color, label.c_str());
+			}
+
+			double const scale = static_cast<double>(width) / static_cast<double>(std::max(to - from, int64_t(1)));
+			float const left = origin.x + k_lane_label_width;
+			for (profiler::zone const& z : zones)
+			{
+				float const x0 = left + static_cast<float>(static_cast<double>(std::max(z.start, from) - from) * scale);
+				float const x1 = std::max(left + static_cast<float>(static_cast<double>(std::min(z.end, to) - from) * scale), x0 + 1.f);
+				float const y0 = origin.y + static_cast<float>(lane_rows[z.lane] + z.depth) * row_height;
+				ImVec2 const min(x0, y0);
+				ImVec2 const max(x1, y0 + row_height - 1.f);
+
+				draw_list->AddRectFilled(min, max, get_zone_color(z.name));
+
+				ImVec4 const clip(x0, y0, x1, max.y);
+				draw_list->AddText(nullptr, 0.f, ImVec2(x0 + 2.f, y0), IM_COL32_BLACK, z.name, nullptr, 0.f, &clip);
+
+				if (ImGui::IsMouseHoveringRect(min, max))
+					ImGui::SetTooltip("%s: %.3f ms", z.name, to_ms(z.end - z.start));
+			}
+
+			ImGui::Dummy(ImVec2(width + k_lane_label_width, height));
+		}
+
+		void draw_totals()
+		{
+			totals.clear();
+			for (profiler::zone const& z : zones)
+			{
+				auto const found = std::ranges::find(totals, z.name, &zone_total::name);
+				if (found == totals.end())
+					totals.push_back({ z.name, z.end - z.start, 1 });
+				else
+				{
+					found->duration += z.end - z.start;
+					++found->count;
+				}
+			}
+			std::ranges::sort(totals, std::ranges::greater(), &zone_total::duration);
+
+			if (ImGui::BeginTable("Totals", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+			{
+				ImGui::TableSetupColumn("Zone");
+				ImGui::TableSetupColumn("Total (ms)");
+				ImGui::TableSetupColumn("Count");
+				ImGui::TableHeadersRow();
+
+				for (zone_total const& t : totals)
+				{
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(t.name);
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f", to_ms(t.duration));
+					ImGui::TableNextColumn();
+					ImGui::Text("%zu", t.count);
+				}
+
+				ImGui::EndTable();
+			}
+		}
+	}
+
+	void draw(bool* enabled)
+	{
+		ImGui::SetNextWindowSize(k_default_size, ImGuiCond_FirstUseEver);
+		if (!ImGui::Begin("Profiler", enabled))
+		{
+			ImGui::End();
+			return;
+		}
+
+#if !OT_PROFILER
+		ImGui::TextUnformatted("Zones were compiled out of this build");
+#endif
+
+		bool paused = profiler::is_paused();
+		if (ImGui::Checkbox("Paused", &paused))
+			profiler::set_paused(paused);
+
+		profiler::get_frames(frames);
+
+		// The last frame is still running
+		if (frames.size() < 2)
+		{
+			ImGui::TextUnformatted("No frame recorded yet");
+			ImGui::End();
+			return;
+		}
+
+		ImGui::SameLine();
+		if (ImGui::Button("Export Chrome Trace"))
+			export_trace();
+		if (!export_result.empty())
+		{
+			ImGui::SameLine();
+			ImGui::TextUnformatted(export_result.c_str());
+		}
+
+		size_t const frame_count = frames.size() - 1;
+		draw_frames(frame_count);
+
+		int64_t const from = frames[static_cast<size_t>(selected_frame)];
+		int64_t const to = frames[static_cast<size_t>(selected_frame) + 1];
+		zones.clear();
+		profiler::get_zones(from, to, zones);
+
+		ImGui::Text("Frame: %.3f ms, %zu zones", to_ms(to - from), zones.size());
+
+		if (ImGui::BeginChild("Timeline", ImVec2(0.f, ImGui::GetContentRegionAvail().y * 0.6f), true, ImGuiWindowFlags_HorizontalScrollbar))
+			draw_timeline(from, to);
+		ImGui::EndChild();
+
+		draw_totals();
+
+		ImGui::End();
+	}
+}
@@ -0,0 +1,571 @@
+#include "egfx/mesh_buffer.h"
+
+#include "egfx/mesh_definition.h"
+
+#include <cassert>
+#include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+namespace ot::egfx
+{
+	namespace
+	{
+		// Transform of a part, with the inverse used for its normals
+		struct part_transform
+		{
+			math::transform_matrix transform;
+			math::transform_matrix inverse;
+		};
+
+		[[nodiscard]] std::optional<part_transform> make_part_transform(submesh_part const& part)
+		{
+			if (!part.transform)
+				return std::nullopt;
+			return part_transform{ *part.transform, invert(*part.transform) };
+		}
+
+		// Normals go through the inverse transpose, to stay perpendicular to their face under non-uniform scales
+		[[nodiscard]] math::vector3f transform_normal(math::vector3f n, math::transform_matrix const& inverse)
+		{
+			return normalized(math::vector3f{
+				inverse[0][0] * n.x + inverse[1][0] * n.y + inverse[2][0] * n.z,
+				inverse[0][1] * n.x + inverse[1][1] * n.y + inverse[2][1] * n.z,
+				inverse[0][2] * n.x + inverse[1][2] * n.y + inverse[2][2] * n.z,
+			});
+		}
+
+		// Bounds of the transformed box: each axis of the transform stretches the box by its absolute components
+		[[nodiscard]] math::aabb transform_bounds(math::aabb const& b, math::transform_matrix const& t)
+		{
+			math::vector3f const h = b.half_size;
+			return {
+				transform(b.position, t),
+				{
+					std::abs(t[0][0]) * h.x + std::abs(t[0][1]) * h.y + std::abs(t[0][2]) * h.z,
+					std::abs(t[1][0]) * h.x + std::abs(t[1][1]) * h.y + std::abs(t[1][2]) * h.z,
+					std::abs(t[2][0]) * h.x + std::abs(t[2][1]) * h.y + std::abs(t[2][2]) * h.z,
+				},
+			};
+		}
+
+		// Calls 'add_corner' with the render vertex of each corner of the face, which returns the index of the vertex, and 'add_triangle' with the indices of each triangle of a fan over the face
+		// Triangle fans are not support on Direct3D 11, and we need something that works for the whole mesh anyway
+		template<typename AddCorner, typename AddTriangle>
+		void triangulate_face(face::cref face, part_transform const* t, AddCorner&& add_corner, AddTriangle&& add_triangle)
+		{
+			math::vector3f const normal = t != nullptr ? transform_normal(face.get_normal(), t->inverse) : face.get_normal();
+
+			// Each half-edge stands for the corner it leaves from
+			uint32_t first = 0;
+			uint32_t previous = 0;
+			size_t corner_count = 0;
+			for (half_edge::cref const corner : face.get_half_edges())
+			{
+				math::point3f const position = corner.get_source_vertex().get_position();
+				uint32_t const index = add_corner(render_vertex{ t != nullptr ? transform(position, t->transform) : position, normal, corner.get_uv() });
+				if (corner_count == 0)
+					first = index;
+				else if (corner_count >= 2)
+					add_triangle(first, previous, index);
+
+				previous = index;
+				++corner_count;
+			}
+		}
+
+		template<typename AddCorner, typename AddTriangle>
+		void triangulate_parts(std::span<submesh_part const> parts, AddCorner&& add_corner, AddTriangle&& add_triangle)
+		{
+			for (submesh_part const& part : parts)
+			{
+				std::optional<part_transform> const t = make_part_transform(part);
+				for (face::cref const face : part.mesh->get_faces())
+					triangulate_face(face, t ? &*t : nullptr, add_corner, add_triangle);
+			}
+		}
+
+		// Builds a fan-shaped triangle list, without sharing vertices between faces
+		template<typename Index>
+		void write_triangle_data(std::span<submesh_part const> parts, std::span<render_vertex> vertices, std::span<Index> indices)
+		{
+			auto vertex_it = vertices.begin();
+			auto index_it = indices.begin();
+
+			triangulate_parts(parts
+				, [&](render_vertex const& v)
+				{
+					uint32_t const index = static_cast<uint32_t>(std::distance(vertices.begin(), vertex_it));
+					*vertex_it++ = v;
+					return index;
+				}
+				, [&](uint32_t a, uint32_t b, uint32_t c)
+				{
+					*index_it++ = static_cast<Index>(a);
+					*index_it++ = static_cast<Index>(b);
+					*index_it++ = static_cast<Index>(c);
+				}
+			);
+
+			assert(vertex_it == vertices.end() && index_it == indices.end());
+		}
+
+		struct render_vertex_hash
+		{
+			size_t operator()(render_vertex const& v) const noexcept
+			{
+				float const components[] = { v.position.x, v.position.y, v.position.z, v.normal.x, v.normal.y, v.normal.z, v.uv.x, v.uv.y };
+				size_t hash = 0;
+				for (float const c : components)
+				{
+					// Adding zero turns -0 into +0, which compare equal
+					hash ^= std::hash<uint32_t>{}(std::bit_cast<uint32_t>(c + 0.f)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+				}
+				return hash;
+			}
+		};
+
+		struct render_vertex_equal
+		{
+			bool operator()(render_vertex const& lhs, render_vertex const& rhs) const noexcept
+			{
+				return lhs.position.x == rhs.position.x && lhs.position.y == rhs.position.y && lhs.position.z == rhs.position.z
+					&& lhs.normal.x == rhs.normal.x && lhs.normal.y == rhs.normal.y && lhs.normal.z == rhs.normal.z
+					&& lhs.uv.x == rhs.uv.x && lhs.uv.y == rhs.uv.y;
+			}
+		};
+
+		// Scoring of Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+		namespace forsyth
+		{
+			constexpr size_t cache_size = 32;
+			constexpr float cache_decay_power = 1.5f;
+			constexpr float last_triangle_score = 0.75f;
+			constexpr float valence_boost_scale = 2.0f;
+			constexpr float valence_boost_power = 0.5f;
+
+			constexpr uint32_t no_triangle = ~uint32_t(0);
+
+			[[nodiscard]] float get_vertex_score(int cache_position, size_t remaining_valence)
+			{
+				if (remaining_valence == 0)
+					return -1.f; // no triangle left needs this vertex
+
+				float score = 0.f;
+				if (cache_position >= 0)
+				{
+					if (cache_position < 3)
+					{
+						// The vertex was used in the last triangle. Fixed score, so that the triangle strip does not get favored too much
+						score = last_triangle_score;
+					}
+					else
+					{
+						float const scaler = 1.f / static_cast<float>(cache_size - 3);
+						score = std::pow(1.f - static_cast<float>(cache_position - 3) * scaler, cache_decay_power);
+					}
+				}
+
+				// Boost vertices with few triangles left, to get rid of lone triangles
+				score += valence_boost_scale * std::pow(static_cast<float>(remaining_valence), -valence_boost_power);
+				return score;
+			}
+		}
+	}
+
+	void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count)
+	{
+		using namespace forsyth;
+
+		size_t const triangle_count = indices.size() / 3;
+		if (triangle_count == 0)
+			return;
+
+		// Triangles of each vertex, in compressed rows. The first 'remaining_valence' entries are the triangles which were not added yet
+		std::vector<uint32_t> vertex_triangle_offsets(vertex_count + 1, 0);
+		for (uint32_t const index : indices)
+			++vertex_triangle_offsets[index + 1];
+		std::partial_sum(vertex_triangle_offsets.begin(), vertex_triangle_offsets.end(), vertex_triangle_offsets.begin());
+
+		std::vector<uint32_t> vertex_triangles(indices.size());
+		std::vector<uint32_t> remaining_valence(vertex_count, 0);
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			uint32_t const v = indices[i];
+			vertex_triangles[vertex_triangle_offsets[v] + remaining_valence[v]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<float> vertex_scores(vertex_count);
+		for (size_t v = 0; v < vertex_count; ++v)
+			vertex_scores[v] = get_vertex_score(-1, remaining_valence[v]);
+
+		auto const get_triangle_score = [&indices, &vertex_scores](uint32_t t)
+		{
+			return vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+		};
+
+		uint32_t best_triangle = 0;
+		for (uint32_t t = 1; t < triangle_count; ++t)
+		{
+			if (get_triangle_score(t) > get_triangle_score(best_triangle))
+				best_triangle = t;
+		}
+
+		std::vector<bool> triangle_added(triangle_count, false);
+		size_t next_unadded = 0;
+
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> new_cache;
+		cache.reserve(cache_size + 3);
+		new_cache.reserve(cache_size + 3);
+
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+
+		for (size_t added = 0; added < triangle_count; ++added)
+		{
+			if (best_triangle == no_triangle)
+			{
+				// Nothing in the cache connects to the remaining triangles: start from any of them
+				while (triangle_added[next_unadded])
+					++next_unadded;
+				best_triangle = static_cast<uint32_t>(next_unadded);
+			}
+
+			uint32_t const* const triangle = &indices[best_triangle * 3];
+			output.insert(output.end(), triangle, triangle + 3);
+			triangle_added[best_triangle] = true;
+
+			new_cache.clear();
+			for (size_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t const v = triangle[corner];
+
+				// Remove the triangle from the remaining triangles of the vertex
+				uint32_t* const triangles_begin = &vertex_triangles[vertex_triangle_offsets[v]];
+				uint32_t* const triangles_end = triangles_begin + remaining_valence[v];
+				*std::find(triangles_begin, triangles_end, best_triangle) = *(triangles_end - 1);
+				--remaining_valence[v];
+
+				new_cache.push_back(v);
+			}
+
+			for (uint32_t const v : cache)
+			{
+				if (std::find(triangle, triangle + 3, v) == triangle + 3)
+					new_cache.push_back(v);
+			}
+
+			// Vertices pushed out of the cache lose their cache score
+			for (size_t i = cache_size; i < new_cache.size(); ++i)
+			{
+				uint32_t const v = new_cache[i];
+				vertex_scores[v] = get_vertex_score(-1, remaining_valence[v]);
+			}
+			new_cache.resize(std::min(new_cache.size(), cache_size));
+			std::swap(cache, new_cache);
+
+			for (size_t i = 0; i < cache.size(); ++i)
+			{
+				uint32_t const v = cache[i];
+				vertex_scores[v] = get_vertex_score(static_cast<int>(i), remaining_valence[v]);
+			}
+
+			// Only triangles touching the cache had their score change
+			best_triangle = no_triangle;
+			float best_score = -1.f;
+			for (uint32_t const v : cache)
+			{
+				uint32_t const* const triangles_begin = &vertex_triangles[vertex_triangle_offsets[v]];
+				for (uint32_t const* t = triangles_begin; t != triangles_begin + remaining_valence[v]; ++t)
+				{
+					float const score = get_triangle_score(*t);
+					if (score > best_score)
+					{
+						best_score = score;
+						best_triangle = *t;
+					}
+				}
+			}
+		}
+
+		std::copy(output.begin(), output.end(), indices.begin());
+	}
+
+	float get_acmr(std::span<uint32_t const> indices, size_t cache_size)
+	{
+		size_t const triangle_count = indices.size() / 3;
+		if (triangle_count == 0 || cache_size == 0)
+			return 0.f;
+
+		std::vector<uint32_t> cache(cache_size, ~uint32_t(0));
+		size_t cache_head = 0;
+		size_t miss_count = 0;
+		for (uint32_t const index : indices)
+		{
+			if (std::find(cache.begin(), cache.end(), index) == cache.end())
+			{
+				++miss_count;
+				cache[cache_head] = index;
+				cache_head = (cache_head + 1) % cache_size;
+			}
+		}
+
+		return static_cast<float>(miss_count) / static_cast<float>(triangle_count);
+	}
+
+	triangle_list make_welded_triangle_list(std::span<submesh_part const> parts)
+	{
+		submesh_buffer_layout const corner_layout = get_submesh_buffer_layout(parts);
+
+		triangle_list list;
+		list.vertices.reserve(corner_layout.vertex_count);
+		list.indices.reserve(corner_layout.index_count);
+
+		std::unordered_map<render_vertex, uint32_t, render_vertex_hash, render_vertex_equal> vertex_indices;
+		vertex_indices.reserve(corner_layout.vertex_count);
+
+		triangulate_parts(parts
+			, [&](render_vertex const& v)
+			{
+				auto const [it, inserted] = vertex_indices.try_emplace(v, static_cast<uint32_t>(list.vertices.size()));
+				if (inserted)
+					list.vertices.push_back(v);
+				return it->second;
+			}
+			, [&list](uint32_t a, uint32_t b, uint32_t c)
+			{
+				list.indices.insert(list.indices.end(), { a, b, c });
+			}
+		);
+
+		optimize_vertex_cache(list.indices, list.vertices.size());
+		return list;
+	}
+
+	submesh_buffer_layout get_submesh_buffer_layout(triangle_list const& list)
+	{
+		submesh_buffer_layout layout;
+		layout.vertex_count = list.vertices.size();
+		layout.index_count = list.indices.size();
+		layout.format = layout.vertex_count <= max_16bit_vertex_count ? index_format::uint16 : index_format::uint32;
+		return layout;
+	}
+
+	void write_submesh_buffers(triangle_list const& list, submesh_buffer_layout const& layout, std::span<render_vertex> vertices, std::span<std::byte> indices)
+	{
+		if (vertices.size() != layout.vertex_count || indices.size() != layout.get_index_buffer_size() || list.vertices.size() != layout.vertex_count || list.indices.size() != layout.index_count)
+			throw std::invalid_argument("Submesh buffers do not match the layout");
+
+		std::copy(list.vertices.begin(), list.vertices.end(), vertices.begin());
+
+		if (layout.format == index_format::uint16)
+		{
+			if (layout.vertex_count > max_16bit_vertex_count)
+				throw std::invalid_argument("Too many vertices for a 16-bit index buffer");
+
+			auto index_it = reinterpret_cast<uint16_t*>(indices.data());
+			for (uint32_t const index : list.indices)
+				*index_it++ = static_cast<uint16_t>(index);
+		}
+		else
+		{
+			std::memcpy(indices.data(), list.indices.data(), indices.size());
+		}
+	}
+
+	submesh_buffer_layout get_submesh_buffer_layout(std::span<submesh_part const> parts)
+	{
+		submesh_buffer_layout layout;
+		for (submesh_part const& part : parts)
+		{
+			for (auto const& face : part.mesh->get_faces())
+			{
+				auto const face_vertex_count = face.get_vertex_count();
+				assert(face_vertex_count >= 3); // I've had issues at some point, better make sure
+				auto const triangle_count = face_vertex_count - 2;
+
+				layout.vertex_count += face_vertex_count;
+				layout.index_count += triangle_count * 3;
+			}
+		}
+
+		layout.format = layout.vertex_count <= max_16bit_vertex_count ? index_format::uint16 : index_format::uint32;
+		return layout;
+	}
+
+	void write_submesh_buffers(std::span<submesh_part const> parts, submesh_buffer_layout const& layout, std::span<render_vertex> vertices, std::span<std::byte> indices)
+	{
+		if (vertices.size() != layout.vertex_count || indices.size() != layout.get_index_buffer_size())
+			throw std::invalid_argument("Submesh buffers do not match the layout");
+
+		if (layout.format == index_format::uint16)
+		{
+			if (layout.vertex_count > max_16bit_vertex_count)
+				throw std::invalid_argument("Too many vertices for a 16-bit index buffer");
+
+			write_triangle_data(parts, vertices, std::span<uint16_t>(reinterpret_cast<uint16_t*>(indices.data()), layout.index_count));
+		}
+		else
+		{
+			write_triangle_data(parts, vertices, std::span<uint32_t>(reinterpret_cast<uint32_t*>(indices.data()), layout.index_count));
+		}
+	}
+
+	namespace
+	{
+		template<typename Index>
+		void write_face_data(face::cref face, face_buffer_range const& range, std::span<render_vertex> vertices, std::span<Index> indices)
+		{
+			auto vertex_it = vertices.begin();
+			auto index_it = indices.begin();
+
+			triangulate_face(face, nullptr
+				, [&](render_vertex const& v)
+				{
+					uint32_t const index = static_cast<uint32_t>(range.vertex_start + std::distance(vertices.begin(), vertex_it));
+					*vertex_it++ = v;
+					return index;
+				}
+				, [&](uint32_t a, uint32_t b, uint32_t c)
+				{
+					*index_it++ = static_cast<Index>(a);
+					*index_it++ = static_cast<Index>(b);
+					*index_it++ = static_cast<Index>(c);
+				}
+			);
+
+			// Unused room: copies of the first vertex, and triangles collapsed on it
+			std::fill(vertex_it, vertices.end(), vertices.front());
+			std::fill(index_it, indices.end(), static_cast<Index>(range.vertex_start));
+		}
+
+		template<typename Index>
+		std::span<Index> as_indices(std::span<std::byte> bytes)
+		{
+			return std::span<Index>(reinterpret_cast<Index*>(bytes.data()), bytes.size() / sizeof(Index));
+		}
+	}
+
+	face_buffer_map::face_buffer_map(mesh_definition const& m)
+	{
+		size_t face_vertex_total = 0;
+		for (auto const& face : m.get_faces())
+			face_vertex_total += face.get_vertex_count() + face_vertex_slack;
+
+		// Any face fits in 3 indices per vertex
+		size_t const spare_vertex_count = static_cast<size_t>(static_cast<float>(face_vertex_total) * spare_capacity);
+		layout.vertex_count = face_vertex_total + spare_vertex_count;
+		layout.index_count = face_vertex_total * 3 + spare_vertex_count * 3;
+		layout.format = layout.vertex_count <= max_16bit_vertex_count ? index_format::uint16 : index_format::uint32;
+
+		ranges.reserve(m.get_faces().size());
+		for (auto const& face : m.get_faces())
+		{
+			[[maybe_unused]] bool const appended = try_append(face.get_vertex_count());
+			assert(appended);
+		}
+	}
+
+	bool face_buffer_map::try_append(size_t face_vertex_count)
+	{
+		size_t const vertex_capacity = face_vertex_count + face_vertex_slack;
+		size_t const index_capacity = (vertex_capacity - 2) * 3;
+		if (used_vertex_count + vertex_capacity > layout.vertex_count || used_index_count + index_capacity > layout.index_count)
+			return false;
+
+		ranges.push_back({ used_vertex_count, vertex_capacity, used_index_count, index_capacity });
+		used_vertex_count += vertex_capacity;
+		used_index_count += index_capacity;
+		return true;
+	}
+
+	bool face_buffer_map::update(mesh_definition const& m, std::span<face::id const> changed_faces)
+	{
+		for (face::id const f : changed_faces)
+		{
+			size_t const face_index = static_cast<size_t>(f);
+
+			// New faces get appended in id order
+			while (ranges.size() <= face_index)
+			{
+				if (!try_append(m.get_face(face::id(ranges.size())).get_vertex_count()))
+					return false;
+			}
+
+			if (m.get_face(f).get_vertex_count() > ranges[face_index].vertex_capacity)
+				return false;
+		}
+
+		return true;
+	}
+
+	void write_submesh_buffers(mesh_definition const& m, face_buffer_map const& map, std::span<render_vertex> vertices, std::span<std::byte> indices)
+	{
+		submesh_buffer_layout const& layout = map.get_layout();
+		if (vertices.size() != layout.vertex_count || indices.size() != layout.get_index_buffer_size() || map.get_face_count() != m.get_faces().size())
+			throw std::invalid_argument("Submesh buffers do not match the layout");
+
+		size_t vertex_end = 0;
+		size_t index_end = 0;
+		for (auto const& face : m.get_faces())
+		{
+			face_buffer_range const& range = map.get_range(face.get_id());
+			write_face_buffers(face, range, layout.format
+				, vertices.subspan(range.vertex_start, range.vertex_capacity)
+				, indices.subspan(range.index_start * layout.get_index_size(), range.index_capacity * layout.get_index_size())
+			);
+			vertex_end = std::max(vertex_end, range.vertex_start + range.vertex_capacity);
+			index_end = std::max(index_end, range.index_start + range.index_capacity);
+		}
+
+		std::fill(vertices.begin() + vertex_end, vertices.end(), render_vertex{});
+		std::fill(indices.begin() + index_end * layout.get_index_size(), indices.end(), std::byte(0));
+	}
+
+	void write_face_buffers(face::cref face, face_buffer_range const& range, index_format format, std::span<render_vertex> vertices, std::span<std::byte> indices)
+	{
+		size_t const index_size = format == index_format::uint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		if (vertices.size() != range.vertex_capacity || indices.size() != range.index_capacity * index_size || face.get_vertex_count() > range.vertex_capacity)
+			throw std::invalid_argument("Face buffers do not match the range");
+
+		if (format == index_format::uint16)
+			write_face_data(face, range, vertices, as_indices<uint16_t>(indices));
+		else
+			write_face_data(face, range, vertices, as_indices<uint32_t>(indices));
+	}
+
+	math::aabb get_triangle_bounds(triangle_list const& list)
+	{
+		if (list.vertices.empty())
+			return {};
+
+		math::aabb bounds{ list.vertices.front().position, { 0.f, 0.f, 0.f } };
+		for (render_vertex const& v : list.vertices)
+			bounds.merge(v.position);
+		return bounds;
+	}
+
+	math::aabb get_submesh_bounds(std::span<submesh_definition const> submeshes)
+	{
+		math::aabb bounds{};
+		bool first = true;
+		for (submesh_definition const& submesh : submeshes)
+		{
+			for (submesh_part const& part : submesh.parts)
+			{
+				math::aabb const part_bounds = part.transform ? transform_bounds(part.mesh->get_bounds(), *part.transform) : part.mesh->get_bounds();
+				if (first)
+					bounds = part_bounds;
+				else
+					bounds.merge(part_bounds);
+				first = false;
+			}
+		}
+		return bounds;
+	}
+}
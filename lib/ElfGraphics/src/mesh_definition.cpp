@@ -1,37 +1,68 @@
 #include "mesh_definition.h"
 
+#include "math/plane_batch.h"
+
 #include <numeric>
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
 #include <system_error>
 #include <cassert>
+#include <cmath>
 
 namespace ot::egfx
 {	
-	namespace vertex
+	namespace
 	{
-		math::point2f cref::get_uv() const
+		template<typename T, typename Id>
+		T& attribute(persistent_vector<T>& attributes, Id id)
 		{
-			// Do "spherical" mapping
-			// Imagine the texture as a sphere
-			// u is the theta coordinate on the XZ plane, mapped between 0 and 1 (0 and 1 touch at -X, Z=0)
-			// v is the phi coordinate, again between 0 (top) and 1 (bottom) 
-
-			// TODO: need a UV per face, using a Cubic projection
-
-			math::point3f const pos = get_position();
+			return attributes.get_mutable(static_cast<size_t>(id));
+		}
+	}
 
-			if (float_eq(pos, math::point3f(0.f, 0.f, 0.f)))
-				return { 0.f, 0.f };
+	math::point2f uv_mapping::project(math::point3f p, math::vector3f face_normal) const noexcept
+	{
+		// Axes of the closest axis-aligned plane, seen from the front of the face with v pointing down (-Y) on walls
+		math::vector3f const n = face_normal;
+		float const abs_x = std::abs(n.x);
+		float const abs_y = std::abs(n.y);
+		float const abs_z = std::abs(n.z);
+
+		math::vector3f u_axis, v_axis;
+		if (abs_y >= abs_x && abs_y >= abs_z)
+		{
+			u_axis = { 1.f, 0.f, 0.f };
+			v_axis = { 0.f, 0.f, std::copysign(1.f, n.y) };
+		}
+		else if (abs_x >= abs_z)
+		{
+			u_axis = { 0.f, 0.f, -std::copysign(1.f, n.x) };
+			v_axis = { 0.f, -1.f, 0.f };
+		}
+		else
+		{
+			u_axis = { std::copysign(1.f, n.z), 0.f, 0.f };
+			v_axis = { 0.f, -1.f, 0.f };
+		}
 
-			float u = std::atan2(pos.z, pos.x); // -pi to pi
-			u *= std::numbers::inv_pi_v<float> *0.5f; // -0.5 to 0.5
-			u += 0.5f; // 0 to 1
+		if (projection == uv_projection::planar)
+		{
+			// Tilts the axes onto the face. The v axis lies along the dominant plane, so it is never parallel to the normal
+			v_axis = normalized(v_axis + n * -dot_product(v_axis, n));
+			u_axis = cross_product(n, v_axis);
+		}
 
-			float const xz_norm = std::sqrt(pos.x * pos.x + pos.z * pos.z);
-			float v = std::atan2(xz_norm, pos.y); // xz_norm >= 0, [0 to pi]. If xz_norm = 0, +Y = 0, -Y = Pi
-			v *= std::numbers::inv_pi_v<float>; // 0 to 1
+		math::vector3f const v = vector_from_origin(p);
+		float const u0 = dot_product(v, u_axis);
+		float const v0 = dot_product(v, v_axis);
 
-			return { u, v };
-		}
+		float const cos_r = std::cos(rotation);
+		float const sin_r = std::sin(rotation);
+		return {
+			(u0 * cos_r - v0 * sin_r) * scale.x + offset.x,
+			(u0 * sin_r + v0 * cos_r) * scale.y + offset.y,
+		};
 	}
 
 	namespace half_edge
@@ -43,43 +74,42 @@ namespace ot::egfx
 		//     Current Twin                             New Twin                 Current Twin
 		auto ref::split_at(math::point3f point) const -> ref
 		{
-			m->half_edges.reserve(m->half_edges.size() + 2);
-
 			auto const edge_id = e;
+			auto const twin_id = m->get_half_edge_twin(edge_id);
 
-			mesh_definition::half_edge_data& edge = m->get_half_edge_data(edge_id);
+			auto const new_edge_id = m->add_half_edge();
+			auto const new_twin_id = m->add_half_edge();
+			auto const new_vertex_id = m->add_vertex(point, new_edge_id);
 
-			auto const twin_id = edge.twin;
-			mesh_definition::half_edge_data& twin = m->get_half_edge_data(twin_id);
+			auto& vertices = m->half_edge_vertices;
+			auto& faces = m->half_edge_faces;
+			auto& nexts = m->half_edge_nexts;
+			auto& twins = m->half_edge_twins;
 
-			auto const new_edge_id = id(m->half_edges.size());
-			auto& new_edge = m->half_edges.emplace_back();
+			attribute(faces, new_edge_id) = m->get_half_edge_face(edge_id);
+			attribute(vertices, new_edge_id) = m->get_half_edge_vertex(edge_id);
+			attribute(nexts, new_edge_id) = m->get_half_edge_next(edge_id);
+			attribute(twins, new_edge_id) = twin_id;
 
-			auto const new_twin_id = id(m->half_edges.size());
-			auto& new_twin = m->half_edges.emplace_back();
+			attribute(faces, new_twin_id) = m->get_half_edge_face(twin_id);
+			attribute(vertices, new_twin_id) = m->get_half_edge_vertex(twin_id);
+			attribute(nexts, new_twin_id) = m->get_half_edge_next(twin_id);
+			attribute(twins, new_twin_id) = edge_id;
 
-			auto const new_vertex_id = vertex::id(m->vertices.size());
-			mesh_definition::vertex_data& new_vertex = m->vertices.emplace_back();
-			new_vertex.position = point;
-			new_vertex.first_edge = new_edge_id;
+			attribute(vertices, edge_id) = new_vertex_id;
+			attribute(nexts, edge_id) = new_edge_id;
+			attribute(twins, edge_id) = new_twin_id;
 
-			new_edge.face = edge.face;
-			new_edge.vertex = edge.vertex;
-			new_edge.next = edge.next;
-			new_edge.twin = twin_id;
+			attribute(vertices, twin_id) = new_vertex_id;
+			attribute(nexts, twin_id) = new_twin_id;
+			attribute(twins, twin_id) = new_edge_id;
 
-			new_twin.face = twin.face;
-			new_twin.vertex = twin.vertex;
-			new_twin.next = twin.next;
-			new_twin.twin = edge_id;
+			// Both new half-edges leave from the new vertex
+			m->update_half_edge_uv(new_edge_id);
+			m->update_half_edge_uv(new_twin_id);
 
-			edge.vertex = new_vertex_id;
-			edge.next = new_edge_id;
-			edge.twin = new_twin_id;
-
-			twin.vertex = new_vertex_id;
-			twin.next = new_twin_id;
-			twin.twin = new_edge_id;
+			m->mark_face_dirty(attribute(faces, edge_id));
+			m->mark_face_dirty(attribute(faces, twin_id));
 
 			return { *m, new_edge_id };
 		}
@@ -87,21 +117,14 @@ namespace ot::egfx
 
 	namespace face
 	{
-		detail::face_data const& cref::get_face_data() const noexcept
-		{
-			return m->get_face_data(f);
-		}
-
 		math::vector3f cref::get_normal() const
 		{
-			return get_face_data().normal;
+			return m->get_face_normal(f);
 		}
 
 		math::plane cref::get_plane() const
 		{
-			detail::face_data const& data = get_face_data();
-			detail::half_edge_data const& h = m->get_half_edge_data(data.first_edge);
-			math::point3f const p = m->get_vertex(h.vertex).get_position();
+			math::point3f const p = m->get_vertex_position(m->get_face_first_vertex(f));
 			math::vector3f const n = get_normal();
 			float const d = dot_product(vector_from_origin(p), n);
 			return { n, d };
@@ -132,21 +155,44 @@ namespace ot::egfx
 
 		half_edge::cref cref::get_first_half_edge() const
 		{
-			return m->get_half_edge(get_face_data().first_edge);
+			return m->get_half_edge(m->get_face_first_edge(f));
 		}
 
-		detail::face_data& ref::get_face_data() const noexcept
+		half_edge::ref ref::get_first_half_edge() const
 		{
-			return m->get_face_data(f);
+			return m->get_half_edge(m->get_face_first_edge(f));
 		}
 
-		half_edge::ref ref::get_first_half_edge() const
+		void ref::set_uv_mapping(uv_mapping const& mapping) const
 		{
-			return m->get_half_edge(get_face_data().first_edge);
+			attribute(m->face_uv_mappings, f) = mapping;
+			m->update_face_uvs(f);
+			m->mark_face_dirty(f);
 		}
 
 		expected<ref, split_fail> ref::split(math::plane const p) const
 		{
+			// Classify every vertex in one batch first: a face without vertices on both sides of the plane is left as is
+			std::vector<math::point3f> positions;
+			for (auto const v : get_vertices())
+				positions.push_back(v.get_position());
+
+			std::vector<math::plane_side_result> sides(positions.size());
+			math::get_plane_sides(p, positions, sides);
+			bool const has_inside = std::find(sides.begin(), sides.end(), math::plane_side_result::inside) != sides.end();
+			bool const has_outside = std::find(sides.begin(), sides.end(), math::plane_side_result::outside) != sides.end();
+			if (!has_inside || !has_outside)
+			{
+				if (has_inside)
+					return make_unexpected(split_fail::inside);
+				else if (has_outside)
+					return make_unexpected(split_fail::outside);
+				else if (float_cmp(dot_product(get_normal(), p.normal), 0.f) > 0)
+					return make_unexpected(split_fail::aligned);
+				else
+					return make_unexpected(split_fail::opposite_aligned);
+			}
+
 			struct point_data
 			{
 				half_edge::ref half_edge; // half-edge before the point
@@ -282,37 +328,39 @@ namespace ot::egfx
 				// Insert a new face outside the plane, and a new half-edge pair for the new edge between the two faces
 				// We keep the current face as the "inside" face
 
-				face::id const new_face_id{ m->faces.size() };
-				detail::face_data& new_face = m->faces.emplace_back();
+				uv_mapping const mapping = get_uv_mapping(); // copied, adding the face can move the mappings
+				face::id const new_face_id = m->add_face(get_normal(), mapping); // new face has same normal and mapping, the corners it takes over keep their uvs
+				half_edge::id const outside_edge_id = m->add_half_edge();
+				half_edge::id const inside_edge_id = m->add_half_edge();
 
-				m->half_edges.reserve(m->half_edges.size() + 2);
-				half_edge::id const outside_edge_id{ m->half_edges.size() };
-				detail::half_edge_data& outside_edge = m->half_edges.emplace_back();
+				auto& vertices = m->half_edge_vertices;
+				auto& faces = m->half_edge_faces;
+				auto& nexts = m->half_edge_nexts;
+				auto& twins = m->half_edge_twins;
 
-				half_edge::id const inside_edge_id{ m->half_edges.size() };
-				detail::half_edge_data& inside_edge = m->half_edges.emplace_back();
+				// Initialize the new half-edges
+				attribute(twins, outside_edge_id) = inside_edge_id;
+				attribute(twins, inside_edge_id) = outside_edge_id;
 
-				detail::half_edge_data& enter_edge = m->get_half_edge_data(enter_edge_id);
-				detail::half_edge_data& exit_edge = m->get_half_edge_data(exit_edge_id);
+				attribute(faces, outside_edge_id) = new_face_id;
+				attribute(faces, inside_edge_id) = get_id();
 
-				// Initialize the new half-edges
-				outside_edge.twin = inside_edge_id;
-				inside_edge.twin = outside_edge_id;
+				attribute(vertices, outside_edge_id) = m->get_half_edge_vertex(exit_edge_id);
+				attribute(vertices, inside_edge_id) = m->get_half_edge_vertex(enter_edge_id);
 
-				outside_edge.face = new_face_id;
-				inside_edge.face = get_id();
+				attribute(nexts, outside_edge_id) = m->get_half_edge_next(exit_edge_id);
+				attribute(nexts, inside_edge_id) = m->get_half_edge_next(enter_edge_id);
 
-				outside_edge.vertex = exit_edge.vertex;
-				inside_edge.vertex = enter_edge.vertex;
+				attribute(nexts, exit_edge_id) = inside_edge_id;
+				attribute(nexts, enter_edge_id) = outside_edge_id;
 
-				outside_edge.next = exit_edge.next;
-				inside_edge.next = enter_edge.next;
+				m->set_face_first_edge(new_face_id, outside_edge_id);
 
-				exit_edge.next = inside_edge_id;
-				enter_edge.next = outside_edge_id;
+				m->update_half_edge_uv(outside_edge_id);
+				m->update_half_edge_uv(inside_edge_id);
 
-				new_face.first_edge = outside_edge_id;
-				new_face.normal = get_normal(); // new face has same normal
+				m->mark_face_dirty(get_id());
+				m->mark_face_dirty(new_face_id);
 
 				return face::ref{ *m, new_face_id };
 			}
@@ -334,252 +382,524 @@ namespace ot::egfx
 
 	namespace
 	{
-		math::vector3f get_average_normal(std::span<math::plane const> planes)
+		// Keeps the first of each set of coplanar planes, the halves of a split face sharing the plane of the face they come from
+		// Snapped planes are only merged when exactly equal
+		void remove_coplanar_planes(std::vector<math::plane>& planes, std::vector<math::fixed_plane>& fixed_planes)
 		{
-			return normalized(std::accumulate(planes.begin(), planes.end(), math::vector3f{}, [](math::vector3f value, math::plane plane) { return value + plane.normal; }));
+			bool const snapped = !fixed_planes.empty();
+			size_t kept = 0;
+			for (size_t i = 0; i < planes.size(); ++i)
+			{
+				bool const is_duplicate = snapped
+					? std::find(fixed_planes.begin(), fixed_planes.begin() + kept, fixed_planes[i]) != fixed_planes.begin() + kept
+					: std::any_of(planes.begin(), planes.begin() + kept, [&p = planes[i]](math::plane const& other) { return float_eq(other, p); });
+				if (is_duplicate)
+					continue;
+
+				planes[kept] = planes[i];
+				if (snapped)
+					fixed_planes[kept] = fixed_planes[i];
+				++kept;
+			}
+
+			planes.resize(kept);
+			if (snapped)
+				fixed_planes.resize(kept);
 		}
 
-		struct edge_intersection
+		// A corner of a face polygon during construction
+		struct polygon_corner
 		{
-			half_edge::id edge;
-			face::id planes[2];
+			math::point3f position;
+			face::id edge_plane; // index of the other plane bordering the edge leaving this corner, none if the edge is still part of the initial quad
 		};
-	}
 
-	struct mesh_definition::point_intersection
-	{
-		std::vector<edge_intersection> edges;
-		std::vector<face::id> planes;
-		vertex::id vertex;
-	};
+		using corner_list = std::vector<polygon_corner>;
 
-	auto mesh_definition::find_intersections(std::span<const math::plane> planes, std::vector<mesh_definition::vertex_data>& vertices, std::vector<mesh_definition::half_edge_data>& half_edges) -> std::vector<point_intersection>
-	{
-		if (planes.size() < 3)
+		// Returns a square on the plane, centered on the point of the plane closest to the origin. The corners are counter-clockwise around the normal
+		[[nodiscard]] corner_list make_plane_quad(math::plane p, float half_extent)
 		{
-			return {};
+			math::vector3f const n = p.normal;
+
+			// Build the tangents from the world axis least aligned with the normal
+			math::vector3f const axis = std::abs(n.x) < std::abs(n.y)
+				? (std::abs(n.x) < std::abs(n.z) ? math::vector3f::unit_x() : math::vector3f::unit_z())
+				: (std::abs(n.y) < std::abs(n.z) ? math::vector3f::unit_y() : math::vector3f::unit_z());
+			math::vector3f const u = normalized(cross_product(n, axis)) * half_extent;
+			math::vector3f const v = cross_product(n, u);
+			math::point3f const center = p.get_point();
+
+			return {
+				{ center - u - v, face::id::none },
+				{ center + u - v, face::id::none },
+				{ center + u + v, face::id::none },
+				{ center - u + v, face::id::none },
+			};
 		}
 
-		std::vector<point_intersection> intersections;
+		// Buffers reused between clips, to classify the corners of a polygon in one batch
+		struct clip_scratch
+		{
+			std::vector<math::point3f> positions;
+			std::vector<float> distances;
+			std::vector<math::plane_side_result> sides;
+		};
 
-		// Find the point intersections where 3 or more planes intersect
-		for (size_t i = 0; i < planes.size() - 2; ++i)
+		// Clips the polygon of a face against the half-space of another plane, keeping the inside part in 'result'
+		// New corners are computed from the three planes meeting at them when possible, so that error does not accumulate along the long edges of the initial quad
+		// Returns false if the polygon was entirely inside the half-space, in which case 'result' is left untouched
+		// With snapped planes, corners are snapped and classified exactly, a corner snapped from a position on the plane being on it
+		bool clip_polygon(std::span<const math::plane> planes, std::span<math::fixed_plane const> fixed_planes, face::id face_id, face::id clip_id, corner_list const& polygon, corner_list& result, clip_scratch& scratch)
 		{
-			math::plane const plane1 = planes[i];
-			for (size_t j = i + 1; j < planes.size() - 1; ++j)
+			math::plane const face_plane = planes[static_cast<size_t>(face_id)];
+			math::plane const clip_plane = planes[static_cast<size_t>(clip_id)];
+			bool const snapped = !fixed_planes.empty();
+
+			size_t const count = polygon.size();
+			scratch.positions.resize(count);
+			scratch.distances.resize(count);
+			scratch.sides.resize(count);
+			std::transform(polygon.begin(), polygon.end(), scratch.positions.begin(), [](polygon_corner const& c) { return c.position; });
+			math::distances_to(clip_plane, scratch.positions, scratch.distances);
+			if (snapped)
 			{
-				math::plane const plane2 = planes[j];
-				for (size_t k = j + 1; k < planes.size(); ++k)
-				{
-					math::plane const plane3 = planes[k];
+				math::fixed_plane const& fixed_clip_plane = fixed_planes[static_cast<size_t>(clip_id)];
+				int64_t const tolerance = get_snapping_tolerance(fixed_clip_plane);
+				for (size_t k = 0; k < count; ++k)
+					scratch.sides[k] = get_plane_side(fixed_clip_plane, math::snap(scratch.positions[k]), tolerance);
+			}
+			else
+			{
+				math::distances_to_plane_sides(scratch.distances, scratch.sides);
+			}
+
+			if (std::find(scratch.sides.begin(), scratch.sides.end(), math::plane_side_result::outside) == scratch.sides.end())
+				return false;
 
-					auto const intersection_result = find_intersection(plane1, plane2, plane3);
-					if (!intersection_result)
+			auto const make_position = [&](polygon_corner const& from, float from_distance, polygon_corner const& to, float to_distance)
+			{
+				if (snapped)
+				{
+					if (from.edge_plane != face::id::none)
 					{
-						continue;
+						if (auto const intersection = find_intersection(fixed_planes[static_cast<size_t>(face_id)], fixed_planes[static_cast<size_t>(from.edge_plane)], fixed_planes[static_cast<size_t>(clip_id)]))
+							return to_point(*intersection);
 					}
 
-					std::vector<face::id> intersecting_planes{ face::id(i), face::id(j), face::id(k) };
+					return to_point(math::snap(math::find_distance_ray_intersection(from.position, from_distance, to.position, to_distance)));
+				}
 
-					// check for extra planes
-					for (size_t l = 0; l < planes.size(); ++l)
-					{
-						if (l == i || l == j || l == k) continue;
+				if (from.edge_plane != face::id::none)
+				{
+					if (auto const intersection = find_intersection(face_plane, planes[static_cast<size_t>(from.edge_plane)], clip_plane))
+						return *intersection;
+				}
 
-						math::plane const plane4 = planes[l];
+				return math::find_distance_ray_intersection(from.position, from_distance, to.position, to_distance);
+			};
 
-						math::plane_side_result const result = get_plane_side(plane4, *intersection_result);
-						if (result == math::plane_side_result::on_plane)
-						{
-							if (l < k)
-								goto skip_intersection; // we've already found this intersection
+			result.clear();
 
-							intersecting_planes.push_back(face::id(l));
-						} 
-						else if (result == math::plane_side_result::outside)
-						{
-							goto skip_intersection; // intersection outside the mesh
-						}
-					}
+			for (size_t k = 0; k < count; ++k)
+			{
+				size_t const k_next = (k + 1) % count;
+				polygon_corner const& current = polygon[k];
+				polygon_corner const& next = polygon[k_next];
+				float const current_distance = scratch.distances[k];
+				float const next_distance = scratch.distances[k_next];
+				math::plane_side_result const current_side = scratch.sides[k];
+				math::plane_side_result const next_side = scratch.sides[k_next];
+
+				if (current_side != math::plane_side_result::outside)
+				{
+					// A corner on the plane followed by an outside corner now starts an edge along the clipping plane
+					bool const exits_on_plane = current_side == math::plane_side_result::on_plane && next_side == math::plane_side_result::outside;
+					result.push_back({ current.position, exits_on_plane ? clip_id : current.edge_plane });
 
-					// Create the new point intersection, and find the new edge intersections
-					{
-						auto const vertex_id = vertex::id(vertices.size());
-						mesh_definition::vertex_data& vertex = vertices.emplace_back();
-						vertex.position = *intersection_result;
-						vertex.first_edge = half_edge::id::none;
+					if (current_side == math::plane_side_result::inside && next_side == math::plane_side_result::outside)
+						result.push_back({ make_position(current, current_distance, next, next_distance), clip_id });
+				}
+				else if (next_side == math::plane_side_result::inside)
+				{
+					result.push_back({ make_position(current, current_distance, next, next_distance), current.edge_plane });
+				}
+			}
 
-						point_intersection intersection;
-						intersection.vertex = vertex_id;
-						intersection.planes = std::move(intersecting_planes);
+			if (result.size() < 3)
+				result.clear();
 
-						// find edge intersections with existing point intersections
-						for (point_intersection& previous_intersection : intersections)
-						{
-							auto const& planes_current = intersection.planes;
-							auto const& planes_other = previous_intersection.planes;
+			return true;
+		}
 
-							// find 2 planes that are also in the other intersection
-							size_t current_found_plane = 0;
-							face::id found_planes[2];
-							for (face::id const p : planes_current)
-							{
-								if (std::find(planes_other.begin(), planes_other.end(), p) == planes_other.end())
-									continue; // current plane not in the other intersection
+		// Removes the corners starting an edge of (almost) zero length, which happens when more than three planes meet at a vertex
+		// Snapped corners are only removed when exactly equal
+		void remove_degenerate_edges(corner_list& polygon, bool snapped)
+		{
+			for (size_t k = 0; k < polygon.size() && polygon.size() >= 3;)
+			{
+				polygon_corner const& next = polygon[(k + 1) % polygon.size()];
+				if (snapped ? polygon[k].position == next.position : float_eq(polygon[k].position, next.position))
+					polygon.erase(polygon.begin() + k);
+				else
+					++k;
+			}
 
-								found_planes[current_found_plane] = p;
-								++current_found_plane;
+			if (polygon.size() < 3)
+				polygon.clear();
+		}
 
-								if (current_found_plane == 2)
-									break;
-							}
+		// Recomputes each corner from the three planes meeting at it
+		void resolve_corner_positions(std::span<const math::plane> planes, face::id face_id, corner_list& polygon)
+		{
+			math::plane const face_plane = planes[static_cast<size_t>(face_id)];
+			std::vector<math::plane_triple> triples;
+			triples.reserve(polygon.size());
+			face::id previous_plane = polygon.back().edge_plane;
+			for (polygon_corner const& corner : polygon)
+			{
+				triples.push_back({ face_plane, planes[static_cast<size_t>(previous_plane)], planes[static_cast<size_t>(corner.edge_plane)] });
+				previous_plane = corner.edge_plane;
+			}
 
-							// other intersection does not have enough common planes
-							if (current_found_plane < 2)
-								continue;
+			std::vector<std::optional<math::point3f>> intersections(polygon.size());
+			math::find_intersections(triples, intersections);
+			for (size_t k = 0; k < polygon.size(); ++k)
+			{
+				if (intersections[k])
+					polygon[k].position = *intersections[k];
+			}
+		}
 
-							// create new intersection edges
-							half_edges.reserve(half_edges.capacity() + 2);
+		// Snaps each corner to where the three planes meeting at it meet, which only depends on these planes
+		// Corners from different faces at the same vertex then get exactly the same position
+		void resolve_snapped_corner_positions(std::span<math::fixed_plane const> fixed_planes, face::id face_id, corner_list& polygon)
+		{
+			if (polygon.empty())
+				return;
 
-							auto const he1_id = half_edge::id(half_edges.size());
-							auto& he1 = half_edges.emplace_back();
+			math::fixed_plane const& face_plane = fixed_planes[static_cast<size_t>(face_id)];
+			face::id previous_plane = polygon.back().edge_plane;
+			for (polygon_corner& corner : polygon)
+			{
+				if (auto const intersection = find_intersection(face_plane, fixed_planes[static_cast<size_t>(previous_plane)], fixed_planes[static_cast<size_t>(corner.edge_plane)]))
+					corner.position = to_point(*intersection);
+				previous_plane = corner.edge_plane;
+			}
+		}
 
-							auto const he2_id = half_edge::id(half_edges.size());
-							auto& he2 = half_edges.emplace_back();
+	}
 
-							he1.twin = he2_id;
-							he1.vertex = previous_intersection.vertex;
-							he2.twin = he1_id;
-							he2.vertex = intersection.vertex;
+	struct mesh_definition::face_polygon
+	{
+		corner_list corners;
+	};
 
-							// Resolve the "first edges" of the vertices if needed
-							{
-								if (vertex.first_edge == half_edge::id::none)
-								{
-									vertex.first_edge = he1_id;
-								}
-
-								mesh_definition::vertex_data& previous_vertex = vertices[static_cast<size_t>(previous_intersection.vertex)];
-								if (previous_vertex.first_edge == half_edge::id::none)
-								{
-									previous_vertex.first_edge = he2_id;
-								}
-							}
+	auto mesh_definition::clip_face_polygons(std::span<const math::plane> planes, std::span<math::fixed_plane const> fixed_planes) -> std::vector<face_polygon>
+	{
+		float initial_half_extent = 1.f;
+		for (math::plane const& p : planes)
+			initial_half_extent = std::max(initial_half_extent, 4.f * std::abs(p.distance));
 
-							edge_intersection& ei1 = previous_intersection.edges.emplace_back();
-							ei1.edge = he1_id;
-							ei1.planes[0] = found_planes[0];
-							ei1.planes[1] = found_planes[1];
+		// If an edge of the initial quad survives clipping, the quad was too small to contain the face. Grow it until the face is closed
+		size_t const max_attempts = 8;
+		float const extent_growth = 16.f;
 
-							edge_intersection& ei2 = intersection.edges.emplace_back();
-							ei2.edge = he2_id;
-							ei2.planes[0] = found_planes[0];
-							ei2.planes[1] = found_planes[1];
-						}
+		std::vector<face_polygon> polygons(planes.size());
+		corner_list scratch;
+		clip_scratch clip_buffers;
+		for (size_t i = 0; i < planes.size(); ++i)
+		{
+			face::id const face_id = face::id(i);
+			corner_list& polygon = polygons[i].corners;
 
-						intersections.push_back(std::move(intersection));
-					}
+			float half_extent = initial_half_extent;
+			for (size_t attempt = 0; attempt < max_attempts; ++attempt, half_extent *= extent_growth)
+			{
+				polygon = make_plane_quad(planes[i], half_extent);
+				if (!fixed_planes.empty())
+				{
+					for (polygon_corner& corner : polygon)
+						corner.position = to_point(math::snap(corner.position));
+				}
+
+				for (size_t j = 0; j < planes.size() && !polygon.empty(); ++j)
+				{
+					if (j == i)
+						continue;
 
-				skip_intersection:
-					;
+					if (clip_polygon(planes, fixed_planes, face_id, face::id(j), polygon, scratch, clip_buffers))
+						std::swap(polygon, scratch);
 				}
+
+				bool const is_closed = std::none_of(polygon.begin(), polygon.end(), [](polygon_corner const& c) { return c.edge_plane == face::id::none; });
+				if (is_closed)
+					break;
 			}
-		}
 
-		intersections.erase(std::remove_if(intersections.begin(), intersections.end(), [](point_intersection const& p)
-		{
-			return p.edges.size() <= 2;
-		}), intersections.end());
+			if (std::any_of(polygon.begin(), polygon.end(), [](polygon_corner const& c) { return c.edge_plane == face::id::none; }))
+				throw std::invalid_argument("Input faces do not form a closed volume");
+
+			if (fixed_planes.empty())
+			{
+				remove_degenerate_edges(polygon, false);
+				if (polygon.empty())
+					throw std::invalid_argument("Input face does not contribute to the volume");
+
+				resolve_corner_positions(planes, face_id, polygon);
+			}
+			else
+			{
+				// Where more than three planes meet, corners snapping to the same point leave an edge of exactly zero length
+				resolve_snapped_corner_positions(fixed_planes, face_id, polygon);
+				remove_degenerate_edges(polygon, true);
+				if (polygon.empty())
+					throw std::invalid_argument("Input face does not contribute to the volume");
+			}
+		}
 
-		return intersections;
+		return polygons;
 	}
 
-	void mesh_definition::resolve_edge_directions(std::span<const math::plane> planes, std::span<point_intersection const> intersections, std::span<mesh_definition::half_edge_data> half_edges, std::span<mesh_definition::face_data> faces)
+	void mesh_definition::link_face_polygons(std::span<face_polygon const> polygons, vertex_precision precision)
 	{
-		// For each vertex, check which half-edges are "ingoing" (ie: pointing at the vertex) or "outgoing" (ie: has its origin at the vertex)
-		for (point_intersection const& intersection : intersections)
+		size_t const face_count = polygons.size();
+		size_t const corner_count = std::accumulate(polygons.begin(), polygons.end(), size_t(0), [](size_t sum, face_polygon const& p) { return sum + p.corners.size(); });
+		if (corner_count % 2 != 0)
+			throw std::invalid_argument("Input faces do not form a closed volume");
+
+		// Two faces of a convex volume share at most one edge, so a half-edge is identified by its face and the face of its twin
+		// Twins are allocated as consecutive pairs
+		auto const make_key = [face_count](size_t face, face::id other_face) { return face * face_count + static_cast<size_t>(other_face); };
+		std::unordered_map<size_t, half_edge::id> edge_ids;
+		edge_ids.reserve(corner_count);
+
+		size_t next_edge_id = 0;
+		for (size_t i = 0; i < face_count; ++i)
 		{
-			auto const& edges = intersection.edges;
+			for (polygon_corner const& corner : polygons[i].corners)
+			{
+				auto const twin_it = edge_ids.find(make_key(static_cast<size_t>(corner.edge_plane), face::id(i)));
+				half_edge::id const edge_id = twin_it != edge_ids.end() ? half_edge::id(static_cast<size_t>(twin_it->second) ^ 1) : half_edge::id(next_edge_id);
+				if (twin_it == edge_ids.end())
+					next_edge_id += 2;
+
+				if (!edge_ids.emplace(make_key(i, corner.edge_plane), edge_id).second)
+					throw std::invalid_argument("Input faces share more than one edge");
+			}
+		}
+
+		if (next_edge_id != corner_count)
+			throw std::invalid_argument("Input faces do not form a closed volume");
 
-			for (size_t i = 0; i < edges.size() - 1; ++i)
+		half_edge_vertices.resize(corner_count, vertex::id::none);
+		half_edge_faces.resize(corner_count, face::id::none);
+		half_edge_twins.resize(corner_count, half_edge::id::none);
+		half_edge_nexts.resize(corner_count, half_edge::id::none);
+		half_edge_uvs.resize(corner_count, math::point2f{ 0.f, 0.f });
+		std::vector<math::point3f> corner_positions(corner_count);
+		for (size_t i = 0; i < face_count; ++i)
+		{
+			corner_list const& polygon = polygons[i].corners;
+			for (size_t k = 0; k < polygon.size(); ++k)
 			{
-				auto const& edge1 = edges[i];
-				for (size_t j = i + 1; j < edges.size(); ++j)
-				{
-					auto const& edge2 = edges[j];
-
-					// index of the shared plane for each edge intersection
-					int plane_index1;
-					int plane_index2;
-					if (edge1.planes[0] == edge2.planes[0]) {
-						plane_index1 = 0; 
-						plane_index2 = 0;
-					} else if (edge1.planes[0] == edge2.planes[1]) {
-						plane_index1 = 0; 
-						plane_index2 = 1;
-					} else if (edge1.planes[1] == edge2.planes[0]) {
-						plane_index1 = 1; 
-						plane_index2 = 0;
-					} else if (edge1.planes[1] == edge2.planes[1]) {
-						plane_index1 = 1; 
-						plane_index2 = 1;
-					} else {
-						continue;
-					}
+				polygon_corner const& corner = polygon[k];
+				polygon_corner const& next = polygon[(k + 1) % polygon.size()];
+				half_edge::id const edge_id = edge_ids[make_key(i, corner.edge_plane)];
+				attribute(half_edge_faces, edge_id) = face::id(i);
+				attribute(half_edge_nexts, edge_id) = edge_ids[make_key(i, next.edge_plane)];
+				attribute(half_edge_twins, edge_id) = half_edge::id(static_cast<size_t>(edge_id) ^ 1);
+				corner_positions[static_cast<size_t>(edge_id)] = corner.position;
+			}
 
-					face::id const shared_plane_id = edge1.planes[plane_index1];
-					face::id const other_plane1 = edge1.planes[1 - plane_index1];
-					face::id const other_plane2 = edge2.planes[1 - plane_index2];
-					math::plane const shared_plane = planes[static_cast<size_t>(shared_plane_id)];
-					math::plane const edge1_plane = planes[static_cast<size_t>(other_plane1)];
-					math::plane const edge2_plane = planes[static_cast<size_t>(other_plane2)];
+			face_first_edges.set(i, edge_ids[make_key(i, polygon.front().edge_plane)]);
+		}
 
-					math::vector3f const direction = cross_product(shared_plane.normal, edge1_plane.normal);
+		// Each half-edge stands for the corner it leaves from
+		std::vector<vertex::id> corner_vertices(corner_count, vertex::id::none);
+		if (precision == vertex_precision::snapped)
+		{
+			// Snapped corners at the same vertex have exactly the same position
+			std::unordered_map<math::fixed_point3, vertex::id> position_vertices;
+			position_vertices.reserve(corner_count);
+			for (size_t e = 0; e < corner_count; ++e)
+			{
+				auto const [it, added] = position_vertices.try_emplace(math::snap(corner_positions[e]), vertex::id::none);
+				if (added)
+					it->second = add_vertex(corner_positions[e], half_edge::id(e));
+				corner_vertices[e] = it->second;
+			}
+		}
+		else
+		{
+			// The corner at the tip of a half-edge is the same vertex as the corner its twin leaves from
+			std::vector<size_t> corner_roots(corner_count);
+			std::iota(corner_roots.begin(), corner_roots.end(), size_t(0));
+			auto const find_root = [&corner_roots](size_t corner)
+			{
+				while (corner_roots[corner] != corner)
+				{
+					corner_roots[corner] = corner_roots[corner_roots[corner]];
+					corner = corner_roots[corner];
+				}
+				return corner;
+			};
 
-					// Determine which edge is "ingoing" and which one is "outgoing"
-					auto const [ingoing, outgoing, outgoing_id] = [&]
-					{
-						mesh_definition::half_edge_data& he1 = half_edges[static_cast<size_t>(edge1.edge)];
-						mesh_definition::half_edge_data& he2 = half_edges[static_cast<size_t>(edge2.edge)];
-						if (dot_product(direction, edge2_plane.normal) < 0)
-							return std::make_tuple(&he2, &half_edges[static_cast<size_t>(he1.twin)], he1.twin);
-						else
-							return std::make_tuple(&he1, &half_edges[static_cast<size_t>(he2.twin)], he2.twin);
-					}();
-
-					ingoing->next = outgoing_id;
-					ingoing->face = shared_plane_id;
-					outgoing->face = shared_plane_id;
-
-					faces[static_cast<size_t>(shared_plane_id)].first_edge = outgoing_id;
+			for (size_t e = 0; e < corner_count; ++e)
+			{
+				size_t const a = find_root(static_cast<size_t>(get_half_edge_twin(half_edge::id(e))));
+				size_t const b = find_root(static_cast<size_t>(get_half_edge_next(half_edge::id(e))));
+				if (a != b)
+					corner_roots[std::max(a, b)] = std::min(a, b);
+			}
+
+			for (size_t e = 0; e < corner_count; ++e)
+			{
+				size_t const root = find_root(e);
+				if (corner_vertices[root] == vertex::id::none)
+				{
+					corner_vertices[root] = add_vertex(corner_positions[root], half_edge::id(e));
 				}
+				corner_vertices[e] = corner_vertices[root];
 			}
 		}
+
+		for (size_t e = 0; e < corner_count; ++e)
+		{
+			vertex::id const target = corner_vertices[static_cast<size_t>(get_half_edge_next(half_edge::id(e)))];
+			if (target != corner_vertices[static_cast<size_t>(get_half_edge_twin(half_edge::id(e)))])
+				throw std::invalid_argument("Input faces do not meet at the same vertices");
+			half_edge_vertices.set(e, target);
+		}
+
+		for (size_t i = 0; i < face_count; ++i)
+		{
+			face_first_vertices.set(i, corner_vertices[static_cast<size_t>(get_face_first_edge(face::id(i)))]);
+		}
+
+		for (size_t e = 0; e < corner_count; ++e)
+		{
+			face::id const face = get_half_edge_face(half_edge::id(e));
+			half_edge_uvs.set(e, get_face_uv_mapping(face).project(corner_positions[e], get_face_normal(face)));
+		}
 	}
 
-	void mesh_definition::update_bounds(math::aabb& bounds, std::span<mesh_definition::vertex_data const> vertices)
+	vertex::id mesh_definition::add_vertex(math::point3f position, half_edge::id first_edge)
 	{
-		for (mesh_definition::vertex_data const& vertex : vertices)
+		vertex::id const id{ vertex_positions.size() };
+		vertex_positions.push_back(position);
+		vertex_first_edges.push_back(first_edge);
+		return id;
+	}
+
+	half_edge::id mesh_definition::add_half_edge()
+	{
+		half_edge::id const id{ half_edge_nexts.size() };
+		half_edge_vertices.push_back(vertex::id::none);
+		half_edge_faces.push_back(face::id::none);
+		half_edge_twins.push_back(half_edge::id::none);
+		half_edge_nexts.push_back(half_edge::id::none);
+		half_edge_uvs.push_back({ 0.f, 0.f });
+		return id;
+	}
+
+	face::id mesh_definition::add_face(math::vector3f normal, uv_mapping const& mapping)
+	{
+		face::id const id{ face_normals.size() };
+		face_first_edges.push_back(half_edge::id::none);
+		face_first_vertices.push_back(vertex::id::none);
+		face_normals.push_back(normal);
+		face_uv_mappings.push_back(mapping);
+		return id;
+	}
+
+	void mesh_definition::set_face_first_edge(face::id face, half_edge::id first_edge)
+	{
+		attribute(face_first_edges, face) = first_edge;
+		// The source of a half-edge is the tip of its twin
+		attribute(face_first_vertices, face) = get_half_edge_vertex(get_half_edge_twin(first_edge));
+	}
+
+	void mesh_definition::mark_face_dirty(face::id face)
+	{
+		if (std::find(dirty_faces.begin(), dirty_faces.end(), face) == dirty_faces.end())
+			dirty_faces.push_back(face);
+	}
+
+	void mesh_definition::update_half_edge_uv(half_edge::id id)
+	{
+		face::id const face = get_half_edge_face(id);
+		math::point3f const source = get_vertex_position(get_half_edge_vertex(get_half_edge_twin(id)));
+		attribute(half_edge_uvs, id) = get_face_uv_mapping(face).project(source, get_face_normal(face));
+	}
+
+	void mesh_definition::update_face_uvs(face::id id)
+	{
+		half_edge::id const first = get_face_first_edge(id);
+		half_edge::id e = first;
+		do
+		{
+			update_half_edge_uv(e);
+			e = get_half_edge_next(e);
+		} while (e != first);
+	}
+
+	size_t mesh_definition::count_bytes(std::unordered_set<void const*>& counted_chunks) const
+	{
+		return vertex_positions.count_bytes(counted_chunks)
+			+ vertex_first_edges.count_bytes(counted_chunks)
+			+ half_edge_vertices.count_bytes(counted_chunks)
+			+ half_edge_faces.count_bytes(counted_chunks)
+			+ half_edge_twins.count_bytes(counted_chunks)
+			+ half_edge_nexts.count_bytes(counted_chunks)
+			+ half_edge_uvs.count_bytes(counted_chunks)
+			+ face_first_edges.count_bytes(counted_chunks)
+			+ face_first_vertices.count_bytes(counted_chunks)
+			+ face_normals.count_bytes(counted_chunks)
+			+ face_uv_mappings.count_bytes(counted_chunks)
+			+ dirty_faces.capacity() * sizeof(face::id);
+	}
+
+	void mesh_definition::update_bounds(math::aabb& bounds, persistent_vector<math::point3f> const& positions)
+	{
+		for (std::span<math::point3f const> const chunk : positions.get_chunks())
 		{
-			bounds.merge(vertex.position);
+			for (math::point3f const& position : chunk)
+				bounds.merge(position);
 		}
 	}
 
-	mesh_definition::mesh_definition(std::span<const math::plane> planes)
+	mesh_definition::mesh_definition(std::span<const math::plane> input_planes, vertex_precision precision)
 	{
-		if (planes.empty())
+		if (input_planes.empty())
 			return;
 
-		faces.resize(planes.size());
-		for (size_t i = 0; i < planes.size(); ++i)
-			faces[i].normal = planes[i].normal;
+		std::vector<math::fixed_plane> fixed_planes;
+		std::vector<math::plane> planes;
+		planes.reserve(input_planes.size());
+		if (precision == vertex_precision::snapped)
+		{
+			fixed_planes.reserve(input_planes.size());
+			for (math::plane const& p : input_planes)
+			{
+				fixed_planes.push_back(math::snap(p));
+				planes.push_back(to_plane(fixed_planes.back()));
+			}
+		}
+		else
+		{
+			planes.assign(input_planes.begin(), input_planes.end());
+		}
 
-		std::vector<point_intersection> const intersections = find_intersections(planes, vertices, half_edges);
-		if (intersections.empty())
+		remove_coplanar_planes(planes, fixed_planes);
+		if (planes.size() < 4)
 			throw std::invalid_argument("Input faces had no intersections");
 
-		resolve_edge_directions(planes, intersections, half_edges, faces);
-		update_bounds(bounds, vertices);
+		for (math::plane const& p : planes)
+			add_face(p.normal);
+
+		std::vector<face_polygon> const polygons = clip_face_polygons(planes, fixed_planes);
+		link_face_polygons(polygons, precision);
+		update_bounds(bounds, vertex_positions);
 	}
 
 	mesh_definition const& mesh_definition::get_cube()
@@ -0,0 +1,138 @@
+#include "egfx/mesh_definition_cache.h"
+
+#include "egfx/mesh_definition.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <tuple>
+
+namespace ot::egfx
+{
+	namespace
+	{
+		// Entries are only pruned once the cache has doubled since the last pruning, which keeps the cost of pruning constant per insertion
+		constexpr size_t min_prune_size = 256;
+
+		std::vector<math::plane> make_key(std::span<math::plane const> planes)
+		{
+			std::vector<math::plane> key(planes.begin(), planes.end());
+			for (math::plane& p : key)
+			{
+				// Adding zero turns negative zeroes into positive ones, which compare equal but do not hash the same
+				p.normal.x += 0.f;
+				p.normal.y += 0.f;
+				p.normal.z += 0.f;
+				p.distance += 0.f;
+			}
+
+			std::sort(key.begin(), key.end(), [](math::plane const& lhs, math::plane const& rhs)
+			{
+				return std::tie(lhs.normal.x, lhs.normal.y, lhs.normal.z, lhs.distance) < std::tie(rhs.normal.x, rhs.normal.y, rhs.normal.z, rhs.distance);
+			});
+
+			return key;
+		}
+	}
+
+	size_t mesh_definition_cache::key_hash::operator()(std::vector<math::plane> const& planes) const noexcept
+	{
+		// FNV-1a over the bits of every component
+		uint64_t h = 0xcbf29ce484222325ull;
+		auto const mix = [&h](float f)
+		{
+			h ^= std::bit_cast<uint32_t>(f);
+			h *= 0x100000001b3ull;
+		};
+
+		for (math::plane const& p : planes)
+		{
+			mix(p.normal.x);
+			mix(p.normal.y);
+			mix(p.normal.z);
+			mix(p.distance);
+		}
+
+		return static_cast<size_t>(h ^ (h >> 32));
+	}
+
+	bool mesh_definition_cache::key_equal::operator()(std::vector<math::plane> const& lhs, std::vector<math::plane> const& rhs) const noexcept
+	{
+		return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](math::plane const& l, math::plane const& r)
+		{
+			return l.normal.x == r.normal.x && l.normal.y == r.normal.y && l.normal.z == r.normal.z && l.distance == r.distance;
+		});
+	}
+
+	mesh_definition_cache::mesh_definition_cache()
+		: next_prune_size(min_prune_size)
+	{
+
+	}
+
+	std::shared_ptr<mesh_definition const> mesh_definition_cache::get(std::span<math::plane const> planes)
+	{
+		std::vector<math::plane> key = make_key(planes);
+
+		{
+			std::lock_guard const lock(mutex);
+			auto const found = entries.find(key);
+			if (found != entries.end())
+			{
+				if (std::shared_ptr<mesh_definition const> existing = found->second.lock())
+				{
+					++hits;
+					return existing;
+				}
+			}
+		}
+
+		// Built outside of the lock, as it is the expensive part and other threads may be building other meshes meanwhile
+		// Built from the sorted key, so the order of the faces does not depend on which call built the definition first
+		auto built = std::make_shared<mesh_definition const>(key);
+		++misses;
+
+		std::lock_guard const lock(mutex);
+		std::weak_ptr<mesh_definition const>& entry = entries[std::move(key)];
+		if (std::shared_ptr<mesh_definition const> existing = entry.lock())
+		{
+			// Another thread built the same mesh first, share its definition
+			return existing;
+		}
+
+		entry = built;
+		if (entries.size() >= next_prune_size)
+			prune_expired();
+
+		return built;
+	}
+
+	void mesh_definition_cache::prune_expired()
+	{
+		std::erase_if(entries, [](auto const& entry)
+		{
+			return entry.second.expired();
+		});
+
+		next_prune_size = std::max(min_prune_size, entries.size() * 2);
+	}
+
+	mesh_definition_cache::statistics mesh_definition_cache::get_statistics() const
+	{
+		std::lock_guard const lock(mutex);
+		return { hits, misses, entries.size() };
+	}
+
+	void mesh_definition_cache::reset_statistics() noexcept
+	{
+		hits = 0;
+		misses = 0;
+	}
+
+	void mesh_definition_cache::clear()
+	{
+		std::lock_guard const lock(mutex);
+		entries.clear();
+		next_prune_size = min_prune_size;
+	}
+}
@@ -105,11 +105,27 @@ namespace ot::egfx
 			return get_scene_node(static_cast<derived const&>(*this)).numAttachedObjects();
 		}
 
+		template<typename Derived>
+		bool node_const_impl<Derived>::is_static() const noexcept
+		{
+			return get_scene_node(static_cast<derived const&>(*this)).isStatic();
+		}
+
 		template class node_const_impl<node_cref>;
 		template class node_const_impl<node_ref>;
 		template class node_const_impl<node>;
 	}
 
+	namespace
+	{
+		// Static nodes keep their derived transform until the scene manager is told that they changed
+		void notify_if_static(Ogre::SceneNode& scene_node) noexcept
+		{
+			if (scene_node.isStatic())
+				scene_node.getCreator()->notifyStaticDirty(&scene_node);
+		}
+	}
+
 	node_cref make_node_cref(Ogre::SceneNode const& node) noexcept
 	{
 		return detail::make_node_cref(&node);
@@ -407,41 +423,66 @@ namespace ot::egfx
 
 	void node_ref::set_position(math::point3f p) const noexcept
 	{
-		get_scene_node(*this).setPosition(to_ogre_vector(p));
+		Ogre::SceneNode& scene_node = get_scene_node(*this);
+		scene_node.setPosition(to_ogre_vector(p));
+		notify_if_static(scene_node);
 	}
 	
 	void node_ref::set_rotation(math::quaternion rot) const noexcept
 	{
-		get_scene_node(*this).setOrientation(to_ogre_quaternion(rot));
+		Ogre::SceneNode& scene_node = get_scene_node(*this);
+		scene_node.setOrientation(to_ogre_quaternion(rot));
+		notify_if_static(scene_node);
 	}
 	
 	void node_ref::set_direction(math::vector3f direction) const noexcept
 	{
-		get_scene_node(*this).setDirection(to_ogre_vector(direction));
+		Ogre::SceneNode& scene_node = get_scene_node(*this);
+		scene_node.setDirection(to_ogre_vector(direction));
+		notify_if_static(scene_node);
 	}
 
 	void node_ref::rotate_around(math::vector3f axis, float rad) const noexcept
 	{
-		get_scene_node(*this).rotate(
+		Ogre::SceneNode& scene_node = get_scene_node(*this);
+		scene_node.rotate(
 			Ogre::Vector3(static_cast<Ogre::Real>(axis.x), static_cast<Ogre::Real>(axis.y), static_cast<Ogre::Real>(axis.z)),
 			Ogre::Radian(static_cast<Ogre::Real>(rad))
 		);
+		notify_if_static(scene_node);
 	}
 		
 	void node_ref::set_scale(float s) const noexcept
 	{
-		get_scene_node(*this).setScale(s, s, s);
+		Ogre::SceneNode& scene_node = get_scene_node(*this);
+		scene_node.setScale(s, s, s);
+		notify_if_static(scene_node);
 	}
 	
 	void node_ref::set_scale(math::scales s) const noexcept
 	{
-		get_scene_node(*this).setScale(s.x, s.y, s.z);
+		Ogre::SceneNode& scene_node = get_scene_node(*this);
+		scene_node.setScale(s.x, s.y, s.z);
+		notify_if_static(scene_node);
 	}	
 
 	void node_ref::attach_child(node_ref child) const noexcept
 	{
 		get_scene_node(*this).addChild(&get_scene_node(child));
 	}
+
+	void node_ref::set_static(bool is_static) const
+	{
+		// Also changes the objects attached to the node
+		Ogre::SceneNode& scene_node = get_scene_node(*this);
+		if (scene_node.setStatic(is_static) && is_static)
+			scene_node.getCreator()->notifyStaticDirty(&scene_node);
+	}
+
+	void node_ref::set_visible(bool visible) const
+	{
+		get_scene_node(*this).setVisible(visible, /*cascade*/ false);
+	}
 	
 	node::node() noexcept
 		: pimpl(nullptr)
@@ -541,6 +582,16 @@ namespace ot::egfx
 		static_cast<node_ref>(*this).attach_child(child);
 	}
 
+	void node::set_static(bool is_static)
+	{
+		static_cast<node_ref>(*this).set_static(is_static);
+	}
+
+	void node::set_visible(bool visible)
+	{
+		static_cast<node_ref>(*this).set_visible(visible);
+	}
+
 	std::optional<node_cref> node::get_parent() const noexcept
 	{
 		return static_cast<node_cref>(*this).get_parent();
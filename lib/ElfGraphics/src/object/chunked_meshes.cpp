@@ -0,0 +1,296 @@
+#include "egfx/object/chunked_meshes.h"
+
+#include "mesh.h"
+#include "scene.h"
+#include "material.h"
+
+#include "core/fwd_delete.h"
+
+#include "Ogre/SceneManager.h"
+#include "Ogre/SceneNode.h"
+#include "Ogre/Item.h"
+
+#include <chrono>
+#include <format>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ot::egfx
+{
+	class chunked_meshes_impl
+	{
+		struct chunk_render
+		{
+			mesh merged;
+			Ogre::SceneNode* node = nullptr;
+			Ogre::Item* item = nullptr;
+			size_t submesh_count = 0;
+			bool visible = true;
+		};
+
+		Ogre::SceneManager* scene_manager;
+		chunk_grid grid;
+		std::unordered_map<uint64_t, material_handle_t> materials; // by the key given to the grid
+		std::unordered_map<chunk_coord, chunk_render, chunk_coord_hash> renders;
+		chunk_build_queue pending_chunks; // dirty chunks taken from the grid and not built yet
+		std::unordered_set<chunk_coord, chunk_coord_hash> visible_cells; // kept between calls for its memory
+		size_t next_mesh_number = 0;
+		size_t draw_count = 0; // submeshes of every built chunk
+
+		[[nodiscard]] uint64_t get_material_key(material_handle_t const& material)
+		{
+			uint64_t const key = to_id_string(material).mHash;
+			materials.try_emplace(key, material);
+			return key;
+		}
+
+		void destroy_item(chunk_render& r) noexcept
+		{
+			r.node->detachObject(r.item);
+			scene_manager->destroyItem(r.item);
+			r.item = nullptr;
+		}
+
+		void destroy(chunk_render& r) noexcept
+		{
+			destroy_item(r);
+			scene_manager->destroySceneNode(r.node);
+			r.node = nullptr;
+		}
+
+		void build(chunk_coord const& cell)
+		{
+			// Chunks rarely change once built, their vertices are welded
+			std::vector<submesh_definition> submeshes;
+			for (chunk_submesh& submesh : grid.make_submeshes(cell))
+				submeshes.push_back({ std::move(submesh.parts), materials.at(submesh.material), true });
+
+			// Items cannot change their mesh, the item is replaced
+			auto const found = renders.find(cell);
+			if (found != renders.end())
+			{
+				chunk_render& r = found->second;
+				destroy_item(r);
+				r.merged.reload_mesh(submeshes);
+				draw_count = draw_count - r.submesh_count + submeshes.size();
+				r.submesh_count = submeshes.size();
+				r.item = scene_manager->createItem(get_mesh_ptr(r.merged), Ogre::SCENE_STATIC);
+				r.item->setVisible(r.visible);
+				r.node->attachObject(r.item);
+				scene_manager->notifyStaticDirty(r.node);
+				return;
+			}
+
+			// Vertices are in world space, static nodes must have static parents
+			chunk_render r;
+			r.merged = create_mesh(std::format("Chunk mesh {}", next_mesh_number++), submeshes);
+			r.submesh_count = submeshes.size();
+			draw_count += r.submesh_count;
+			r.node = scene_manager->getRootSceneNode(Ogre::SCENE_STATIC)->createChildSceneNode(Ogre::SCENE_STATIC);
+			r.item = scene_manager->createItem(get_mesh_ptr(r.merged), Ogre::SCENE_STATIC);
+			r.node->attachObject(r.item);
+			renders.emplace(cell, std::move(r));
+		}
+
+	public:
+		chunked_meshes_impl(Ogre::SceneManager& scene_manager, float chunk_size)
+			: scene_manager(&scene_manager)
+			, grid(chunk_size)
+		{
+
+		}
+
+		~chunked_meshes_impl()
+		{
+			for (auto& [cell, r] : renders)
+				destroy(r);
+		}
+
+		chunk_part_id add(std::shared_ptr<mesh_definition const> mesh, math::transform_matrix const& transform, material_handle_t const& material)
+		{
+			return grid.add({ std::move(mesh), transform, get_material_key(material) });
+		}
+
+		void remove(chunk_part_id id)
+		{
+			grid.remove(id);
+		}
+
+		void set(chunk_part_id id, std::shared_ptr<mesh_definition const> mesh, math::transform_matrix const& transform, material_handle_t const& material)
+		{
+			grid.set(id, { std::move(mesh), transform, get_material_key(material) });
+		}
+
+		void clear()
+		{
+			grid.clear();
+		}
+
+		void build_pending(chunk_coord const& cell)
+		{
+			if (grid.find_chunk(cell) != nullptr)
+			{
+				build(cell);
+				return;
+			}
+
+			// Emptied chunk
+			auto const found = renders.find(cell);
+			if (found != renders.end())
+			{
+				draw_count -= found->second.submesh_count;
+				destroy(found->second);
+				renders.erase(found);
+			}
+		}
+
+		void update()
+		{
+			pending_chunks.take_dirty_chunks(grid);
+			while (std::optional<chunk_coord> const cell = pending_chunks.pop())
+				build_pending(*cell);
+		}
+
+		bool update(math::milliseconds budget)
+		{
+			using clock = std::chrono::steady_clock;
+			auto const start = clock::now();
+
+			// Chunks which lost parts are built whatever the budget, the removed parts would be drawn until then
+			pending_chunks.take_dirty_chunks(grid);
+			bool first = true;
+			while (!pending_chunks.empty())
+			{
+				if (!first && !pending_chunks.is_next_urgent() && clock::now() - start >= budget)
+					break;
+
+				build_pending(*pending_chunks.pop());
+				first = false;
+			}
+			return pending_chunks.empty();
+		}
+
+		[[nodiscard]] bool is_pending(chunk_coord const& cell) const noexcept
+		{
+			return pending_chunks.contains(cell) || grid.is_chunk_dirty(cell);
+		}
+
+		[[nodiscard]] size_t get_pending_count() const noexcept
+		{
+			size_t count = pending_chunks.size();
+			for (chunk_coord const& cell : grid.get_dirty_chunks())
+			{
+				if (!pending_chunks.contains(cell))
+					++count;
+			}
+			return count;
+		}
+
+		size_t set_visible_chunks(std::span<chunk_coord const> visible)
+		{
+			visible_cells.clear();
+			visible_cells.insert(visible.begin(), visible.end());
+
+			size_t hidden_count = 0;
+			for (auto& [cell, r] : renders)
+			{
+				bool const is_visible = visible_cells.contains(cell);
+				if (is_visible != r.visible)
+				{
+					r.visible = is_visible;
+					r.item->setVisible(is_visible);
+				}
+				if (!is_visible)
+					++hidden_count;
+			}
+			return hidden_count;
+		}
+
+		void show_all_chunks()
+		{
+			for (auto& [cell, r] : renders)
+			{
+				if (!r.visible)
+				{
+					r.visible = true;
+					r.item->setVisible(true);
+				}
+			}
+		}
+
+		[[nodiscard]] chunk_grid const& get_grid() const noexcept { return grid; }
+		[[nodiscard]] size_t get_draw_count() const noexcept { return draw_count; }
+	};
+
+	chunked_meshes::chunked_meshes(scene& s, float chunk_size)
+		: pimpl(new chunked_meshes_impl(get_impl(s).get_scene_manager(), chunk_size))
+	{
+
+	}
+
+	chunked_meshes::chunked_meshes(chunked_meshes&&) noexcept = default;
+	chunked_meshes& chunked_meshes::operator=(chunked_meshes&&) noexcept = default;
+	chunked_meshes::~chunked_meshes() = default;
+
+	chunk_part_id chunked_meshes::add(std::shared_ptr<mesh_definition const> mesh, math::transform_matrix const& transform, material_handle_t const& material)
+	{
+		return pimpl->add(std::move(mesh), transform, material);
+	}
+
+	void chunked_meshes::remove(chunk_part_id id)
+	{
+		pimpl->remove(id);
+	}
+
+	void chunked_meshes::set(chunk_part_id id, std::shared_ptr<mesh_definition const> mesh, math::transform_matrix const& transform, material_handle_t const& material)
+	{
+		pimpl->set(id, std::move(mesh), transform, material);
+	}
+
+	void chunked_meshes::clear()
+	{
+		pimpl->clear();
+	}
+
+	void chunked_meshes::update()
+	{
+		pimpl->update();
+	}
+
+	bool chunked_meshes::update(math::milliseconds budget)
+	{
+		return pimpl->update(budget);
+	}
+
+	bool chunked_meshes::is_pending(chunk_coord const& cell) const noexcept
+	{
+		return pimpl->is_pending(cell);
+	}
+
+	size_t chunked_meshes::get_pending_count() const noexcept
+	{
+		return pimpl->get_pending_count();
+	}
+
+	size_t chunked_meshes::set_visible_chunks(std::span<chunk_coord const> visible)
+	{
+		return pimpl->set_visible_chunks(visible);
+	}
+
+	void chunked_meshes::show_all_chunks()
+	{
+		pimpl->show_all_chunks();
+	}
+
+	chunk_grid const& chunked_meshes::get_grid() const noexcept
+	{
+		return pimpl->get_grid();
+	}
+
+	size_t chunked_meshes::get_draw_count() const noexcept
+	{
+		return pimpl->get_draw_count();
+	}
+}
+
+template struct ot::fwd_delete<ot::egfx::chunked_meshes_impl>;
@@ -4,6 +4,7 @@
 #include "ogre_conversion.h"
 #include "node.h"
 #include "egfx/mesh_definition.h"
+#include "egfx/mesh_buffer.h"
 #include "material.h"
 
 #include "Ogre/Root.h"
@@ -12,6 +13,10 @@
 #include "Ogre/MeshManager2.h"
 #include "Ogre/SubMesh2.h"
 #include "Ogre/Item.h"
+#include "Ogre/SceneManager.h"
+#include "Ogre/HlmsManager.h"
+
+#include <algorithm>
 
 namespace ot::egfx
 {
@@ -87,6 +92,7 @@ namespace ot::egfx
 	}
 
 	mesh::mesh(mesh&& other) noexcept
+		: face_map(std::move(other.face_map))
 	{
 		Ogre::MeshPtr& other_ptr = get_mesh_ptr(other);
 		new(storage_mesh) Ogre::MeshPtr(other_ptr);
@@ -102,6 +108,7 @@ namespace ot::egfx
 			Ogre::MeshPtr& other_ptr = get_mesh_ptr(other);
 			get_mesh_ptr(*this) = other_ptr;
 			other_ptr = nullptr;
+			face_map = std::move(other.face_map);
 		}
 		return *this;
 	}
@@ -129,31 +136,27 @@ namespace ot::egfx
 
 	namespace
 	{
-		struct render_vertex
+		[[nodiscard]] Ogre::VertexElement2Vec get_vertex_buffer_elements()
 		{
-			math::point3f position;
-			math::vector3f normal;
-			math::point2f uv;
-
-			[[nodiscard]] static Ogre::VertexElement2Vec get_vertex_buffer_elements()
-			{
-				return {
-					Ogre::VertexElement2(Ogre::VET_FLOAT3, Ogre::VES_POSITION)
-					, Ogre::VertexElement2(Ogre::VET_FLOAT3, Ogre::VES_NORMAL)
-					, Ogre::VertexElement2(Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES)
-				};
-			}
-		};
+			static_assert(sizeof(render_vertex) == sizeof(float) * 8, "render_vertex must match the vertex buffer elements");
+			return {
+				Ogre::VertexElement2(Ogre::VET_FLOAT3, Ogre::VES_POSITION)
+				, Ogre::VertexElement2(Ogre::VET_FLOAT3, Ogre::VES_NORMAL)
+				, Ogre::VertexElement2(Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES)
+			};
+		}
 
-		// Creates a static vertex buffer 
-		[[nodiscard]] Ogre::VertexBufferPacked* create_static_vertex_buffer(Ogre::VertexElement2Vec const& buffer_elements, size_t num_vertices, ogre::unique_geometry_mem initial_data)
+		// Creates a vertex buffer. Immutable buffers take ownership of the data, while the others copy it and allow partial uploads
+		[[nodiscard]] Ogre::VertexBufferPacked* create_vertex_buffer(Ogre::VertexElement2Vec const& buffer_elements, size_t num_vertices, Ogre::BufferType buffer_type, ogre::unique_geometry_mem initial_data)
 		{
 			auto& root = Ogre::Root::getSingleton();
 			auto const render_system = root.getRenderSystem();
 			auto const vao_manager = render_system->getVaoManager();
 
-			auto const vertex_buffer = vao_manager->createVertexBuffer(buffer_elements, num_vertices, Ogre::BT_IMMUTABLE, initial_data.get(), true /* take ownership */);
-			initial_data.release();
+			bool const take_ownership = buffer_type == Ogre::BT_IMMUTABLE;
+			auto const vertex_buffer = vao_manager->createVertexBuffer(buffer_elements, num_vertices, buffer_type, initial_data.get(), take_ownership);
+			if (take_ownership)
+				initial_data.release();
 			return vertex_buffer;
 		}
 
@@ -163,106 +166,141 @@ namespace ot::egfx
 			size_t size; // in element count
 		};
 
-		[[nodiscard]] Ogre::VertexBufferPackedVec make_render_vertex_buffers(geometry_data data)
+		[[nodiscard]] Ogre::VertexBufferPackedVec make_render_vertex_buffers(geometry_data data, Ogre::BufferType buffer_type)
 		{
-			Ogre::VertexBufferPacked* const vertex_buffer = create_static_vertex_buffer(render_vertex::get_vertex_buffer_elements(), data.size, std::move(data).buffer);
+			Ogre::VertexBufferPacked* const vertex_buffer = create_vertex_buffer(get_vertex_buffer_elements(), data.size, buffer_type, std::move(data).buffer);
 			return { vertex_buffer };
 		}
 
-		[[nodiscard]] Ogre::IndexBufferPacked* make_index_buffer(geometry_data data)
+		[[nodiscard]] Ogre::IndexBufferPacked::IndexType to_ogre_index_type(index_format format)
 		{
-			auto& root = Ogre::Root::getSingleton();
-			auto const render_system = root.getRenderSystem();
-			auto const vao_manager = render_system->getVaoManager();
+			switch (format)
+			{
+			case index_format::uint16: return Ogre::IndexBufferPacked::IT_16BIT;
+			case index_format::uint32: return Ogre::IndexBufferPacked::IT_32BIT;
+			}
 
-			auto const index_buffer = vao_manager->createIndexBuffer(Ogre::IndexBufferPacked::IT_16BIT, data.size, Ogre::BT_IMMUTABLE, data.buffer.get(), true /* take ownership */);
-			data.buffer.release();
-			return index_buffer;
+			throw std::invalid_argument("Invalid index format");
 		}
 
-		[[nodiscard]] std::pair<size_t, size_t> get_triangle_vertex_index_count(mesh_definition const& mesh)
+		[[nodiscard]] Ogre::IndexBufferPacked* make_index_buffer(geometry_data data, index_format format, Ogre::BufferType buffer_type)
 		{
-			size_t vertex_count = 0;
-			size_t index_count = 0;
-			for (auto const& face : mesh.get_faces())
-			{
-				auto const face_vertex_count = face.get_vertex_count();
-				assert(face_vertex_count >= 3); // I've had issues at some point, better make sure
-				auto const triangle_count = face_vertex_count - 2;
+			auto& root = Ogre::Root::getSingleton();
+			auto const render_system = root.getRenderSystem();
+			auto const vao_manager = render_system->getVaoManager();
 
-				vertex_count += face_vertex_count;
-				index_count += triangle_count * 3;
-			}
-			return { vertex_count, index_count };
+			bool const take_ownership = buffer_type == Ogre::BT_IMMUTABLE;
+			auto const index_buffer = vao_manager->createIndexBuffer(to_ogre_index_type(format), data.size, buffer_type, data.buffer.get(), take_ownership);
+			if (take_ownership)
+				data.buffer.release();
+			return index_buffer;
 		}
 
 		struct vertex_array_data
 		{
 			geometry_data vertex_data;
 			geometry_data index_data;
+			index_format format;
 		};
 
-		// Builds a fan-shaped triangle list
-		// Triangle fans are not support on Direct3D 11, and we need something that works for the whole mesh anyway
-		[[nodiscard]] auto make_triangle_data(mesh_definition const& mesh) -> vertex_array_data
+		[[nodiscard]] auto make_triangle_data(triangle_list const& list) -> vertex_array_data
 		{
-			auto const [vertex_count, index_count] = get_triangle_vertex_index_count(mesh);
+			submesh_buffer_layout const layout = get_submesh_buffer_layout(list);
 
-			ogre::unique_geometry_mem vertex_mem = ogre::allocate_geometry(sizeof(render_vertex) * vertex_count);
-			ogre::unique_geometry_mem index_mem = ogre::allocate_geometry(index_count * sizeof(Ogre::uint16));
-			auto const vertex_mem_begin = reinterpret_cast<render_vertex*>(vertex_mem.get());
-			auto vertex_it = vertex_mem_begin;
-			auto index_it = reinterpret_cast<Ogre::uint16*>(index_mem.get());
-			
-			for (auto const& face : mesh.get_faces())
+			ogre::unique_geometry_mem vertex_mem = ogre::allocate_geometry(layout.get_vertex_buffer_size());
+			ogre::unique_geometry_mem index_mem = ogre::allocate_geometry(layout.get_index_buffer_size());
+
+			write_submesh_buffers(list, layout
+				, std::span<render_vertex>(static_cast<render_vertex*>(vertex_mem.get()), layout.vertex_count)
+				, std::span<std::byte>(static_cast<std::byte*>(index_mem.get()), layout.get_index_buffer_size())
+			);
+
+			return
 			{
-				auto const vertices = face.get_vertices();
-				auto const face_vertex_count = face.get_vertex_count();
-				auto const normal = face.get_normal();
-
-				auto const base_index = static_cast<Ogre::uint16>(std::distance(vertex_mem_begin, vertex_it));
-
-				// push vertices
-				for (auto const vertex : vertices)
-				{
-					new(vertex_it++) render_vertex{ vertex.get_position(), normal, vertex.get_uv() };
-				}
-
-				// push indices
-				auto const index1 = base_index;
-				auto index2 = base_index + 1;
-				
-				do
-				{
-					auto index3 = index2 + 1;
-					new(index_it++) auto(static_cast<Ogre::uint16>(index1));
-					new(index_it++) auto(static_cast<Ogre::uint16>(index2));
-					new(index_it++) auto(static_cast<Ogre::uint16>(index3));
-					index2 = index3;
-				} while (index2 - index1 + 1 != face_vertex_count);
-			}
+				{ std::move(vertex_mem), layout.vertex_count }
+				, { std::move(index_mem), layout.index_count }
+				, layout.format
+			};
+		}
+
+		[[nodiscard]] auto make_triangle_data(submesh_definition const& submesh) -> vertex_array_data
+		{
+			if (submesh.weld_vertices)
+				return make_triangle_data(make_welded_triangle_list(submesh.parts));
+
+			submesh_buffer_layout const layout = get_submesh_buffer_layout(submesh.parts);
+
+			ogre::unique_geometry_mem vertex_mem = ogre::allocate_geometry(layout.get_vertex_buffer_size());
+			ogre::unique_geometry_mem index_mem = ogre::allocate_geometry(layout.get_index_buffer_size());
+
+			std::span<render_vertex> const vertices(static_cast<render_vertex*>(vertex_mem.get()), layout.vertex_count);
+			std::span<std::byte> const indices(static_cast<std::byte*>(index_mem.get()), layout.get_index_buffer_size());
+			write_submesh_buffers(submesh.parts, layout, vertices, indices);
 
 			return
 			{
-				{ std::move(vertex_mem), vertex_count }
-				, { std::move(index_mem), index_count }
+				{ std::move(vertex_mem), layout.vertex_count }
+				, { std::move(index_mem), layout.index_count }
+				, layout.format
 			};
 		}
 
-		[[nodiscard]] Ogre::VertexArrayObject* make_render_vao(mesh_definition const& mesh)
+		// Lays out the faces with spare room, so that they can be updated in place
+		[[nodiscard]] auto make_triangle_data(mesh_definition const& mesh_def, face_buffer_map const& face_map) -> vertex_array_data
+		{
+			submesh_buffer_layout const& layout = face_map.get_layout();
+
+			ogre::unique_geometry_mem vertex_mem = ogre::allocate_geometry(layout.get_vertex_buffer_size());
+			ogre::unique_geometry_mem index_mem = ogre::allocate_geometry(layout.get_index_buffer_size());
+
+			write_submesh_buffers(mesh_def, face_map
+				, std::span<render_vertex>(static_cast<render_vertex*>(vertex_mem.get()), layout.vertex_count)
+				, std::span<std::byte>(static_cast<std::byte*>(index_mem.get()), layout.get_index_buffer_size())
+			);
+
+			return
+			{
+				{ std::move(vertex_mem), layout.vertex_count }
+				, { std::move(index_mem), layout.index_count }
+				, layout.format
+			};
+		}
+
+		[[nodiscard]] Ogre::VertexArrayObject* make_render_vao(vertex_array_data data, Ogre::BufferType buffer_type)
 		{
 			auto& root = Ogre::Root::getSingleton();
 			auto const render_system = root.getRenderSystem();
 			auto const vao_manager = render_system->getVaoManager();
 
-			auto [vertex_data, index_data] = make_triangle_data(mesh);
+			auto [vertex_data, index_data, format] = std::move(data);
 			
-			auto const vertex_buffers = make_render_vertex_buffers(std::move(vertex_data));
-			auto const index_buffer = make_index_buffer(std::move(index_data));
+			auto const vertex_buffers = make_render_vertex_buffers(std::move(vertex_data), buffer_type);
+			auto const index_buffer = make_index_buffer(std::move(index_data), format, buffer_type);
 
 			return vao_manager->createVertexArrayObject(vertex_buffers, index_buffer, Ogre::OT_TRIANGLE_LIST);
 		}
 
+		void set_submesh_material(Ogre::SubMesh& render_submesh, material_handle_t const& mat)
+		{
+			if (mat.is_null())
+				return;
+
+			auto& root = Ogre::Root::getSingleton();
+			Ogre::HlmsManager* const hlms_manager = root.getHlmsManager();
+
+			Ogre::HlmsDatablock const* const datablock = hlms_manager->getDatablockNoDefault(to_id_string(mat));
+			if (datablock == nullptr)
+			{
+				throw std::invalid_argument(std::format("Invalid material '{}'", mat.to_debug_string()));
+			}
+
+			std::string const* const name = datablock->getNameStr();
+			if (name != nullptr)
+			{
+				render_submesh.setMaterialName(*name);
+			}
+		}
+
 		void set_mesh_bounds(Ogre::Mesh& render_mesh, math::aabb const& mesh_bounds)
 		{
 			math::point3f const bounds_center = mesh_bounds.position;
@@ -271,14 +309,45 @@ namespace ot::egfx
 			render_mesh._setBoundingSphereRadius(bounds_half_size.norm());
 		}
 
+		[[nodiscard]] Ogre::MeshPtr make_mesh(std::string const& name, std::span<submesh_definition const> submeshes)
+		{
+			if (submeshes.empty() || std::any_of(submeshes.begin(), submeshes.end(), [](submesh_definition const& s) { return s.parts.empty(); }))
+				throw std::invalid_argument(std::format("Mesh '{}' has a submesh without geometry", name));
+
+			auto& mesh_manager = Ogre::MeshManager::getSingleton();
+
+			Ogre::MeshPtr render_mesh = mesh_manager.createManual(name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+
+			for (submesh_definition const& submesh : submeshes)
+			{
+				Ogre::SubMesh* render_submesh = render_mesh->createSubMesh();
+				auto const vao = make_render_vao(make_triangle_data(submesh), Ogre::BT_IMMUTABLE);
+				render_submesh->mVao[Ogre::VpNormal].push_back(vao);
+				render_submesh->mVao[Ogre::VpShadow].push_back(vao);
+				set_submesh_material(*render_submesh, submesh.material);
+			}
+
+			set_mesh_bounds(*render_mesh, get_submesh_bounds(submeshes));
+
+			return render_mesh;
+		}
+
+		// Single submesh in tight immutable buffers
 		[[nodiscard]] Ogre::MeshPtr make_mesh(std::string const& name, mesh_definition const& mesh_def)
+		{
+			submesh_definition const submesh{ { &mesh_def } };
+			return make_mesh(name, std::span(&submesh, 1));
+		}
+
+		// Single submesh, in buffers which can be partially updated when faces of the definition change
+		[[nodiscard]] Ogre::MeshPtr make_patchable_mesh(std::string const& name, mesh_definition const& mesh_def, face_buffer_map const& face_map)
 		{
 			auto& mesh_manager = Ogre::MeshManager::getSingleton();
 
 			Ogre::MeshPtr render_mesh = mesh_manager.createManual(name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
 
 			Ogre::SubMesh* render_submesh = render_mesh->createSubMesh();
-			auto const vao = make_render_vao(mesh_def);
+			auto const vao = make_render_vao(make_triangle_data(mesh_def, face_map), Ogre::BT_DEFAULT);
 			render_submesh->mVao[Ogre::VpNormal].push_back(vao);
 			render_submesh->mVao[Ogre::VpShadow].push_back(vao);
 
@@ -296,7 +365,75 @@ namespace ot::egfx
 
 		destroy_mesh();
 
-		ptr = make_mesh(name, mesh_def);
+		// Meshes which were edited keep the patchable layout
+		if (face_map.get_face_count() == 0)
+		{
+			ptr = make_mesh(name, mesh_def);
+		}
+		else
+		{
+			face_map = face_buffer_map(mesh_def);
+			ptr = make_patchable_mesh(name, mesh_def, face_map);
+		}
+	}
+
+	void mesh::reload_patchable_mesh(mesh_definition const& mesh_def)
+	{
+		Ogre::MeshPtr& ptr = get_mesh_ptr(*this);
+
+		auto const name = ptr->getName(); // copy
+
+		destroy_mesh();
+
+		face_map = face_buffer_map(mesh_def);
+		ptr = make_patchable_mesh(name, mesh_def, face_map);
+	}
+
+	void mesh::update_mesh(mesh_definition const& mesh_def)
+	{
+		std::span<face::id const> const dirty_faces = mesh_def.get_dirty_faces();
+		if (dirty_faces.empty())
+			return;
+
+		// The first edit moves the mesh out of its tight immutable buffers
+		if (face_map.get_face_count() == 0 || !face_map.update(mesh_def, dirty_faces))
+		{
+			reload_patchable_mesh(mesh_def);
+			return;
+		}
+
+		Ogre::MeshPtr const& ptr = get_mesh_ptr(*this);
+		Ogre::VertexArrayObject* const vao = ptr->getSubMesh(0)->mVao[Ogre::VpNormal][0];
+		Ogre::VertexBufferPacked* const vertex_buffer = vao->getVertexBuffers()[0];
+		Ogre::IndexBufferPacked* const index_buffer = vao->getIndexBuffer();
+
+		submesh_buffer_layout const& layout = face_map.get_layout();
+		std::vector<render_vertex> face_vertices;
+		std::vector<std::byte> face_indices;
+		for (face::id const f : dirty_faces)
+		{
+			face_buffer_range const& range = face_map.get_range(f);
+			face_vertices.resize(range.vertex_capacity);
+			face_indices.resize(range.index_capacity * layout.get_index_size());
+			write_face_buffers(mesh_def.get_face(f), range, layout.format, face_vertices, face_indices);
+
+			vertex_buffer->upload(face_vertices.data(), range.vertex_start, range.vertex_capacity);
+			index_buffer->upload(face_indices.data(), range.index_start, range.index_capacity);
+		}
+
+		set_mesh_bounds(*ptr, mesh_def.get_bounds());
+	}
+
+	void mesh::reload_mesh(std::span<submesh_definition const> submeshes)
+	{
+		Ogre::MeshPtr& ptr = get_mesh_ptr(*this);
+
+		auto const name = ptr->getName(); // copy
+
+		destroy_mesh();
+
+		face_map = face_buffer_map();
+		ptr = make_mesh(name, submeshes);
 	}
 
 	material_handle_t item_ref::get_material() const
@@ -366,12 +503,38 @@ namespace ot::egfx
 		return m;
 	}
 
+	mesh create_mesh(std::string const& name, std::span<submesh_definition const> submeshes)
+	{
+		Ogre::MeshPtr render_mesh = make_mesh(name, submeshes);
+
+		mesh m;
+		init_mesh(m, std::move(render_mesh));
+		return m;
+	}
+
 	item_ref add_item(node_ref owner, mesh const& m)
 	{
 		Ogre::SceneNode& owner_node = get_scene_node(owner);
 		Ogre::SceneManager& scene_manager = *owner_node.getCreator();
-		Ogre::Item* const item = scene_manager.createItem(get_mesh_ptr(m), Ogre::SCENE_DYNAMIC);
+		// Objects must share the memory type of the node they are attached to
+		bool const is_static = owner_node.isStatic();
+		Ogre::Item* const item = scene_manager.createItem(get_mesh_ptr(m), is_static ? Ogre::SCENE_STATIC : Ogre::SCENE_DYNAMIC);
 		owner_node.attachObject(item);
+		if (is_static)
+			scene_manager.notifyStaticDirty(&owner_node);
 		return make_item_ref(*item);
 	}
+
+	void remove_item(item_ref i)
+	{
+		Ogre::Item& item = get_item(i);
+		Ogre::SceneNode* const node = item.getParentSceneNode();
+		if (node != nullptr)
+		{
+			node->detachObject(&item);
+		}
+
+		Ogre::SceneManager* const scene_manager = item._getManager();
+		scene_manager->destroyItem(&item);
+	}
 }
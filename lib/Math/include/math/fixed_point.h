@@ -0,0 +1,71 @@
+#pragma once
+
+#include "math/vector3.h"
+#include "math/plane.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+// Positions and planes snapped to fixed grids and stored as integers
+// Snapping the same geometry always gives the same integers, which can be compared exactly and hashed, and the predicates on them are computed without rounding
+namespace ot::math
+{
+	// Coordinates are multiples of 1/2^fixed_position_bits world units
+	inline constexpr int fixed_position_bits = 16;
+	// Normal components are multiples of 1/2^fixed_normal_bits
+	inline constexpr int fixed_normal_bits = 14;
+	// Largest coordinate, in grid units, for which the plane predicates cannot overflow
+	inline constexpr int64_t max_fixed_coordinate = int64_t(1) << 40;
+
+	using fixed_point3 = point3<int64_t>;
+
+	// Points p such that dot(normal, p) == distance, in units of 1/2^(fixed_normal_bits + fixed_position_bits)
+	struct fixed_plane
+	{
+		vector3<int64_t> normal;
+		int64_t distance;
+
+		[[nodiscard]] constexpr bool operator==(fixed_plane const& rhs) const noexcept
+		{
+			return normal.x == rhs.normal.x && normal.y == rhs.normal.y && normal.z == rhs.normal.z && distance == rhs.distance;
+		}
+	};
+
+	// Throws std::invalid_argument if the point is too far from the origin to be snapped
+	[[nodiscard]] fixed_point3 snap(point3f p);
+	// The normal of the plane is expected to be normalized. Throws std::invalid_argument if the plane is too far from the origin to be snapped
+	[[nodiscard]] fixed_plane snap(plane p);
+
+	// Exact for coordinates below 2^8 world units, where floats still hold every grid position. Snapping the result again then gives back the same point
+	[[nodiscard]] point3f to_point(fixed_point3 p) noexcept;
+	// The plane with a normalized normal
+	[[nodiscard]] plane to_plane(fixed_plane const& p) noexcept;
+
+	// Exact signed distance from the plane, scaled by the norm of its normal
+	[[nodiscard]] int64_t scaled_distance_to(fixed_plane const& p, fixed_point3 v) noexcept;
+
+	// Largest scaled distance between the plane and a point snapped from a position exactly on it
+	[[nodiscard]] int64_t get_snapping_tolerance(fixed_plane const& p) noexcept;
+
+	// Exact side of the point, which is on the plane if its scaled distance is within 'tolerance'
+	// Passing get_snapping_tolerance(p) treats points snapped from positions on the plane as on it
+	[[nodiscard]] plane_side_result get_plane_side(fixed_plane const& p, fixed_point3 v, int64_t tolerance = 0) noexcept;
+
+	// The snapped point where the three planes meet, or nothing if they do not meet at a single point within the grid
+	// The result does not depend on the order of the planes
+	[[nodiscard]] std::optional<fixed_point3> find_intersection(fixed_plane p1, fixed_plane p2, fixed_plane p3);
+}
+
+template<>
+struct std::hash<ot::math::fixed_point3>
+{
+	[[nodiscard]] size_t operator()(ot::math::fixed_point3 const& p) const noexcept
+	{
+		// Mixes each coordinate with a different odd constant, so that permutations of a point do not collide
+		uint64_t const h = static_cast<uint64_t>(p.x) * 0x9E3779B97F4A7C15ull
+			^ static_cast<uint64_t>(p.y) * 0xC2B2AE3D27D4EB4Full
+			^ static_cast<uint64_t>(p.z) * 0x165667B19E3779F9ull;
+		return static_cast<size_t>(h ^ (h >> 29));
+	}
+};
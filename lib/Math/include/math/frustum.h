@@ -0,0 +1,27 @@
+#pragma once
+
+#include "math/plane.h"
+#include "math/aabb.h"
+#include "math/transform_matrix.h"
+
+#include <array>
+
+namespace ot::math
+{
+	// Convex volume seen by a camera, bounded by 6 planes whose normals face out of it
+	struct frustum
+	{
+		std::array<plane, 6> planes; // near, far, left, right, bottom, top
+
+		// Returns true when the box is entirely out of the frustum. Boxes near its corners can be kept even though they are out of it
+		[[nodiscard]] bool is_outside(aabb const& box) const noexcept;
+		[[nodiscard]] bool contains(point3f p) const noexcept;
+	};
+
+	// Frustum of a perspective camera looking along -Z in its local space, like Ogre cameras
+	// 
+	//   camera_transform: local to world transform of the camera, without scale
+	//   fov_y: vertical field of view, in radians
+	//   aspect_ratio: width of the viewport divided by its height
+	[[nodiscard]] frustum make_perspective_frustum(transform_matrix const& camera_transform, float fov_y, float aspect_ratio, float z_near, float z_far);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "math/plane.h"
+#include "math/ray.h"
+
+#include <optional>
+#include <span>
+
+namespace ot::math
+{
+	// Batched versions of the plane functions, processing several elements per instruction where the build allows it
+	// Each output span must have the same size as the input span. Results match the scalar functions they mirror
+
+	// Signed distance from the plane to each point, as plane::distance_to
+	void distances_to(plane const& p, std::span<point3f const> points, std::span<float> distances) noexcept;
+
+	// Side of the plane of each point, as get_plane_side
+	void get_plane_sides(plane const& p, std::span<point3f const> points, std::span<plane_side_result> sides) noexcept;
+
+	// Side of the plane of each distance, as distance_to_plane_side
+	void distances_to_plane_sides(std::span<float const> distances, std::span<plane_side_result> sides) noexcept;
+
+	// Distance along the ray, in multiples of its direction, at which it crosses each plane. NaN for planes parallel to the ray
+	// Negative distances are behind the origin of the ray
+	void intersect_distances(ray const& r, std::span<plane const> planes, std::span<float> distances) noexcept;
+
+	struct plane_triple
+	{
+		plane p1;
+		plane p2;
+		plane p3;
+	};
+
+	// Point where the three planes of each triple meet, as find_intersection
+	void find_intersections(std::span<plane_triple const> triples, std::span<std::optional<point3f>> points) noexcept;
+}
@@ -0,0 +1,135 @@
+#include "math/fixed_point.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <tuple>
+
+namespace ot::math
+{
+	namespace
+	{
+		constexpr double position_scale = double(int64_t(1) << fixed_position_bits);
+		constexpr double normal_scale = double(int64_t(1) << fixed_normal_bits);
+
+		// Rounds to the nearest integer, or returns nothing if the value is beyond 'limit' or not a number
+		std::optional<int64_t> to_fixed(double value, int64_t limit) noexcept
+		{
+			double const rounded = std::round(value);
+			if (!(std::abs(rounded) <= double(limit)))
+				return std::nullopt;
+			return static_cast<int64_t>(rounded);
+		}
+
+		vector3<int64_t> cross_product(vector3<int64_t> const& lhs, vector3<int64_t> const& rhs) noexcept
+		{
+			return {
+				lhs.y * rhs.z - lhs.z * rhs.y,
+				lhs.z * rhs.x - lhs.x * rhs.z,
+				lhs.x * rhs.y - lhs.y * rhs.x,
+			};
+		}
+	}
+
+	fixed_point3 snap(point3f p)
+	{
+		auto const x = to_fixed(double(p.x) * position_scale, max_fixed_coordinate);
+		auto const y = to_fixed(double(p.y) * position_scale, max_fixed_coordinate);
+		auto const z = to_fixed(double(p.z) * position_scale, max_fixed_coordinate);
+		if (!x || !y || !z)
+			throw std::invalid_argument("Point is too far from the origin to be snapped");
+
+		return { *x, *y, *z };
+	}
+
+	fixed_plane snap(plane p)
+	{
+		int64_t const normal_limit = int64_t(1) << fixed_normal_bits;
+		auto const x = to_fixed(double(p.normal.x) * normal_scale, normal_limit);
+		auto const y = to_fixed(double(p.normal.y) * normal_scale, normal_limit);
+		auto const z = to_fixed(double(p.normal.z) * normal_scale, normal_limit);
+		auto const distance = to_fixed(double(p.distance) * normal_scale * position_scale, max_fixed_coordinate << fixed_normal_bits);
+		if (!x || !y || !z || !distance)
+			throw std::invalid_argument("Plane is too far from the origin to be snapped");
+		if (*x == 0 && *y == 0 && *z == 0)
+			throw std::invalid_argument("Plane normal is too short to be snapped");
+
+		return { { *x, *y, *z }, *distance };
+	}
+
+	point3f to_point(fixed_point3 p) noexcept
+	{
+		return {
+			static_cast<float>(double(p.x) / position_scale),
+			static_cast<float>(double(p.y) / position_scale),
+			static_cast<float>(double(p.z) / position_scale),
+		};
+	}
+
+	plane to_plane(fixed_plane const& p) noexcept
+	{
+		double const x = double(p.normal.x) / normal_scale;
+		double const y = double(p.normal.y) / normal_scale;
+		double const z = double(p.normal.z) / normal_scale;
+		double const norm = std::sqrt(x * x + y * y + z * z);
+		return {
+			{ static_cast<float>(x / norm), static_cast<float>(y / norm), static_cast<float>(z / norm) },
+			static_cast<float>(double(p.distance) / (normal_scale * position_scale) / norm),
+		};
+	}
+
+	int64_t scaled_distance_to(fixed_plane const& p, fixed_point3 v) noexcept
+	{
+		// Each product is below 2^54 within the limits of snapping, so the sum cannot overflow
+		return p.normal.x * v.x + p.normal.y * v.y + p.normal.z * v.z - p.distance;
+	}
+
+	int64_t get_snapping_tolerance(fixed_plane const& p) noexcept
+	{
+		// Each coordinate moves by at most half a grid unit
+		return (std::abs(p.normal.x) + std::abs(p.normal.y) + std::abs(p.normal.z) + 1) / 2;
+	}
+
+	plane_side_result get_plane_side(fixed_plane const& p, fixed_point3 v, int64_t tolerance) noexcept
+	{
+		int64_t const distance = scaled_distance_to(p, v);
+		if (distance > tolerance)
+			return plane_side_result::outside;
+		else if (distance < -tolerance)
+			return plane_side_result::inside;
+		else
+			return plane_side_result::on_plane;
+	}
+
+	std::optional<fixed_point3> find_intersection(fixed_plane p1, fixed_plane p2, fixed_plane p3)
+	{
+		// Sorting the planes makes the rounding of the division the same for any order
+		std::array<fixed_plane, 3> planes{ p1, p2, p3 };
+		std::sort(planes.begin(), planes.end(), [](fixed_plane const& lhs, fixed_plane const& rhs)
+		{
+			return std::tie(lhs.normal.x, lhs.normal.y, lhs.normal.z, lhs.distance) < std::tie(rhs.normal.x, rhs.normal.y, rhs.normal.z, rhs.distance);
+		});
+
+		vector3<int64_t> const c23 = cross_product(planes[1].normal, planes[2].normal);
+		vector3<int64_t> const c31 = cross_product(planes[2].normal, planes[0].normal);
+		vector3<int64_t> const c12 = cross_product(planes[0].normal, planes[1].normal);
+
+		// Exact, the normals being below 2^14
+		int64_t const w = planes[0].normal.x * c23.x + planes[0].normal.y * c23.y + planes[0].normal.z * c23.z;
+		if (w == 0)
+			return std::nullopt;
+
+		// p = (d1 * (n2 x n3) + d2 * (n3 x n1) + d3 * (n1 x n2)) / w
+		double const d1 = double(planes[0].distance);
+		double const d2 = double(planes[1].distance);
+		double const d3 = double(planes[2].distance);
+		auto const x = to_fixed((d1 * double(c23.x) + d2 * double(c31.x) + d3 * double(c12.x)) / double(w), max_fixed_coordinate);
+		auto const y = to_fixed((d1 * double(c23.y) + d2 * double(c31.y) + d3 * double(c12.y)) / double(w), max_fixed_coordinate);
+		auto const z = to_fixed((d1 * double(c23.z) + d2 * double(c31.z) + d3 * double(c12.z)) / double(w), max_fixed_coordinate);
+		if (!x || !y || !z)
+			return std::nullopt;
+
+		return fixed_point3{ *x, *y, *z };
+	}
+}
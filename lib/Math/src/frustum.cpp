@@ -0,0 +1,47 @@
+#include "math/frustum.h"
+
+#include <cmath>
+
+namespace ot::math
+{
+	bool frustum::is_outside(aabb const& box) const noexcept
+	{
+		for (plane const& p : planes)
+		{
+			// Distance from the center to the corner of the box which is the furthest toward the inside of the plane
+			float const radius = std::abs(p.normal.x) * box.half_size.x + std::abs(p.normal.y) * box.half_size.y + std::abs(p.normal.z) * box.half_size.z;
+			if (p.distance_to(box.position) > radius)
+				return true;
+		}
+		return false;
+	}
+
+	bool frustum::contains(point3f p) const noexcept
+	{
+		for (plane const& frustum_plane : planes)
+			if (frustum_plane.distance_to(p) > 0.f)
+				return false;
+		return true;
+	}
+
+	frustum make_perspective_frustum(transform_matrix const& camera_transform, float fov_y, float aspect_ratio, float z_near, float z_far)
+	{
+		float const tan_y = std::tan(fov_y * 0.5f);
+		float const tan_x = tan_y * aspect_ratio;
+
+		// Side planes go through the camera, a point (x, y, z) being out of the right plane when x > -z * tan_x
+		frustum const local{ {
+			plane{ { 0.f, 0.f, 1.f }, -z_near },
+			plane{ { 0.f, 0.f, -1.f }, z_far },
+			plane{ normalized(vector3f{ -1.f, 0.f, tan_x }), 0.f },
+			plane{ normalized(vector3f{ 1.f, 0.f, tan_x }), 0.f },
+			plane{ normalized(vector3f{ 0.f, -1.f, tan_y }), 0.f },
+			plane{ normalized(vector3f{ 0.f, 1.f, tan_y }), 0.f },
+		} };
+
+		frustum world;
+		for (size_t i = 0; i < world.planes.size(); ++i)
+			world.planes[i] = transform(local.planes[i], camera_transform);
+		return world;
+	}
+}
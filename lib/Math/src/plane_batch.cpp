@@ -0,0 +1,268 @@
+#include "math/plane_batch.h"
+
+#include "core/compiler.h"
+#include "core/stdint.h"
+
+#include <cassert>
+#include <cfloat>
+#include <limits>
+
+#if OT_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#if OT_SIMD_AVX
+#include <immintrin.h>
+#endif
+
+namespace ot::math
+{
+	static_assert(sizeof(point3f) == 3 * sizeof(float), "Points are loaded as packed floats");
+	static_assert(sizeof(plane) == 4 * sizeof(float), "Planes are loaded as packed floats");
+	static_assert(sizeof(plane_side_result) == sizeof(int32_t), "Sides are stored as 32-bit integers");
+
+	namespace
+	{
+		// Tolerance of distance_to_plane_side and float_eq when comparing against 0
+		constexpr float zero_epsilon = FLT_EPSILON;
+
+		float intersect_distance(ray const& r, plane const& p) noexcept
+		{
+			float const denominator = r.direction.x * p.normal.x + r.direction.y * p.normal.y + r.direction.z * p.normal.z;
+			if (denominator <= zero_epsilon && denominator >= -zero_epsilon)
+				return std::numeric_limits<float>::quiet_NaN();
+
+			vector3f const v = p.get_point() - r.origin;
+			return (v.x * p.normal.x + v.y * p.normal.y + v.z * p.normal.z) / denominator;
+		}
+
+#if OT_SIMD_SSE2
+		// Selects the lanes of 'a' and 'b' into [a[i0], a[i1], b[i2], b[i3]]
+#define OT_SHUFFLE(a, b, i0, i1, i2, i3) _mm_shuffle_ps(a, b, _MM_SHUFFLE(i3, i2, i1, i0))
+
+		// Loads 4 packed points as one register per coordinate
+		void load_points(float const* data, __m128& x, __m128& y, __m128& z) noexcept
+		{
+			__m128 const a = _mm_loadu_ps(data); // x0 y0 z0 x1
+			__m128 const b = _mm_loadu_ps(data + 4); // y1 z1 x2 y2
+			__m128 const c = _mm_loadu_ps(data + 8); // z2 x3 y3 z3
+
+			x = OT_SHUFFLE(a, OT_SHUFFLE(b, c, 2, 2, 1, 1), 0, 3, 0, 2);
+			y = OT_SHUFFLE(OT_SHUFFLE(a, b, 1, 1, 0, 0), OT_SHUFFLE(b, c, 3, 3, 2, 2), 0, 2, 0, 2);
+			z = OT_SHUFFLE(OT_SHUFFLE(a, b, 2, 2, 1, 1), OT_SHUFFLE(c, c, 0, 0, 3, 3), 0, 2, 0, 2);
+		}
+
+#undef OT_SHUFFLE
+
+		// Loads 4 planes 'stride' floats apart as one register per component
+		void load_planes(float const* data, size_t stride, __m128& x, __m128& y, __m128& z, __m128& d) noexcept
+		{
+			x = _mm_loadu_ps(data);
+			y = _mm_loadu_ps(data + stride);
+			z = _mm_loadu_ps(data + 2 * stride);
+			d = _mm_loadu_ps(data + 3 * stride);
+			_MM_TRANSPOSE4_PS(x, y, z, d);
+		}
+
+		__m128 distances_to(__m128 nx, __m128 ny, __m128 nz, __m128 d, __m128 x, __m128 y, __m128 z) noexcept
+		{
+			return _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, x), _mm_mul_ps(ny, y)), _mm_mul_ps(nz, z)), d);
+		}
+
+		__m128i to_sides(__m128 distances) noexcept
+		{
+			__m128 const outside = _mm_cmpgt_ps(distances, _mm_set1_ps(zero_epsilon));
+			__m128 const inside = _mm_cmplt_ps(distances, _mm_set1_ps(-zero_epsilon));
+			return _mm_or_si128(
+				_mm_and_si128(_mm_castps_si128(outside), _mm_set1_epi32(static_cast<int32_t>(plane_side_result::outside))),
+				_mm_and_si128(_mm_castps_si128(inside), _mm_set1_epi32(static_cast<int32_t>(plane_side_result::inside))));
+		}
+
+		// Lanes of 'mask' take 'if_true', others take 'if_false'
+		__m128 select(__m128 mask, __m128 if_true, __m128 if_false) noexcept
+		{
+			return _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false));
+		}
+
+		__m128 is_zero(__m128 v) noexcept
+		{
+			return _mm_and_ps(_mm_cmple_ps(v, _mm_set1_ps(zero_epsilon)), _mm_cmpge_ps(v, _mm_set1_ps(-zero_epsilon)));
+		}
+#endif
+
+#if OT_SIMD_AVX
+		void load_points(float const* data, __m256& x, __m256& y, __m256& z) noexcept
+		{
+			__m128 x0, y0, z0, x1, y1, z1;
+			load_points(data, x0, y0, z0);
+			load_points(data + 12, x1, y1, z1);
+			x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+			y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+			z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+		}
+#endif
+	}
+
+	void distances_to(plane const& p, std::span<point3f const> points, std::span<float> distances) noexcept
+	{
+		assert(points.size() == distances.size());
+
+		size_t i = 0;
+		float const* const data = reinterpret_cast<float const*>(points.data());
+
+#if OT_SIMD_AVX
+		{
+			__m256 const nx = _mm256_set1_ps(p.normal.x);
+			__m256 const ny = _mm256_set1_ps(p.normal.y);
+			__m256 const nz = _mm256_set1_ps(p.normal.z);
+			__m256 const d = _mm256_set1_ps(p.distance);
+			for (; i + 8 <= points.size(); i += 8)
+			{
+				__m256 x, y, z;
+				load_points(data + 3 * i, x, y, z);
+				__m256 const result = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, x), _mm256_mul_ps(ny, y)), _mm256_mul_ps(nz, z)), d);
+				_mm256_storeu_ps(distances.data() + i, result);
+			}
+		}
+#endif
+
+#if OT_SIMD_SSE2
+		{
+			__m128 const nx = _mm_set1_ps(p.normal.x);
+			__m128 const ny = _mm_set1_ps(p.normal.y);
+			__m128 const nz = _mm_set1_ps(p.normal.z);
+			__m128 const d = _mm_set1_ps(p.distance);
+			for (; i + 4 <= points.size(); i += 4)
+			{
+				__m128 x, y, z;
+				load_points(data + 3 * i, x, y, z);
+				_mm_storeu_ps(distances.data() + i, distances_to(nx, ny, nz, d, x, y, z));
+			}
+		}
+#endif
+
+		for (; i < points.size(); ++i)
+			distances[i] = p.distance_to(points[i]);
+	}
+
+	void get_plane_sides(plane const& p, std::span<point3f const> points, std::span<plane_side_result> sides) noexcept
+	{
+		assert(points.size() == sides.size());
+
+		size_t i = 0;
+
+#if OT_SIMD_SSE2
+		float const* const data = reinterpret_cast<float const*>(points.data());
+		__m128 const nx = _mm_set1_ps(p.normal.x);
+		__m128 const ny = _mm_set1_ps(p.normal.y);
+		__m128 const nz = _mm_set1_ps(p.normal.z);
+		__m128 const d = _mm_set1_ps(p.distance);
+		for (; i + 4 <= points.size(); i += 4)
+		{
+			__m128 x, y, z;
+			load_points(data + 3 * i, x, y, z);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sides.data() + i), to_sides(distances_to(nx, ny, nz, d, x, y, z)));
+		}
+#endif
+
+		for (; i < points.size(); ++i)
+			sides[i] = get_plane_side(p, points[i]);
+	}
+
+	void distances_to_plane_sides(std::span<float const> distances, std::span<plane_side_result> sides) noexcept
+	{
+		assert(distances.size() == sides.size());
+
+		size_t i = 0;
+
+#if OT_SIMD_SSE2
+		for (; i + 4 <= distances.size(); i += 4)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sides.data() + i), to_sides(_mm_loadu_ps(distances.data() + i)));
+#endif
+
+		for (; i < distances.size(); ++i)
+			sides[i] = distance_to_plane_side(distances[i]);
+	}
+
+	void intersect_distances(ray const& r, std::span<plane const> planes, std::span<float> distances) noexcept
+	{
+		assert(planes.size() == distances.size());
+
+		size_t i = 0;
+
+#if OT_SIMD_SSE2
+		float const* const data = reinterpret_cast<float const*>(planes.data());
+		__m128 const dx = _mm_set1_ps(r.direction.x);
+		__m128 const dy = _mm_set1_ps(r.direction.y);
+		__m128 const dz = _mm_set1_ps(r.direction.z);
+		__m128 const ox = _mm_set1_ps(r.origin.x);
+		__m128 const oy = _mm_set1_ps(r.origin.y);
+		__m128 const oz = _mm_set1_ps(r.origin.z);
+		__m128 const nan = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+		for (; i + 4 <= planes.size(); i += 4)
+		{
+			__m128 nx, ny, nz, d;
+			load_planes(data + 4 * i, 4, nx, ny, nz, d);
+
+			__m128 const denominator = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, nx), _mm_mul_ps(dy, ny)), _mm_mul_ps(dz, nz));
+			__m128 const vx = _mm_sub_ps(_mm_mul_ps(nx, d), ox);
+			__m128 const vy = _mm_sub_ps(_mm_mul_ps(ny, d), oy);
+			__m128 const vz = _mm_sub_ps(_mm_mul_ps(nz, d), oz);
+			__m128 const numerator = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, nx), _mm_mul_ps(vy, ny)), _mm_mul_ps(vz, nz));
+
+			_mm_storeu_ps(distances.data() + i, select(is_zero(denominator), nan, _mm_div_ps(numerator, denominator)));
+		}
+#endif
+
+		for (; i < planes.size(); ++i)
+			distances[i] = intersect_distance(r, planes[i]);
+	}
+
+	void find_intersections(std::span<plane_triple const> triples, std::span<std::optional<point3f>> points) noexcept
+	{
+		assert(triples.size() == points.size());
+
+		size_t i = 0;
+
+#if OT_SIMD_SSE2
+		// Same formula as find_intersection, 4 triples at a time
+		constexpr size_t triple_stride = sizeof(plane_triple) / sizeof(float);
+		float const* const data = reinterpret_cast<float const*>(triples.data());
+		for (; i + 4 <= triples.size(); i += 4)
+		{
+			float const* const first = data + triple_stride * i;
+			__m128 a1, b1, c1, d1, a2, b2, c2, d2, a3, b3, c3, d3;
+			load_planes(first, triple_stride, a1, b1, c1, d1);
+			load_planes(first + 4, triple_stride, a2, b2, c2, d2);
+			load_planes(first + 8, triple_stride, a3, b3, c3, d3);
+
+			__m128 const bc12 = _mm_sub_ps(_mm_mul_ps(b1, c2), _mm_mul_ps(b2, c1));
+			__m128 const bc23 = _mm_sub_ps(_mm_mul_ps(b2, c3), _mm_mul_ps(b3, c2));
+			__m128 const bc31 = _mm_sub_ps(_mm_mul_ps(b3, c1), _mm_mul_ps(b1, c3));
+			__m128 const w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a1, bc23), _mm_mul_ps(a2, bc31)), _mm_mul_ps(a3, bc12));
+
+			__m128 const ad12 = _mm_sub_ps(_mm_mul_ps(a1, d2), _mm_mul_ps(a2, d1));
+			__m128 const ad23 = _mm_sub_ps(_mm_mul_ps(a2, d3), _mm_mul_ps(a3, d2));
+			__m128 const ad31 = _mm_sub_ps(_mm_mul_ps(a3, d1), _mm_mul_ps(a1, d3));
+
+			alignas(16) float x[4];
+			alignas(16) float y[4];
+			alignas(16) float z[4];
+			_mm_store_ps(x, _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d1, bc23), _mm_mul_ps(d2, bc31)), _mm_mul_ps(d3, bc12)), w));
+			_mm_store_ps(y, _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c1, ad23), _mm_mul_ps(c2, ad31)), _mm_mul_ps(c3, ad12)), w));
+			_mm_store_ps(z, _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(b1, ad23), _mm_mul_ps(b2, ad31)), _mm_mul_ps(b3, ad12)), w));
+			int const parallel = _mm_movemask_ps(is_zero(w));
+
+			for (size_t k = 0; k < 4; ++k)
+			{
+				if (parallel & (1 << k))
+					points[i + k].reset();
+				else
+					points[i + k] = point3f{ x[k], y[k], -z[k] };
+			}
+		}
+#endif
+
+		for (; i < triples.size(); ++i)
+			points[i] = find_intersection(triples[i].p1, triples[i].p2, triples[i].p3);
+	}
+}
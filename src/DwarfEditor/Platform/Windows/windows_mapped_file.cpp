@@ -0,0 +1,81 @@
+#include "platform/mapped_file.h"
+
+#include "platform/Windows/windows_main.h"
+
+#include <winrt/base.h>
+
+#include <utility>
+
+namespace ot::dedit::platform
+{
+	namespace
+	{
+		[[nodiscard]] std::error_code get_last_error() noexcept
+		{
+			return { static_cast<int>(::GetLastError()), std::system_category() };
+		}
+	}
+
+	mapped_file::mapped_file(mapped_file&& other) noexcept
+		: file_handle(std::exchange(other.file_handle, nullptr))
+		, mapping_handle(std::exchange(other.mapping_handle, nullptr))
+		, data(std::exchange(other.data, nullptr))
+		, size(std::exchange(other.size, 0))
+	{
+
+	}
+
+	mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+	{
+		if (this != &other)
+		{
+			mapped_file old(std::move(*this));
+			file_handle = std::exchange(other.file_handle, nullptr);
+			mapping_handle = std::exchange(other.mapping_handle, nullptr);
+			data = std::exchange(other.data, nullptr);
+			size = std::exchange(other.size, 0);
+		}
+		return *this;
+	}
+
+	mapped_file::~mapped_file()
+	{
+		if (data != nullptr)
+			::UnmapViewOfFile(data);
+		if (mapping_handle != nullptr)
+			::CloseHandle(mapping_handle);
+		if (file_handle != nullptr)
+			::CloseHandle(file_handle);
+	}
+
+	std::expected<mapped_file, std::error_code> map_file(std::string_view path)
+	{
+		mapped_file f;
+
+		HANDLE const file = ::CreateFileW(winrt::to_hstring(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return std::unexpected(get_last_error());
+		f.file_handle = file;
+
+		LARGE_INTEGER file_size;
+		if (!::GetFileSizeEx(file, &file_size))
+			return std::unexpected(get_last_error());
+
+		// Empty files cannot be mapped, but are a valid empty view
+		if (file_size.QuadPart == 0)
+			return f;
+
+		HANDLE const mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+			return std::unexpected(get_last_error());
+		f.mapping_handle = mapping;
+
+		void const* const view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr)
+			return std::unexpected(get_last_error());
+
+		f.data = static_cast<std::byte const*>(view);
+		f.size = static_cast<size_t>(file_size.QuadPart);
+		return f;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <system_error>
+#include <expected>
+#include <string_view>
+#include <span>
+#include <cstddef>
+
+namespace ot::dedit::platform
+{
+	// Read-only view of the whole content of a file, mapped in memory
+	class mapped_file
+	{
+		void* file_handle = nullptr;
+		void* mapping_handle = nullptr;
+		std::byte const* data = nullptr;
+		size_t size = 0;
+
+		friend std::expected<mapped_file, std::error_code> map_file(std::string_view path);
+
+	public:
+		mapped_file() = default;
+		mapped_file(mapped_file&& other) noexcept;
+		mapped_file& operator=(mapped_file&& other) noexcept;
+		~mapped_file();
+
+		[[nodiscard]] std::span<std::byte const> get_data() const noexcept { return { data, size }; }
+	};
+
+	// Maps the file at 'path' in memory for reading
+	// Error conditions:
+	//   - Any error from the system when opening or mapping the file
+	[[nodiscard]] std::expected<mapped_file, std::error_code> map_file(std::string_view path);
+}
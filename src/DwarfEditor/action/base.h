@@ -4,6 +4,8 @@
 
 #include "map.fwd.h"
 
+#include "core/size_t.h"
+
 namespace ot::dedit::action
 {
 	class base
@@ -14,5 +16,8 @@ namespace ot::dedit::action
 		virtual void apply(map& current_map) = 0;
 		virtual void redo(map& current_map) { apply(current_map); }
 		virtual void undo(map& current_map) = 0;
+
+		// Bytes held by the action, itself included, for the memory budget of the undo history
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept = 0;
 	};
 }
@@ -1,4 +1,5 @@
 #include "action/brush.h"
+#include "action/memory_size.h"
 
 #include "console.h"
 #include "serialize/serialize_map.h"
@@ -20,11 +21,12 @@ namespace ot::dedit::action
 		brush_entity* b = current_map.find_brush(get_id());
 		if (b == nullptr)
 		{
-			console::error(std::format("Could not apply action: entity '{}' not found", as_int(get_id())));
+			console::error("Could not apply action: entity '{}' not found", as_int(get_id()));
 			return;
 		}
 
 		do_apply(*b, false);
+		current_map.on_entity_changed(get_id());
 	}
 
 	void single_brush::redo(map& current_map)
@@ -32,11 +34,12 @@ namespace ot::dedit::action
 		brush_entity* b = current_map.find_brush(get_id());
 		if (b == nullptr)
 		{
-			console::error(std::format("Could not redo action: entity '{}' not found", as_int(get_id())));
+			console::error("Could not redo action: entity '{}' not found", as_int(get_id()));
 			return;
 		}
 
 		do_apply(*b, true);
+		current_map.on_entity_changed(get_id());
 	}
 
 	void single_brush::undo(map& current_map)
@@ -44,6 +47,7 @@ namespace ot::dedit::action
 		brush* b = current_map.find_brush(get_id());
 		assert(b != nullptr);
 		do_undo(*b);
+		current_map.on_entity_changed(get_id());
 	}
 
 	brush_definition_base::brush_definition_base(brush_entity const& b)
@@ -53,9 +57,19 @@ namespace ot::dedit::action
 
 	}
 
+	void brush_definition_base::set_new_state(brush_entity& b, std::shared_ptr<egfx::mesh_definition> new_mesh)
+	{
+		previous_state_size = count_unshared_bytes(*previous_state, *new_mesh);
+		b.update_node(std::move(new_mesh));
+	}
+
 	void brush_definition_base::do_undo(brush_entity& b)
 	{
-		b.reload_node(std::move(previous_state));
+		// The previous mesh is kept for the next undo, once redone
+		b.reload_node(previous_state);
+
+		// The brush shares the previous mesh again, and redoing builds the new one from it
+		previous_state_size = 0;
 	}
 
 	split_brush_edge::split_brush_edge(brush_entity const& b, egfx::half_edge::id edge, math::point3f point)
@@ -72,7 +86,7 @@ namespace ot::dedit::action
 
 		auto new_mesh = std::make_shared<egfx::mesh_definition>(b.get_mesh_def());
 		new_mesh->get_half_edge(edge).split_at(point);
-		b.reload_node(std::move(new_mesh));
+		set_new_state(b, std::move(new_mesh));
 	}
 
 	split_brush_face::split_brush_face(brush_entity const& b, egfx::face::id face, math::plane plane)
@@ -91,8 +105,8 @@ namespace ot::dedit::action
 		{
 			egfx::face::ref const new_face = *result;
 			if(!is_redo)
-				console::log(std::format( "Split brush {} face {} into new face {}", as_int(get_id()), static_cast<size_t>(face), static_cast<size_t>(new_face.get_id())));
-			b.reload_node(std::move(new_mesh));
+				console::log("Split brush {} face {} into new face {}", as_int(get_id()), static_cast<size_t>(face), static_cast<size_t>(new_face.get_id()));
+			set_new_state(b, std::move(new_mesh));
 		}
 		else
 		{
@@ -100,16 +114,16 @@ namespace ot::dedit::action
 			switch (fail)
 			{
 			case egfx::face::split_fail::inside: 
-				console::error(std::format("Could not split brush {} face {}: face was entirely inside the plane", as_int(get_id()), static_cast<size_t>(face)));
+				console::error("Could not split brush {} face {}: face was entirely inside the plane", as_int(get_id()), static_cast<size_t>(face));
 				break;
 			case egfx::face::split_fail::outside:
-				console::error(std::format("Could not split brush {} face {}: face was entirely outside the plane", as_int(get_id()), static_cast<size_t>(face)));
+				console::error("Could not split brush {} face {}: face was entirely outside the plane", as_int(get_id()), static_cast<size_t>(face));
 				break;
 			case egfx::face::split_fail::aligned:
-				console::error(std::format("Could not split brush {} face {}: face was aligned to the plane", as_int(get_id()), static_cast<size_t>(face)));
+				console::error("Could not split brush {} face {}: face was aligned to the plane", as_int(get_id()), static_cast<size_t>(face));
 				break;
 			case egfx::face::split_fail::opposite_aligned:
-				console::error(std::format("Could not split brush {} face {}: face was opposite-aligned to the plane", as_int(get_id()), static_cast<size_t>(face)));
+				console::error("Could not split brush {} face {}: face was opposite-aligned to the plane", as_int(get_id()), static_cast<size_t>(face));
 				break;
 			}
 		}		
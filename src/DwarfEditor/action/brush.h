@@ -31,9 +31,14 @@ namespace ot::dedit::action
 	class brush_definition_base : public single_brush
 	{		
 		std::shared_ptr<egfx::mesh_definition const> previous_state;
+		size_t previous_state_size = 0; // bytes of the chunks of the previous mesh which the new mesh does not share, 0 once undone
 	protected:
 		brush_definition_base(brush_entity const& b);
 
+		// Gives the new mesh to the brush, measuring what keeping the previous mesh costs
+		void set_new_state(brush_entity& b, std::shared_ptr<egfx::mesh_definition> new_mesh);
+		[[nodiscard]] size_t get_previous_state_size() const noexcept { return previous_state_size; }
+
 		virtual void do_undo(brush_entity& b) override;
 	};
 
@@ -47,6 +52,8 @@ namespace ot::dedit::action
 
 	public:
 		split_brush_edge(brush_entity const& b, egfx::half_edge::id edge, math::point3f point);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this) + get_previous_state_size(); }
 	};
 
 	class split_brush_face : public brush_definition_base
@@ -59,6 +66,8 @@ namespace ot::dedit::action
 
 	public:
 		split_brush_face(brush_entity const& b, egfx::face::id face, math::plane plane);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this) + get_previous_state_size(); }
 	};
 		
 	class set_brush_material : public single_brush
@@ -71,5 +80,7 @@ namespace ot::dedit::action
 
 	public:
 		set_brush_material(brush_entity const& b, egfx::material_handle_t const& mat);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this); }
 	};
 }
@@ -0,0 +1,109 @@
+#include "history.h"
+
+#include "base.h"
+
+#include <cassert>
+
+namespace ot::dedit::action
+{
+	history::history(size_t memory_budget)
+		: memory_budget(memory_budget)
+	{
+
+	}
+
+	void history::push(fwd_uptr<base> action, int id)
+	{
+		for (entry const& e : undone)
+			memory_usage -= e.memory_size;
+		undone.clear();
+
+		size_t const memory_size = action->get_memory_size();
+		applied.push_back({ std::move(action), id, memory_size });
+		memory_usage += memory_size;
+
+		trim();
+	}
+
+	base& history::get_undo() const
+	{
+		assert(has_undo());
+		return *applied.back().action;
+	}
+
+	base& history::get_redo() const
+	{
+		assert(has_redo());
+		return *undone.back().action;
+	}
+
+	void history::on_undone()
+	{
+		assert(has_undo());
+
+		entry e = std::move(applied.back());
+		applied.pop_back();
+
+		// Undoing can change what an action keeps, like the state of a deleted entity
+		memory_usage -= e.memory_size;
+		e.memory_size = e.action->get_memory_size();
+		memory_usage += e.memory_size;
+
+		undone.push_back(std::move(e));
+		trim();
+	}
+
+	void history::on_redone()
+	{
+		assert(has_redo());
+
+		entry e = std::move(undone.back());
+		undone.pop_back();
+
+		memory_usage -= e.memory_size;
+		e.memory_size = e.action->get_memory_size();
+		memory_usage += e.memory_size;
+
+		applied.push_back(std::move(e));
+		trim();
+	}
+
+	int history::get_last_id() const noexcept
+	{
+		if (applied.empty())
+			return 0;
+
+		return applied.back().id;
+	}
+
+	void history::set_memory_budget(size_t bytes)
+	{
+		memory_budget = bytes;
+		trim();
+	}
+
+	void history::trim()
+	{
+		while (memory_usage > memory_budget && applied.size() > 1)
+		{
+			memory_usage -= applied.front().memory_size;
+			applied.pop_front();
+			++dropped_count;
+		}
+
+		while (memory_usage > memory_budget && undone.size() > 1)
+		{
+			memory_usage -= undone.front().memory_size;
+			undone.pop_front();
+			++dropped_count;
+		}
+	}
+
+	void history::clear() noexcept
+	{
+		applied.clear();
+		undone.clear();
+		memory_usage = 0;
+		dropped_count = 0;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "base.fwd.h"
+
+#include "core/uptr.h"
+#include "core/size_t.h"
+
+#include <deque>
+
+namespace ot::dedit::action
+{
+	// Applied and undone actions, within a memory budget
+	// When the actions take more than the budget, the oldest applied actions are dropped first, then the undone actions furthest from being redone
+	// The latest applied action and the next action to redo are always kept, even when they alone are over the budget
+	class history
+	{
+	public:
+		static constexpr size_t default_memory_budget = size_t(256) << 20;
+
+	private:
+		struct entry
+		{
+			fwd_uptr<base> action;
+			int id;
+			size_t memory_size;
+		};
+
+		std::deque<entry> applied; // oldest first
+		std::deque<entry> undone; // furthest from being redone first
+		size_t memory_budget;
+		size_t memory_usage = 0;
+		size_t dropped_count = 0;
+
+		void trim();
+
+	public:
+		explicit history(size_t memory_budget = default_memory_budget);
+
+		// Adds an action which was just applied, forgetting the undone actions
+		void push(fwd_uptr<base> action, int id);
+
+		// The action to undo or redo next. Must only be called if there is one
+		[[nodiscard]] base& get_undo() const;
+		[[nodiscard]] base& get_redo() const;
+		// Moves the action just undone or redone to the other side of the history, measuring its memory again
+		void on_undone();
+		void on_redone();
+
+		[[nodiscard]] bool has_undo() const noexcept { return !applied.empty(); }
+		[[nodiscard]] bool has_redo() const noexcept { return !undone.empty(); }
+		[[nodiscard]] size_t get_undo_count() const noexcept { return applied.size(); }
+		[[nodiscard]] size_t get_redo_count() const noexcept { return undone.size(); }
+
+		// Id of the latest applied action, 0 when there is none
+		[[nodiscard]] int get_last_id() const noexcept;
+
+		// Drops old actions right away if the history is over the new budget
+		void set_memory_budget(size_t bytes);
+		[[nodiscard]] size_t get_memory_budget() const noexcept { return memory_budget; }
+		[[nodiscard]] size_t get_memory_usage() const noexcept { return memory_usage; }
+		// Number of actions dropped to stay within the budget since the history was created or cleared
+		[[nodiscard]] size_t get_dropped_count() const noexcept { return dropped_count; }
+
+		void clear() noexcept;
+	};
+}
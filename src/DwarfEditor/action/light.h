@@ -33,6 +33,8 @@ namespace ot::dedit::action
 
 	public:
 		set_light_type(egfx::light_cref l, egfx::light_type new_type);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this); }
 	};
 
 	class set_light_power_scale : public single_light
@@ -46,6 +48,8 @@ namespace ot::dedit::action
 
 	public:
 		set_light_power_scale(egfx::light_cref l, float new_scale);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this); }
 	};
 
 	class set_light_diffuse : public single_light
@@ -59,6 +63,8 @@ namespace ot::dedit::action
 
 	public:
 		set_light_diffuse(egfx::light_cref l, egfx::color new_color);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this); }
 	};
 
 	class set_light_attenuation : public single_light
@@ -78,5 +84,7 @@ namespace ot::dedit::action
 
 	public:
 		set_light_attenuation(egfx::light_cref l, float new_range, float new_const, float new_linear, float new_quadratic);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this); }
 	};
 }
@@ -1,4 +1,5 @@
 #include "map_entity.h"
+#include "memory_size.h"
 
 #include "map.h"
 #include "console.h"
@@ -6,17 +7,36 @@
 #include "serialize/serialize_map.h"
 
 #include <format>
+#include <tuple>
 
 namespace ot::dedit::action
 {
+	namespace
+	{
+		template<typename T>
+		[[nodiscard]] size_t count_owned_arg_bytes(T const&) noexcept
+		{
+			return 0;
+		}
+
+		[[nodiscard]] size_t count_owned_arg_bytes(std::shared_ptr<egfx::mesh_definition const> const& mesh)
+		{
+			return count_owned_bytes(mesh);
+		}
+	}
+
 	delete_entity::delete_entity(map_entity const& e)
 		: id(e.get_id())
 		, previous_parent(e.get_parent()->get_id())
-		, serialized_state(nullptr, &std::fclose)
 	{
 
 	}
 
+	size_t delete_entity::get_memory_size() const noexcept
+	{
+		return sizeof(*this) + serialized_state.capacity();
+	}
+
 	void delete_entity::apply(map& current_map)
 	{
 		do_delete(current_map, false);
@@ -32,49 +52,48 @@ namespace ot::dedit::action
 		map_entity* const parent_entity = current_map.find_entity(previous_parent);
 		if (parent_entity == nullptr)
 		{
-			console::error(std::format("Could not undo 'delete_brush' action: parent entity '{}' not found", as_int(id)));
+			console::error("Could not undo 'delete_brush' action: parent entity '{}' not found", as_int(id));
 			return;
 		}
 
-		if (!serialize::fread(current_map, *parent_entity, serialized_state.get()))
+		serialized_state.rewind();
+		if (!serialize::fread(current_map, *parent_entity, serialized_state))
 		{
-			console::error(std::format("Could not undo 'delete_brush' action: failed to deserialize brush '{}'", as_int(id)));
+			console::error("Could not undo 'delete_brush' action: failed to deserialize brush '{}'", as_int(id));
 			return;
 		}
+
+		// Redoing writes the entities again, the state is not needed until then
+		serialized_state.clear();
+		serialized_state.shrink_to_fit();
 	}
 
 	void delete_entity::do_delete(map& current_map, bool is_redo)
 	{
-		std::FILE* f;
-		errno_t const err = tmpfile_s(&f);
-		if (err != 0)
-		{
-			console::error("Could not apply 'delete_entity' action: temporary buffer for preserving state could not be acquired");
-			return;
-		}
-
-		serialized_state.reset(f);
+		// Redoing writes the same entities again over the previous state
+		serialized_state.clear();
 
 		map_entity* const b = current_map.find_entity(id);
 		if (b == nullptr)
 		{
-			console::error(std::format("Could not apply 'delete_entity' action: entity '{}' not found", as_int(id)));
+			console::error("Could not apply 'delete_entity' action: entity '{}' not found", as_int(id));
 			return;
 		}
 
 		std::string_view const type_name = as_string(b->get_type());
 
-		if (!serialize::fwrite(*b, serialized_state.get()))
+		if (!serialize::fwrite(*b, serialized_state))
 		{
-			console::error(std::format("Could not apply 'delete_entity' action: failed to serialize entity '{}'", as_int(id)));
+			console::error("Could not apply 'delete_entity' action: failed to serialize entity '{}'", as_int(id));
 			return;
 		}
 
-		fseek(serialized_state.get(), 0, SEEK_SET);
+		// The state is kept for as long as the action is in the history, without the room left by its growth
+		serialized_state.shrink_to_fit();
 
 		current_map.delete_entity(id);
 		if (!is_redo)
-			console::log(std::format("Deleted {} {}", type_name, as_int(id)));
+			console::log("Deleted {} {}", type_name, as_int(id));
 	}
 		
 	template<typename EntityType, typename... Args>
@@ -95,6 +114,7 @@ namespace ot::dedit::action
 		if (!id)
 			throw std::logic_error("spawn_entity::undo called before apply");
 		current_map.delete_entity(*id);
+		measure_owned_args();
 	}
 
 	template<typename EntityType, typename... Args>
@@ -110,7 +130,7 @@ namespace ot::dedit::action
 		map_entity* const parent = current_map.find_entity(parent_id);
 		if (parent == nullptr)
 		{
-			console::error(std::format("Failed to spawn {}: parent id '{}' not found", type_name, as_int(parent_id)));
+			console::error("Failed to spawn {}: parent id '{}' not found", type_name, as_int(parent_id));
 			return;
 		}
 
@@ -119,8 +139,16 @@ namespace ot::dedit::action
 			current_map.make_entity<EntityType>(*id, *parent, std::get<Is>(extra_args)...);
 		}(std::index_sequence_for<Args...>{});
 		
+		measure_owned_args();
 		if (!is_redo)
-			console::log(std::format("Created {} {} under {}", type_name, as_int(*id), parent->get_name()));
+			console::log("Created {} {} under {}", type_name, as_int(*id), parent->get_name());
+	}
+
+	template<typename EntityType, typename... Args>
+	void spawn_entity<EntityType, Args...>::measure_owned_args()
+	{
+		// The spawned entity shares its arguments, they only cost the history once it is undone
+		owned_size = std::apply([](Args const&... args) { return (size_t(0) + ... + count_owned_arg_bytes(args)); }, extra_args);
 	}
 
 	spawn_brush::spawn_brush(entity_id parent_id, std::shared_ptr<egfx::mesh_definition const> mesh_def)
@@ -150,11 +178,12 @@ namespace ot::dedit::action
 		map_entity* const e = current_map.find_entity(get_id());
 		if (e == nullptr)
 		{
-			console::error(std::format("Could not apply action: entity '{}' not found", as_int(get_id())));
+			console::error("Could not apply action: entity '{}' not found", as_int(get_id()));
 			return;
 		}
 
 		do_apply(*e, false);
+		current_map.on_entity_changed(get_id());
 	}
 
 	void single_entity::redo(map& current_map)
@@ -162,11 +191,12 @@ namespace ot::dedit::action
 		map_entity* const e = current_map.find_entity(get_id());
 		if (e == nullptr)
 		{
-			console::error(std::format("Could not redo action: entity '{}' not found", as_int(get_id())));
+			console::error("Could not redo action: entity '{}' not found", as_int(get_id()));
 			return;
 		}
 
 		do_apply(*e, true);
+		current_map.on_entity_changed(get_id());
 	}
 
 	void single_entity::undo(map& current_map)
@@ -174,6 +204,7 @@ namespace ot::dedit::action
 		map_entity* const e = current_map.find_entity(get_id());
 		assert(e != nullptr);
 		do_undo(*e);
+		current_map.on_entity_changed(get_id());
 	}
 
 	set_entity_position::set_entity_position(map_entity const& e, math::point3f point)
@@ -256,7 +287,7 @@ namespace ot::dedit::action
 		map_entity* const e = current_map.find_entity(e_id);
 		if (e == nullptr)
 		{
-			console::error(std::format("Could not apply action: entity '{}' not found", as_int(e_id)));
+			console::error("Could not apply action: entity '{}' not found", as_int(e_id));
 			return;
 		}
 
@@ -265,7 +296,7 @@ namespace ot::dedit::action
 		auto const found_it = std::ranges::find(objects, object_id, &egfx::object_ref::get_object_id);
 		if (found_it == objects.end())
 		{
-			console::error(std::format("Could not apply action: object '{}' under entity '{}' not found", as_int(object_id), as_int(e_id)));
+			console::error("Could not apply action: object '{}' under entity '{}' not found", as_int(object_id), as_int(e_id));
 			return;
 		}
 
@@ -277,7 +308,7 @@ namespace ot::dedit::action
 		map_entity* const e = current_map.find_entity(e_id);
 		if (e == nullptr)
 		{
-			console::error(std::format("Could not redo action: entity '{}' not found", as_int(e_id)));
+			console::error("Could not redo action: entity '{}' not found", as_int(e_id));
 			return;
 		}
 
@@ -286,7 +317,7 @@ namespace ot::dedit::action
 		auto const found_it = std::ranges::find(objects, object_id, &egfx::object_ref::get_object_id);
 		if (found_it == objects.end())
 		{
-			console::error(std::format("Could not redo action: object '{}' under entity '{}' not found", as_int(object_id), as_int(e_id)));
+			console::error("Could not redo action: object '{}' under entity '{}' not found", as_int(object_id), as_int(e_id));
 			return;
 		}
 
@@ -298,7 +329,7 @@ namespace ot::dedit::action
 		map_entity* const e = current_map.find_entity(e_id);
 		if (e == nullptr)
 		{
-			console::error(std::format("Could not undo action: entity '{}' not found", as_int(e_id)));
+			console::error("Could not undo action: entity '{}' not found", as_int(e_id));
 			return;
 		}
 
@@ -307,7 +338,7 @@ namespace ot::dedit::action
 		auto const found_it = std::ranges::find(objects, object_id, &egfx::object_ref::get_object_id);
 		if (found_it == objects.end())
 		{
-			console::error(std::format("Could not undo action: object '{}' under entity '{}' not found", as_int(object_id), as_int(e_id)));
+			console::error("Could not undo action: object '{}' under entity '{}' not found", as_int(object_id), as_int(e_id));
 			return;
 		}
 
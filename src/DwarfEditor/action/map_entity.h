@@ -3,6 +3,7 @@
 #include "base.h"
 
 #include "map.fwd.h"
+#include "serialize/byte_stream.h"
 
 #include "core/uptr.h"
 
@@ -13,7 +14,6 @@
 #include "math/quaternion.h"
 #include "math/transform_matrix.h"
 
-#include <cstdio>
 #include <optional>
 #include <memory>
 
@@ -23,7 +23,7 @@ namespace ot::dedit::action
 	{
 		entity_id id;
 		entity_id previous_parent;
-		uptr<std::FILE, int(*)(std::FILE*)> serialized_state;
+		serialize::byte_stream serialized_state; // the entity and its children as they were before being deleted
 
 		void do_delete(map& current_map, bool is_redo);
 
@@ -34,6 +34,8 @@ namespace ot::dedit::action
 
 	public:
 		delete_entity(map_entity const& e);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override;
 	};
 
 	template<typename EntityType, typename... Args>
@@ -42,8 +44,10 @@ namespace ot::dedit::action
 		std::optional<entity_id> id;
 		entity_id parent_id;
 		std::tuple<Args...> extra_args;
+		size_t owned_size = 0; // bytes of the arguments which only the action keeps alive, such as the mesh of an undone brush
 
 		void do_spawn(map& current_map, bool is_redo);
+		void measure_owned_args();
 
 	public:
 		template<typename... ConstructorArgs>
@@ -57,6 +61,8 @@ namespace ot::dedit::action
 		virtual void apply(map& current_map) override;
 		virtual void redo(map& current_map) override;
 		virtual void undo(map& current_map) override;
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this) + owned_size; }
 	};
 
 	extern template class spawn_entity<brush_entity, std::shared_ptr<egfx::mesh_definition const>>;
@@ -105,6 +111,8 @@ namespace ot::dedit::action
 
 	public:
 		set_entity_position(map_entity const& b, math::point3f point);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this); }
 	};
 
 	class set_entity_rotation : public single_entity
@@ -118,6 +126,8 @@ namespace ot::dedit::action
 
 	public:
 		set_entity_rotation(map_entity const& e, math::quaternion rot);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this); }
 	};
 
 	class set_entity_scale : public single_entity
@@ -131,6 +141,8 @@ namespace ot::dedit::action
 
 	public:
 		set_entity_scale(map_entity const& e, math::scales s);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this); }
 	};
 
 	class single_object : public base
@@ -164,5 +176,7 @@ namespace ot::dedit::action
 
 	public:
 		set_object_casts_shadows(egfx::object_cref object, bool new_value);
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this); }
 	};
 }
@@ -0,0 +1,25 @@
+#include "memory_size.h"
+
+#include "egfx/mesh_definition.h"
+
+#include <unordered_set>
+
+namespace ot::dedit::action
+{
+	size_t count_owned_bytes(std::shared_ptr<egfx::mesh_definition const> const& mesh)
+	{
+		if (mesh == nullptr || mesh.use_count() > 1)
+			return 0;
+
+		std::unordered_set<void const*> counted_chunks;
+		return sizeof(egfx::mesh_definition) + mesh->count_bytes(counted_chunks);
+	}
+
+	size_t count_unshared_bytes(egfx::mesh_definition const& kept, egfx::mesh_definition const& current)
+	{
+		// Meshes share the chunks an edit did not write to, only the others are kept alive by the history
+		std::unordered_set<void const*> counted_chunks;
+		(void)current.count_bytes(counted_chunks);
+		return sizeof(egfx::mesh_definition) + kept.count_bytes(counted_chunks);
+	}
+}
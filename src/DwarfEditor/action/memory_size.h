@@ -0,0 +1,15 @@
+#pragma once
+
+#include "egfx/mesh_definition.fwd.h"
+
+#include "core/size_t.h"
+
+#include <memory>
+
+namespace ot::dedit::action
+{
+	// Bytes of the mesh which 'mesh' alone keeps alive, 0 when the mesh has other owners such as a brush
+	[[nodiscard]] size_t count_owned_bytes(std::shared_ptr<egfx::mesh_definition const> const& mesh);
+	// Bytes of 'kept' which 'current' does not share, what keeping a previous version of a mesh costs
+	[[nodiscard]] size_t count_unshared_bytes(egfx::mesh_definition const& kept, egfx::mesh_definition const& current);
+}
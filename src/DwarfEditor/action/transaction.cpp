@@ -0,0 +1,46 @@
+#include "transaction.h"
+
+#include "map.h"
+
+namespace ot::dedit::action
+{
+	transaction::transaction(std::vector<fwd_uptr<base>> actions)
+		: actions(std::move(actions))
+	{
+
+	}
+
+	void transaction::push_action(fwd_uptr<base> action)
+	{
+		actions.push_back(std::move(action));
+	}
+
+	size_t transaction::get_memory_size() const noexcept
+	{
+		size_t size = sizeof(*this) + actions.capacity() * sizeof(fwd_uptr<base>);
+		for (auto const& a : actions)
+			size += a->get_memory_size();
+		return size;
+	}
+
+	void transaction::apply(map& current_map)
+	{
+		entity_change_batch const batch(current_map);
+		for (auto& a : actions)
+			a->apply(current_map);
+	}
+
+	void transaction::redo(map& current_map)
+	{
+		entity_change_batch const batch(current_map);
+		for (auto& a : actions)
+			a->redo(current_map);
+	}
+
+	void transaction::undo(map& current_map)
+	{
+		entity_change_batch const batch(current_map);
+		for (auto it = actions.rbegin(); it != actions.rend(); ++it)
+			(*it)->undo(current_map);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "base.h"
+#include "accumulator.h"
+
+#include "map.fwd.h"
+
+#include "core/uptr.h"
+#include "core/size_t.h"
+
+#include <vector>
+
+namespace ot::dedit::action
+{
+	// Actions applied together and undone together, as a single step of the history
+	// Entity changes are batched on the map, so an entity changed by several of the actions is only updated once
+	class transaction : public base, public accumulator
+	{
+		std::vector<fwd_uptr<base>> actions;
+
+	public:
+		transaction() = default;
+		explicit transaction(std::vector<fwd_uptr<base>> actions);
+
+		virtual void push_action(fwd_uptr<base> action) override;
+
+		[[nodiscard]] bool empty() const noexcept { return actions.empty(); }
+		[[nodiscard]] size_t size() const noexcept { return actions.size(); }
+
+		// Actions are applied and redone in the order they were pushed, and undone in reverse
+		virtual void apply(map& current_map) override;
+		virtual void redo(map& current_map) override;
+		virtual void undo(map& current_map) override;
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override;
+	};
+}
@@ -1,6 +1,7 @@
 #include "application/action_handler.h"
 
 #include "action/brush.h"
+#include "action/transaction.h"
 
 #include "input.h"
 #include "console.h"
@@ -41,52 +42,51 @@ namespace ot::dedit
 		if (current_actions.empty())
 			return;
 
-		for (auto& data : current_actions)
+		// The actions pushed since the last call are a single step of the history, undone and redone together
+		action_data data;
+		if (current_actions.size() == 1)
 		{
-			data.action->apply(current_map);
+			data = std::move(current_actions.front());
 		}
+		else
+		{
+			std::vector<fwd_uptr<action::base>> grouped;
+			grouped.reserve(current_actions.size());
+			for (auto& current : current_actions)
+				grouped.push_back(std::move(current.action));
 
-		applied_actions.insert(applied_actions.end(), std::make_move_iterator(current_actions.begin()), std::make_move_iterator(current_actions.end()));
+			data = { fwd_uptr<action::base>(new action::transaction(std::move(grouped))), current_actions.back().id };
+		}
 		current_actions.clear();
-		undone_actions.clear();
+
+		data.action->apply(current_map);
+		actions.push(std::move(data.action), data.id);
 	}
 
 	void action_handler::clear()
 	{
 		current_actions.clear();
-		applied_actions.clear();
-		undone_actions.clear();
+		actions.clear();
 	}
 
 	void action_handler::redo_latest(map& current_map)
 	{
 		assert(has_redo());
 
-		auto& data = undone_actions.back();
-		data.action->redo(current_map);
-		applied_actions.push_back(std::move(data));
-		undone_actions.pop_back();
+		actions.get_redo().redo(current_map);
+		actions.on_redone();
 	}
 
 	void action_handler::undo_latest(map& current_map)
 	{
 		assert(has_undo());
 
-		auto& data = applied_actions.back();
-		data.action->undo(current_map);
-		undone_actions.push_back(std::move(data));
-		applied_actions.pop_back();
+		actions.get_undo().undo(current_map);
+		actions.on_undone();
 	}
 
 	int action_handler::get_last_action() const noexcept
 	{
-		if (applied_actions.empty())
-		{
-			return 0;
-		}
-		else
-		{
-			return applied_actions.back().id;
-		}
+		return actions.get_last_id();
 	}
 }
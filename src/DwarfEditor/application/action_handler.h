@@ -1,6 +1,7 @@
 #pragma once
 
 #include "action/accumulator.h"
+#include "action/history.h"
 
 #include "map.h"
 
@@ -20,8 +21,7 @@ namespace ot::dedit
 		};
 
 		std::vector<action_data> current_actions;
-		std::vector<action_data> applied_actions;
-		std::vector<action_data> undone_actions;
+		action::history actions;
 
 		int next_id = 0;
 
@@ -30,6 +30,7 @@ namespace ot::dedit
 		
 		bool handle_keyboard_event(SDL_KeyboardEvent const& key, map& current_map);
 		
+		// Applies the actions pushed since the last call as a single transaction
 		void apply_actions(map& current_map);
 		void undo_latest(map& current_map);
 		void redo_latest(map& current_map);
@@ -38,8 +39,12 @@ namespace ot::dedit
 		// This is used by ex: the map handler to tell if actions were applied since the map was last saved
 		[[nodiscard]] int get_last_action() const noexcept;
 
-		[[nodiscard]] bool has_undo() const noexcept { return !applied_actions.empty(); }
-		[[nodiscard]] bool has_redo() const noexcept { return !undone_actions.empty(); }
+		[[nodiscard]] bool has_undo() const noexcept { return actions.has_undo(); }
+		[[nodiscard]] bool has_redo() const noexcept { return actions.has_redo(); }
+
+		// Undo history, bounded by a memory budget
+		[[nodiscard]] action::history& get_history() noexcept { return actions; }
+		[[nodiscard]] action::history const& get_history() const noexcept { return actions; }
 
 		void clear();
 	};
@@ -1,12 +1,15 @@
 #include "application.h"
 
 #include "input.h"
+#include "brush_mesh_cache.h"
 #include "selection/base_context.h"
 #include "imgui/module.h"
 
 #include "egfx/scene.h"
 #include "egfx/object/camera.h"
 
+#include "core/profiler.h"
+
 #include "Ogre/ConfigOptionMap.h"
 #include "Ogre/PlatformInformation.h"
 #include "Ogre/RenderSystem.h"
@@ -61,7 +64,8 @@ namespace ot::dedit
 		, main_window(std::move(window))
 		, graphics(graphics)
 		, main_scene(graphics.create_scene(std::string(program_config.get_scene().get_workspace()), get_number_threads() - 1))
-		, current_map(main_scene.get_root_node())
+		, current_map(main_scene)
+		, mesh_repo(get_brush_mesh_cache().get_definitions())
 	{
 		if (auto const maybe_ambiant = program_config.get_scene().get_ambient_light())
 		{
@@ -88,22 +92,44 @@ namespace ot::dedit
 		auto last_frame = std::chrono::steady_clock::now();
 		auto current_frame = last_frame;
 
+		profiler::set_thread_name("Main");
+
 		while (!wants_quit || !map_handler::can_quit()) 
 		{
-			start_frame();
+			OT_PROFILE_FRAME();
+
+			{
+				OT_PROFILE_ZONE("start_frame");
+				start_frame();
+			}
 		
-			handle_events();
+			{
+				OT_PROFILE_ZONE("handle_events");
+				handle_events();
+			}
 
-			pre_update();
+			{
+				OT_PROFILE_ZONE("pre_update");
+				pre_update();
+			}
 
-			update(current_frame - last_frame);
+			{
+				OT_PROFILE_ZONE("update");
+				update(current_frame - last_frame);
+			}
 
-			if (!render())
 			{
-				quit();
+				OT_PROFILE_ZONE("render");
+				if (!render())
+				{
+					quit();
+				}
 			}
 
-			end_frame();
+			{
+				OT_PROFILE_ZONE("end_frame");
+				end_frame();
+			}
 
 			last_frame = std::exchange(current_frame, std::chrono::steady_clock::now());
 		}
@@ -232,20 +258,80 @@ namespace ot::dedit
 		update_im3d();
 	}
 
+	namespace
+	{
+		constexpr math::milliseconds csg_frame_budget{ 4.f };
+		constexpr math::milliseconds brush_chunk_frame_budget{ 4.f };
+
+		// Outlines the polygons of the csg result, while it is enabled from the debug menu
+		void draw_csg_result(map const& m)
+		{
+			egfx::csg::incremental_evaluator const& csg = m.get_csg();
+			Im3d::PushColor(Im3d::Color_Green);
+			m.get_root().for_each_recursive([&csg](map_entity const& e)
+			{
+				if (e.get_type() != entity_type::brush || !csg.contains(as_csg_id(e.get_id())))
+					return false;
+
+				for (egfx::csg::polygon const& p : csg.get_polygons(as_csg_id(e.get_id())))
+				{
+					Im3d::BeginLineLoop();
+					for (math::point3f const& v : p.vertices)
+						Im3d::Vertex(v);
+					Im3d::End();
+				}
+				return false;
+			});
+			Im3d::PopColor();
+		}
+	}
+
 	void application::update(math::seconds dt)
 	{
-		menu::update();
+		{
+			OT_PROFILE_ZONE("menu");
+			menu::update();
+		}
 
-		map_handler::update();
+		{
+			OT_PROFILE_ZONE("map_handler");
+			map_handler::update();
+		}
 
 		camera_controller::update(dt);
 
 		input::frame_input input;
 		input.mouse_action = mouse.get_action();
 
-		selection_context->update(selection_actions, input);
+		{
+			OT_PROFILE_ZONE("selection_context");
+			selection_context->update(selection_actions, input);
+		}
+
+		{
+			OT_PROFILE_ZONE("apply_actions");
+			selection_actions.apply_actions(current_map);
+		}
+
+		// The rest of the csg is evaluated over the next frames
+		if (current_map.is_csg_enabled())
+		{
+			OT_PROFILE_ZONE("update_csg");
+			current_map.update_csg(csg_frame_budget);
+			draw_csg_result(current_map);
+		}
 
-		selection_actions.apply_actions(current_map);
+		{
+			OT_PROFILE_ZONE("update_static_brushes");
+			current_map.update_static_brushes(dt, brush_chunk_frame_budget);
+		}
+
+		{
+			OT_PROFILE_ZONE("update_brush_culling");
+			egfx::camera_cref const camera = main_scene.get_camera();
+			math::frustum const view = math::make_perspective_frustum(camera.get_transformation(), camera.get_rad_fov_y(), camera.get_aspect_ratio(), camera.get_z_near(), camera.get_z_far());
+			current_map.update_brush_culling(camera.get_position(), view);
+		}
 	}
 
 	namespace
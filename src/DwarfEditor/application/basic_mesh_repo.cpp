@@ -3,6 +3,7 @@
 #include "math/plane.h"
 
 #include "egfx/mesh_definition.h"
+#include "egfx/mesh_definition_cache.h"
 
 namespace ot::dedit
 {
@@ -74,4 +75,14 @@ namespace ot::dedit
 	{
 
 	}
+
+	basic_mesh_repo::basic_mesh_repo(egfx::mesh_definition_cache& cache)
+		: cube(cache.get(cube_planes))
+		, octagonal_prism(cache.get(octagon_planes))
+		, hex_prism(cache.get(hex_planes))
+		, tri_prism(cache.get(tri_planes))
+		, square_pyramid(cache.get(pyramid_planes))
+	{
+
+	}
 }
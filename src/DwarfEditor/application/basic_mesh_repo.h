@@ -16,6 +16,8 @@ namespace ot::dedit
 
 	public:
 		basic_mesh_repo();
+		// Shares the shapes with the brushes loaded through the cache
+		explicit basic_mesh_repo(egfx::mesh_definition_cache& cache);
 
 		std::shared_ptr<egfx::mesh_definition const> get_cube() const noexcept { return cube; }
 		std::shared_ptr<egfx::mesh_definition const> get_octagonal_prism() const noexcept { return octagonal_prism; }
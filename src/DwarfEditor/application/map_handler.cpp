@@ -3,6 +3,7 @@
 #include "application.h"
 #include "console.h"
 #include "platform/file_dialog.h"
+#include "platform/mapped_file.h"
 #include "serialize/serialize_map.h"
 #include "input.h"
 
@@ -128,7 +129,7 @@ namespace ot::dedit
 			if (ec)
 			{
 				if (ec != std::errc::operation_canceled)
-					console::error(std::format("Open file failed ({})", ec.message()));
+					console::error("Open file failed ({})", ec.message());
 				return;
 			}
 
@@ -137,19 +138,23 @@ namespace ot::dedit
 			acc.clear();
 			saved_action = 0;
 
-			std::FILE* file = std::fopen(file_path.c_str(), "rb");
-			assert(file != nullptr);
-			if (!serialize::fread(m, file))
+			auto const file = platform::map_file(file_path);
+			if (!file)
+			{
+				console::error("Could not open '{}' ({})", file_path, file.error().message());
+				return;
+			}
+
+			if (!serialize::read(m, file->get_data()))
 			{
 				m.clear();
-				console::error(std::format("Failed loading map '{}'", file_path));
+				console::error("Failed loading map '{}'", file_path);
 			} 
 			else
 			{
 				app.map_path = std::move(file_path);
-				console::log(std::format("Opened map '{}'", app.map_path));
+				console::log("Opened map '{}'", app.map_path);
 			}
-			std::fclose(file);
 		});
 	}
 
@@ -174,18 +179,18 @@ namespace ot::dedit
 			std::FILE* file = std::fopen(app.map_path.c_str(), "wb");
 			if (file == nullptr)
 			{
-				console::error(std::format("Could not open '{}' for writing", app.map_path));
+				console::error("Could not open '{}' for writing", app.map_path);
 				return;
 			}
 
 			if (!serialize::fwrite(m, file))
 			{
-				console::error(std::format("Failed to save map '{}'", app.map_path));
+				console::error("Failed to save map '{}'", app.map_path);
 				std::fclose(file);
 			} 
 			else
 			{
-				console::log(std::format("Saved map '{}'", app.map_path));
+				console::log("Saved map '{}'", app.map_path);
 				saved_action = acc.get_last_action();
 				std::fclose(file);
 				do_post_save_operation();
@@ -209,26 +214,26 @@ namespace ot::dedit
 			if (ec)
 			{
 				if (ec != std::errc::operation_canceled)
-					console::error(std::format("Save file failed ({})", ec.message()));
+					console::error("Save file failed ({})", ec.message());
 				return;
 			}
 
 			std::FILE* file = std::fopen(file_path.c_str(), "wb");
 			if (file == nullptr)
 			{
-				console::error(std::format("Could not open '{}' for writing", file_path));
+				console::error("Could not open '{}' for writing", file_path);
 				return;
 			}
 
 			if (!serialize::fwrite(m, file))
 			{
-				console::error(std::format("Failed to save map as '{}'", file_path));
+				console::error("Failed to save map as '{}'", file_path);
 				std::fclose(file);
 			} 
 			else
 			{
 				app.map_path = std::move(file_path);
-				console::log(std::format("Saved map as '{}'", app.map_path));
+				console::log("Saved map as '{}'", app.map_path);
 				saved_action = acc.get_last_action();
 				std::fclose(file);
 				do_post_save_operation();
@@ -6,10 +6,13 @@
 #include "input.h"
 #include "config.h"
 #include "console.h"
+#include "brush_mesh_cache.h"
 
 #include "menu/console_window.h"
 #include "menu/about_window.h"
 
+#include "egfx/imgui/profiler_window.h"
+
 #include "action/map_entity.h"
 
 #include <imgui.h>
@@ -71,6 +74,12 @@ namespace ot::dedit
 			return true;
 		}
 
+		if (is_key_press(e, SDLK_p, input::keyboard::mod_group::alt))
+		{
+			draw_profiler_window = !draw_profiler_window;
+			return true;
+		}
+
 		if (is_key_press(e, SDLK_b, input::keyboard::mod_combo::ctrl_alt))
 		{
 			acc.emplace_action<action::spawn_brush>(entity_id::root, mesh_repo.get_cube());
@@ -88,7 +97,7 @@ namespace ot::dedit
 
 		if (!draw_console_window)
 		{
-			size_t const error_count = std::ranges::count(console::get_logs(), console::level_type::error, &console::log_data::level);
+			size_t const error_count = console::get_log_count(console::level_type::error);
 			if (error_count > last_error_count)
 				draw_console_window = true;
 			last_error_count = error_count;
@@ -104,6 +113,11 @@ namespace ot::dedit
 			about_window::draw(&draw_about_window);
 		}
 
+		if (draw_profiler_window)
+		{
+			egfx::imgui::profiler_window::draw(&draw_profiler_window);
+		}
+
 		if(draw_imgui_demo)
 		{
 			ImGui::ShowDemoWindow(&draw_imgui_demo);
@@ -166,12 +180,24 @@ namespace ot::dedit
 				acc.redo_latest(m);
 			}
 
+			ImGui::Separator();
+
+			action::history& history = acc.get_history();
+			float constexpr mebibyte = 1024.f * 1024.f;
+			ImGui::Text("History: %zu undo, %zu redo, %zu dropped", history.get_undo_count(), history.get_redo_count(), history.get_dropped_count());
+			ImGui::Text("History memory: %.1f of %.0f MiB", static_cast<float>(history.get_memory_usage()) / mebibyte, static_cast<float>(history.get_memory_budget()) / mebibyte);
+
+			int budget = static_cast<int>(history.get_memory_budget() >> 20);
+			if (ImGui::SliderInt("Budget (MiB)", &budget, 1, 4096))
+				history.set_memory_budget(static_cast<size_t>(budget) << 20);
+
 			ImGui::EndMenu();
 		}
 
 		if (ImGui::BeginMenu("Window"))
 		{
 			ImGui::MenuItem("Console", "Alt+O", &draw_console_window);
+			ImGui::MenuItem("Profiler", "Alt+P", &draw_profiler_window);
 
 			ImGui::EndMenu();
 		}
@@ -236,6 +262,74 @@ namespace ot::dedit
 			ImGui::EndMenu();
 		}
 
+		if (ImGui::BeginMenu("Debug"))
+		{
+			if (ImGui::BeginMenu("Brush Mesh Cache"))
+			{
+				brush_mesh_cache& cache = get_brush_mesh_cache();
+				brush_mesh_cache::statistics const stats = cache.get_statistics();
+				ImGui::Text("Definitions: %zu hits, %zu misses, %zu entries", stats.definitions.hits, stats.definitions.misses, stats.definitions.entries);
+				ImGui::Text("Render meshes: %zu hits, %zu misses, %zu entries", stats.mesh_hits, stats.mesh_misses, stats.meshes);
+
+				if (ImGui::MenuItem("Reset Counters"))
+				{
+					cache.reset_statistics();
+				}
+
+				ImGui::EndMenu();
+			}
+
+			if (ImGui::BeginMenu("Scene Nodes"))
+			{
+				map::node_counts const counts = m.count_nodes();
+				ImGui::Text("Static: %zu", counts.static_nodes);
+				ImGui::Text("Dynamic: %zu", counts.dynamic_nodes);
+
+				ImGui::EndMenu();
+			}
+
+			if (ImGui::BeginMenu("Brush Chunks"))
+			{
+				egfx::chunked_meshes const& chunks = m.get_brush_chunks();
+				ImGui::Text("Chunked brushes: %zu", m.get_chunked_brush_count());
+				ImGui::Text("Chunk draw calls: %zu", chunks.get_draw_count());
+				ImGui::Text("Chunks waiting to be built: %zu", chunks.get_pending_count());
+				ImGui::Text("Chunk size: %.1f", chunks.get_grid().get_chunk_size());
+
+				ImGui::EndMenu();
+			}
+
+			if (ImGui::BeginMenu("Brush CSG"))
+			{
+				bool enabled = m.is_csg_enabled();
+				if (ImGui::MenuItem("Show Result", "", &enabled))
+					m.set_csg_enabled(enabled);
+
+				egfx::csg::incremental_evaluator const& csg = m.get_csg();
+				ImGui::Text("Brushes: %zu", csg.size());
+				ImGui::Text("Waiting for evaluation: %zu", csg.get_dirty_count());
+
+				ImGui::EndMenu();
+			}
+
+			if (ImGui::BeginMenu("Brush Culling"))
+			{
+				bool enabled = m.is_brush_culling_enabled();
+				if (ImGui::MenuItem("Enabled", "", &enabled))
+					m.set_brush_culling(enabled);
+
+				brush_visibility const& visibility = m.get_brush_visibility();
+				ImGui::Text("Culled brushes: %zu", m.get_culled_brush_count());
+				ImGui::Text("Culled chunks: %zu", m.get_culled_chunk_count());
+				ImGui::Text("Cells: %zu of %.1f, %zu solid", visibility.get_cell_count(), visibility.get_cell_size(), visibility.get_solid_cell_count());
+				ImGui::Text("Visible sets: %zu", visibility.get_visible_set_count());
+
+				ImGui::EndMenu();
+			}
+
+			ImGui::EndMenu();
+		}
+
 		if (ImGui::BeginMenu("Help"))
 		{
 			ImGui::MenuItem("About", "", &draw_about_window, about_window::has_content());
@@ -272,10 +366,10 @@ namespace ot::dedit
 			ImGui::Text("Unsaved map%s", map_handler.is_map_dirty() ? " (*)" : "");
 		}
 
-		std::span<console::log_data const> const logs = console::get_logs();
-		if (!logs.empty())
+		console::log_range const logs = console::get_logs();
+		console::log_data last_log;
+		if (!logs.empty() && console::read_log(logs.end - 1, last_log))
 		{
-			console::log_data const& last_log = logs.back();
 
 			ImGui::SameLine();
 			ImGui::Separator();
@@ -286,7 +380,8 @@ namespace ot::dedit
 			if (color)
 				ImGui::PushStyleColor(ImGuiCol_Text, *color);
 
-			ImGui::TextUnformatted(last_log.message.c_str());
+			std::string_view const message = last_log.get_message();
+			ImGui::TextUnformatted(message.data(), message.data() + message.size());
 
 			if (ImGui::IsItemClicked())
 				draw_console_window = true;
@@ -18,6 +18,7 @@ namespace ot::dedit
 
 		bool draw_console_window = false;
 		bool draw_about_window = false;
+		bool draw_profiler_window = false;
 		bool draw_imgui_demo = false;
 
 		size_t last_error_count = 0;
@@ -0,0 +1,263 @@
+#include "brush_bvh.h"
+
+#include "math/plane_batch.h"
+
+#include "core/uptr.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace ot::dedit
+{
+	namespace
+	{
+		constexpr uint32_t max_leaf_size = 4;
+
+		math::aabb transform_bounds(math::aabb const& local_bounds, math::transform_matrix const& m) noexcept
+		{
+			math::point3f const min = local_bounds.min();
+			math::point3f const max = local_bounds.max();
+
+			math::aabb bounds{ transform(min, m), {} };
+			for (int corner = 1; corner < 8; ++corner)
+			{
+				math::point3f const p{
+					(corner & 1) ? max.x : min.x,
+					(corner & 2) ? max.y : min.y,
+					(corner & 4) ? max.z : min.z,
+				};
+				bounds.merge(transform(p, m));
+			}
+			return bounds;
+		}
+
+		float get_axis(math::point3f const& p, int axis) noexcept
+		{
+			return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+		}
+
+		// Slab test, with the inverse of the direction precomputed. Returns the distance at which the ray enters the box
+		std::optional<float> intersects(math::aabb const& box, math::point3f const& origin, math::vector3f const& inverse_direction, float max_distance) noexcept
+		{
+			math::point3f const min = box.min();
+			math::point3f const max = box.max();
+
+			float t_min = 0.f;
+			float t_max = max_distance;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float const o = get_axis(origin, axis);
+				float const inv_d = axis == 0 ? inverse_direction.x : axis == 1 ? inverse_direction.y : inverse_direction.z;
+				float t0 = (get_axis(min, axis) - o) * inv_d;
+				float t1 = (get_axis(max, axis) - o) * inv_d;
+				if (t0 > t1)
+					std::swap(t0, t1);
+
+				// NaNs, from a zero direction and an origin on the slab, leave the range untouched
+				t_min = t0 > t_min ? t0 : t_min;
+				t_max = t1 < t_max ? t1 : t_max;
+				if (t_min > t_max)
+					return {};
+			}
+			return t_min;
+		}
+	}
+
+	void brush_bvh::set_brush(entity_id id, std::shared_ptr<egfx::mesh_definition const> mesh, math::transform_matrix const& world_transform)
+	{
+		assert(mesh != nullptr);
+
+		math::aabb const world_bounds = transform_bounds(mesh->get_bounds(), world_transform);
+
+		auto const [it, inserted] = item_indices.try_emplace(id, items.size());
+		if (inserted)
+		{
+			items.push_back(item{ id, ot::as_movable(mesh), invert(world_transform), world_bounds });
+			needs_rebuild = true;
+		}
+		else
+		{
+			item& existing = items[it->second];
+			existing.mesh = ot::as_movable(mesh);
+			existing.world_to_local = invert(world_transform);
+			existing.world_bounds = world_bounds;
+			needs_refit = true;
+		}
+	}
+
+	void brush_bvh::remove_brush(entity_id id)
+	{
+		auto const it = item_indices.find(id);
+		if (it == item_indices.end())
+			return;
+
+		size_t const removed = it->second;
+		item_indices.erase(it);
+		if (removed != items.size() - 1)
+		{
+			items[removed] = ot::as_movable(items.back());
+			item_indices[items[removed].id] = removed;
+		}
+		items.pop_back();
+		needs_rebuild = true;
+	}
+
+	void brush_bvh::clear() noexcept
+	{
+		items.clear();
+		item_indices.clear();
+		nodes.clear();
+		needs_rebuild = false;
+		needs_refit = false;
+	}
+
+	uint32_t brush_bvh::build_node(uint32_t first, uint32_t count)
+	{
+		uint32_t const node_index = static_cast<uint32_t>(nodes.size());
+		nodes.push_back(node{ items[first].world_bounds, first, count });
+
+		math::aabb centers{ items[first].world_bounds.position, {} };
+		for (uint32_t i = first + 1; i < first + count; ++i)
+		{
+			nodes[node_index].bounds.merge(items[i].world_bounds);
+			centers.merge(items[i].world_bounds.position);
+		}
+
+		if (count <= max_leaf_size)
+			return node_index;
+
+		// Median split along the axis where the centers are the most spread out
+		math::vector3f const spread = centers.half_size;
+		int const axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+		uint32_t const half = count / 2;
+		auto const begin = items.begin() + first;
+		std::nth_element(begin, begin + half, begin + count, [axis](item const& lhs, item const& rhs)
+		{
+			return get_axis(lhs.world_bounds.position, axis) < get_axis(rhs.world_bounds.position, axis);
+		});
+
+		build_node(first, half);
+		uint32_t const second_child = build_node(first + half, count - half);
+		nodes[node_index].first = second_child;
+		nodes[node_index].count = 0;
+		return node_index;
+	}
+
+	void brush_bvh::rebuild()
+	{
+		nodes.clear();
+		if (!items.empty())
+		{
+			nodes.reserve(2 * items.size() / max_leaf_size + 1);
+			build_node(0, static_cast<uint32_t>(items.size()));
+		}
+
+		for (size_t i = 0; i < items.size(); ++i)
+			item_indices[items[i].id] = i;
+
+		needs_rebuild = false;
+		needs_refit = false;
+	}
+
+	void brush_bvh::refit()
+	{
+		// Children always come after their parent
+		for (size_t i = nodes.size(); i-- > 0;)
+		{
+			node& n = nodes[i];
+			if (n.count == 0)
+			{
+				n.bounds = nodes[i + 1].bounds;
+				n.bounds.merge(nodes[n.first].bounds);
+			}
+			else
+			{
+				n.bounds = items[n.first].world_bounds;
+				for (uint32_t item_index = n.first + 1; item_index < n.first + n.count; ++item_index)
+					n.bounds.merge(items[item_index].world_bounds);
+			}
+		}
+
+		needs_refit = false;
+	}
+
+	void brush_bvh::update()
+	{
+		if (needs_rebuild)
+			rebuild();
+		else if (needs_refit)
+			refit();
+	}
+
+	std::optional<brush_bvh::hit> brush_bvh::raycast(math::ray const& r, entity_id ignored)
+	{
+		update();
+		if (nodes.empty())
+			return {};
+
+		float constexpr infinity = std::numeric_limits<float>::infinity();
+		math::vector3f const inverse_direction{
+			1.f / r.direction.x,
+			1.f / r.direction.y,
+			1.f / r.direction.z,
+		};
+
+		std::optional<hit> closest;
+		float closest_distance = infinity;
+
+		std::vector<math::plane> face_planes;
+		std::vector<float> face_distances;
+
+		uint32_t stack[64];
+		size_t stack_size = 0;
+		stack[stack_size++] = 0;
+		while (stack_size > 0)
+		{
+			node const& n = nodes[stack[--stack_size]];
+			if (!intersects(n.bounds, r.origin, inverse_direction, closest_distance))
+				continue;
+
+			if (n.count == 0)
+			{
+				uint32_t const first_child = static_cast<uint32_t>(&n - nodes.data()) + 1;
+				stack[stack_size++] = n.first;
+				stack[stack_size++] = first_child;
+				continue;
+			}
+
+			for (uint32_t item_index = n.first; item_index < n.first + n.count; ++item_index)
+			{
+				item const& brush = items[item_index];
+				if (brush.id == ignored || !intersects(brush.world_bounds, r.origin, inverse_direction, closest_distance))
+					continue;
+
+				// Transforms are affine, so distances along the local ray are the same as along the world ray
+				math::ray const local_ray{ transform(r.origin, brush.world_to_local), transform(r.direction, brush.world_to_local) };
+
+				face_planes.clear();
+				for (egfx::face::cref const face : brush.mesh->get_faces())
+					face_planes.push_back(face.get_plane());
+				face_distances.resize(face_planes.size());
+				math::intersect_distances(local_ray, face_planes, face_distances);
+
+				size_t face_index = 0;
+				for (egfx::face::cref const face : brush.mesh->get_faces())
+				{
+					// Parallel faces have a NaN distance
+					float const distance = face_distances[face_index++];
+					if (!(distance >= 0.f && distance < closest_distance))
+						continue;
+
+					if (face.is_on_face(local_ray.origin + local_ray.direction * distance))
+					{
+						closest = hit{ brush.id, face.get_id(), distance };
+						closest_distance = distance;
+					}
+				}
+			}
+		}
+
+		return closest;
+	}
+}
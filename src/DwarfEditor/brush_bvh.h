@@ -0,0 +1,74 @@
+#pragma once
+
+#include "map.fwd.h"
+
+#include "egfx/mesh_definition.h"
+
+#include "math/aabb.h"
+#include "math/ray.h"
+#include "math/transform_matrix.h"
+
+#include "core/size_t.h"
+#include "core/stdint.h"
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace ot::dedit
+{
+	// Bounding volume hierarchy over the world bounds of the brushes of a map, for picking without going through the scene
+	// Adding or removing brushes rebuilds the tree on the next query, moving or reshaping them only refits the existing nodes
+	class brush_bvh
+	{
+	public:
+		struct hit
+		{
+			entity_id id;
+			egfx::face::id face;
+			float distance; // along the ray, in multiples of its direction
+		};
+
+	private:
+		struct item
+		{
+			entity_id id;
+			std::shared_ptr<egfx::mesh_definition const> mesh;
+			math::transform_matrix world_to_local;
+			math::aabb world_bounds;
+		};
+
+		struct node
+		{
+			math::aabb bounds;
+			uint32_t first; // first item of a leaf, or the second child of an inner node. The first child always follows its parent
+			uint32_t count; // number of items of a leaf, 0 for inner nodes
+		};
+
+		std::vector<item> items;
+		std::unordered_map<entity_id, size_t> item_indices;
+		std::vector<node> nodes;
+		bool needs_rebuild = false;
+		bool needs_refit = false;
+
+		uint32_t build_node(uint32_t first, uint32_t count);
+		void rebuild();
+		void refit();
+
+	public:
+		// Adds the brush, or updates its mesh and transform if it is already in the hierarchy
+		void set_brush(entity_id id, std::shared_ptr<egfx::mesh_definition const> mesh, math::transform_matrix const& world_transform);
+		void remove_brush(entity_id id);
+		void clear() noexcept;
+
+		[[nodiscard]] bool contains(entity_id id) const noexcept { return item_indices.contains(id); }
+		[[nodiscard]] size_t size() const noexcept { return items.size(); }
+
+		// Rebuilds or refits the tree if brushes changed since the last query. Queries call it themselves
+		void update();
+
+		// Returns the brush whose faces the ray hits first, ignoring hits behind its origin and the 'ignored' brush
+		[[nodiscard]] std::optional<hit> raycast(math::ray const& r, entity_id ignored = entity_id::root);
+	};
+}
@@ -0,0 +1,85 @@
+#include "brush_mesh_cache.h"
+
+#include "egfx/mesh_definition.h"
+
+#include <algorithm>
+#include <format>
+
+namespace ot::dedit
+{
+	namespace
+	{
+		constexpr size_t min_prune_size = 256;
+	}
+
+	brush_mesh_cache::brush_mesh_cache()
+		: next_prune_size(min_prune_size)
+	{
+
+	}
+
+	std::shared_ptr<egfx::mesh> brush_mesh_cache::get_mesh(std::shared_ptr<egfx::mesh_definition const> const& def)
+	{
+		mesh_entry& entry = meshes[def.get()];
+		if (entry.definition.lock() == def)
+		{
+			if (std::shared_ptr<egfx::mesh> existing = entry.mesh.lock())
+			{
+				++mesh_hits;
+				return existing;
+			}
+		}
+
+		++mesh_misses;
+		auto created = std::make_shared<egfx::mesh>(egfx::create_mesh(std::format("Brush mesh {}", next_mesh_name++), *def));
+		entry = { def, created };
+
+		if (meshes.size() >= next_prune_size)
+			prune_expired();
+
+		return created;
+	}
+
+	bool brush_mesh_cache::has_mesh(egfx::mesh_definition const& def) const
+	{
+		auto const found = meshes.find(&def);
+		return found != meshes.end() && found->second.definition.lock().get() == &def && !found->second.mesh.expired();
+	}
+
+	void brush_mesh_cache::move_mesh(egfx::mesh_definition const& old_def, std::shared_ptr<egfx::mesh_definition const> const& new_def, std::shared_ptr<egfx::mesh> const& m)
+	{
+		auto const found = meshes.find(&old_def);
+		if (found != meshes.end() && found->second.mesh.lock() == m)
+			meshes.erase(found);
+
+		meshes[new_def.get()] = { new_def, m };
+	}
+
+	void brush_mesh_cache::prune_expired()
+	{
+		std::erase_if(meshes, [](auto const& entry)
+		{
+			return entry.second.mesh.expired() || entry.second.definition.expired();
+		});
+
+		next_prune_size = std::max(min_prune_size, meshes.size() * 2);
+	}
+
+	brush_mesh_cache::statistics brush_mesh_cache::get_statistics() const
+	{
+		return { definitions.get_statistics(), mesh_hits, mesh_misses, meshes.size() };
+	}
+
+	void brush_mesh_cache::reset_statistics() noexcept
+	{
+		definitions.reset_statistics();
+		mesh_hits = 0;
+		mesh_misses = 0;
+	}
+
+	brush_mesh_cache& get_brush_mesh_cache()
+	{
+		static brush_mesh_cache cache;
+		return cache;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "egfx/mesh_definition_cache.h"
+#include "egfx/object/mesh.h"
+
+#include "core/size_t.h"
+#include "core/stdint.h"
+
+#include <memory>
+#include <unordered_map>
+
+namespace ot::dedit
+{
+	// Shares the mesh definitions of brushes built from the same planes, and the render meshes of brushes with the same definition
+	// Both are held weakly, and go away with the last brush using them
+	// Render meshes are only created and shared on the main thread, definitions can be built from any thread
+	class brush_mesh_cache
+	{
+		struct mesh_entry
+		{
+			std::weak_ptr<egfx::mesh_definition const> definition; // tells apart a new definition allocated at the address of a destroyed one
+			std::weak_ptr<egfx::mesh> mesh;
+		};
+
+		egfx::mesh_definition_cache definitions;
+		std::unordered_map<egfx::mesh_definition const*, mesh_entry> meshes;
+		size_t next_prune_size;
+		uint64_t next_mesh_name = 0;
+		size_t mesh_hits = 0;
+		size_t mesh_misses = 0;
+
+		void prune_expired();
+
+	public:
+		struct statistics
+		{
+			egfx::mesh_definition_cache::statistics definitions;
+			size_t mesh_hits; // render meshes shared with another brush
+			size_t mesh_misses; // render meshes created
+			size_t meshes; // render meshes remembered, some of which may have been destroyed
+		};
+
+		brush_mesh_cache();
+
+		[[nodiscard]] egfx::mesh_definition_cache& get_definitions() noexcept { return definitions; }
+
+		// The render mesh of the definition, shared with every brush showing the same definition
+		[[nodiscard]] std::shared_ptr<egfx::mesh> get_mesh(std::shared_ptr<egfx::mesh_definition const> const& def);
+		[[nodiscard]] bool has_mesh(egfx::mesh_definition const& def) const;
+		// Makes 'm', which was rewritten in place for 'new_def', the render mesh of 'new_def' instead of 'old_def'
+		void move_mesh(egfx::mesh_definition const& old_def, std::shared_ptr<egfx::mesh_definition const> const& new_def, std::shared_ptr<egfx::mesh> const& m);
+
+		[[nodiscard]] statistics get_statistics() const;
+		void reset_statistics() noexcept;
+	};
+
+	// Shared by every map, so that brushes keep sharing their meshes across loads and undo history
+	[[nodiscard]] brush_mesh_cache& get_brush_mesh_cache();
+}
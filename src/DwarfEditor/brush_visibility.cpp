@@ -0,0 +1,537 @@
+#include "brush_visibility.h"
+
+#include "core/uptr.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace ot::dedit
+{
+	namespace
+	{
+		// Corners of cells on the faces of a brush count as inside it, for cells aligned with the faces to be solid
+		constexpr float solid_epsilon = 1e-4f;
+
+		math::aabb get_world_bounds(egfx::mesh_definition const& mesh, math::transform_matrix const& world_transform)
+		{
+			// Tighter than transforming the local bounds
+			auto const vertices = mesh.get_vertices();
+			math::aabb bounds{ transform((*vertices.begin()).get_position(), world_transform), {} };
+			for (egfx::vertex::cref const v : vertices)
+				bounds.merge(transform(v.get_position(), world_transform));
+			return bounds;
+		}
+
+		// Whether the segment between two points of the grid goes through the inside of the box between 'min' and 'max', not only along its sides
+		[[nodiscard]] bool crosses_inside(std::array<float, 3> from, std::array<float, 3> to, std::array<float, 3> min, std::array<float, 3> max) noexcept
+		{
+			float enter = 0.f;
+			float exit = 1.f;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float const d = to[axis] - from[axis];
+				if (d == 0.f)
+				{
+					if (from[axis] <= min[axis] || from[axis] >= max[axis])
+						return false;
+					continue;
+				}
+
+				float const t0 = (min[axis] - from[axis]) / d;
+				float const t1 = (max[axis] - from[axis]) / d;
+				enter = std::max(enter, std::min(t0, t1));
+				exit = std::min(exit, std::max(t0, t1));
+			}
+			return enter < exit;
+		}
+
+		[[nodiscard]] bool overlaps(auto const& min_a, auto const& max_a, auto const& min_b, auto const& max_b) noexcept
+		{
+			return min_a.x <= max_b.x && min_b.x <= max_a.x && min_a.y <= max_b.y && min_b.y <= max_a.y && min_a.z <= max_b.z && min_b.z <= max_a.z;
+		}
+	}
+
+	brush_visibility::brush_visibility(float cell_size)
+		: requested_cell_size(cell_size)
+		, cell_size(cell_size)
+	{
+		if (!(cell_size > 0.f))
+			throw std::invalid_argument("Cells must have a positive size");
+	}
+
+	void brush_visibility::set_brush(entity_id id, std::shared_ptr<egfx::mesh_definition const> mesh, math::transform_matrix const& world_transform)
+	{
+		assert(mesh != nullptr);
+
+		auto const [it, inserted] = item_indices.try_emplace(id, items.size());
+		size_t const index = it->second;
+		if (!inserted)
+		{
+			// Moving a parent reports its children as changed, even when they end up where they were
+			item const& existing = items[index];
+			if (existing.mesh == mesh && float_eq(existing.world_transform, world_transform))
+				return;
+		}
+
+		math::aabb const world_bounds = get_world_bounds(*mesh, world_transform);
+		cell const min = get_cell(world_bounds.min());
+		cell const max = get_cell(world_bounds.max());
+
+		// Views only change around the previous and the new place of the brush
+		cell previous_min = min;
+		cell previous_max = max;
+		bool views_changed = false;
+		if (!inserted && !needs_rebuild)
+		{
+			previous_min = item_min_cells[index];
+			previous_max = item_max_cells[index];
+			views_changed = mark_solid_cells(items[index], previous_min, previous_max, false);
+		}
+
+		if (inserted)
+		{
+			items.push_back(item{ id, ot::as_movable(mesh), world_transform, world_bounds });
+			all_items.push_back(static_cast<uint32_t>(index));
+		}
+		else
+		{
+			items[index] = item{ id, ot::as_movable(mesh), world_transform, world_bounds };
+		}
+
+		if (needs_rebuild)
+			return;
+
+		if (!is_in_grid(min) || !is_in_grid(max))
+		{
+			// The grid grows with the brushes
+			needs_rebuild = true;
+			return;
+		}
+
+		if (inserted)
+		{
+			item_min_cells.push_back(min);
+			item_max_cells.push_back(max);
+		}
+		else
+		{
+			item_min_cells[index] = min;
+			item_max_cells[index] = max;
+		}
+
+		views_changed = mark_solid_cells(items[index], min, max, true) || views_changed;
+		if (views_changed)
+		{
+			drop_visible_sets(previous_min, previous_max);
+			drop_visible_sets(min, max);
+			return;
+		}
+
+		// Brushes too small to block a cell only change which sets see them
+		for (auto& [eye_index, set] : visible_sets)
+		{
+			if (!overlaps(set.min, set.max, previous_min, previous_max) && !overlaps(set.min, set.max, min, max))
+				continue;
+
+			std::erase(set.items, static_cast<uint32_t>(index));
+			if (sees_cells(set, min, max))
+				set.items.push_back(static_cast<uint32_t>(index));
+		}
+	}
+
+	void brush_visibility::remove_brush(entity_id id)
+	{
+		auto const it = item_indices.find(id);
+		if (it == item_indices.end())
+			return;
+
+		size_t const removed = it->second;
+		size_t const last = items.size() - 1;
+		item_indices.erase(it);
+		if (!needs_rebuild)
+		{
+			cell const min = item_min_cells[removed];
+			cell const max = item_max_cells[removed];
+			if (mark_solid_cells(items[removed], min, max, false))
+			{
+				drop_visible_sets(min, max);
+			}
+			else
+			{
+				for (auto& [eye_index, set] : visible_sets)
+					std::erase(set.items, static_cast<uint32_t>(removed));
+			}
+		}
+
+		if (removed != last)
+		{
+			items[removed] = ot::as_movable(items.back());
+			item_indices[items[removed].id] = removed;
+			if (!needs_rebuild)
+			{
+				item_min_cells[removed] = item_min_cells[last];
+				item_max_cells[removed] = item_max_cells[last];
+
+				// The sets left see the brush moved in place of the removed one under its new index
+				for (auto& [eye_index, set] : visible_sets)
+					std::ranges::replace(set.items, static_cast<uint32_t>(last), static_cast<uint32_t>(removed));
+			}
+		}
+
+		items.pop_back();
+		all_items.pop_back();
+		if (!needs_rebuild)
+		{
+			item_min_cells.pop_back();
+			item_max_cells.pop_back();
+		}
+	}
+
+	void brush_visibility::clear() noexcept
+	{
+		items.clear();
+		item_indices.clear();
+		all_items.clear();
+		needs_rebuild = true;
+	}
+
+	size_t brush_visibility::get_index(cell c) const noexcept
+	{
+		return static_cast<size_t>(c.x) + static_cast<size_t>(grid_size.x) * (static_cast<size_t>(c.y) + static_cast<size_t>(grid_size.y) * static_cast<size_t>(c.z));
+	}
+
+	auto brush_visibility::get_cell(math::point3f p) const noexcept -> cell
+	{
+		return {
+			static_cast<int32_t>(std::floor((p.x - grid_origin.x) / cell_size)),
+			static_cast<int32_t>(std::floor((p.y - grid_origin.y) / cell_size)),
+			static_cast<int32_t>(std::floor((p.z - grid_origin.z) / cell_size)),
+		};
+	}
+
+	auto brush_visibility::get_cell(size_t index) const noexcept -> cell
+	{
+		size_t const layer = static_cast<size_t>(grid_size.x) * static_cast<size_t>(grid_size.y);
+		return {
+			static_cast<int32_t>(index % static_cast<size_t>(grid_size.x)),
+			static_cast<int32_t>(index % layer / static_cast<size_t>(grid_size.x)),
+			static_cast<int32_t>(index / layer),
+		};
+	}
+
+	bool brush_visibility::is_in_grid(cell c) const noexcept
+	{
+		return c.x >= 0 && c.y >= 0 && c.z >= 0 && c.x < grid_size.x && c.y < grid_size.y && c.z < grid_size.z;
+	}
+
+	void brush_visibility::rebuild()
+	{
+		needs_rebuild = false;
+		visible_sets.clear();
+		solid_counts.clear();
+		item_min_cells.clear();
+		item_max_cells.clear();
+		all_items.resize(items.size());
+		std::iota(all_items.begin(), all_items.end(), uint32_t(0));
+		cell_size = requested_cell_size;
+		grid_size = { 0, 0, 0 };
+
+		if (items.empty())
+			return;
+
+		math::aabb bounds = items.front().world_bounds;
+		for (item const& brush : items)
+			bounds.merge(brush.world_bounds);
+
+		for (;;)
+		{
+			math::vector3f const border{ cell_size, cell_size, cell_size };
+			grid_origin = bounds.min() - border;
+			math::vector3f const extent = bounds.half_size * 2.f + border * 2.f;
+			grid_size = {
+				static_cast<int32_t>(std::ceil(extent.x / cell_size)),
+				static_cast<int32_t>(std::ceil(extent.y / cell_size)),
+				static_cast<int32_t>(std::ceil(extent.z / cell_size)),
+			};
+
+			size_t const cell_count = static_cast<size_t>(grid_size.x) * static_cast<size_t>(grid_size.y) * static_cast<size_t>(grid_size.z);
+			if (cell_count <= max_cell_count)
+				break;
+
+			cell_size *= std::cbrt(static_cast<float>(cell_count) / static_cast<float>(max_cell_count)) * 1.01f;
+		}
+
+		solid_counts.assign(static_cast<size_t>(grid_size.x) * static_cast<size_t>(grid_size.y) * static_cast<size_t>(grid_size.z), 0);
+		item_min_cells.reserve(items.size());
+		item_max_cells.reserve(items.size());
+		for (item const& brush : items)
+		{
+			cell const min = get_cell(brush.world_bounds.min());
+			cell const max = get_cell(brush.world_bounds.max());
+			assert(is_in_grid(min) && is_in_grid(max));
+			item_min_cells.push_back(min);
+			item_max_cells.push_back(max);
+			mark_solid_cells(brush, min, max, true);
+		}
+	}
+
+	bool brush_visibility::mark_solid_cells(item const& brush, cell min, cell max, bool is_added)
+	{
+		// Tested in the space of the mesh, which keeps its planes right under non-uniform scales
+		math::transform_matrix const world_to_local = invert(brush.world_transform);
+		std::vector<math::plane> planes;
+		for (egfx::face::cref const face : brush.mesh->get_faces())
+			planes.push_back(face.get_plane());
+
+		// Corners shared by neighbouring cells are tested once
+		int32_t const corners_x = max.x - min.x + 2;
+		int32_t const corners_y = max.y - min.y + 2;
+		int32_t const corners_z = max.z - min.z + 2;
+		std::vector<bool> inside(static_cast<size_t>(corners_x) * static_cast<size_t>(corners_y) * static_cast<size_t>(corners_z));
+		auto const get_corner_index = [=](int32_t x, int32_t y, int32_t z)
+		{
+			return static_cast<size_t>(x) + static_cast<size_t>(corners_x) * (static_cast<size_t>(y) + static_cast<size_t>(corners_y) * static_cast<size_t>(z));
+		};
+
+		for (int32_t z = 0; z < corners_z; ++z)
+		{
+			for (int32_t y = 0; y < corners_y; ++y)
+			{
+				for (int32_t x = 0; x < corners_x; ++x)
+				{
+					math::vector3f const offset{ float(min.x + x), float(min.y + y), float(min.z + z) };
+					math::point3f const local = transform(grid_origin + offset * cell_size, world_to_local);
+					bool is_inside = true;
+					for (math::plane const& p : planes)
+					{
+						if (p.distance_to(local) > solid_epsilon)
+						{
+							is_inside = false;
+							break;
+						}
+					}
+					inside[get_corner_index(x, y, z)] = is_inside;
+				}
+			}
+		}
+
+		bool views_changed = false;
+		for (int32_t z = 0; z + 1 < corners_z; ++z)
+		{
+			for (int32_t y = 0; y + 1 < corners_y; ++y)
+			{
+				for (int32_t x = 0; x + 1 < corners_x; ++x)
+				{
+					bool is_solid = true;
+					for (int corner = 0; corner < 8 && is_solid; ++corner)
+						is_solid = inside[get_corner_index(x + (corner & 1), y + ((corner >> 1) & 1), z + ((corner >> 2) & 1))];
+
+					if (!is_solid)
+						continue;
+
+					uint32_t& count = solid_counts[get_index({ min.x + x, min.y + y, min.z + z })];
+					assert(is_added || count > 0);
+					count = is_added ? count + 1 : count - 1;
+					views_changed = views_changed || count == (is_added ? 1 : 0);
+				}
+			}
+		}
+		return views_changed;
+	}
+
+	void brush_visibility::drop_visible_sets(cell min, cell max)
+	{
+		std::erase_if(visible_sets, [min, max](auto const& entry)
+		{
+			return overlaps(entry.second.min, entry.second.max, min, max);
+		});
+	}
+
+	bool brush_visibility::is_seen(cell eye, cell target, std::vector<uint32_t>& walked, uint32_t walk, std::vector<size_t>& pending) const
+	{
+		// A line from the eye's cell to the target stays in the hull of both cells, and goes through a chain of open cells, each entered through a face of the previous one
+		// All the cells are the same box moved, so a cell is in the hull when the segment between the first corners of the eye's cell and of the target crosses the cell grown by a cell on each side
+		std::array<float, 3> const from{ float(eye.x), float(eye.y), float(eye.z) };
+		std::array<float, 3> const to{ float(target.x), float(target.y), float(target.z) };
+		size_t const target_index = get_index(target);
+
+		pending.clear();
+		pending.push_back(get_index(eye));
+		walked[pending.front()] = walk;
+		while (!pending.empty())
+		{
+			cell const c = get_cell(pending.back());
+			pending.pop_back();
+
+			// Cells toward the target are walked first, which goes straight to it when nothing is in the way
+			int32_t const dx = target.x > c.x ? 1 : -1;
+			int32_t const dy = target.y > c.y ? 1 : -1;
+			int32_t const dz = target.z > c.z ? 1 : -1;
+			cell const neighbours[] = {
+				{ c.x - dx, c.y, c.z }, { c.x, c.y - dy, c.z }, { c.x, c.y, c.z - dz },
+				{ c.x + dx, c.y, c.z }, { c.x, c.y + dy, c.z }, { c.x, c.y, c.z + dz },
+			};
+			for (cell const& n : neighbours)
+			{
+				if (!is_in_grid(n))
+					continue;
+
+				size_t const index = get_index(n);
+				if (walked[index] == walk)
+					continue;
+
+				std::array<float, 3> const grown_min{ float(n.x - 1), float(n.y - 1), float(n.z - 1) };
+				std::array<float, 3> const grown_max{ float(n.x + 1), float(n.y + 1), float(n.z + 1) };
+				if (!crosses_inside(from, to, grown_min, grown_max))
+					continue;
+
+				if (index == target_index)
+					return true;
+
+				walked[index] = walk;
+				if (!is_solid(index))
+					pending.push_back(index);
+			}
+		}
+		return false;
+	}
+
+	bool brush_visibility::sees_cells(visible_set const& set, cell min, cell max) const
+	{
+		if (!overlaps(set.min, set.max, min, max))
+			return false;
+
+		for (int32_t z = min.z; z <= max.z; ++z)
+			for (int32_t y = min.y; y <= max.y; ++y)
+				for (int32_t x = min.x; x <= max.x; ++x)
+					if (std::ranges::binary_search(set.cells, static_cast<uint32_t>(get_index({ x, y, z }))))
+						return true;
+		return false;
+	}
+
+	auto brush_visibility::compute_visible_set(cell eye) const -> visible_set
+	{
+		size_t const cell_count = solid_counts.size();
+		std::vector<bool> visible(cell_count);
+		std::vector<bool> tested(cell_count);
+		visible_set set{ {}, {}, eye, eye };
+
+		// A cell can only be seen through an open neighbour the view goes through, which is seen as well
+		// Seen cells are grown from the eye, only testing the neighbours of open cells already seen, closest first
+		std::vector<size_t> pending;
+		size_t next_pending = 0;
+		auto const see = [&](size_t index)
+		{
+			visible[index] = true;
+			set.cells.push_back(static_cast<uint32_t>(index));
+			cell const c = get_cell(index);
+			set.min = { std::min(set.min.x, c.x), std::min(set.min.y, c.y), std::min(set.min.z, c.z) };
+			set.max = { std::max(set.max.x, c.x), std::max(set.max.y, c.y), std::max(set.max.z, c.z) };
+
+			// Solid cells are seen, but not seen through
+			if (is_solid(index))
+				return;
+
+			cell const neighbours[] = {
+				{ c.x - 1, c.y, c.z }, { c.x + 1, c.y, c.z },
+				{ c.x, c.y - 1, c.z }, { c.x, c.y + 1, c.z },
+				{ c.x, c.y, c.z - 1 }, { c.x, c.y, c.z + 1 },
+			};
+			for (cell const& n : neighbours)
+			{
+				if (!is_in_grid(n))
+					continue;
+
+				size_t const neighbour = get_index(n);
+				if (!visible[neighbour] && !tested[neighbour])
+					pending.push_back(neighbour);
+			}
+		};
+
+		see(get_index(eye));
+
+		std::vector<uint32_t> walked(cell_count, 0);
+		uint32_t walk = 0;
+		std::vector<size_t> walk_pending;
+		while (next_pending < pending.size())
+		{
+			size_t const target = pending[next_pending++];
+			if (visible[target] || tested[target])
+				continue;
+			tested[target] = true;
+
+			if (is_seen(eye, get_cell(target), walked, ++walk, walk_pending))
+				see(target);
+		}
+		std::ranges::sort(set.cells);
+
+		for (size_t item_index = 0; item_index < items.size(); ++item_index)
+		{
+			cell const min = item_min_cells[item_index];
+			cell const max = item_max_cells[item_index];
+			if (!overlaps(min, max, set.min, set.max))
+				continue;
+
+			bool seen = false;
+			for (int32_t z = min.z; z <= max.z && !seen; ++z)
+				for (int32_t y = min.y; y <= max.y && !seen; ++y)
+					for (int32_t x = min.x; x <= max.x && !seen; ++x)
+						seen = visible[get_index({ x, y, z })];
+
+			if (seen)
+				set.items.push_back(static_cast<uint32_t>(item_index));
+		}
+		return set;
+	}
+
+	std::span<uint32_t const> brush_visibility::find_visible_set(math::point3f eye)
+	{
+		update();
+
+		cell const c = get_cell(eye);
+		if (!is_in_grid(c))
+			return all_items;
+
+		size_t const index = get_index(c);
+		if (is_solid(index))
+			return all_items;
+
+		auto const [it, inserted] = visible_sets.try_emplace(index);
+		if (inserted)
+			it->second = compute_visible_set(c);
+		return it->second.items;
+	}
+
+	void brush_visibility::update()
+	{
+		if (needs_rebuild)
+			rebuild();
+	}
+
+	void brush_visibility::get_potentially_visible_brushes(math::point3f eye, std::vector<entity_id>& visible)
+	{
+		visible.clear();
+		for (uint32_t const item_index : find_visible_set(eye))
+			visible.push_back(items[item_index].id);
+	}
+
+	void brush_visibility::get_visible_brushes(math::point3f eye, math::frustum const& f, std::vector<entity_id>& visible)
+	{
+		visible.clear();
+		for (uint32_t const item_index : find_visible_set(eye))
+		{
+			item const& brush = items[item_index];
+			if (!f.is_outside(brush.world_bounds))
+				visible.push_back(brush.id);
+		}
+	}
+
+	size_t brush_visibility::get_solid_cell_count() const noexcept
+	{
+		return static_cast<size_t>(std::ranges::count_if(solid_counts, [](uint32_t count) { return count != 0; }));
+	}
+}
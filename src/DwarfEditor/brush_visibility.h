@@ -0,0 +1,117 @@
+#pragma once
+
+#include "map.fwd.h"
+
+#include "egfx/mesh_definition.h"
+
+#include "math/aabb.h"
+#include "math/frustum.h"
+#include "math/transform_matrix.h"
+
+#include "core/size_t.h"
+#include "core/stdint.h"
+
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace ot::dedit
+{
+	// Potentially visible sets of the brushes of a map, to skip the brushes hidden behind other brushes before frustum culling
+	// Space is divided into a grid of cells, the cells entirely inside a brush being solid and blocking the view. Brushes are convex, so a cell is inside a brush when its corners are
+	// A cell is seen from another when open cells in the hull of both connect them, which any straight line between them needs. The cells seen are then mapped to the brushes whose bounds overlap them
+	// Sets are conservative: a brush seen from anywhere in the eye's cell is in its set. Views through gaps of no width, like between the edges of two solid cells, are ignored
+	// A set is computed the first time the eye enters its cell. Changing a brush marks again the cells under its previous and new bounds, and drops the sets which reached them
+	// When no cell became solid or open, as for brushes smaller than a cell, the sets are kept and only learn whether they see the brush
+	// The grid is only rebuilt on the next query when brushes go out of it
+	class brush_visibility
+	{
+	public:
+		static constexpr float default_cell_size = 2.f;
+		// Cells are made larger than the requested size when the grid would have more cells than this
+		static constexpr size_t max_cell_count = size_t(1) << 20;
+
+	private:
+		struct cell
+		{
+			int32_t x;
+			int32_t y;
+			int32_t z;
+		};
+
+		struct item
+		{
+			entity_id id;
+			std::shared_ptr<egfx::mesh_definition const> mesh;
+			math::transform_matrix world_transform;
+			math::aabb world_bounds;
+		};
+
+		struct visible_set
+		{
+			std::vector<uint32_t> items;
+			std::vector<uint32_t> cells; // sorted indices of the cells seen
+			cell min; // first cell seen
+			cell max; // last cell seen
+		};
+
+		std::vector<item> items;
+		std::unordered_map<entity_id, size_t> item_indices;
+		bool needs_rebuild = false;
+
+		// Grid over the bounds of the brushes, with a border of empty cells for views going around them
+		float requested_cell_size;
+		float cell_size;
+		math::point3f grid_origin{ 0.f, 0.f, 0.f };
+		cell grid_size{ 0, 0, 0 };
+		std::vector<uint32_t> solid_counts; // by cell index, number of brushes the cell is inside of
+		std::vector<cell> item_min_cells; // by item index, first cell overlapped by the bounds of the brush
+		std::vector<cell> item_max_cells; // by item index, last cell overlapped by the bounds of the brush
+		std::vector<uint32_t> all_items; // seen from out of the grid or from solid cells
+		std::unordered_map<size_t, visible_set> visible_sets; // by cell index of the eye
+
+		[[nodiscard]] size_t get_index(cell c) const noexcept;
+		[[nodiscard]] cell get_cell(math::point3f p) const noexcept;
+		[[nodiscard]] cell get_cell(size_t index) const noexcept;
+		[[nodiscard]] bool is_in_grid(cell c) const noexcept;
+		[[nodiscard]] bool is_solid(size_t index) const noexcept { return solid_counts[index] != 0; }
+
+		void rebuild();
+		// Counts the brush in the solid cells it covers between 'min' and 'max', or stops counting it. Returns whether cells became solid or open
+		bool mark_solid_cells(item const& brush, cell min, cell max, bool is_added);
+		// Drops the sets which saw any of the cells between 'min' and 'max'
+		void drop_visible_sets(cell min, cell max);
+		// Whether the set saw any of the cells between 'min' and 'max'
+		[[nodiscard]] bool sees_cells(visible_set const& set, cell min, cell max) const;
+		// Whether a straight line can go from the eye's cell to the target cell without going through solid cells. Cells are marked with 'walk' in 'walked' as they are walked
+		[[nodiscard]] bool is_seen(cell eye, cell target, std::vector<uint32_t>& walked, uint32_t walk, std::vector<size_t>& pending) const;
+		[[nodiscard]] visible_set compute_visible_set(cell eye) const;
+		[[nodiscard]] std::span<uint32_t const> find_visible_set(math::point3f eye);
+
+	public:
+		explicit brush_visibility(float cell_size = default_cell_size);
+
+		// Adds the brush, or updates its mesh and transform if it is already in the grid. Setting the same mesh and transform again keeps the visible sets
+		void set_brush(entity_id id, std::shared_ptr<egfx::mesh_definition const> mesh, math::transform_matrix const& world_transform);
+		void remove_brush(entity_id id);
+		void clear() noexcept;
+
+		[[nodiscard]] bool contains(entity_id id) const noexcept { return item_indices.contains(id); }
+		[[nodiscard]] size_t size() const noexcept { return items.size(); }
+
+		// Rebuilds the grid if brushes went out of it since the last query. Queries call it themselves
+		void update();
+
+		// Replaces the content of 'visible' with the brushes which can be seen from the point, in no particular order
+		// Every brush can be seen from out of the grid and from inside a brush
+		void get_potentially_visible_brushes(math::point3f eye, std::vector<entity_id>& visible);
+		// Same as get_potentially_visible_brushes, only keeping the brushes whose bounds are in the frustum
+		void get_visible_brushes(math::point3f eye, math::frustum const& f, std::vector<entity_id>& visible);
+
+		[[nodiscard]] float get_cell_size() const noexcept { return cell_size; }
+		[[nodiscard]] size_t get_cell_count() const noexcept { return solid_counts.size(); }
+		[[nodiscard]] size_t get_solid_cell_count() const noexcept;
+		[[nodiscard]] size_t get_visible_set_count() const noexcept { return visible_sets.size(); }
+	};
+}
@@ -1,14 +1,29 @@
 #include "console.h"
 
-#include <vector>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <new>
 
 namespace ot::dedit::console
 {
 	namespace
 	{
+		// A log is written in place in its slot. The slot's sequence is 0 while it is written, so that readers copying it at the same time can tell
+		struct log_slot
+		{
+			std::atomic<uint64_t> sequence{ 0 }; // sequence number of the log + 1
+			log_data data;
+		};
+
 		struct console_data
 		{
-			std::vector<log_data> logs;
+			std::array<log_slot, max_log_count> slots;
+			std::atomic<uint64_t> next_sequence{ 0 };
+			std::atomic<uint64_t> first_sequence{ 0 }; // logs before were cleared
+			std::array<std::atomic<size_t>, level_count> level_counts{};
+			std::atomic<level_type> level_filter{ level_type::verbose };
 		};
 
 		alignas(console_data) char log_storage[sizeof(console_data)];
@@ -24,18 +39,80 @@ namespace ot::dedit::console
 	void clear()
 	{
 		console_data& data = access_console_data();
-		data.logs.clear();
+		data.first_sequence.store(data.next_sequence.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		for (std::atomic<size_t>& count : data.level_counts)
+			count.store(0, std::memory_order_relaxed);
+	}
+
+	void set_level_filter(level_type minimum) noexcept
+	{
+		access_console_data().level_filter.store(minimum, std::memory_order_relaxed);
+	}
+
+	level_type get_level_filter() noexcept
+	{
+		return access_console_data().level_filter.load(std::memory_order_relaxed);
+	}
+
+	void output(level_type level, std::string_view message) noexcept
+	{
+		console_data& data = access_console_data();
+		if (level < data.level_filter.load(std::memory_order_relaxed))
+			return;
+
+		// Producers only contend on the counter. A producer a whole ring behind could write the same slot at the same time, which readers see as a torn message
+		uint64_t const sequence = data.next_sequence.fetch_add(1, std::memory_order_relaxed);
+		log_slot& slot = data.slots[sequence % max_log_count];
+		slot.sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		size_t const length = std::min(message.size(), max_message_length);
+		std::memcpy(slot.data.text, message.data(), length);
+		if (message.size() > max_message_length)
+			std::memcpy(slot.data.text + max_message_length - 3, "...", 3);
+		slot.data.length = static_cast<uint8_t>(length);
+		slot.data.level = level;
+
+		slot.sequence.store(sequence + 1, std::memory_order_release);
+		data.level_counts[static_cast<size_t>(level)].fetch_add(1, std::memory_order_relaxed);
 	}
 
-	void output(level_type level, std::string&& s)
+	log_range get_logs() noexcept
 	{
-		log_data& data = access_console_data().logs.emplace_back();
-		data.level = level;
-		data.message = std::move(s);
+		console_data const& data = access_console_data();
+		uint64_t const end = data.next_sequence.load(std::memory_order_acquire);
+		uint64_t const first = data.first_sequence.load(std::memory_order_relaxed);
+		uint64_t const oldest = end > max_log_count ? end - max_log_count : 0;
+		return { std::max(first, oldest), end };
+	}
+
+	bool read_log(uint64_t sequence, log_data& log) noexcept
+	{
+		log_slot const& slot = access_console_data().slots[sequence % max_log_count];
+		if (slot.sequence.load(std::memory_order_acquire) != sequence + 1)
+			return false;
+
+		std::memcpy(&log, &slot.data, sizeof(log_data));
+
+		// The copy is only valid if the slot was not written meanwhile
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot.sequence.load(std::memory_order_relaxed) == sequence + 1;
+	}
+
+	bool read_log_level(uint64_t sequence, level_type& level) noexcept
+	{
+		log_slot const& slot = access_console_data().slots[sequence % max_log_count];
+		if (slot.sequence.load(std::memory_order_acquire) != sequence + 1)
+			return false;
+
+		level = slot.data.level;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot.sequence.load(std::memory_order_relaxed) == sequence + 1;
 	}
 
-	std::span<log_data const> get_logs()
+	size_t get_log_count(level_type level) noexcept
 	{
-		return access_console_data().logs;
+		return access_console_data().level_counts[static_cast<size_t>(level)].load(std::memory_order_relaxed);
 	}
 }
@@ -1,8 +1,11 @@
 #pragma once
 
-#include <string>
+#include "core/size_t.h"
+#include "core/stdint.h"
+
+#include <format>
 #include <string_view>
-#include <span>
+#include <utility>
 
 namespace ot::dedit::console
 {
@@ -10,7 +13,7 @@ namespace ot::dedit::console
 
 	void clear();
 
-	enum class level_type
+	enum class level_type : uint8_t
 	{
 		verbose,
 		log,
@@ -18,28 +21,102 @@ namespace ot::dedit::console
 		error,
 	};
 
-	struct log_data
+	inline constexpr size_t level_count = 4;
+
+	// Logs are kept in a ring of fixed capacity, new logs overwriting the oldest ones
+	// Messages longer than max_message_length are cut, ending with "..."
+	inline constexpr size_t max_log_count = 4096;
+	inline constexpr size_t max_message_length = 244;
+
+	// Messages under the level are dropped before being formatted
+	void set_level_filter(level_type minimum) noexcept;
+	[[nodiscard]] level_type get_level_filter() noexcept;
+
+	// Outputs can come from any thread, without locking
+	void output(level_type level, std::string_view message) noexcept;
+
+	template<typename... Args> requires (sizeof...(Args) > 0)
+	void output(level_type level, std::format_string<Args...> fmt, Args&&... args)
 	{
-		std::string message;
-		level_type level;
-	};
+		if (level < get_level_filter())
+			return;
+
+		// Formatted on the stack and copied into the ring, one character more telling the message was cut
+		char buffer[max_message_length + 1];
+		auto const result = std::format_to_n(buffer, max_message_length + 1, fmt, std::forward<Args>(args)...);
+		output(level, std::string_view(buffer, result.out));
+	}
 
-	void output(level_type level, std::string&& s);
+	inline void verbose(std::string_view s)
+	{
+		output(level_type::verbose, s);
+	}
+
+	template<typename... Args> requires (sizeof...(Args) > 0)
+	void verbose(std::format_string<Args...> fmt, Args&&... args)
+	{
+		output(level_type::verbose, fmt, std::forward<Args>(args)...);
+	}
 		
-	inline void log(std::string s)
+	inline void log(std::string_view s)
+	{
+		output(level_type::log, s);
+	}
+
+	template<typename... Args> requires (sizeof...(Args) > 0)
+	void log(std::format_string<Args...> fmt, Args&&... args)
 	{
-		output(level_type::log, std::move(s));
+		output(level_type::log, fmt, std::forward<Args>(args)...);
 	}
 
-	inline void warning(std::string&& s)
+	inline void warning(std::string_view s)
 	{
-		output(level_type::warning, std::move(s));
+		output(level_type::warning, s);
 	}
 
-	inline void error(std::string&& s)
+	template<typename... Args> requires (sizeof...(Args) > 0)
+	void warning(std::format_string<Args...> fmt, Args&&... args)
 	{
-		output(level_type::error, std::move(s));
+		output(level_type::warning, fmt, std::forward<Args>(args)...);
 	}
 
-	std::span<log_data const> get_logs();
+	inline void error(std::string_view s)
+	{
+		output(level_type::error, s);
+	}
+
+	template<typename... Args> requires (sizeof...(Args) > 0)
+	void error(std::format_string<Args...> fmt, Args&&... args)
+	{
+		output(level_type::error, fmt, std::forward<Args>(args)...);
+	}
+
+	// Copy of a log, read from the ring
+	struct log_data
+	{
+		level_type level;
+		uint8_t length;
+		char text[max_message_length];
+
+		[[nodiscard]] std::string_view get_message() const noexcept { return { text, length }; }
+	};
+
+	// Sequence numbers of the logs in the ring, from the oldest to the next log to be output
+	struct log_range
+	{
+		uint64_t begin;
+		uint64_t end;
+
+		[[nodiscard]] bool empty() const noexcept { return begin == end; }
+		[[nodiscard]] size_t size() const noexcept { return static_cast<size_t>(end - begin); }
+	};
+
+	[[nodiscard]] log_range get_logs() noexcept;
+
+	// Return false when the log was overwritten or is still being output by another thread
+	[[nodiscard]] bool read_log(uint64_t sequence, log_data& log) noexcept;
+	[[nodiscard]] bool read_log_level(uint64_t sequence, level_type& level) noexcept;
+
+	// Number of logs of the level output since the console was cleared, overwritten logs included
+	[[nodiscard]] size_t get_log_count(level_type level) noexcept;
 }
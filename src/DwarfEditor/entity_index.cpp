@@ -0,0 +1,106 @@
+#include "entity_index.h"
+
+#include <stdexcept>
+
+namespace ot::dedit
+{
+	size_t& entity_index::get_first_child(size_t parent_slot) noexcept
+	{
+		return parent_slot == no_slot ? first_root_child : links[parent_slot].first_child;
+	}
+
+	size_t entity_index::add(entity_id id, entity_id parent)
+	{
+		if (id == entity_id::root || slots.contains(id))
+			throw std::invalid_argument("Entity id already in the map");
+
+		size_t parent_slot = no_slot;
+		if (parent != entity_id::root)
+		{
+			parent_slot = find(parent);
+			if (parent_slot == no_slot)
+				throw std::invalid_argument("Parent entity not in the map");
+		}
+
+		size_t slot;
+		if (!free_slots.empty())
+		{
+			slot = free_slots.back();
+			free_slots.pop_back();
+		}
+		else
+		{
+			slot = links.size();
+			links.emplace_back();
+		}
+
+		slots.emplace(id, slot);
+
+		// New children go first, the order of siblings is kept by the scene nodes
+		size_t& first_sibling = get_first_child(parent_slot);
+		slot_links& l = links[slot];
+		l = slot_links{};
+		l.id = id;
+		l.parent = parent_slot;
+		l.next_sibling = first_sibling;
+		if (first_sibling != no_slot)
+			links[first_sibling].previous_sibling = slot;
+		first_sibling = slot;
+
+		return slot;
+	}
+
+	void entity_index::remove_subtree(entity_id id, std::vector<size_t>& removed_slots)
+	{
+		size_t const subtree_root = find(id);
+		if (subtree_root == no_slot)
+			return;
+
+		// Unlink the subtree from its siblings
+		slot_links const& root_links = links[subtree_root];
+		if (root_links.previous_sibling != no_slot)
+			links[root_links.previous_sibling].next_sibling = root_links.next_sibling;
+		else
+			get_first_child(root_links.parent) = root_links.next_sibling;
+		if (root_links.next_sibling != no_slot)
+			links[root_links.next_sibling].previous_sibling = root_links.previous_sibling;
+
+		// Every slot appended is visited once, which collects the subtree breadth-first
+		size_t const first_removed = removed_slots.size();
+		removed_slots.push_back(subtree_root);
+		for (size_t i = first_removed; i < removed_slots.size(); ++i)
+		{
+			size_t const slot = removed_slots[i];
+			for (size_t child = links[slot].first_child; child != no_slot; child = links[child].next_sibling)
+				removed_slots.push_back(child);
+		}
+
+		for (size_t i = first_removed; i < removed_slots.size(); ++i)
+		{
+			size_t const slot = removed_slots[i];
+			slots.erase(links[slot].id);
+			links[slot] = slot_links{};
+			free_slots.push_back(slot);
+		}
+	}
+
+	void entity_index::clear() noexcept
+	{
+		slots.clear();
+		links.clear();
+		free_slots.clear();
+		first_root_child = no_slot;
+	}
+
+	size_t entity_index::find(entity_id id) const noexcept
+	{
+		auto const it = slots.find(id);
+		return it != slots.end() ? it->second : no_slot;
+	}
+
+	entity_id entity_index::get_parent(size_t slot) const noexcept
+	{
+		size_t const parent_slot = links[slot].parent;
+		return parent_slot != no_slot ? links[parent_slot].id : entity_id::root;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "map.fwd.h"
+
+#include "core/size_t.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace ot::dedit
+{
+	// Index of the entities of a map by id, with the links between each entity and its parent and children
+	// Each entity is given a slot, which the map uses to store the entity. Slots of removed entities are reused by the next entities
+	// The root entity is implicit: it is never in the index, but entities can have it as their parent
+	class entity_index
+	{
+	public:
+		static constexpr size_t no_slot = static_cast<size_t>(-1);
+
+	private:
+		struct slot_links
+		{
+			entity_id id = entity_id::root;
+			size_t parent = no_slot; // no_slot for the children of the root
+			size_t first_child = no_slot;
+			size_t next_sibling = no_slot;
+			size_t previous_sibling = no_slot;
+		};
+
+		std::unordered_map<entity_id, size_t> slots;
+		std::vector<slot_links> links;
+		std::vector<size_t> free_slots;
+		size_t first_root_child = no_slot;
+
+		[[nodiscard]] size_t& get_first_child(size_t parent_slot) noexcept;
+
+	public:
+		// Adds the entity as a child of 'parent', and returns the slot of the new entity
+		// Throws std::invalid_argument if 'id' is already in the index, or if 'parent' is neither the root nor in the index
+		size_t add(entity_id id, entity_id parent);
+
+		// Removes the entity and every entity under it. Their slots are appended to 'removed_slots', parents before their children
+		// Does nothing if the entity is not in the index
+		void remove_subtree(entity_id id, std::vector<size_t>& removed_slots);
+
+		void clear() noexcept;
+
+		// Returns the slot of the entity, or no_slot if it is not in the index
+		[[nodiscard]] size_t find(entity_id id) const noexcept;
+		[[nodiscard]] bool contains(entity_id id) const noexcept { return slots.contains(id); }
+
+		// Returns the parent of the entity in the slot, which can be the root
+		[[nodiscard]] entity_id get_parent(size_t slot) const noexcept;
+
+		// Returns the number of slots, including the free ones. Slots are always lower than this
+		[[nodiscard]] size_t get_slot_count() const noexcept { return links.size(); }
+		[[nodiscard]] size_t size() const noexcept { return slots.size(); }
+	};
+}
@@ -1,8 +1,12 @@
 #include "map.h"
+#include "brush_mesh_cache.h"
 
 #include "serialize/serialize_mesh_definition.h"
 #include "serialize/serialize_math.h"
 
+#include "egfx/scene.h"
+
+#include <algorithm>
 #include <format>
 #include <cassert>
 
@@ -283,39 +287,39 @@ namespace ot::dedit
 		node.set_user_ptr(this);
 	}
 
-	bool node_entity::fwrite(std::FILE* f) const
+	bool node_entity::fwrite(serialize::byte_stream& stream) const
 	{
 		std::string_view const name = node.get_name();
 		size_t const name_size = name.size();
-		if(!::fwrite(&name_size, sizeof(name_size), 1, f))
+		if(!serialize::fwrite(&name_size, sizeof(name_size), 1, stream))
 			return false;
 
-		if (!::fwrite(name.data(), 1, name.size(), f))
+		if (!serialize::fwrite(name.data(), 1, name.size(), stream))
 			return false;
 
-		if (!serialize::fwrite(node.get_position(), f)
-			|| !serialize::fwrite(node.get_rotation(), f)
-			|| !serialize::fwrite(node.get_scale(), f))
+		if (!serialize::fwrite(node.get_position(), stream)
+			|| !serialize::fwrite(node.get_rotation(), stream)
+			|| !serialize::fwrite(node.get_scale(), stream))
 			return false;
 
 		return true;
 	}
 
-	bool node_entity::fread(map_entity& parent, std::FILE* f)
+	bool node_entity::fread(map_entity& parent, serialize::byte_stream& stream)
 	{
 		size_t name_size;
-		if (!::fread(&name_size, sizeof(name_size), 1, f))
+		if (!serialize::fread(&name_size, sizeof(name_size), 1, stream))
 			return false;
 
 		std::string name;
 		name.resize(name_size);
-		if (!::fread(name.data(), 1, name_size, f))
+		if (!serialize::fread(name.data(), 1, name_size, stream))
 			return false;
 
 		math::point3f position;
 		math::quaternion rotation;
 		math::scales scales;
-		if (!serialize::fread(position, f) || !serialize::fread(rotation, f) || !serialize::fread(scales, f))
+		if (!serialize::fread(position, stream) || !serialize::fread(rotation, stream) || !serialize::fread(scales, stream))
 			return false;
 		
 		node = egfx::create_child_node(parent.get_node());
@@ -339,18 +343,32 @@ namespace ot::dedit
 	brush_entity::brush_entity(entity_id id, map_entity& parent, std::shared_ptr<egfx::mesh_definition const> mesh_def)
 		: node_entity(id, parent, make_brush_name(id))
 		, mesh_def(mesh_def)
-		, mesh(egfx::create_mesh(make_brush_name(id), *mesh_def))
+		, mesh(get_brush_mesh_cache().get_mesh(this->mesh_def))
 	{
 		egfx::node_ref const node_ref = get_node();
-		egfx::add_item(node_ref, mesh);
+		egfx::add_item(node_ref, *mesh);
 	}
 
-	bool brush::fwrite(std::FILE* f) const
+	void brush_entity::set_mesh(std::shared_ptr<egfx::mesh> new_mesh)
 	{
-		if (!node_entity::fwrite(f))
+		if (new_mesh == mesh)
+			return;
+
+		// Items cannot change their mesh, the item is replaced
+		egfx::item_ref const previous_item = get_item();
+		egfx::material_handle_t const material = previous_item.get_material();
+		egfx::remove_item(previous_item);
+
+		mesh = std::move(new_mesh);
+		egfx::add_item(get_node(), *mesh).set_material(material);
+	}
+
+	bool brush::fwrite(serialize::byte_stream& stream) const
+	{
+		if (!node_entity::fwrite(stream))
 			return false;
 
-		if (!serialize::fwrite(*mesh_def, f))
+		if (!serialize::fwrite(*mesh_def, stream))
 			return false;
 
 		// TODO: material
@@ -358,19 +376,19 @@ namespace ot::dedit
 		return true;
 	}
 
-	bool brush::fread(map_entity& parent, std::FILE* f)
+	bool brush::fread(map_entity& parent, serialize::byte_stream& stream)
 	{
-		if (!node_entity::fread(parent, f))
+		if (!node_entity::fread(parent, stream))
 			return false;
 
-		auto read_mesh_def = std::make_shared<egfx::mesh_definition>();
-		if (!serialize::fread(*read_mesh_def, f))
+		std::shared_ptr<egfx::mesh_definition const> read_mesh_def;
+		if (!serialize::fread(read_mesh_def, get_brush_mesh_cache().get_definitions(), stream))
 			return false;
 		
 		mesh_def = std::move(read_mesh_def);
-		mesh = egfx::create_mesh(make_brush_name(get_id()), *mesh_def);
+		mesh = get_brush_mesh_cache().get_mesh(mesh_def);
 
-		egfx::item_ref const brush = egfx::add_item(get_node(), mesh);
+		egfx::item_ref const brush = egfx::add_item(get_node(), *mesh);
 
 		// TODO: material
 		
@@ -379,8 +397,38 @@ namespace ot::dedit
 
 	void brush::reload_node(std::shared_ptr<egfx::mesh_definition const> new_def)
 	{
+		brush_mesh_cache& cache = get_brush_mesh_cache();
+		if (mesh.use_count() == 1 && !cache.has_mesh(*new_def))
+		{
+			// No other brush shows the mesh, it can be reloaded in place
+			mesh->reload_mesh(*new_def);
+			cache.move_mesh(*mesh_def, new_def, mesh);
+		}
+		else
+		{
+			set_mesh(cache.get_mesh(new_def));
+		}
+
+		mesh_def = std::move(new_def);
+	}
+
+	void brush::update_node(std::shared_ptr<egfx::mesh_definition> new_def)
+	{
+		brush_mesh_cache& cache = get_brush_mesh_cache();
+		if (mesh.use_count() == 1)
+		{
+			mesh->update_mesh(*new_def);
+			new_def->clear_dirty_faces();
+			cache.move_mesh(*mesh_def, new_def, mesh);
+		}
+		else
+		{
+			// Other brushes still show the previous definition, the brush gets a mesh of its own
+			new_def->clear_dirty_faces();
+			set_mesh(cache.get_mesh(new_def));
+		}
+
 		mesh_def = std::move(new_def);
-		mesh.reload_mesh(*mesh_def);
 	}
 
 	light_entity::light_entity(entity_id id)
@@ -395,43 +443,43 @@ namespace ot::dedit
 		egfx::add_light(get_node(), light_type);
 	}
 
-	bool light_entity::fwrite(std::FILE* f) const
+	bool light_entity::fwrite(serialize::byte_stream& stream) const
 	{
-		if (!node_entity::fwrite(f))
+		if (!node_entity::fwrite(stream))
 			return false;
 
 		egfx::light_cref const light = get_light();
 
 		egfx::light_type const light_type = light.get_light_type();
-		if (!::fwrite(&light_type, sizeof(light_type), 1, f))
+		if (!serialize::fwrite(&light_type, sizeof(light_type), 1, stream))
 			return false;
 
 		float const power_scale = light.get_power_scale();
-		if (!::fwrite(&power_scale, sizeof(power_scale), 1, f))
+		if (!serialize::fwrite(&power_scale, sizeof(power_scale), 1, stream))
 			return false;
 
 		egfx::color const diffuse = light.get_diffuse();
-		if (!::fwrite(&diffuse, sizeof(float), 3 /*don't write alpha*/, f))
+		if (!serialize::fwrite(&diffuse, sizeof(float), 3 /*don't write alpha*/, stream))
 			return false;
 
 		return true;
 	}
 
-	bool light_entity::fread(map_entity& parent, std::FILE* f)
+	bool light_entity::fread(map_entity& parent, serialize::byte_stream& stream)
 	{
-		if (!node_entity::fread(parent, f))
+		if (!node_entity::fread(parent, stream))
 			return false;
 
 		egfx::light_type light_type;
-		if (!::fread(&light_type, sizeof(light_type), 1, f))
+		if (!serialize::fread(&light_type, sizeof(light_type), 1, stream))
 			return false;
 
 		float power_scale;
-		if (!::fread(&power_scale, sizeof(power_scale), 1, f))
+		if (!serialize::fread(&power_scale, sizeof(power_scale), 1, stream))
 			return false;
 
 		egfx::color diffuse;
-		if (!::fread(&diffuse, sizeof(float), 3, f))
+		if (!serialize::fread(&diffuse, sizeof(float), 3, stream))
 			return false;
 		diffuse.a = 1.0f;
 
@@ -442,8 +490,9 @@ namespace ot::dedit
 		return true;
 	}
 
-	map::map(egfx::node_ref root_node)
-		: root(allocate_entity_id(), root_node)
+	map::map(egfx::scene& s)
+		: root(allocate_entity_id(), s.get_root_node())
+		, brush_chunks(s)
 	{
 
 	}
@@ -455,28 +504,71 @@ namespace ot::dedit
 
 	void map::on_new_entity(entity_id id)
 	{
-		assert(find_entity(id) == nullptr);
 		if (next_entity_id <= as_int(id))
 			next_entity_id = as_int(id) + 1;
 	}
 
+	void map::add_entity(entity_id parent, uptr<map_entity> e)
+	{
+		entity_id const id = e->get_id();
+		entity_type const type = e->get_type();
+		size_t const slot = index.add(id, parent);
+		if (slot == entities.size())
+			entities.push_back(ot::as_movable(e));
+		else
+			entities[slot] = ot::as_movable(e);
+
+		on_new_entity(id);
+
+		// Entities made to be read have no transform nor mesh yet
+		brush_picking_outdated = true;
+		brush_culling_outdated = true;
+		if (csg_enabled)
+			csg_added_entities.push_back(id);
+
+		// New nodes are dynamic
+		if (type == entity_type::brush)
+			dynamic_brushes[id] = math::seconds(0.f);
+	}
+
 	void map::delete_entity(entity_id id)
 	{
-		map_entity const* deleted_parent = find_entity(id);
-		if (deleted_parent == nullptr)
-			return;
+		std::vector<size_t> removed_slots;
+		index.remove_subtree(id, removed_slots);
 
-		auto const [removed_it, removed_sent] = std::ranges::remove_if(entities, [deleted_parent](uptr<map_entity> const& e) -> bool
+		// Children go before their parents
+		for (auto it = removed_slots.rbegin(); it != removed_slots.rend(); ++it)
 		{
-			return deleted_parent->find_recursive(e->get_id()) != nullptr;
-		});
-
-		entities.erase(removed_it, removed_sent);
+			entity_id const removed_id = entities[*it]->get_id();
+			egfx::csg::brush_id const csg_id = as_csg_id(removed_id);
+			if (csg.contains(csg_id))
+				csg.remove_brush(csg_id);
+			dynamic_brushes.erase(removed_id);
+			remove_from_chunks(removed_id);
+			// Also lets go of the mesh right away, for undo actions to measure what they alone keep
+			brush_picking.remove_brush(removed_id);
+			brush_culling.remove_brush(removed_id);
+			entities[*it].reset();
+		}
 	}
 
 	void map::clear()
 	{
 		entities.clear();
+		index.clear();
+		brush_picking.clear();
+		brush_picking_outdated = false;
+		brush_culling.clear();
+		brush_culling_outdated = false;
+		culled_brush_count = 0;
+		culled_chunk_count = 0;
+		csg.clear();
+		csg_added_entities.clear();
+		dynamic_brushes.clear();
+		brush_chunks.clear();
+		chunked_brushes.clear();
+		unmerged_brushes.clear();
+		changed_entities.clear();
 		next_entity_id = 1; // Root always has id 0
 	}
 
@@ -503,14 +595,7 @@ namespace ot::dedit
 
 	map_entity* map::find_entity(entity_id id)
 	{
-		if (id == entity_id::root)
-			return &root;
-
-		auto const it_found = std::find_if(entities.begin(), entities.end(), [id](uptr<map_entity> const& b) { return b->get_id() == id; });
-		if (it_found == entities.end())
-			return nullptr;
-
-		return (*it_found).get();
+		return const_cast<map_entity*>(static_cast<map const*>(this)->find_entity(id));
 	}
 
 	map_entity const* map::find_entity(entity_id id) const
@@ -518,11 +603,11 @@ namespace ot::dedit
 		if (id == entity_id::root)
 			return &root;
 
-		auto const it_found = std::find_if(entities.begin(), entities.end(), [id](uptr<map_entity> const& b) { return b->get_id() == id; });
-		if (it_found == entities.end())
+		size_t const slot = index.find(id);
+		if (slot == entity_index::no_slot)
 			return nullptr;
 
-		return (*it_found).get();
+		return entities[slot].get();
 	}
 
 	std::expected<entity_type, std::error_code> map::get_entity_type(entity_id id) const
@@ -533,4 +618,275 @@ namespace ot::dedit
 		else
 			return std::unexpected(std::make_error_code(std::errc::invalid_argument));
 	}
+
+	void map::touch_entity(map_entity& e)
+	{
+		// Static nodes keep the transform of their parent from when they were last changed, so children moving with the entity must be dynamic too
+		e.for_each_recursive([this](map_entity& child)
+		{
+			if (child.get_type() == entity_type::brush)
+			{
+				if (remove_from_chunks(child.get_id()))
+					child.get_node().set_visible(true);
+				child.get_node().set_static(false);
+				dynamic_brushes[child.get_id()] = math::seconds(0.f);
+			}
+			return false;
+		});
+	}
+
+	bool map::remove_from_chunks(entity_id id)
+	{
+		auto const found = chunked_brushes.find(id);
+		if (found == chunked_brushes.end())
+			return false;
+
+		brush_chunks.remove(found->second);
+		chunked_brushes.erase(found);
+		unmerged_brushes.erase(id);
+		return true;
+	}
+
+	bool map::is_drawn_by_chunk(entity_id id) const
+	{
+		return chunked_brushes.contains(id) && !unmerged_brushes.contains(id);
+	}
+
+	void map::on_entity_changed(entity_id id)
+	{
+		if (entity_change_depth > 0)
+		{
+			changed_entities.push_back(id);
+			return;
+		}
+
+		map_entity* const e = find_entity(id);
+		if (e == nullptr)
+			return;
+
+		update_changed_entity(*e);
+	}
+
+	void map::begin_entity_changes() noexcept
+	{
+		++entity_change_depth;
+	}
+
+	void map::end_entity_changes()
+	{
+		assert(entity_change_depth > 0);
+		if (--entity_change_depth > 0)
+			return;
+
+		std::ranges::sort(changed_entities);
+		auto const duplicates = std::ranges::unique(changed_entities);
+		changed_entities.erase(duplicates.begin(), duplicates.end());
+
+		for (entity_id const id : changed_entities)
+		{
+			// Entities deleted later in the batch are skipped
+			map_entity* const e = find_entity(id);
+			if (e == nullptr)
+				continue;
+
+			bool has_changed_ancestor = false;
+			for (map_entity const* parent = e->get_parent(); parent != nullptr && !has_changed_ancestor; parent = parent->get_parent())
+				has_changed_ancestor = std::ranges::binary_search(changed_entities, parent->get_id());
+
+			if (!has_changed_ancestor)
+				update_changed_entity(*e);
+		}
+
+		changed_entities.clear();
+	}
+
+	void map::update_changed_entity(map_entity& e)
+	{
+		touch_entity(e);
+
+		e.for_each_recursive([this](map_entity const& child)
+		{
+			if (child.get_type() == entity_type::brush)
+			{
+				brush_entity const& b = static_cast<brush_entity const&>(child);
+				math::transform_matrix const world_transform = b.get_world_transform();
+				if (!brush_picking_outdated)
+					brush_picking.set_brush(b.get_id(), b.get_shared_mesh_def(), world_transform);
+				if (!brush_culling_outdated)
+					brush_culling.set_brush(b.get_id(), b.get_shared_mesh_def(), world_transform);
+				if (csg_enabled)
+					csg.set_brush(as_csg_id(b.get_id()), { b.get_shared_mesh_def(), world_transform });
+			}
+			return false;
+		});
+	}
+
+	void map::update_csg(math::milliseconds budget)
+	{
+		if (!csg_enabled)
+			return;
+
+		for (entity_id const id : csg_added_entities)
+		{
+			map_entity const* const e = find_entity(id);
+			if (e != nullptr && e->get_type() == entity_type::brush)
+			{
+				brush_entity const& b = static_cast<brush_entity const&>(*e);
+				csg.set_brush(as_csg_id(id), { b.get_shared_mesh_def(), b.get_world_transform() });
+			}
+		}
+		csg_added_entities.clear();
+
+		csg.update(budget);
+	}
+
+	void map::update_static_brushes(math::seconds dt, math::milliseconds budget)
+	{
+		for (auto it = dynamic_brushes.begin(); it != dynamic_brushes.end();)
+		{
+			it->second += dt;
+			if (it->second < static_brush_delay)
+			{
+				++it;
+				continue;
+			}
+
+			brush_entity* const b = find_brush(it->first);
+			if (b != nullptr)
+			{
+				b->get_node().set_static(true);
+				chunked_brushes[b->get_id()] = brush_chunks.add(b->get_shared_mesh_def(), b->get_world_transform(), b->get_item().get_material());
+				unmerged_brushes.insert(b->get_id());
+			}
+			it = dynamic_brushes.erase(it);
+		}
+
+		brush_chunks.update(budget);
+
+		// Brushes are hidden once their chunk draws them
+		std::erase_if(unmerged_brushes, [this](entity_id id)
+		{
+			if (brush_chunks.is_pending(brush_chunks.get_grid().get_part_chunk(chunked_brushes.at(id))))
+				return false;
+
+			find_brush(id)->get_node().set_visible(false);
+			return true;
+		});
+	}
+
+	map::node_counts map::count_nodes() const noexcept
+	{
+		node_counts counts;
+		for (uptr<map_entity> const& e : entities)
+		{
+			if (e == nullptr)
+				continue;
+
+			if (e->get_node().is_static())
+				++counts.static_nodes;
+			else
+				++counts.dynamic_nodes;
+		}
+		return counts;
+	}
+
+	void map::update_brush_culling(math::point3f eye, math::frustum const& f)
+	{
+		if (!brush_culling_enabled)
+			return;
+
+		if (brush_culling_outdated)
+		{
+			brush_culling.clear();
+			for (uptr<map_entity> const& e : entities)
+			{
+				if (e != nullptr && e->get_type() == entity_type::brush)
+				{
+					brush_entity const& b = static_cast<brush_entity const&>(*e);
+					brush_culling.set_brush(b.get_id(), b.get_shared_mesh_def(), b.get_world_transform());
+				}
+			}
+			brush_culling_outdated = false;
+		}
+
+		brush_culling.get_visible_brushes(eye, f, visible_brushes);
+		std::sort(visible_brushes.begin(), visible_brushes.end());
+
+		// A chunk is drawn when any of its brushes is visible
+		culled_brush_count = 0;
+		visible_chunks.clear();
+		for (uptr<map_entity> const& e : entities)
+		{
+			if (e == nullptr || e->get_type() != entity_type::brush)
+				continue;
+
+			bool const visible = std::binary_search(visible_brushes.begin(), visible_brushes.end(), e->get_id());
+			if (!visible)
+				++culled_brush_count;
+
+			if (!is_drawn_by_chunk(e->get_id()))
+				e->get_node().set_visible(visible);
+			else if (visible)
+				visible_chunks.push_back(brush_chunks.get_grid().get_part_chunk(chunked_brushes.at(e->get_id())));
+		}
+
+		culled_chunk_count = brush_chunks.set_visible_chunks(visible_chunks);
+	}
+
+	void map::set_brush_culling(bool enabled)
+	{
+		if (enabled == brush_culling_enabled)
+			return;
+
+		brush_culling_enabled = enabled;
+		if (enabled)
+			return;
+
+		for (uptr<map_entity> const& e : entities)
+		{
+			if (e != nullptr && e->get_type() == entity_type::brush && !is_drawn_by_chunk(e->get_id()))
+				e->get_node().set_visible(true);
+		}
+		brush_chunks.show_all_chunks();
+		culled_brush_count = 0;
+		culled_chunk_count = 0;
+	}
+
+	void map::set_csg_enabled(bool enabled)
+	{
+		if (enabled == csg_enabled)
+			return;
+
+		csg_enabled = enabled;
+		csg.clear();
+		csg_added_entities.clear();
+		if (!enabled)
+			return;
+
+		// Brushes are read by the next update, like added entities
+		for (uptr<map_entity> const& e : entities)
+		{
+			if (e != nullptr && e->get_type() == entity_type::brush)
+				csg_added_entities.push_back(e->get_id());
+		}
+	}
+
+	std::optional<brush_bvh::hit> map::raycast_brushes(math::ray const& r, entity_id ignored) const
+	{
+		if (brush_picking_outdated)
+		{
+			brush_picking.clear();
+			for (uptr<map_entity> const& e : entities)
+			{
+				if (e != nullptr && e->get_type() == entity_type::brush)
+				{
+					brush_entity const& b = static_cast<brush_entity const&>(*e);
+					brush_picking.set_brush(b.get_id(), b.get_shared_mesh_def(), b.get_world_transform());
+				}
+			}
+			brush_picking_outdated = false;
+		}
+
+		return brush_picking.raycast(r, ignored);
+	}
 }
@@ -1,26 +1,40 @@
 #pragma once
 
 #include "map.fwd.h"
+#include "entity_index.h"
+#include "brush_bvh.h"
+#include "brush_visibility.h"
+#include "serialize/byte_stream.h"
 
 #include "core/uptr.h"
 #include "core/directive.h"
 
 #include "egfx/mesh_definition.h"
+#include "egfx/csg.h"
 #include "egfx/object/mesh.h"
 #include "egfx/object/light.h"
+#include "egfx/object/chunked_meshes.h"
+#include "egfx/scene.fwd.h"
 #include "egfx/node.h"
 
 #include "math/transform_matrix.h"
+#include "math/frustum.h"
+#include "math/unit/time.h"
 
 #include <cassert>
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <expected>
 #include <system_error>
+#include <exception>
 
 namespace ot::dedit
 {	
 	[[nodiscard]] inline constexpr uint64_t as_int(entity_id i) noexcept { return static_cast<uint64_t>(i); }
+	// Brushes are applied in the order they were created
+	[[nodiscard]] inline constexpr egfx::csg::brush_id as_csg_id(entity_id i) noexcept { return static_cast<egfx::csg::brush_id>(as_int(i)); }
 	[[nodiscard]] constexpr std::string_view as_string(entity_type t) noexcept
 	{
 		switch (t)
@@ -143,8 +157,8 @@ namespace ot::dedit
 		[[nodiscard]] virtual egfx::node_cref get_node() const noexcept = 0;
 		[[nodiscard]] virtual std::string_view get_name() const noexcept = 0;
 		[[nodiscard]] virtual entity_type get_type() const noexcept = 0;
-		[[nodiscard]] virtual bool fwrite(std::FILE* f) const = 0;
-		[[nodiscard]] virtual bool fread(map_entity& parent, std::FILE* f) = 0;
+		[[nodiscard]] virtual bool fwrite(serialize::byte_stream& stream) const = 0;
+		[[nodiscard]] virtual bool fread(map_entity& parent, serialize::byte_stream& stream) = 0;
 		
 		[[nodiscard]] map_entity const* get_parent() const noexcept;
 		[[nodiscard]] map_entity* get_parent() noexcept;
@@ -200,8 +214,8 @@ namespace ot::dedit
 		[[nodiscard]] virtual egfx::node_cref get_node() const noexcept override { return node; }
 		[[nodiscard]] virtual std::string_view get_name() const noexcept override { return "Root"; }
 		[[nodiscard]] virtual entity_type get_type() const noexcept override { return type; }
-		virtual bool fwrite(std::FILE*) const override { return true; }
-		virtual bool fread(map_entity&, std::FILE*) override { return true; }
+		virtual bool fwrite(serialize::byte_stream&) const override { return true; }
+		virtual bool fread(map_entity&, serialize::byte_stream&) override { return true; }
 	};
 
 	// Entities which own their own scene node
@@ -217,14 +231,16 @@ namespace ot::dedit
 		[[nodiscard]] virtual egfx::node_ref get_node() noexcept override final { return node; }
 		[[nodiscard]] virtual egfx::node_cref get_node() const noexcept override final { return node; }
 		[[nodiscard]] virtual std::string_view get_name() const noexcept override final { return node.get_name(); }
-		[[nodiscard]] virtual bool fwrite(std::FILE* file) const override;
-		[[nodiscard]] virtual bool fread(map_entity& parent, std::FILE* file) override;
+		[[nodiscard]] virtual bool fwrite(serialize::byte_stream& stream) const override;
+		[[nodiscard]] virtual bool fread(map_entity& parent, serialize::byte_stream& stream) override;
 	};
 
 	class brush_entity final : public node_entity
 	{
 		std::shared_ptr<egfx::mesh_definition const> mesh_def;
-		egfx::mesh mesh;
+		std::shared_ptr<egfx::mesh> mesh; // shared with the other brushes with the same definition, see brush_mesh_cache
+
+		void set_mesh(std::shared_ptr<egfx::mesh> new_mesh);
 
 	public:
 		static constexpr entity_type type = entity_type::brush;
@@ -239,10 +255,12 @@ namespace ot::dedit
 		[[nodiscard]] egfx::item_cref get_item() const noexcept { return get_node().get_object(0).as<egfx::item_cref>(); }
 				
 		[[nodiscard]] virtual entity_type get_type() const noexcept override { return type; }
-		[[nodiscard]] virtual bool fwrite(std::FILE* file) const override;
-		[[nodiscard]] virtual bool fread(map_entity& parent, std::FILE* file) override;
+		[[nodiscard]] virtual bool fwrite(serialize::byte_stream& stream) const override;
+		[[nodiscard]] virtual bool fread(map_entity& parent, serialize::byte_stream& stream) override;
 
 		void reload_node(std::shared_ptr<egfx::mesh_definition const> new_def);
+		// Only rewrites the render data of the faces marked dirty in the new definition, then clears them
+		void update_node(std::shared_ptr<egfx::mesh_definition> new_def);
 	};
 
 	using brush = brush_entity; // not renaming everything for now
@@ -255,8 +273,8 @@ namespace ot::dedit
 		light_entity(entity_id id);
 		light_entity(entity_id id, map_entity& parent, egfx::light_type type);
 
-		[[nodiscard]] virtual bool fwrite(std::FILE* file) const override;
-		[[nodiscard]] virtual bool fread(map_entity& parent, std::FILE* file) override;
+		[[nodiscard]] virtual bool fwrite(serialize::byte_stream& stream) const override;
+		[[nodiscard]] virtual bool fread(map_entity& parent, serialize::byte_stream& stream) override;
 		[[nodiscard]] virtual entity_type get_type() const noexcept override { return type; }
 
 		[[nodiscard]] egfx::light_ref get_light() noexcept { return get_node().get_object(0).as<egfx::light_ref>(); }
@@ -266,20 +284,57 @@ namespace ot::dedit
 	class map
 	{
 		uint64_t next_entity_id = 0;
-		std::vector<uptr<map_entity>> entities;
+		std::vector<uptr<map_entity>> entities; // indexed by slot, null for free slots
+		entity_index index;
 		root_entity root;
+		mutable brush_bvh brush_picking;
+		mutable bool brush_picking_outdated = false; // entities were added, the hierarchy is rebuilt on the next pick
+		egfx::csg::incremental_evaluator csg; // only holds the brushes while the csg is enabled
+		std::vector<entity_id> csg_added_entities; // added entities, given to the evaluator on the next update once they are read
+		bool csg_enabled = false;
+		std::unordered_map<entity_id, math::seconds> dynamic_brushes; // brushes whose nodes are dynamic, with the time since they last changed
+		egfx::chunked_meshes brush_chunks; // static brushes are drawn merged with their neighbours, their own items are hidden
+		std::unordered_map<entity_id, egfx::chunk_part_id> chunked_brushes;
+		std::unordered_set<entity_id> unmerged_brushes; // chunked brushes still drawn by their own item until their chunk is built
+		brush_visibility brush_culling;
+		bool brush_culling_outdated = false; // entities were added, the grid is filled again on the next update
+		bool brush_culling_enabled = false;
+		size_t culled_brush_count = 0;
+		size_t culled_chunk_count = 0;
+		std::vector<entity_id> visible_brushes; // kept between updates for its memory
+		std::vector<egfx::chunk_coord> visible_chunks; // kept between updates for its memory, may hold duplicates
+		size_t entity_change_depth = 0; // number of batches of changes opened and not yet ended
+		std::vector<entity_id> changed_entities; // entities changed in the current batch, kept between batches for its memory
 
 		void on_new_entity(entity_id id);
+		void touch_entity(map_entity& e);
+		void update_changed_entity(map_entity& e);
+		// Returns whether the brush was merged into a chunk
+		bool remove_from_chunks(entity_id id);
+		// Whether the brush is drawn by its chunk instead of its own item
+		[[nodiscard]] bool is_drawn_by_chunk(entity_id id) const;
+		void add_entity(entity_id parent, uptr<map_entity> e);
 
 	public:
-		map(egfx::node_ref root_node);
+		// Brushes left untouched for this long get static nodes, which the scene skips every frame, and are merged into chunks
+		static constexpr math::seconds static_brush_delay{ 2.f };
+
+		struct node_counts
+		{
+			size_t static_nodes = 0;
+			size_t dynamic_nodes = 0;
+		};
+
+		explicit map(egfx::scene& s);
 				
 		root_entity& get_root() noexcept { return root; }
+		root_entity const& get_root() const noexcept { return root; }
 
 		[[nodiscard]] entity_id allocate_entity_id();
 
+		// Creates an entity without its scene node, for it to be read. The entity is expected to attach its node to 'parent'
 		template<typename... Args>
-		map_entity& make_default_entity(entity_type type, entity_id id, Args&&... args)
+		map_entity& make_default_entity(entity_type type, entity_id id, map_entity& parent, Args&&... args)
 		{
 			switch (type)
 			{
@@ -287,10 +342,10 @@ namespace ot::dedit
 				throw std::invalid_argument("Cannot create root entities");
 
 			case entity_type::brush:
-				return make_default_entity<brush_entity>(id, ot::forward<Args>(args)...);
+				return make_default_entity<brush_entity>(id, parent, ot::forward<Args>(args)...);
 
 			case entity_type::light:
-				return make_default_entity<light_entity>(id, ot::forward<Args>(args)...);
+				return make_default_entity<light_entity>(id, parent, ot::forward<Args>(args)...);
 
 			default:
 				assert(false);
@@ -299,19 +354,21 @@ namespace ot::dedit
 		}
 
 		template<typename EntityType, typename... Args>
-		EntityType& make_default_entity(entity_id id, Args&&... args)
+		EntityType& make_default_entity(entity_id id, map_entity& parent, Args&&... args)
 		{
-			on_new_entity(id);
-			entities.push_back(ot::make_unique<EntityType>(id, ot::forward<Args>(args)...));
-			return static_cast<EntityType&>(*entities.back());
+			auto e = ot::make_unique<EntityType>(id, ot::forward<Args>(args)...);
+			EntityType& created = *e;
+			add_entity(parent.get_id(), ot::as_movable(e));
+			return created;
 		}
 
 		template<typename EntityType, typename... Args>
 		EntityType& make_entity(entity_id id, map_entity& parent, Args&&... args)
 		{
-			on_new_entity(id);
-			entities.push_back(ot::make_unique<EntityType>(id, parent, ot::forward<Args>(args)...));
-			return static_cast<EntityType&>(*entities.back());
+			auto e = ot::make_unique<EntityType>(id, parent, ot::forward<Args>(args)...);
+			EntityType& created = *e;
+			add_entity(parent.get_id(), ot::as_movable(e));
+			return created;
 		}
 
 		template<typename EntityType, typename... Args>
@@ -320,6 +377,7 @@ namespace ot::dedit
 			return make_entity<EntityType>(id, get_root(), ot::forward<Args>(args)...);
 		}
 
+		// Deletes the entity and all its children
 		void delete_entity(entity_id id);
 
 		void clear();
@@ -335,5 +393,77 @@ namespace ot::dedit
 		[[nodiscard]] bool has_entity(entity_id id) const { return find_entity(id) != nullptr; }
 
 		[[nodiscard]] std::expected<entity_type, std::error_code> get_entity_type(entity_id id) const;
+
+		// Must be called after the transform of the entity or the mesh of a brush changes, to update the brushes at and under the entity for picking and csg
+		// The brushes are also made dynamic again, until they are left untouched for 'static_brush_delay'
+		void on_entity_changed(entity_id id);
+		// Until the matching end_entity_changes, on_entity_changed only records the entity. Batches can be nested, entity_change_batch pairs the calls
+		// Ending the outermost batch updates each changed entity once, skipping the entities under another changed entity as they are updated with it
+		void begin_entity_changes() noexcept;
+		void end_entity_changes();
+
+		// Makes the brushes unchanged for 'static_brush_delay' static and merges them into chunks, then rebuilds the chunks which changed for at most 'budget'
+		// After a load every brush becomes static at once, the chunks are then built over the next frames. Brushes are drawn by their own item until their chunk is built
+		void update_static_brushes(math::seconds dt, math::milliseconds budget);
+		[[nodiscard]] egfx::chunked_meshes const& get_brush_chunks() const noexcept { return brush_chunks; }
+		[[nodiscard]] size_t get_chunked_brush_count() const noexcept { return chunked_brushes.size(); }
+		[[nodiscard]] node_counts count_nodes() const noexcept;
+
+		// Hides the brushes which cannot be seen from the eye or are out of the frustum, while brush culling is enabled
+		// Brushes merged into chunks are hidden with their chunk, when none of the brushes of the chunk is visible
+		// Visibility is conservative, see brush_visibility. Changing a brush only updates the grid around it
+		void update_brush_culling(math::point3f eye, math::frustum const& f);
+		// Disabling brush culling shows the hidden brushes again
+		void set_brush_culling(bool enabled);
+		[[nodiscard]] bool is_brush_culling_enabled() const noexcept { return brush_culling_enabled; }
+		[[nodiscard]] size_t get_culled_brush_count() const noexcept { return culled_brush_count; }
+		[[nodiscard]] size_t get_culled_chunk_count() const noexcept { return culled_chunk_count; }
+		[[nodiscard]] brush_visibility const& get_brush_visibility() const noexcept { return brush_culling; }
+
+		// Re-evaluates the csg of the brushes affected by the changes since the last update, for at most 'budget', while the csg is enabled
+		void update_csg(math::milliseconds budget);
+		// Nothing renders the csg yet, so it is only kept up to date while enabled for inspection. Enabling it evaluates every brush again
+		void set_csg_enabled(bool enabled);
+		[[nodiscard]] bool is_csg_enabled() const noexcept { return csg_enabled; }
+		[[nodiscard]] egfx::csg::incremental_evaluator const& get_csg() const noexcept { return csg; }
+
+		// Returns the brush whose faces the world-space ray hits first, other than 'ignored'
+		[[nodiscard]] std::optional<brush_bvh::hit> raycast_brushes(math::ray const& r, entity_id ignored = entity_id::root) const;
+	};
+
+	// Batches the entity changes of its lifetime, ending the batch even when leaving through an exception
+	// The entities changed before the exception are still updated, errors while updating them being dropped to let the first exception through
+	class entity_change_batch
+	{
+		map& m;
+		int exception_count;
+
+	public:
+		explicit entity_change_batch(map& m) noexcept
+			: m(m)
+			, exception_count(std::uncaught_exceptions())
+		{
+			m.begin_entity_changes();
+		}
+
+		entity_change_batch(entity_change_batch const&) = delete;
+		entity_change_batch& operator=(entity_change_batch const&) = delete;
+
+		~entity_change_batch() noexcept(false)
+		{
+			if (std::uncaught_exceptions() == exception_count)
+			{
+				m.end_entity_changes();
+				return;
+			}
+
+			try
+			{
+				m.end_entity_changes();
+			}
+			catch (...)
+			{
+			}
+		}
 	};
 }
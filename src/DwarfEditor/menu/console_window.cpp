@@ -3,13 +3,73 @@
 #include "console.h"
 
 #include <imgui.h>
+#include <array>
 #include <optional>
+#include <vector>
 
 namespace ot::dedit::console_window
 {
 	const ImVec2 k_default_size(520, 600);
 	const ImVec2 k_item_spacing(4, 1);
 
+	namespace
+	{
+		std::array<bool, console::level_count> shown_levels{ true, true, true, true };
+		std::vector<uint64_t> shown_logs; // sequence numbers of the logs of the shown levels, kept between frames for its memory
+
+		char const* get_level_name(console::level_type level)
+		{
+			switch (level)
+			{
+			case console::level_type::verbose: return "Verbose";
+			case console::level_type::log: return "Log";
+			case console::level_type::warning: return "Warning";
+			case console::level_type::error: return "Error";
+			}
+			return "";
+		}
+
+		void draw_log(uint64_t sequence)
+		{
+			console::log_data log;
+			if (!console::read_log(sequence, log))
+			{
+				// Overwritten or still being written, the line keeps its place
+				ImGui::TextUnformatted("");
+				return;
+			}
+
+			std::optional<ImVec4> color;
+			char const* prefix = nullptr;
+			switch (log.level)
+			{
+			case console::level_type::verbose:
+				color = ImVec4(0.6f, 0.6f, 0.6f, 1.f);
+				break;
+			case console::level_type::warning:
+				prefix = "[warning]";
+				color = ImVec4(1.f, 1.f, 0.4f, 1.f);
+				break;
+			case console::level_type::error:
+				prefix = "[error]";
+				color = ImVec4(1.f, 0.4f, 0.4f, 1.f);
+				break;
+			}
+
+			if (color)
+				ImGui::PushStyleColor(ImGuiCol_Text, *color);
+
+			std::string_view const message = log.get_message();
+			if (prefix == nullptr)
+				ImGui::TextUnformatted(message.data(), message.data() + message.size());
+			else
+				ImGui::Text("%s %.*s", prefix, static_cast<int>(message.size()), message.data());
+
+			if (color)
+				ImGui::PopStyleColor();
+		}
+	}
+
 	void draw(bool* enabled)
 	{
 		ImGui::SetNextWindowSize(k_default_size, ImGuiCond_FirstUseEver);
@@ -19,9 +79,18 @@ namespace ot::dedit::console_window
 			return;
 		}
 
+		bool all_levels_shown = true;
+		for (size_t i = 0; i < console::level_count; ++i)
+		{
+			if (i > 0)
+				ImGui::SameLine();
+			ImGui::Checkbox(get_level_name(static_cast<console::level_type>(i)), &shown_levels[i]);
+			all_levels_shown = all_levels_shown && shown_levels[i];
+		}
+
 		{
 			ImGui::BeginChild("ScrollArea##Console", {}, false, ImGuiWindowFlags_HorizontalScrollbar);
-			
+
 			bool copy_log = false;
 			if (ImGui::BeginPopupContextWindow())
 			{
@@ -29,39 +98,47 @@ namespace ot::dedit::console_window
 				if (ImGui::Selectable("Clear")) console::clear();
 				ImGui::EndPopup();
 			}
-			
+
 			ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, k_item_spacing);
 
 			if (copy_log)
 				ImGui::LogToClipboard();
 
-			auto const logs = console::get_logs();
-			for (console::log_data const& log : logs)
+			// Only the levels of the ring are read when filtering, and only the visible lines are formatted and drawn
+			console::log_range const logs = console::get_logs();
+			shown_logs.clear();
+			if (!all_levels_shown)
 			{
-				std::optional<ImVec4> color;
-				std::string prefix;
-				switch (log.level)
+				for (uint64_t sequence = logs.begin; sequence != logs.end; ++sequence)
 				{
-				case console::level_type::warning: 
-					prefix = "[warning]";
-					color = ImVec4(1.f, 1.f, 0.4f, 1.f); 
-					break;
-				case console::level_type::error: 
-					prefix = "[error]";
-					color = ImVec4(1.f, 0.4f, 0.4f, 1.f); 
-					break;
+					console::level_type level;
+					if (console::read_log_level(sequence, level) && shown_levels[static_cast<size_t>(level)])
+						shown_logs.push_back(sequence);
 				}
+			}
 
-				if (color)
-					ImGui::PushStyleColor(ImGuiCol_Text, *color);
-
-				if (prefix.empty())
-					ImGui::TextUnformatted(log.message.c_str());
-				else
-					ImGui::Text("%s %s", prefix.c_str(), log.message.c_str());
+			auto const get_sequence = [&](int line)
+			{
+				return all_levels_shown ? logs.begin + static_cast<uint64_t>(line) : shown_logs[static_cast<size_t>(line)];
+			};
+			int const line_count = static_cast<int>(all_levels_shown ? logs.size() : shown_logs.size());
 
-				if (color)
-					ImGui::PopStyleColor();
+			// Every line goes to the clipboard
+			if (copy_log)
+			{
+				for (int line = 0; line < line_count; ++line)
+					draw_log(get_sequence(line));
+			}
+			else
+			{
+				ImGuiListClipper clipper;
+				clipper.Begin(line_count);
+				while (clipper.Step())
+				{
+					for (int line = clipper.DisplayStart; line < clipper.DisplayEnd; ++line)
+						draw_log(get_sequence(line));
+				}
+				clipper.End();
 			}
 
 			if (copy_log)
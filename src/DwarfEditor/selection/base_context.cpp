@@ -14,85 +14,12 @@
 
 namespace ot::dedit::selection
 {
-	namespace
-	{
-		bool hits_brush(math::ray const& mouse_ray, math::transform_matrix const& brush_transform, egfx::mesh_definition const& mesh)
-		{
-			for (egfx::face::cref const face : mesh.get_faces())
-			{
-				math::plane const local_plane = face.get_plane();
-				math::plane const world_plane = transform(local_plane, brush_transform);
-
-				auto const result = mouse_ray.intersects(world_plane);
-				if (result)
-				{
-					math::point3f const intersection = *result;
-					math::point3f const local_intersection = transform(intersection, invert(brush_transform));
-					if (face.is_on_face(local_intersection))
-					{
-						return true;
-					}
-				}
-			}
-
-			return false;
-		}
-	}
-
 	void base_context::do_selection()
 	{
 		math::ray const r = get_mouse_ray(*main_window, current_scene->get_camera());
 
-		auto const result = current_scene->raycast_objects(r);
-
-		for (egfx::object_id const hit_object : result)
-		{
-			auto const root_entities = current_map->get_root_entities();
-			map_entity const* found_entity = nullptr;
-			for (map_entity const& root_entity : root_entities)
-			{
-				bool const found = root_entity.for_each_recursive([hit_object, &found_entity](map_entity const& e)
-				{
-					if (e.get_node().contains(hit_object))
-					{
-						found_entity = &e;
-						return true;
-					}
-
-					return false;
-				});
-
-				if(found)
-					break;
-			}
-
-			if (found_entity == nullptr)
-				continue;
-
-			map_entity const& hit_entity = *found_entity;
-
-			entity_id const hit_entity_id = hit_entity.get_id();
-			if (hit_entity_id == selected_entity)
-				continue;
-			
-			switch (hit_entity.get_type())
-			{
-			case entity_type::brush:
-			{
-				brush const& b = static_cast<brush const&>(hit_entity);
-
-				if (hits_brush(r, b.get_world_transform(), b.get_mesh_def()))
-				{
-					select_entity(hit_entity_id);
-					return;
-				}
-
-				break;
-			}
-			default:
-				break;
-			}
-		}
+		if (auto const hit = current_map->raycast_brushes(r, selected_entity.value_or(entity_id::root)))
+			select_entity(hit->id);
 	}
 
 	void base_context::select_entity(entity_id entity)
@@ -114,7 +41,7 @@ namespace ot::dedit::selection
 		}
 		else
 		{
-			console::error(std::format("select_entity failed: invalid entity id '{}'", as_int(entity)));
+			console::error("select_entity failed: invalid entity id '{}'", as_int(entity));
 		}		
 	}
 
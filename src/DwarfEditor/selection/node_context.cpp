@@ -500,14 +500,28 @@ namespace ot::dedit::selection
 			{
 				math::point3f const vertex_pos = transform(vertex.get_position(), t);
 				Im3d::DrawPoint(vertex_pos, 10.f, Im3d::Color_Blue);
+			}
 
-				switch (vertex_debug)
+			switch (vertex_debug)
+			{
+			case vertex_debug_type::uv:
+				// Each face has its own uvs at a vertex, drawn slightly inside the face
+				for (egfx::face::cref const face : mesh_def.get_faces())
 				{
-				case vertex_debug_type::uv:
-					math::point2f const uv = vertex.get_uv();
-					Im3d::Text(vertex_pos, 2.f, Im3d::Color_White, Im3d::TextFlags_Default, "%.3f, %.3f", uv.x, uv.y);
-					break;
+					math::vector3f center_sum{ 0.f, 0.f, 0.f };
+					for (egfx::vertex::cref const vertex : face.get_vertices())
+						center_sum += vector_from_origin(vertex.get_position());
+					math::point3f const center = math::point3f{ 0.f, 0.f, 0.f } + center_sum / static_cast<float>(face.get_vertex_count());
+
+					for (egfx::half_edge::cref const corner : face.get_half_edges())
+					{
+						math::point3f const corner_pos = corner.get_source_vertex().get_position();
+						math::point3f const text_pos = transform(corner_pos + (center - corner_pos) * 0.2f, t);
+						math::point2f const uv = corner.get_uv();
+						Im3d::Text(text_pos, 2.f, Im3d::Color_White, Im3d::TextFlags_Default, "%.3f, %.3f", uv.x, uv.y);
+					}
 				}
+				break;
 			}
 		}
 	}
@@ -0,0 +1,55 @@
+#include "byte_stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ot::dedit::serialize
+{
+	void byte_stream::write(void const* data, size_t size)
+	{
+		if (size == 0)
+			return;
+
+		size_t const offset = bytes.size();
+		bytes.resize(offset + size);
+		std::memcpy(bytes.data() + offset, data, size);
+	}
+
+	size_t byte_stream::read(void* data, size_t size) noexcept
+	{
+		size_t const read_size = std::min(size, bytes.size() - read_offset);
+		if (read_size != 0)
+			std::memcpy(data, bytes.data() + read_offset, read_size);
+		read_offset += read_size;
+		return read_size;
+	}
+
+	void byte_stream::clear() noexcept
+	{
+		bytes.clear();
+		read_offset = 0;
+	}
+
+	void byte_stream::shrink_to_fit()
+	{
+		bytes.shrink_to_fit();
+	}
+
+	size_t fwrite(void const* data, size_t size, size_t count, byte_stream& stream)
+	{
+		stream.write(data, size * count);
+		return count;
+	}
+
+	size_t fread(void* data, size_t size, size_t count, byte_stream& stream) noexcept
+	{
+		if (size == 0)
+			return 0;
+
+		// Partial elements are left in the stream
+		size_t const remaining = stream.size() - stream.get_read_offset();
+		size_t const read_count = std::min(count, remaining / size);
+		(void)stream.read(data, read_count * size);
+		return read_count;
+	}
+}
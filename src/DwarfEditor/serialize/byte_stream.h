@@ -0,0 +1,39 @@
+#pragma once
+
+#include "core/size_t.h"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace ot::dedit::serialize
+{
+	// Growable buffer written and read like a file, for state kept in memory such as the entities of undoable deletes
+	// Writes append at the end, reads go forward from the start. Like files, reading past the end reads what is left and fails
+	class byte_stream
+	{
+		std::vector<std::byte> bytes;
+		size_t read_offset = 0;
+
+	public:
+		void write(void const* data, size_t size);
+		// Copies the next 'size' bytes to 'data'. Returns the number of bytes copied, less than 'size' at the end of the stream
+		[[nodiscard]] size_t read(void* data, size_t size) noexcept;
+
+		// Goes back to the start for reading
+		void rewind() noexcept { read_offset = 0; }
+		// Empties the stream, keeping its memory
+		void clear() noexcept;
+		// Frees the memory left over by the writes
+		void shrink_to_fit();
+
+		[[nodiscard]] size_t size() const noexcept { return bytes.size(); }
+		[[nodiscard]] size_t capacity() const noexcept { return bytes.capacity(); }
+		[[nodiscard]] size_t get_read_offset() const noexcept { return read_offset; }
+		[[nodiscard]] std::span<std::byte const> get_data() const noexcept { return bytes; }
+	};
+
+	// Same as std::fwrite and std::fread, on a byte_stream. Only whole elements are read
+	size_t fwrite(void const* data, size_t size, size_t count, byte_stream& stream);
+	size_t fread(void* data, size_t size, size_t count, byte_stream& stream) noexcept;
+}
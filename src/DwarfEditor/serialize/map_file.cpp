@@ -0,0 +1,518 @@
+#include "map_file.h"
+
+#include "egfx/mesh_definition.h"
+#include "egfx/mesh_definition_cache.h"
+
+#include "core/profiler.h"
+
+#include <bit>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+namespace ot::dedit::serialize
+{
+	namespace
+	{
+		[[nodiscard]] constexpr uint32_t make_tag(char const (&s)[5]) noexcept
+		{
+			return uint32_t(uint8_t(s[0])) | uint32_t(uint8_t(s[1])) << 8 | uint32_t(uint8_t(s[2])) << 16 | uint32_t(uint8_t(s[3])) << 24;
+		}
+
+		constexpr uint32_t entity_chunk_tag = make_tag("ENTS");
+		constexpr uint32_t name_chunk_tag = make_tag("NAME");
+		constexpr uint32_t plane_chunk_tag = make_tag("PLAN");
+
+		constexpr size_t header_size = 16;
+		constexpr size_t toc_entry_size = 24;
+		constexpr size_t chunk_alignment = 8;
+		constexpr uint32_t entity_record_size = 96;
+		constexpr size_t plane_size = 4 * sizeof(float);
+
+		// Appends fixed-width little-endian values to a buffer
+		class byte_writer
+		{
+			std::vector<std::byte>& buffer;
+
+		public:
+			explicit byte_writer(std::vector<std::byte>& buffer) noexcept
+				: buffer(buffer)
+			{
+
+			}
+
+			[[nodiscard]] size_t get_offset() const noexcept { return buffer.size(); }
+
+			void write_u32(uint32_t value)
+			{
+				for (size_t i = 0; i < 4; ++i)
+					buffer.push_back(std::byte(value >> (8 * i)));
+			}
+
+			void write_u64(uint64_t value)
+			{
+				for (size_t i = 0; i < 8; ++i)
+					buffer.push_back(std::byte(value >> (8 * i)));
+			}
+
+			void write_f32(float value) { write_u32(std::bit_cast<uint32_t>(value)); }
+
+			void write_bytes(std::span<std::byte const> bytes) { buffer.insert(buffer.end(), bytes.begin(), bytes.end()); }
+
+			void align(size_t alignment) { buffer.resize((buffer.size() + alignment - 1) / alignment * alignment); }
+
+			void patch_u64(size_t offset, uint64_t value) noexcept
+			{
+				for (size_t i = 0; i < 8; ++i)
+					buffer[offset + i] = std::byte(value >> (8 * i));
+			}
+		};
+
+		// Reads fixed-width little-endian values from a span of bytes
+		// Reading past the end returns zeroes and puts the reader in a failed state, so that a record can be checked once after all its fields are read
+		class byte_reader
+		{
+			std::span<std::byte const> data;
+			size_t offset = 0;
+			bool failed = false;
+
+			[[nodiscard]] std::byte const* consume(size_t size) noexcept
+			{
+				if (failed || data.size() - offset < size)
+				{
+					failed = true;
+					return nullptr;
+				}
+
+				std::byte const* const p = data.data() + offset;
+				offset += size;
+				return p;
+			}
+
+			template<typename T>
+			[[nodiscard]] T read_unsigned() noexcept
+			{
+				std::byte const* const p = consume(sizeof(T));
+				if (p == nullptr)
+					return 0;
+
+				T value = 0;
+				for (size_t i = 0; i < sizeof(T); ++i)
+					value |= T(std::to_integer<uint8_t>(p[i])) << (8 * i);
+				return value;
+			}
+
+		public:
+			explicit byte_reader(std::span<std::byte const> data) noexcept
+				: data(data)
+			{
+
+			}
+
+			[[nodiscard]] bool has_failed() const noexcept { return failed; }
+			[[nodiscard]] size_t get_offset() const noexcept { return offset; }
+			[[nodiscard]] size_t get_remaining() const noexcept { return data.size() - offset; }
+
+			[[nodiscard]] uint8_t read_u8() noexcept { return read_unsigned<uint8_t>(); }
+			[[nodiscard]] uint32_t read_u32() noexcept { return read_unsigned<uint32_t>(); }
+			[[nodiscard]] uint64_t read_u64() noexcept { return read_unsigned<uint64_t>(); }
+			[[nodiscard]] float read_f32() noexcept { return std::bit_cast<float>(read_u32()); }
+
+			[[nodiscard]] std::span<std::byte const> read_bytes(size_t size) noexcept
+			{
+				std::byte const* const p = consume(size);
+				return p != nullptr ? std::span<std::byte const>(p, size) : std::span<std::byte const>{};
+			}
+
+			void skip(size_t size) noexcept { (void)consume(size); }
+		};
+
+		[[nodiscard]] std::string_view as_string_view(std::span<std::byte const> bytes) noexcept
+		{
+			return { reinterpret_cast<char const*>(bytes.data()), bytes.size() };
+		}
+
+		[[nodiscard]] bool is_valid_type(entity_type type) noexcept
+		{
+			return type == entity_type::brush || type == entity_type::light;
+		}
+
+		// Planes are a blob of little-endian floats. On little-endian hosts, this is the in-memory layout of math::plane
+		void read_planes(std::span<std::byte const> bytes, std::span<math::plane> planes)
+		{
+			static_assert(sizeof(math::plane) == plane_size);
+			if constexpr (std::endian::native == std::endian::little)
+			{
+				std::memcpy(planes.data(), bytes.data(), planes.size_bytes());
+			}
+			else
+			{
+				byte_reader reader(bytes);
+				for (math::plane& p : planes)
+				{
+					p.normal.x = reader.read_f32();
+					p.normal.y = reader.read_f32();
+					p.normal.z = reader.read_f32();
+					p.distance = reader.read_f32();
+				}
+			}
+		}
+
+		// Version 1 is the in-memory layout of the fields on x64 Windows, written field by field as a tree of entities
+		bool parse_version_1(byte_reader& reader, map_records& records)
+		{
+			struct pending_children
+			{
+				entity_id parent_id;
+				uint64_t remaining;
+			};
+
+			std::vector<pending_children> stack;
+			stack.push_back({ entity_id::root, reader.read_u64() });
+
+			while (!stack.empty())
+			{
+				if (stack.back().remaining == 0)
+				{
+					stack.pop_back();
+					continue;
+				}
+
+				--stack.back().remaining;
+
+				entity_id const id = static_cast<entity_id>(reader.read_u64());
+				entity_type const type = static_cast<entity_type>(reader.read_u32());
+				if (reader.has_failed())
+					return false;
+
+				// Root entities have no data, and their children are root entities
+				entity_id children_parent_id = entity_id::root;
+				if (type != entity_type::root)
+				{
+					if (!is_valid_type(type))
+						return false;
+
+					entity_record& e = records.entities.emplace_back();
+					e.id = id;
+					e.parent_id = stack.back().parent_id;
+					e.type = type;
+
+					uint64_t const name_size = reader.read_u64();
+					e.name = as_string_view(reader.read_bytes(name_size));
+					e.position = { reader.read_f32(), reader.read_f32(), reader.read_f32() };
+					e.rotation.w = reader.read_f32();
+					e.rotation.x = reader.read_f32();
+					e.rotation.y = reader.read_f32();
+					e.rotation.z = reader.read_f32();
+					e.scale = { reader.read_f32(), reader.read_f32(), reader.read_f32() };
+
+					if (type == entity_type::brush)
+					{
+						uint64_t const face_count = reader.read_u64();
+						if (face_count > reader.get_remaining() / plane_size)
+							return false;
+
+						e.first_plane = static_cast<uint32_t>(records.planes.size());
+						e.plane_count = static_cast<uint32_t>(face_count);
+						records.planes.resize(records.planes.size() + face_count);
+						read_planes(reader.read_bytes(face_count * plane_size), std::span(records.planes).subspan(e.first_plane));
+					}
+					else
+					{
+						e.light_type = static_cast<egfx::light_type>(reader.read_u8());
+						e.power_scale = reader.read_f32();
+						e.diffuse = { reader.read_f32(), reader.read_f32(), reader.read_f32() };
+					}
+
+					children_parent_id = id;
+				}
+
+				uint64_t const child_count = reader.read_u64();
+				if (reader.has_failed())
+					return false;
+
+				stack.push_back({ children_parent_id, child_count });
+			}
+
+			return true;
+		}
+
+		struct chunk_view
+		{
+			std::span<std::byte const> data;
+			bool found = false;
+		};
+
+		bool parse_version_2(std::span<std::byte const> data, byte_reader& reader, map_records& records)
+		{
+			uint32_t const chunk_count = reader.read_u32();
+			reader.skip(sizeof(uint32_t));
+
+			chunk_view entity_chunk, name_chunk, plane_chunk;
+			for (uint32_t i = 0; i < chunk_count; ++i)
+			{
+				uint32_t const tag = reader.read_u32();
+				reader.skip(sizeof(uint32_t));
+				uint64_t const offset = reader.read_u64();
+				uint64_t const size = reader.read_u64();
+				if (reader.has_failed() || offset > data.size() || size > data.size() - offset)
+					return false;
+
+				chunk_view* const chunk = tag == entity_chunk_tag ? &entity_chunk
+					: tag == name_chunk_tag ? &name_chunk
+					: tag == plane_chunk_tag ? &plane_chunk
+					: nullptr;
+
+				if (chunk != nullptr)
+				{
+					chunk->data = data.subspan(offset, size);
+					chunk->found = true;
+				}
+			}
+
+			if (!entity_chunk.found || !name_chunk.found || !plane_chunk.found)
+				return false;
+
+			if (plane_chunk.data.size() % plane_size != 0)
+				return false;
+
+			records.planes.resize(plane_chunk.data.size() / plane_size);
+			read_planes(plane_chunk.data, records.planes);
+
+			byte_reader entity_reader(entity_chunk.data);
+			uint32_t const entity_count = entity_reader.read_u32();
+			uint32_t const record_size = entity_reader.read_u32();
+			if (entity_reader.has_failed() || record_size < entity_record_size || entity_count > entity_chunk.data.size() / record_size)
+				return false;
+
+			records.entities.resize(entity_count);
+			for (entity_record& e : records.entities)
+			{
+				size_t const record_start = entity_reader.get_offset();
+
+				e.id = static_cast<entity_id>(entity_reader.read_u64());
+				e.parent_id = static_cast<entity_id>(entity_reader.read_u64());
+				e.type = static_cast<entity_type>(entity_reader.read_u32());
+				uint32_t const name_offset = entity_reader.read_u32();
+				uint32_t const name_size = entity_reader.read_u32();
+				e.position = { entity_reader.read_f32(), entity_reader.read_f32(), entity_reader.read_f32() };
+				e.rotation.w = entity_reader.read_f32();
+				e.rotation.x = entity_reader.read_f32();
+				e.rotation.y = entity_reader.read_f32();
+				e.rotation.z = entity_reader.read_f32();
+				e.scale = { entity_reader.read_f32(), entity_reader.read_f32(), entity_reader.read_f32() };
+				e.first_plane = entity_reader.read_u32();
+				e.plane_count = entity_reader.read_u32();
+				e.light_type = static_cast<egfx::light_type>(entity_reader.read_u32());
+				e.power_scale = entity_reader.read_f32();
+				e.diffuse = { entity_reader.read_f32(), entity_reader.read_f32(), entity_reader.read_f32() };
+
+				// Fields added by later versions of the record
+				entity_reader.skip(record_size - (entity_reader.get_offset() - record_start));
+
+				if (entity_reader.has_failed() || !is_valid_type(e.type))
+					return false;
+
+				if (name_offset > name_chunk.data.size() || name_size > name_chunk.data.size() - name_offset)
+					return false;
+
+				if (e.first_plane > records.planes.size() || e.plane_count > records.planes.size() - e.first_plane)
+					return false;
+
+				e.name = as_string_view(name_chunk.data.subspan(name_offset, name_size));
+			}
+
+			return true;
+		}
+	}
+
+	void write(map_records const& records, std::vector<std::byte>& buffer)
+	{
+		size_t const chunk_count = 3;
+		byte_writer writer(buffer);
+
+		size_t const file_start = writer.get_offset();
+		writer.write_u64(map_file_version);
+		writer.write_u32(chunk_count);
+		writer.write_u32(0);
+
+		// Chunk offsets and sizes are patched once each chunk is written
+		size_t const toc_start = writer.get_offset();
+		for (uint32_t const tag : { entity_chunk_tag, name_chunk_tag, plane_chunk_tag })
+		{
+			writer.write_u32(tag);
+			writer.write_u32(0);
+			writer.write_u64(0);
+			writer.write_u64(0);
+		}
+
+		size_t chunk_index = 0;
+		size_t chunk_start = 0;
+		auto const begin_chunk = [&]
+		{
+			writer.align(chunk_alignment);
+			chunk_start = writer.get_offset();
+		};
+		auto const end_chunk = [&]
+		{
+			size_t const toc_entry = toc_start + chunk_index * toc_entry_size;
+			writer.patch_u64(toc_entry + 8, chunk_start - file_start);
+			writer.patch_u64(toc_entry + 16, writer.get_offset() - chunk_start);
+			++chunk_index;
+		};
+
+		buffer.reserve(buffer.size() + header_size + chunk_count * toc_entry_size + 3 * chunk_alignment
+			+ 8 + records.entities.size() * entity_record_size
+			+ records.planes.size() * plane_size);
+
+		begin_chunk();
+		writer.write_u32(static_cast<uint32_t>(records.entities.size()));
+		writer.write_u32(entity_record_size);
+		uint32_t name_offset = 0;
+		for (entity_record const& e : records.entities)
+		{
+			writer.write_u64(static_cast<uint64_t>(e.id));
+			writer.write_u64(static_cast<uint64_t>(e.parent_id));
+			writer.write_u32(static_cast<uint32_t>(e.type));
+			writer.write_u32(name_offset);
+			writer.write_u32(static_cast<uint32_t>(e.name.size()));
+			writer.write_f32(e.position.x);
+			writer.write_f32(e.position.y);
+			writer.write_f32(e.position.z);
+			writer.write_f32(e.rotation.w);
+			writer.write_f32(e.rotation.x);
+			writer.write_f32(e.rotation.y);
+			writer.write_f32(e.rotation.z);
+			writer.write_f32(e.scale.x);
+			writer.write_f32(e.scale.y);
+			writer.write_f32(e.scale.z);
+			writer.write_u32(e.first_plane);
+			writer.write_u32(e.plane_count);
+			writer.write_u32(static_cast<uint32_t>(e.light_type));
+			writer.write_f32(e.power_scale);
+			writer.write_f32(e.diffuse.r);
+			writer.write_f32(e.diffuse.g);
+			writer.write_f32(e.diffuse.b);
+
+			name_offset += static_cast<uint32_t>(e.name.size());
+		}
+		end_chunk();
+
+		begin_chunk();
+		for (entity_record const& e : records.entities)
+			writer.write_bytes(std::as_bytes(std::span(e.name)));
+		end_chunk();
+
+		begin_chunk();
+		for (math::plane const& p : records.planes)
+		{
+			writer.write_f32(p.normal.x);
+			writer.write_f32(p.normal.y);
+			writer.write_f32(p.normal.z);
+			writer.write_f32(p.distance);
+		}
+		end_chunk();
+	}
+
+	bool fwrite(map_records const& records, std::FILE* f)
+	{
+		std::vector<std::byte> buffer;
+		write(records, buffer);
+		return ::fwrite(buffer.data(), 1, buffer.size(), f) == buffer.size();
+	}
+
+	bool parse(std::span<std::byte const> data, map_records& records)
+	{
+		records.entities.clear();
+		records.planes.clear();
+
+		byte_reader reader(data);
+		uint64_t const version = reader.read_u64();
+		if (reader.has_failed())
+			return false;
+
+		switch (version)
+		{
+		case 1: return parse_version_1(reader, records);
+		case 2: return parse_version_2(data, reader, records);
+		default: return false;
+		}
+	}
+
+	namespace
+	{
+		template<typename BuildMesh>
+		std::vector<std::shared_ptr<egfx::mesh_definition const>> build_brush_meshes_with(map_records const& records, size_t thread_count, BuildMesh const& build_mesh)
+		{
+			std::vector<std::shared_ptr<egfx::mesh_definition const>> meshes(records.entities.size());
+
+			// Records are handed out in small batches: brushes vary a lot in cost, and a static split would leave threads idle
+			size_t const batch_size = 64;
+			size_t const batch_count = (records.entities.size() + batch_size - 1) / batch_size;
+			std::atomic<size_t> next_batch = 0;
+			std::atomic<bool> failed = false;
+			std::exception_ptr first_exception;
+
+			auto const build_batches = [&]
+			{
+				OT_PROFILE_ZONE("build_brush_meshes");
+				for (size_t batch = next_batch++; batch < batch_count && !failed; batch = next_batch++)
+				{
+					size_t const end = std::min(records.entities.size(), (batch + 1) * batch_size);
+					for (size_t i = batch * batch_size; i < end; ++i)
+					{
+						entity_record const& e = records.entities[i];
+						if (e.type != entity_type::brush)
+							continue;
+
+						try
+						{
+							meshes[i] = build_mesh(records.get_planes(e));
+						}
+						catch (...)
+						{
+							// Only the first failing thread writes the exception
+							if (!failed.exchange(true))
+								first_exception = std::current_exception();
+							return;
+						}
+					}
+				}
+			};
+
+			if (thread_count == 0)
+				thread_count = std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+			thread_count = std::min(thread_count, batch_count);
+
+			// The calling thread takes part in the work
+			std::vector<std::jthread> workers;
+			for (size_t t = 1; t < thread_count; ++t)
+				workers.emplace_back(build_batches);
+			build_batches();
+			workers.clear();
+
+			if (first_exception)
+				std::rethrow_exception(first_exception);
+
+			return meshes;
+		}
+	}
+
+	std::vector<std::shared_ptr<egfx::mesh_definition const>> build_brush_meshes(map_records const& records, size_t thread_count)
+	{
+		return build_brush_meshes_with(records, thread_count, [](std::span<math::plane const> planes)
+		{
+			return std::make_shared<egfx::mesh_definition const>(planes);
+		});
+	}
+
+	std::vector<std::shared_ptr<egfx::mesh_definition const>> build_brush_meshes(map_records const& records, egfx::mesh_definition_cache& cache, size_t thread_count)
+	{
+		return build_brush_meshes_with(records, thread_count, [&cache](std::span<math::plane const> planes)
+		{
+			return cache.get(planes);
+		});
+	}
+}
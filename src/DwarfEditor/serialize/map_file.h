@@ -0,0 +1,85 @@
+#pragma once
+
+#include "map.fwd.h"
+
+#include "egfx/mesh_definition.fwd.h"
+#include "egfx/object/light.fwd.h"
+#include "egfx/color.h"
+
+#include "math/vector3.h"
+#include "math/plane.h"
+#include "math/quaternion.h"
+#include "math/transform_matrix.h"
+
+#include "core/stdint.h"
+
+#include <cstdio>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace ot::dedit::serialize
+{
+	// Version written by 'write'. Older versions can still be parsed
+	inline constexpr uint64_t map_file_version = 2;
+
+	// Flat description of an entity of a map file, independent from the scene
+	struct entity_record
+	{
+		entity_id id;
+		entity_id parent_id = entity_id::root;
+		entity_type type;
+		std::string_view name; // points into the parsed data, or the entity being written
+		math::point3f position;
+		math::quaternion rotation = math::quaternion::identity();
+		math::scales scale{ 1.f, 1.f, 1.f };
+
+		// Brushes: range of the brush's faces in map_records::planes
+		uint32_t first_plane = 0;
+		uint32_t plane_count = 0;
+
+		// Lights
+		egfx::light_type light_type{};
+		float power_scale = 1.f;
+		egfx::color diffuse = egfx::color::white();
+	};
+
+	// Content of a map file. Entities are ordered so that parents come before their children
+	struct map_records
+	{
+		std::vector<entity_record> entities;
+		std::vector<math::plane> planes; // planes of every brush, contiguous per brush
+
+		[[nodiscard]] std::span<math::plane const> get_planes(entity_record const& e) const noexcept
+		{
+			return std::span<math::plane const>(planes).subspan(e.first_plane, e.plane_count);
+		}
+	};
+
+	// Appends the records to 'buffer' in the current version of the format
+	//
+	// Version 2 layout, every field fixed-width little-endian:
+	//   u64 version, u32 chunk count, u32 reserved
+	//   table of contents: per chunk, u32 tag, u32 reserved, u64 offset from the start of the file, u64 size
+	//   chunks, 8-byte aligned:
+	//     'ENTS': u32 entity count, u32 record size, then one fixed-size record per entity
+	//     'NAME': names of every entity, referred to by offset and size from the entity records
+	//     'PLAN': planes of every brush as f32 normal x, y, z and distance, referred to by range from the entity records
+	// Unknown chunks are skipped by readers, and records can grow new fields at their end
+	void write(map_records const& records, std::vector<std::byte>& buffer);
+	[[nodiscard]] bool fwrite(map_records const& records, std::FILE* f);
+
+	// Parses the content of a map file of any supported version into 'records'
+	// Names in the records point into 'data', which must outlive them
+	// Returns false if the data is not a valid map file
+	[[nodiscard]] bool parse(std::span<std::byte const> data, map_records& records);
+
+	// Builds the mesh of every brush record, spread over 'thread_count' threads (0 for one per hardware thread)
+	// The result has one entry per record, null for entities other than brushes
+	// Throws std::invalid_argument if the planes of a brush do not form a closed volume
+	[[nodiscard]] std::vector<std::shared_ptr<egfx::mesh_definition const>> build_brush_meshes(map_records const& records, size_t thread_count = 0);
+	// Same, sharing the meshes of brushes with the same planes through the cache
+	[[nodiscard]] std::vector<std::shared_ptr<egfx::mesh_definition const>> build_brush_meshes(map_records const& records, egfx::mesh_definition_cache& cache, size_t thread_count = 0);
+}
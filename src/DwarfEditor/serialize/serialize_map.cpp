@@ -1,65 +1,151 @@
 #include "serialize_map.h"
 
+#include "brush_mesh_cache.h"
+
 #include <cstdio>
+#include <stdexcept>
 
 namespace ot::dedit::serialize
 {
-	bool fwrite(map_entity const& e, std::FILE* f)
+	bool fwrite(map_entity const& e, byte_stream& stream)
 	{
 		entity_id const id = e.get_id();
-		if (!::fwrite(&id, sizeof(id), 1, f))
+		if (!fwrite(&id, sizeof(id), 1, stream))
 			return false;
 
 		entity_type const type = e.get_type();
-		if (!::fwrite(&type, sizeof(type), 1, f))
+		if (!fwrite(&type, sizeof(type), 1, stream))
 			return false;
 
-		if (!e.fwrite(f))
+		if (!e.fwrite(stream))
 			return false;
 
 		auto const children = e.get_children();
 		size_t const size = children.size();
-		if (!::fwrite(&size, sizeof(size), 1, f))
+		if (!fwrite(&size, sizeof(size), 1, stream))
 			return false;
 
 		for (map_entity const& child : children)
 		{
-			if (!fwrite(child, f))
+			if (!fwrite(child, stream))
 				return false;
 		}
 
 		return true;
 	}
 
-	bool fwrite(map const& m, std::FILE* f)
+	map_records make_records(map const& m)
 	{
-		size_t const version = 1;
-		if (!::fwrite(&version, sizeof(version), 1, f))
+		map_records records;
+		m.get_root().for_each_recursive([&records, &root = m.get_root()](map_entity const& e)
+		{
+			if (&e == &root)
+				return false;
+
+			egfx::node_cref const node = e.get_node();
+			entity_record& r = records.entities.emplace_back();
+			r.id = e.get_id();
+			r.parent_id = e.get_parent()->get_id();
+			r.type = e.get_type();
+			r.name = e.get_name();
+			r.position = node.get_position();
+			r.rotation = node.get_rotation();
+			r.scale = node.get_scale();
+
+			switch (r.type)
+			{
+			case entity_type::brush:
+			{
+				auto const faces = static_cast<brush_entity const&>(e).get_mesh_def().get_faces();
+				r.first_plane = static_cast<uint32_t>(records.planes.size());
+				r.plane_count = static_cast<uint32_t>(faces.size());
+				for (egfx::face::cref const face : faces)
+					records.planes.push_back(face.get_plane());
+				break;
+			}
+
+			case entity_type::light:
+			{
+				egfx::light_cref const light = static_cast<light_entity const&>(e).get_light();
+				r.light_type = light.get_light_type();
+				r.power_scale = light.get_power_scale();
+				r.diffuse = light.get_diffuse();
+				break;
+			}
+			}
+
 			return false;
+		});
 
-		auto const root_entities = m.get_root_entities();
-		size_t const root_entity_count = root_entities.size();
+		return records;
+	}
 
-		if (!::fwrite(&root_entity_count, sizeof(root_entity_count), 1, f))
+	bool load(map& m, map_records const& records)
+	{
+		// Building the meshes of brushes is the expensive part of loading, and is independent between brushes
+		// Creating scene nodes and render meshes must happen on the main thread, once every mesh is built
+		std::vector<std::shared_ptr<egfx::mesh_definition const>> meshes;
+		try
+		{
+			meshes = build_brush_meshes(records, get_brush_mesh_cache().get_definitions());
+		}
+		catch (std::invalid_argument const&)
+		{
 			return false;
+		}
 
-		for (map_entity const& e : root_entities)
+		// Records refer to their parent by id, and parents always come first
+		for (size_t i = 0; i < records.entities.size(); ++i)
 		{
-			if (!fwrite(e, f))
-				return false;			
+			entity_record const& r = records.entities[i];
+			map_entity* const parent_entity = m.find_entity(r.parent_id);
+			if (parent_entity == nullptr || m.has_entity(r.id))
+				return false;
+
+			map_entity& parent = *parent_entity;
+			map_entity* e = nullptr;
+			switch (r.type)
+			{
+			case entity_type::brush:
+				e = &m.make_entity<brush_entity>(r.id, parent, std::move(meshes[i]));
+				break;
+
+			case entity_type::light:
+			{
+				light_entity& light = m.make_entity<light_entity>(r.id, parent, r.light_type);
+				light.get_light().set_power_scale(r.power_scale);
+				light.get_light().set_diffuse(r.diffuse);
+				e = &light;
+				break;
+			}
+
+			default:
+				return false;
+			}
+
+			egfx::node_ref const node = e->get_node();
+			node.set_name(r.name);
+			node.set_position(r.position);
+			node.set_rotation(r.rotation);
+			node.set_scale(r.scale);
 		}
 
 		return true;
 	}
+
+	bool fwrite(map const& m, std::FILE* f)
+	{
+		return fwrite(make_records(m), f);
+	}
 	
-	bool fread(map& m, map_entity& parent, std::FILE* f, map_entity** new_entity)
+	bool fread(map& m, map_entity& parent, byte_stream& stream, map_entity** new_entity)
 	{
 		entity_id id;
-		if (!::fread(&id, sizeof(id), 1, f))
+		if (!fread(&id, sizeof(id), 1, stream))
 			return false;
 
 		entity_type type;
-		if (!::fread(&type, sizeof(type), 1, f))
+		if (!fread(&type, sizeof(type), 1, stream))
 			return false;
 
 		map_entity* current_entity = nullptr;
@@ -70,8 +156,8 @@ namespace ot::dedit::serialize
 			break;
 
 		default:
-			map_entity& e = m.make_default_entity(type, id);
-			if (!e.fread(parent, f))
+			map_entity& e = m.make_default_entity(type, id, parent);
+			if (!e.fread(parent, stream))
 				return false;
 
 			current_entity = &e;
@@ -85,38 +171,24 @@ namespace ot::dedit::serialize
 			*new_entity = current_entity;
 
 		size_t child_count;
-		if (!::fread(&child_count, sizeof(child_count), 1, f))
+		if (!fread(&child_count, sizeof(child_count), 1, stream))
 			return false;
 
 		for (size_t n = 0; n < child_count; ++n)
 		{
-			if (!fread(m, *current_entity, f))
+			if (!fread(m, *current_entity, stream))
 				return false;
 		}
 
 		return true;
 	}
 
-	bool fread(map& m, std::FILE* f)
+	bool read(map& m, std::span<std::byte const> data)
 	{
-		size_t version;
-		if (!::fread(&version, sizeof(version), 1, f))
-			return false;
-
-		if (version != 1)
+		map_records records;
+		if (!parse(data, records))
 			return false;
 
-		size_t entity_count;
-		if (!::fread(&entity_count, sizeof(entity_count), 1, f))
-			return false;
-
-		root_entity& root = m.get_root();
-		for (size_t n = 0; n < entity_count; ++n)
-		{
-			if (!fread(m, root, f))
-				return false;
-		}
-
-		return true;
+		return load(m, records);
 	}
 }
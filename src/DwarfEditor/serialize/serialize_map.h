@@ -1,15 +1,27 @@
 #pragma once
 
 #include "map.h"
+#include "map_file.h"
+#include "byte_stream.h"
 
 #include <cstdio>
+#include <cstddef>
 #include <optional>
+#include <span>
 
 namespace ot::dedit::serialize
 {
+	// Flattens the entities of the map into records. Names in the records point to the names of the entities
+	[[nodiscard]] map_records make_records(map const& m);
+	// Creates the entities described by the records in the map
+	[[nodiscard]] bool load(map& m, map_records const& records);
+
+	// Writes the map in the current version of the map file format
 	bool fwrite(map const& m, std::FILE* stream);
-	bool fread(map& m, std::FILE* stream);
+	// Loads a map file of any supported version, usually mapped in memory
+	bool read(map& m, std::span<std::byte const> data);
 
-	bool fwrite(map_entity const& e, std::FILE* f);
-	bool fread(map& m, map_entity& parent, std::FILE* f, map_entity** new_entity = nullptr);
+	// Writes the entity and its children, to be read back as they are by fread
+	bool fwrite(map_entity const& e, byte_stream& stream);
+	bool fread(map& m, map_entity& parent, byte_stream& stream, map_entity** new_entity = nullptr);
 }
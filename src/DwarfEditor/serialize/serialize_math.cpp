@@ -2,110 +2,110 @@
 
 namespace ot::dedit::serialize
 {
-	bool fwrite(math::point3f const& p, std::FILE* stream)
+	bool fwrite(math::point3f const& p, byte_stream& stream)
 	{
 		static_assert(sizeof(math::point3f) == 3 * sizeof(float));
-		return ::fwrite(&p, sizeof(float), 3, stream) == 3;
+		return fwrite(&p, sizeof(float), 3, stream) == 3;
 	}
 
-	bool fread(math::point3f& p, std::FILE* stream)
+	bool fread(math::point3f& p, byte_stream& stream)
 	{
-		return ::fread(&p, sizeof(float), 3, stream) == 3;
+		return fread(&p, sizeof(float), 3, stream) == 3;
 	}
 
-	bool fwrite(std::span<math::point3f const> p, std::FILE* stream)
+	bool fwrite(std::span<math::point3f const> p, byte_stream& stream)
 	{
-		return ::fwrite(p.data(), sizeof(math::point3f), p.size(), stream) == p.size();
+		return fwrite(p.data(), sizeof(math::point3f), p.size(), stream) == p.size();
 	}
 
-	bool fread(std::span<math::point3f> p, std::FILE* stream)
+	bool fread(std::span<math::point3f> p, byte_stream& stream)
 	{
-		return ::fread(p.data(), sizeof(math::point3f), p.size(), stream) == p.size();
+		return fread(p.data(), sizeof(math::point3f), p.size(), stream) == p.size();
 	}
 
-	bool fwrite(math::vector3f const& v, std::FILE* stream)
+	bool fwrite(math::vector3f const& v, byte_stream& stream)
 	{
 		static_assert(sizeof(math::vector3f) == 3 * sizeof(float));
-		return ::fwrite(&v, sizeof(float), 3, stream) == 3;
+		return fwrite(&v, sizeof(float), 3, stream) == 3;
 	}
 
-	bool fread(math::vector3f& v, std::FILE* stream)
+	bool fread(math::vector3f& v, byte_stream& stream)
 	{
-		return ::fread(&v, sizeof(float), 3, stream) == 3;
+		return fread(&v, sizeof(float), 3, stream) == 3;
 	}
 
-	bool fwrite(std::span<math::vector3f const> v, std::FILE* stream)
+	bool fwrite(std::span<math::vector3f const> v, byte_stream& stream)
 	{
-		return ::fwrite(v.data(), sizeof(math::vector3f), v.size(), stream) == v.size();
+		return fwrite(v.data(), sizeof(math::vector3f), v.size(), stream) == v.size();
 	}
 
-	bool fread(std::span<math::vector3f> v, std::FILE* stream)
+	bool fread(std::span<math::vector3f> v, byte_stream& stream)
 	{
-		return ::fread(v.data(), sizeof(math::vector3f), v.size(), stream) == v.size();
+		return fread(v.data(), sizeof(math::vector3f), v.size(), stream) == v.size();
 	}
 
-	bool fwrite(math::plane const& m, std::FILE* stream)
+	bool fwrite(math::plane const& m, byte_stream& stream)
 	{
 		static_assert(sizeof(math::plane) == 4 * sizeof(float));
-		return ::fwrite(&m, sizeof(float), 4, stream) == 4;
+		return fwrite(&m, sizeof(float), 4, stream) == 4;
 	}
 
-	bool fread(math::plane& m, std::FILE* stream)
+	bool fread(math::plane& m, byte_stream& stream)
 	{
-		return ::fread(&m, sizeof(float), 4, stream) == 4;
+		return fread(&m, sizeof(float), 4, stream) == 4;
 	}
 
-	bool fwrite(std::span<math::plane const> p, std::FILE* stream)
+	bool fwrite(std::span<math::plane const> p, byte_stream& stream)
 	{
-		return ::fwrite(p.data(), sizeof(math::plane), p.size(), stream) == p.size();
+		return fwrite(p.data(), sizeof(math::plane), p.size(), stream) == p.size();
 	}
 
-	bool fread(std::span<math::plane> p, std::FILE* stream)
+	bool fread(std::span<math::plane> p, byte_stream& stream)
 	{
-		return ::fread(p.data(), sizeof(math::plane), p.size(), stream) == p.size();
+		return fread(p.data(), sizeof(math::plane), p.size(), stream) == p.size();
 	}
 
-	bool fwrite(math::quaternion const& q, std::FILE* stream)
+	bool fwrite(math::quaternion const& q, byte_stream& stream)
 	{
 		static_assert(sizeof(math::quaternion) == 4 * sizeof(float));
-		return ::fwrite(&q, sizeof(float), 4, stream) == 4;
+		return fwrite(&q, sizeof(float), 4, stream) == 4;
 	}
 
-	bool fread(math::quaternion& q, std::FILE* stream)
+	bool fread(math::quaternion& q, byte_stream& stream)
 	{
-		return ::fread(&q, sizeof(float), 4, stream) == 4;
+		return fread(&q, sizeof(float), 4, stream) == 4;
 	}
 
-	bool fwrite(std::span<math::quaternion const> q, std::FILE* stream)
+	bool fwrite(std::span<math::quaternion const> q, byte_stream& stream)
 	{
-		return ::fwrite(&q, sizeof(math::quaternion), q.size(), stream) == q.size();
+		return fwrite(q.data(), sizeof(math::quaternion), q.size(), stream) == q.size();
 	}
 
-	bool fread(std::span<math::quaternion> q, std::FILE* stream)
+	bool fread(std::span<math::quaternion> q, byte_stream& stream)
 	{
-		return ::fread(&q, sizeof(math::quaternion), q.size(), stream) == q.size();
+		return fread(q.data(), sizeof(math::quaternion), q.size(), stream) == q.size();
 	}
 
 	static_assert(sizeof(math::point3f) == 3 * sizeof(float));
 
-	bool fwrite(math::scales const& s, std::FILE* stream)
+	bool fwrite(math::scales const& s, byte_stream& stream)
 	{
 		
-		return ::fwrite(&s, sizeof(float), 3, stream) == 3;
+		return fwrite(&s, sizeof(float), 3, stream) == 3;
 	}
 
-	bool fread(math::scales& s, std::FILE* stream)
+	bool fread(math::scales& s, byte_stream& stream)
 	{
-		return ::fread(&s, sizeof(float), 3, stream) == 3;
+		return fread(&s, sizeof(float), 3, stream) == 3;
 	}
 
-	bool fwrite(std::span<math::scales const> s, std::FILE* stream)
+	bool fwrite(std::span<math::scales const> s, byte_stream& stream)
 	{
-		return ::fwrite(s.data(), sizeof(math::scales), s.size(), stream) == s.size();
+		return fwrite(s.data(), sizeof(math::scales), s.size(), stream) == s.size();
 	}
 
-	bool fread(std::span<math::scales> s, std::FILE* stream)
+	bool fread(std::span<math::scales> s, byte_stream& stream)
 	{
-		return ::fread(s.data(), sizeof(math::scales), s.size(), stream) == s.size();
+		return fread(s.data(), sizeof(math::scales), s.size(), stream) == s.size();
 	}
 }
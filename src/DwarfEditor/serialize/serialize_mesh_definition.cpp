@@ -1,18 +1,17 @@
 #include "serialize_mesh_definition.h"
 
 #include "egfx/mesh_definition.h"
+#include "egfx/mesh_definition_cache.h"
 
 #include "serialize_math.h"
 
-#include <iostream>
-
 namespace ot::dedit::serialize
 {
-	bool fwrite(egfx::mesh_definition const& m, std::FILE* f)
+	bool fwrite(egfx::mesh_definition const& m, byte_stream& f)
 	{
 		auto const faces = m.get_faces();
 		size_t const face_count = faces.size();
-		if (::fwrite(&face_count, sizeof(face_count), 1, f) != 1)
+		if (fwrite(&face_count, sizeof(face_count), 1, f) != 1)
 			return false;
 
 		std::vector<math::plane> v;
@@ -25,18 +24,38 @@ namespace ot::dedit::serialize
 		return fwrite(v, f);
 	}
 
-	bool fread(egfx::mesh_definition& m, std::FILE* f)
+	namespace
 	{
-		size_t face_count;
-		if (::fread(&face_count, sizeof(face_count), 1, f) != 1)
-			return false;
+		bool fread_planes(std::vector<math::plane>& v, byte_stream& f)
+		{
+			size_t face_count;
+			if (fread(&face_count, sizeof(face_count), 1, f) != 1)
+				return false;
+
+			v.resize(face_count);
+			return fread(v, f);
+		}
+	}
 
-		std::vector<math::plane> v(face_count);
-		if (!fread(v, f))
+	bool fread(egfx::mesh_definition& m, byte_stream& f)
+	{
+		std::vector<math::plane> v;
+		if (!fread_planes(v, f))
 			return false;
 
 		m = egfx::mesh_definition(v);
 
 		return true;
 	}
+
+	bool fread(std::shared_ptr<egfx::mesh_definition const>& m, egfx::mesh_definition_cache& cache, byte_stream& f)
+	{
+		std::vector<math::plane> v;
+		if (!fread_planes(v, f))
+			return false;
+
+		m = cache.get(v);
+
+		return true;
+	}
 }
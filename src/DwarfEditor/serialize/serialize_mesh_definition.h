@@ -1,10 +1,15 @@
 #pragma once
 
 #include "egfx/mesh_definition.fwd.h"
-#include <cstdio>
+
+#include "byte_stream.h"
+
+#include <memory>
 
 namespace ot::dedit::serialize
 {
-	bool fwrite(egfx::mesh_definition const& m, std::FILE* f);
-	bool fread(egfx::mesh_definition& m, std::FILE* f);
+	bool fwrite(egfx::mesh_definition const& m, byte_stream& f);
+	bool fread(egfx::mesh_definition& m, byte_stream& f);
+	// Shares the definition with the other meshes read or built through the cache from the same planes
+	bool fread(std::shared_ptr<egfx::mesh_definition const>& m, egfx::mesh_definition_cache& cache, byte_stream& f);
 }
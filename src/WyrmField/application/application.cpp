@@ -11,6 +11,8 @@
 #include "egfx/module.h"
 #include "egfx/object/camera.h"
 
+#include "core/profiler.h"
+
 #include <SDL_events.h>
 #include <imgui_impl_sdl2.h>
 #include <im3d.h>
@@ -236,19 +238,30 @@ namespace ot::wf
 		std::chrono::time_point current_frame = std::chrono::steady_clock::now();
 		math::seconds time_buffer = fixed_step; // Start with one step
 
+		profiler::set_thread_name("Main");
+
 		while (!wants_quit)
 		{
+			OT_PROFILE_FRAME();
+
 			// Events
-			process_events();
+			{
+				OT_PROFILE_ZONE("process_events");
+				process_events();
+			}
 
 			// Pre-update
-			imgui::pre_update();
-			gfx_module->pre_update();
-			im3d_preupdate(main_scene.get_camera());
+			{
+				OT_PROFILE_ZONE("pre_update");
+				imgui::pre_update();
+				gfx_module->pre_update();
+				im3d_preupdate(main_scene.get_camera());
+			}
 
 			// Fixed Update
 			while (time_buffer >= fixed_step)
 			{
+				OT_PROFILE_ZONE("fixed_update");
 				game->update(fixed_step);
 				main_scene.update(fixed_step);
 
@@ -256,20 +269,33 @@ namespace ot::wf
 			}
 
 			// Render
-			main_scene.render();
+			{
+				OT_PROFILE_ZONE("scene_render");
+				main_scene.render();
+			}
 
-			game->draw();
+			{
+				OT_PROFILE_ZONE("game_draw");
+				game->draw();
+			}
 
 			if (draw_debug)
 			{
+				OT_PROFILE_ZONE("debug_menu");
 				draw_debug_menu();
 			}
 
-			if (!gfx_module->render())
-				wants_quit = true;
+			{
+				OT_PROFILE_ZONE("render");
+				if (!gfx_module->render())
+					wants_quit = true;
+			}
 
 			// End frame
-			imgui::end_frame();
+			{
+				OT_PROFILE_ZONE("end_frame");
+				imgui::end_frame();
+			}
 
 			std::chrono::time_point const last_frame = std::exchange(current_frame, std::chrono::steady_clock::now());
 			time_buffer += current_frame - last_frame;
@@ -2,6 +2,8 @@
 
 #include "application/application.h"
 
+#include "egfx/imgui/profiler_window.h"
+
 #include <imgui.h>
 #include <misc/cpp/imgui_stdlib.h>
 
@@ -12,6 +14,7 @@ namespace ot::wf
 		bool imgui_demo_open = false;
 		bool enemy_editor_open = false;
 		bool player_editor_open = false;
+		bool profiler_open = false;
 
 		void edit_attributes(m3::character_attributes& att)
 		{
@@ -243,11 +246,19 @@ namespace ot::wf
 			{
 				player_editor_open = !player_editor_open;
 			}
+
+			if (ImGui::Button("Profiler"))
+			{
+				profiler_open = !profiler_open;
+			}
 		}
 		ImGui::End();
 
 		if(imgui_demo_open)
 			ImGui::ShowDemoWindow(&imgui_demo_open);
+
+		if (profiler_open)
+			egfx::imgui::profiler_window::draw(&profiler_open);
 		
 		if (enemy_editor_open)
 		{
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <egfx/mesh_definition.h>
+
+#include <math/transform_matrix.h>
+
+#include <memory>
+
+// Brushes shared by the tests of the structures holding them
+namespace ot::test
+{
+	[[nodiscard]] inline std::shared_ptr<egfx::mesh_definition const> make_cube()
+	{
+		return std::make_shared<egfx::mesh_definition const>(egfx::mesh_definition::get_cube());
+	}
+
+	// Rotated by 'y_angle' degrees around the y axis
+	[[nodiscard]] inline math::transform_matrix make_transform(math::vector3f position, float y_angle = 0.f)
+	{
+		return math::transform_matrix::from_components(position, math::quaternion::y_deg_rotation(y_angle));
+	}
+
+	// Unit cube scaled to a box of the given size
+	[[nodiscard]] inline math::transform_matrix make_box(math::vector3f center, math::scales size)
+	{
+		return math::transform_matrix::from_components(center, math::quaternion::identity(), size);
+	}
+}
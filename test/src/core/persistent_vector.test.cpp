@@ -0,0 +1,93 @@
+#include "core/persistent_vector.h"
+
+#include <catch2/catch.hpp>
+
+#include <span>
+#include <vector>
+
+TEST_CASE("persistent_vector push_back", "[core]")
+{
+	ot::persistent_vector<int, 2> v;
+	REQUIRE(v.empty());
+
+	// Enough elements for a few levels of branches with 4 elements per chunk
+	for (int i = 0; i < 100; ++i)
+		v.push_back(i);
+
+	REQUIRE(v.size() == 100);
+	for (int i = 0; i < 100; ++i)
+		REQUIRE(v[i] == i);
+
+	int expected = 0;
+	for (int const i : v)
+		REQUIRE(i == expected++);
+	REQUIRE(expected == 100);
+
+	// Full chunks, then the last elements
+	expected = 0;
+	size_t chunk_count = 0;
+	for (std::span<int const> const chunk : v.get_chunks())
+	{
+		REQUIRE(chunk.size() == 4);
+		for (int const i : chunk)
+			REQUIRE(i == expected++);
+		++chunk_count;
+	}
+	REQUIRE(chunk_count == 25);
+	REQUIRE(expected == 100);
+
+	v.resize(98);
+	std::vector<size_t> chunk_sizes;
+	for (std::span<int const> const chunk : v.get_chunks())
+		chunk_sizes.push_back(chunk.size());
+	REQUIRE(chunk_sizes.size() == 25);
+	REQUIRE(chunk_sizes.back() == 2);
+
+	ot::persistent_vector<int, 2> const empty;
+	REQUIRE(empty.begin() == empty.end());
+	REQUIRE(empty.get_chunks().begin() == empty.get_chunks().end());
+}
+
+TEST_CASE("persistent_vector copies are independent", "[core]")
+{
+	ot::persistent_vector<int, 2> v;
+	v.resize(50, 7);
+
+	ot::persistent_vector<int, 2> copy = v;
+	copy.set(10, 42);
+	copy.push_back(8);
+
+	REQUIRE(v.size() == 50);
+	REQUIRE(v[10] == 7);
+	REQUIRE(copy.size() == 51);
+	REQUIRE(copy[10] == 42);
+	REQUIRE(copy[50] == 8);
+
+	v.get_mutable(10) = 3;
+	REQUIRE(v[10] == 3);
+	REQUIRE(copy[10] == 42);
+
+	copy.resize(5);
+	REQUIRE(copy.size() == 5);
+	REQUIRE(v.size() == 50);
+}
+
+TEST_CASE("persistent_vector count_bytes", "[core]")
+{
+	ot::persistent_vector<int, 2> v;
+	v.resize(256);
+
+	std::unordered_set<void const*> counted_nodes;
+	size_t const original_bytes = v.count_bytes(counted_nodes);
+	REQUIRE(original_bytes >= 256 * sizeof(int));
+
+	// An unmodified copy shares everything
+	ot::persistent_vector<int, 2> copy = v;
+	REQUIRE(copy.count_bytes(counted_nodes) == 0);
+
+	// A write copies only the path to the element
+	copy.set(0, 1);
+	size_t const edit_bytes = copy.count_bytes(counted_nodes);
+	REQUIRE(edit_bytes > 0);
+	REQUIRE(edit_bytes < original_bytes / 4);
+}
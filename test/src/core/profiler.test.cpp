@@ -0,0 +1,143 @@
+#include "core/profiler.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	std::vector<ot::profiler::zone> get_zones_since(ot::int64_t from)
+	{
+		std::vector<ot::profiler::zone> zones;
+		ot::profiler::get_zones(from, ot::profiler::now() + 1, zones);
+		return zones;
+	}
+
+	ot::profiler::zone const* find_zone(std::vector<ot::profiler::zone> const& zones, std::string const& name)
+	{
+		auto const found = std::ranges::find_if(zones, [&name](ot::profiler::zone const& z) { return name == z.name; });
+		return found == zones.end() ? nullptr : &*found;
+	}
+}
+
+TEST_CASE("profiler records nested zones", "[core]")
+{
+	ot::int64_t const from = ot::profiler::now();
+	{
+		ot::profiler::scoped_zone const outer("outer");
+		{
+			ot::profiler::scoped_zone const inner("inner");
+		}
+	}
+
+	std::vector<ot::profiler::zone> const zones = get_zones_since(from);
+	ot::profiler::zone const* const outer = find_zone(zones, "outer");
+	ot::profiler::zone const* const inner = find_zone(zones, "inner");
+	REQUIRE(outer != nullptr);
+	REQUIRE(inner != nullptr);
+	CHECK(outer->depth == 0);
+	CHECK(inner->depth == 1);
+	CHECK(outer->lane == inner->lane);
+	CHECK(outer->start <= inner->start);
+	CHECK(inner->end <= outer->end);
+
+	SECTION("Zones outside of the range are skipped")
+	{
+		std::vector<ot::profiler::zone> later;
+		ot::profiler::get_zones(outer->end + 1, ot::profiler::now() + 1, later);
+		CHECK(find_zone(later, "outer") == nullptr);
+	}
+}
+
+TEST_CASE("profiler records nothing while paused", "[core]")
+{
+	ot::int64_t const from = ot::profiler::now();
+	ot::profiler::set_paused(true);
+	{
+		ot::profiler::scoped_zone const zone("paused");
+	}
+	ot::profiler::set_paused(false);
+
+	CHECK(find_zone(get_zones_since(from), "paused") == nullptr);
+}
+
+TEST_CASE("profiler keeps the last frames", "[core]")
+{
+	std::vector<ot::int64_t> frames;
+	for (size_t i = 0; i < ot::profiler::max_frame_count + 10; ++i)
+		ot::profiler::mark_frame();
+
+	ot::profiler::get_frames(frames);
+	CHECK(frames.size() == ot::profiler::max_frame_count);
+	CHECK(std::ranges::is_sorted(frames));
+}
+
+TEST_CASE("profiler gives each thread a lane and reuses them", "[core]")
+{
+	ot::int64_t const from = ot::profiler::now();
+	ot::profiler::set_thread_name("Main");
+	{
+		ot::profiler::scoped_zone const zone("main zone");
+	}
+
+	std::thread([] { ot::profiler::scoped_zone const zone("first worker"); }).join();
+	size_t const lane_count = ot::profiler::get_lane_count();
+	std::thread([] { ot::profiler::scoped_zone const zone("second worker"); }).join();
+	CHECK(ot::profiler::get_lane_count() == lane_count);
+
+	std::vector<ot::profiler::zone> const zones = get_zones_since(from);
+	ot::profiler::zone const* const main_zone = find_zone(zones, "main zone");
+	ot::profiler::zone const* const first = find_zone(zones, "first worker");
+	ot::profiler::zone const* const second = find_zone(zones, "second worker");
+	REQUIRE(main_zone != nullptr);
+	REQUIRE(first != nullptr);
+	REQUIRE(second != nullptr);
+	CHECK(first->lane != main_zone->lane);
+	CHECK(first->lane == second->lane);
+	CHECK(std::string(ot::profiler::get_lane_name(main_zone->lane)) == "Main");
+}
+
+TEST_CASE("profiler writes Chrome traces", "[core]")
+{
+	ot::profiler::zone const zones[] =
+	{
+		{ "update", 1000, 3500, 0, 0 },
+		{ "say \"hi\"", 1500, 2000, 0, 1 },
+	};
+
+	std::ostringstream out;
+	ot::profiler::write_chrome_trace(out, zones);
+	std::string const trace = out.str();
+
+	CHECK(trace.starts_with("{\"traceEvents\":["));
+	CHECK(trace.find("{\"name\":\"update\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":1.000,\"dur\":2.500}") != std::string::npos);
+	CHECK(trace.find("\"say \\\"hi\\\"\"") != std::string::npos);
+	CHECK(trace.ends_with("]}\n"));
+}
+
+TEST_CASE("Profiler benchmark", "[.][benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+	size_t const zone_count = 1000000;
+
+	auto const start = clock::now();
+	for (size_t i = 0; i < zone_count; ++i)
+	{
+		OT_PROFILE_ZONE("benchmark");
+	}
+	double const zone_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / static_cast<double>(zone_count);
+
+	ot::int64_t const from = ot::profiler::now() - 1000000000;
+	auto const read_start = clock::now();
+	std::vector<ot::profiler::zone> zones;
+	ot::profiler::get_zones(from, ot::profiler::now(), zones);
+	double const read_ms = std::chrono::duration<double, std::milli>(clock::now() - read_start).count();
+
+	WARN("Zone: " << zone_ns << " ns each");
+	WARN("Read " << zones.size() << " zones in " << read_ms << " ms");
+}
@@ -0,0 +1,471 @@
+#include "action/history.h"
+#include "action/base.h"
+#include "action/memory_size.h"
+#include "serialize/serialize_mesh_definition.h"
+
+#include "../brush_helpers.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+	using ot::dedit::action::history;
+
+	// Bytes held by every live test action, to check what the history reports against what is actually kept
+	size_t live_bytes = 0;
+
+	class test_action : public ot::dedit::action::base
+	{
+		std::vector<char> payload;
+
+	public:
+		explicit test_action(size_t payload_size)
+			: payload(payload_size)
+		{
+			live_bytes += get_memory_size();
+		}
+
+		~test_action()
+		{
+			live_bytes -= get_memory_size();
+		}
+
+		// The history only keeps actions, the action handler applies them
+		virtual void apply(ot::dedit::map&) override {}
+		virtual void undo(ot::dedit::map&) override {}
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this) + payload.capacity(); }
+	};
+
+	ot::fwd_uptr<ot::dedit::action::base> make_action(size_t payload_size)
+	{
+		return ot::fwd_uptr<ot::dedit::action::base>(new test_action(payload_size));
+	}
+
+	using ot::egfx::mesh_definition;
+
+	// Meshes of the brushes edited by the brush actions below, null for deleted brushes
+	std::vector<std::shared_ptr<mesh_definition const>> brushes;
+
+	class brush_action;
+	std::unordered_set<brush_action const*> live_brush_actions;
+
+	// Keeps what the brush actions of the editor keep, measured with the same helpers. The editor's actions need a scene to run
+	class brush_action : public ot::dedit::action::base
+	{
+	public:
+		brush_action() { live_brush_actions.insert(this); }
+		~brush_action() { live_brush_actions.erase(this); }
+
+		virtual void apply(ot::dedit::map&) override { apply(); }
+		virtual void undo(ot::dedit::map&) override { undo(); }
+
+		virtual void apply() = 0;
+		virtual void undo() = 0;
+
+		// Adds the meshes kept by the action, and the bytes it keeps besides them
+		virtual void collect_state(std::vector<mesh_definition const*>& meshes, size_t& other_bytes) const = 0;
+	};
+
+	// Same as split_brush_face
+	class split_face_action : public brush_action
+	{
+		size_t brush;
+		ot::egfx::face::id face;
+		ot::math::plane plane;
+		std::shared_ptr<mesh_definition const> previous_state;
+		size_t previous_state_size = 0;
+
+	public:
+		split_face_action(size_t brush, ot::egfx::face::id face, ot::math::plane plane)
+			: brush(brush)
+			, face(face)
+			, plane(plane)
+			, previous_state(brushes[brush])
+		{
+
+		}
+
+		virtual void apply() override
+		{
+			auto new_mesh = std::make_shared<mesh_definition>(*brushes[brush]);
+			if (!new_mesh->get_face(face).split(plane))
+				return;
+
+			previous_state_size = ot::dedit::action::count_unshared_bytes(*previous_state, *new_mesh);
+			brushes[brush] = std::move(new_mesh);
+		}
+
+		virtual void undo() override
+		{
+			brushes[brush] = previous_state;
+			previous_state_size = 0;
+		}
+
+		virtual void collect_state(std::vector<mesh_definition const*>& meshes, size_t& other_bytes) const override
+		{
+			meshes.push_back(previous_state.get());
+			other_bytes += sizeof(*this);
+		}
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this) + previous_state_size; }
+	};
+
+	// Same as delete_entity
+	class delete_action : public brush_action
+	{
+		size_t brush;
+		ot::dedit::serialize::byte_stream serialized_state;
+
+	public:
+		explicit delete_action(size_t brush)
+			: brush(brush)
+		{
+
+		}
+
+		virtual void apply() override
+		{
+			serialized_state.clear();
+			REQUIRE(ot::dedit::serialize::fwrite(*brushes[brush], serialized_state));
+			serialized_state.shrink_to_fit();
+			brushes[brush] = nullptr;
+		}
+
+		virtual void undo() override
+		{
+			auto restored = std::make_shared<mesh_definition>();
+			serialized_state.rewind();
+			REQUIRE(ot::dedit::serialize::fread(*restored, serialized_state));
+			brushes[brush] = std::move(restored);
+
+			serialized_state.clear();
+			serialized_state.shrink_to_fit();
+		}
+
+		virtual void collect_state(std::vector<mesh_definition const*>&, size_t& other_bytes) const override
+		{
+			other_bytes += sizeof(*this) + serialized_state.capacity();
+		}
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this) + serialized_state.capacity(); }
+	};
+
+	// Same as spawn_brush
+	class spawn_action : public brush_action
+	{
+		std::optional<size_t> brush;
+		std::shared_ptr<mesh_definition const> mesh;
+		size_t owned_size = 0;
+
+	public:
+		explicit spawn_action(std::shared_ptr<mesh_definition const> mesh)
+			: mesh(std::move(mesh))
+		{
+
+		}
+
+		virtual void apply() override
+		{
+			if (!brush)
+			{
+				brush = brushes.size();
+				brushes.push_back(mesh);
+			}
+			else
+			{
+				brushes[*brush] = mesh;
+			}
+			owned_size = ot::dedit::action::count_owned_bytes(mesh);
+		}
+
+		virtual void undo() override
+		{
+			brushes[*brush] = nullptr;
+			owned_size = ot::dedit::action::count_owned_bytes(mesh);
+		}
+
+		virtual void collect_state(std::vector<mesh_definition const*>& meshes, size_t& other_bytes) const override
+		{
+			meshes.push_back(mesh.get());
+			other_bytes += sizeof(*this);
+		}
+
+		[[nodiscard]] virtual size_t get_memory_size() const noexcept override { return sizeof(*this) + owned_size; }
+	};
+
+	// Bytes the brush actions actually keep alive, on top of the meshes of the brushes
+	size_t count_brush_action_bytes()
+	{
+		std::unordered_set<void const*> counted_chunks;
+		std::unordered_set<mesh_definition const*> counted_meshes;
+		for (std::shared_ptr<mesh_definition const> const& b : brushes)
+		{
+			if (b != nullptr && counted_meshes.insert(b.get()).second)
+				(void)b->count_bytes(counted_chunks);
+		}
+
+		size_t bytes = 0;
+		std::vector<mesh_definition const*> meshes;
+		for (brush_action const* a : live_brush_actions)
+			a->collect_state(meshes, bytes);
+
+		for (mesh_definition const* m : meshes)
+		{
+			if (counted_meshes.insert(m).second)
+				bytes += sizeof(mesh_definition) + m->count_bytes(counted_chunks);
+		}
+
+		return bytes;
+	}
+}
+
+TEST_CASE("history undoes and redoes in order", "[dedit]")
+{
+	history h;
+	for (int id = 1; id <= 3; ++id)
+		h.push(make_action(16), id);
+
+	CHECK(h.get_undo_count() == 3);
+	CHECK(h.get_last_id() == 3);
+	CHECK(!h.has_redo());
+
+	CHECK(h.get_memory_usage() == live_bytes);
+
+	h.on_undone();
+	CHECK(h.get_last_id() == 2);
+	CHECK(h.get_redo_count() == 1);
+
+	SECTION("Pushing forgets the undone actions")
+	{
+		h.push(make_action(16), 4);
+		CHECK(h.get_last_id() == 4);
+		CHECK(!h.has_redo());
+		CHECK(h.get_undo_count() == 3);
+	}
+
+	SECTION("Redoing moves the action back")
+	{
+		h.on_redone();
+		CHECK(h.get_last_id() == 3);
+		CHECK(!h.has_redo());
+	}
+
+	h.clear();
+	CHECK(h.get_memory_usage() == 0);
+	CHECK(h.get_last_id() == 0);
+	CHECK(live_bytes == 0);
+}
+
+TEST_CASE("history stays within its memory budget", "[dedit]")
+{
+	history h(1000);
+	for (int id = 1; id <= 10; ++id)
+		h.push(make_action(200), id);
+
+	CHECK(h.get_memory_usage() <= h.get_memory_budget());
+	CHECK(h.get_memory_usage() == live_bytes);
+	CHECK(h.get_dropped_count() > 0);
+	CHECK(h.get_last_id() == 10);
+
+	SECTION("The latest action is kept even over the budget")
+	{
+		h.push(make_action(5000), 11);
+		CHECK(h.get_undo_count() == 1);
+		CHECK(h.get_last_id() == 11);
+		CHECK(h.get_memory_usage() == live_bytes);
+	}
+
+	SECTION("Lowering the budget drops old actions right away")
+	{
+		size_t const count = h.get_undo_count();
+		h.set_memory_budget(500);
+		CHECK(h.get_undo_count() < count);
+		CHECK(h.get_memory_usage() <= 500);
+	}
+
+	SECTION("Undone actions furthest from being redone go after the applied ones")
+	{
+		int const oldest_id = 11 - static_cast<int>(h.get_undo_count());
+		while (h.has_undo())
+			h.on_undone();
+		size_t const count = h.get_redo_count();
+		h.set_memory_budget(500);
+		CHECK(h.get_redo_count() < count);
+		REQUIRE(h.get_redo_count() > 0);
+
+		// The oldest action is the next to redo, and is kept
+		h.on_redone();
+		CHECK(h.get_last_id() == oldest_id);
+	}
+
+	h.clear();
+	CHECK(live_bytes == 0);
+}
+
+TEST_CASE("history memory stays flat over 100k actions", "[dedit]")
+{
+	size_t const budget = 1 << 20;
+	history h(budget);
+
+	size_t max_live_bytes = 0;
+	for (int id = 1; id <= 100000; ++id)
+	{
+		// Sizes vary like real edits, from transforms to mesh snapshots
+		h.push(make_action(static_cast<size_t>(id % 97) * 64), id);
+		if (id % 10 == 0)
+			h.on_undone();
+
+		max_live_bytes = std::max(max_live_bytes, live_bytes);
+		REQUIRE(h.get_memory_usage() == live_bytes);
+	}
+
+	CHECK(max_live_bytes <= budget);
+	CHECK(h.get_undo_count() + h.get_redo_count() < 1000);
+	CHECK(h.get_dropped_count() > 0);
+
+	h.clear();
+	CHECK(live_bytes == 0);
+}
+
+TEST_CASE("history measures what brush actions keep", "[dedit]")
+{
+	using ot::dedit::action::count_owned_bytes;
+
+	history h;
+	brushes.clear();
+
+	auto push = [&h](brush_action* a)
+	{
+		a->apply();
+		h.push(ot::fwd_uptr<ot::dedit::action::base>(a), static_cast<int>(h.get_undo_count()) + 1);
+	};
+	auto undo = [&h]()
+	{
+		static_cast<brush_action&>(h.get_undo()).undo();
+		h.on_undone();
+	};
+	auto redo = [&h]()
+	{
+		static_cast<brush_action&>(h.get_redo()).apply();
+		h.on_redone();
+	};
+
+	push(new spawn_action(ot::test::make_cube()));
+	size_t const spawned_size = h.get_memory_usage();
+
+	SECTION("An undone spawn keeps the mesh")
+	{
+		size_t const mesh_size = count_owned_bytes(std::make_shared<mesh_definition const>(*brushes[0]));
+		undo();
+		CHECK(h.get_memory_usage() == spawned_size + mesh_size);
+		CHECK(h.get_memory_usage() == count_brush_action_bytes());
+
+		redo();
+		CHECK(h.get_memory_usage() == spawned_size);
+	}
+
+	SECTION("An undone split keeps nothing but itself")
+	{
+		push(new split_face_action(0, ot::egfx::face::id(0), { { 1, 0, 0 }, 0.1f }));
+		size_t const split_size = h.get_memory_usage() - spawned_size;
+		CHECK(split_size > sizeof(split_face_action) + sizeof(mesh_definition));
+		CHECK(h.get_memory_usage() == count_brush_action_bytes());
+
+		undo();
+		CHECK(h.get_memory_usage() == spawned_size + sizeof(split_face_action));
+		CHECK(h.get_memory_usage() == count_brush_action_bytes());
+
+		redo();
+		CHECK(h.get_memory_usage() == spawned_size + split_size);
+	}
+
+	SECTION("An undone delete lets go of the brush's state")
+	{
+		push(new delete_action(0));
+		CHECK(h.get_memory_usage() > spawned_size + sizeof(delete_action));
+
+		undo();
+		CHECK(h.get_memory_usage() == spawned_size + sizeof(delete_action));
+		REQUIRE(brushes[0] != nullptr);
+		CHECK(brushes[0]->get_faces().size() == 6);
+	}
+
+	h.clear();
+	brushes.clear();
+	CHECK(live_brush_actions.empty());
+}
+
+TEST_CASE("history memory stays within budget over brush edits", "[dedit]")
+{
+	size_t const budget = 256 << 10;
+	history h(budget);
+	brushes.clear();
+
+	std::mt19937 random(42);
+	auto pick = [&random](size_t count) { return std::uniform_int_distribution<size_t>(0, count - 1)(random); };
+
+	size_t max_kept_bytes = 0;
+	for (int step = 1; step <= 10000; ++step)
+	{
+		std::vector<size_t> live;
+		for (size_t i = 0; i < brushes.size(); ++i)
+		{
+			if (brushes[i] != nullptr)
+				live.push_back(i);
+		}
+
+		size_t const roll = pick(20);
+		if (roll < 2 && h.has_undo())
+		{
+			static_cast<brush_action&>(h.get_undo()).undo();
+			h.on_undone();
+		}
+		else if (roll < 4 && h.has_redo())
+		{
+			static_cast<brush_action&>(h.get_redo()).apply();
+			h.on_redone();
+		}
+		else
+		{
+			brush_action* a = nullptr;
+			if (live.empty() || roll < 6)
+			{
+				a = new spawn_action(ot::test::make_cube());
+			}
+			else if (roll < 7)
+			{
+				a = new delete_action(live[pick(live.size())]);
+			}
+			else
+			{
+				// Splits which miss the face do nothing, like in the editor
+				size_t const brush = live[pick(live.size())];
+				auto const face = ot::egfx::face::id(pick(brushes[brush]->get_faces().size()));
+				float const offset = std::uniform_real_distribution<float>(-0.45f, 0.45f)(random);
+				ot::math::vector3f const axes[] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+				a = new split_face_action(brush, face, { axes[pick(3)], offset });
+			}
+
+			a->apply();
+			h.push(ot::fwd_uptr<ot::dedit::action::base>(a), step);
+		}
+
+		REQUIRE(h.get_memory_usage() <= budget);
+		if (step % 100 == 0)
+			max_kept_bytes = std::max(max_kept_bytes, count_brush_action_bytes());
+	}
+
+	CHECK(max_kept_bytes <= budget);
+	CHECK(h.get_dropped_count() > 0);
+
+	h.clear();
+	brushes.clear();
+	CHECK(live_brush_actions.empty());
+}
@@ -0,0 +1,170 @@
+#include "brush_bvh.h"
+
+#include "../brush_helpers.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+	using ot::dedit::brush_bvh;
+	using ot::dedit::entity_id;
+
+	using ot::test::make_cube;
+	using ot::test::make_transform;
+
+	// Cubes laid out in a grid on the x/z plane, rotated differently each
+	struct brush_grid
+	{
+		size_t side;
+		std::shared_ptr<ot::egfx::mesh_definition const> cube = make_cube();
+		std::vector<ot::math::transform_matrix> transforms;
+
+		explicit brush_grid(size_t side)
+			: side(side)
+		{
+			for (size_t i = 0; i < side * side; ++i)
+				transforms.push_back(make_transform({ float(i % side) * 2.f, 0.f, float(i / side) * 2.f }, float(i % 90)));
+		}
+
+		void fill(brush_bvh& bvh) const
+		{
+			for (size_t i = 0; i < transforms.size(); ++i)
+				bvh.set_brush(entity_id(i + 1), cube, transforms[i]);
+		}
+
+		// What picking used to do: every face of every brush
+		std::optional<entity_id> linear_raycast(ot::math::ray const& r) const
+		{
+			std::optional<entity_id> closest;
+			float closest_distance = std::numeric_limits<float>::infinity();
+			for (size_t i = 0; i < transforms.size(); ++i)
+			{
+				for (ot::egfx::face::cref const face : cube->get_faces())
+				{
+					ot::math::plane const world_plane = transform(face.get_plane(), transforms[i]);
+					auto const intersection = r.intersects(world_plane);
+					if (!intersection)
+						continue;
+
+					float const distance = dot_product(*intersection - r.origin, r.direction);
+					if (distance < 0.f || distance >= closest_distance)
+						continue;
+
+					if (face.is_on_face(transform(*intersection, invert(transforms[i]))))
+					{
+						closest = entity_id(i + 1);
+						closest_distance = distance;
+					}
+				}
+			}
+			return closest;
+		}
+	};
+}
+
+TEST_CASE("brush_bvh raycast", "[dedit]")
+{
+	brush_bvh bvh;
+	REQUIRE(!bvh.raycast({ {0, 10, 0}, {0, -1, 0} }));
+
+	auto const cube = make_cube();
+	bvh.set_brush(entity_id(1), cube, make_transform({ 0, 0, 0 }));
+	bvh.set_brush(entity_id(2), cube, make_transform({ 0, -3, 0 }));
+	bvh.set_brush(entity_id(3), cube, make_transform({ 5, 0, 0 }, 45.f));
+	REQUIRE(bvh.size() == 3);
+
+	// Closest of two brushes along the ray
+	auto hit = bvh.raycast({ {0, 10, 0}, {0, -1, 0} });
+	REQUIRE(hit);
+	REQUIRE(hit->id == entity_id(1));
+	REQUIRE(hit->distance == Approx(9.5f));
+	REQUIRE(float_eq(cube->get_face(hit->face).get_plane().normal, ot::math::vector3f{ 0, 1, 0 }));
+
+	// Rotated brush, hit on the corner that sticks out past its unrotated bounds
+	hit = bvh.raycast({ {5.6f, 10, 0}, {0, -1, 0} });
+	REQUIRE(hit);
+	REQUIRE(hit->id == entity_id(3));
+
+	// Hits behind the origin do not count
+	REQUIRE(!bvh.raycast({ {0, 10, 0}, {0, 1, 0} }));
+	hit = bvh.raycast({ {0, -1.5f, 0}, {0, -1, 0} });
+	REQUIRE(hit);
+	REQUIRE(hit->id == entity_id(2));
+
+	// Moving a brush refits the tree
+	bvh.set_brush(entity_id(1), cube, make_transform({ 10, 0, 0 }));
+	hit = bvh.raycast({ {0, 10, 0}, {0, -1, 0} });
+	REQUIRE(hit);
+	REQUIRE(hit->id == entity_id(2));
+	hit = bvh.raycast({ {10, 10, 0}, {0, -1, 0} });
+	REQUIRE(hit);
+	REQUIRE(hit->id == entity_id(1));
+
+	bvh.remove_brush(entity_id(2));
+	REQUIRE(!bvh.contains(entity_id(2)));
+	REQUIRE(!bvh.raycast({ {0, 10, 0}, {0, -1, 0} }));
+	REQUIRE(bvh.raycast({ {10, 10, 0}, {0, -1, 0} })->id == entity_id(1));
+
+	bvh.clear();
+	REQUIRE(bvh.size() == 0);
+	REQUIRE(!bvh.raycast({ {10, 10, 0}, {0, -1, 0} }));
+}
+
+TEST_CASE("brush_bvh matches a linear search", "[dedit]")
+{
+	brush_grid const grid(20);
+	brush_bvh bvh;
+	grid.fill(bvh);
+
+	for (size_t i = 0; i < 200; ++i)
+	{
+		ot::math::point3f const target{ float(i * 37 % 400) / 10.f, 0.f, float(i * 53 % 400) / 10.f };
+		ot::math::point3f const origin{ float(i % 7) * 3.f, 8.f, float(i % 5) * 3.f };
+		ot::math::ray const r{ origin, normalized(target - origin) };
+
+		auto const hit = bvh.raycast(r);
+		auto const expected = grid.linear_raycast(r);
+		CAPTURE(i);
+		REQUIRE(hit.has_value() == expected.has_value());
+		if (hit)
+			REQUIRE(hit->id == *expected);
+	}
+}
+
+TEST_CASE("Brush picking benchmark", "[.][benchmark]")
+{
+	brush_grid const grid(100);
+	size_t const pick_count = 1000;
+
+	using clock = std::chrono::steady_clock;
+
+	brush_bvh bvh;
+	auto const build_start = clock::now();
+	grid.fill(bvh);
+	bvh.update();
+	double const build_seconds = std::chrono::duration<double>(clock::now() - build_start).count();
+
+	std::vector<ot::math::ray> rays;
+	for (size_t i = 0; i < pick_count; ++i)
+	{
+		ot::math::point3f const target{ float(i * 37 % 200), 0.f, float(i * 53 % 200) };
+		rays.push_back({ { 100.f, 50.f, 100.f }, normalized(target - ot::math::point3f{ 100.f, 50.f, 100.f }) });
+	}
+
+	size_t hits = 0;
+	auto const bvh_start = clock::now();
+	for (ot::math::ray const& r : rays)
+		hits += bvh.raycast(r).has_value();
+	double const bvh_seconds = std::chrono::duration<double>(clock::now() - bvh_start).count();
+
+	auto const linear_start = clock::now();
+	for (ot::math::ray const& r : rays)
+		hits += grid.linear_raycast(r).has_value();
+	double const linear_seconds = std::chrono::duration<double>(clock::now() - linear_start).count();
+
+	std::printf("%zu picks in %zu brushes: bvh %.6f s (built in %.6f s), linear %.6f s, %zu hits\n", pick_count, grid.transforms.size(), bvh_seconds, build_seconds, linear_seconds, hits);
+}
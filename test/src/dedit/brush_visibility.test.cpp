@@ -0,0 +1,370 @@
+#include "brush_visibility.h"
+
+#include "../brush_helpers.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <numbers>
+#include <optional>
+#include <random>
+
+namespace
+{
+	using ot::dedit::brush_visibility;
+	using ot::dedit::entity_id;
+
+	using ot::test::make_cube;
+	using ot::test::make_box;
+
+	std::vector<entity_id> get_potentially_visible(brush_visibility& visibility, ot::math::point3f eye)
+	{
+		std::vector<entity_id> visible;
+		visibility.get_potentially_visible_brushes(eye, visible);
+		std::sort(visible.begin(), visible.end());
+		return visible;
+	}
+
+	// Part of the segment inside the brush, in fractions of the segment, if it goes through the inside of the brush
+	std::optional<std::pair<float, float>> clip_segment(ot::math::point3f from, ot::math::point3f to, ot::math::transform_matrix const& world_transform)
+	{
+		ot::math::transform_matrix const world_to_local = invert(world_transform);
+		ot::math::point3f const local_from = transform(from, world_to_local);
+		ot::math::point3f const local_to = transform(to, world_to_local);
+
+		float enter = 0.f;
+		float exit = 1.f;
+		for (ot::egfx::face::cref const face : ot::egfx::mesh_definition::get_cube().get_faces())
+		{
+			float const d0 = face.get_plane().distance_to(local_from);
+			float const d1 = face.get_plane().distance_to(local_to);
+			if (d0 >= 0.f && d1 >= 0.f)
+				return std::nullopt;
+			if (d0 < 0.f && d1 < 0.f)
+				continue;
+
+			float const t = d0 / (d0 - d1);
+			if (d0 < 0.f)
+				exit = std::min(exit, t);
+			else
+				enter = std::max(enter, t);
+		}
+
+		if (enter >= exit)
+			return std::nullopt;
+		return std::pair{ enter, exit };
+	}
+}
+
+TEST_CASE("brush_visibility walls hide brushes", "[dedit]")
+{
+	// A thick wall between two small brushes
+	auto const cube = make_cube();
+	brush_visibility visibility(1.f);
+	visibility.set_brush(entity_id(1), cube, make_box({ -5.f, 0.f, 0.f }, { 1.f, 1.f, 1.f }));
+	visibility.set_brush(entity_id(2), cube, make_box({ 5.f, 0.f, 0.f }, { 1.f, 1.f, 1.f }));
+	visibility.set_brush(entity_id(3), cube, make_box({ 0.f, 0.f, 0.f }, { 2.f, 10.f, 10.f }));
+	REQUIRE(visibility.size() == 3);
+
+	std::vector<entity_id> const all{ entity_id(1), entity_id(2), entity_id(3) };
+	CHECK(get_potentially_visible(visibility, { -3.f, 0.f, 0.f }) == std::vector<entity_id>{ entity_id(1), entity_id(3) });
+	CHECK(get_potentially_visible(visibility, { 3.f, 0.f, 0.f }) == std::vector<entity_id>{ entity_id(2), entity_id(3) });
+	CHECK(visibility.get_visible_set_count() == 2);
+	CHECK(visibility.get_solid_cell_count() > 0);
+
+	// Over the wall, in the border of the grid
+	CHECK(get_potentially_visible(visibility, { 0.f, 5.5f, 0.f }) == all);
+	// Out of the grid, or in the wall
+	CHECK(get_potentially_visible(visibility, { 0.f, 50.f, 0.f }) == all);
+	CHECK(get_potentially_visible(visibility, { 0.f, 0.f, 0.f }) == all);
+
+	SECTION("The frustum is applied to the potentially visible brushes")
+	{
+		// Looking toward -X, away from the wall
+		float const fov = std::numbers::pi_v<float> / 2.f;
+		ot::math::transform_matrix const camera = ot::math::transform_matrix::from_components({ -3.f, 0.f, 0.f }, ot::math::quaternion::y_deg_rotation(90.f));
+		std::vector<entity_id> visible;
+		visibility.get_visible_brushes({ -3.f, 0.f, 0.f }, ot::math::make_perspective_frustum(camera, fov, 1.f, 0.1f, 100.f), visible);
+		CHECK(visible == std::vector<entity_id>{ entity_id(1) });
+	}
+
+	SECTION("Moving the wall away shows what was behind it")
+	{
+		visibility.set_brush(entity_id(3), cube, make_box({ 0.f, 0.f, 20.f }, { 2.f, 10.f, 10.f }));
+		CHECK(get_potentially_visible(visibility, { -3.f, 0.f, 0.f }) == all);
+		CHECK(visibility.get_visible_set_count() == 1);
+	}
+
+	SECTION("Removing the wall shows what was behind it")
+	{
+		visibility.remove_brush(entity_id(3));
+		CHECK(!visibility.contains(entity_id(3)));
+		CHECK(get_potentially_visible(visibility, { -3.f, 0.f, 0.f }) == std::vector<entity_id>{ entity_id(1), entity_id(2) });
+	}
+
+	SECTION("Setting a brush where it already is keeps the visible sets")
+	{
+		size_t const set_count = visibility.get_visible_set_count();
+		visibility.set_brush(entity_id(1), cube, make_box({ -5.f, 0.f, 0.f }, { 1.f, 1.f, 1.f }));
+		CHECK(get_potentially_visible(visibility, { -3.f, 0.f, 0.f }) == std::vector<entity_id>{ entity_id(1), entity_id(3) });
+		CHECK(visibility.get_visible_set_count() == set_count);
+	}
+
+	SECTION("Thin walls do not hide anything")
+	{
+		visibility.set_brush(entity_id(3), cube, make_box({ 0.f, 0.f, 0.f }, { 0.5f, 10.f, 10.f }));
+		CHECK(get_potentially_visible(visibility, { -3.f, 0.f, 0.f }) == all);
+	}
+
+	visibility.clear();
+	CHECK(get_potentially_visible(visibility, { 0.f, 0.f, 0.f }).empty());
+	CHECK(visibility.get_cell_count() == 0);
+}
+
+TEST_CASE("brush_visibility keeps every brush a line of sight reaches", "[dedit]")
+{
+	std::mt19937 random(7);
+	auto const uniform = [&random](float min, float max) { return std::uniform_real_distribution<float>(min, max)(random); };
+
+	auto const cube = make_cube();
+	brush_visibility visibility;
+	std::vector<ot::math::transform_matrix> transforms;
+	for (int i = 0; i < 60; ++i)
+	{
+		ot::math::vector3f const center{ uniform(-15.f, 15.f), uniform(-15.f, 15.f), uniform(-15.f, 15.f) };
+		ot::math::scales const size{ uniform(1.f, 12.f), uniform(1.f, 12.f), uniform(1.f, 12.f) };
+		transforms.push_back(ot::math::transform_matrix::from_components(center, ot::math::quaternion::y_deg_rotation(i % 3 == 0 ? uniform(0.f, 90.f) : 0.f), size));
+		visibility.set_brush(entity_id(i + 1), cube, transforms.back());
+	}
+	visibility.update();
+	REQUIRE(visibility.get_solid_cell_count() > 0);
+
+	size_t line_count = 0;
+	size_t culled_count = 0;
+	for (int eye_index = 0; eye_index < 40; ++eye_index)
+	{
+		ot::math::point3f const eye{ uniform(-18.f, 18.f), uniform(-18.f, 18.f), uniform(-18.f, 18.f) };
+		std::vector<entity_id> const visible = get_potentially_visible(visibility, eye);
+		culled_count += transforms.size() - visible.size();
+
+		for (size_t brush = 0; brush < transforms.size(); ++brush)
+		{
+			// Points just inside the corners of the brush, and anywhere on its faces
+			std::vector<ot::math::point3f> targets;
+			for (ot::egfx::vertex::cref const v : ot::egfx::mesh_definition::get_cube().get_vertices())
+				targets.push_back(transform(destination_from_origin(vector_from_origin(v.get_position()) * 0.99f), transforms[brush]));
+			for (ot::egfx::face::cref const f : ot::egfx::mesh_definition::get_cube().get_faces())
+			{
+				for (int point = 0; point < 8; ++point)
+				{
+					ot::math::vector3f const on_face{ uniform(-0.49f, 0.49f), uniform(-0.49f, 0.49f), uniform(-0.49f, 0.49f) };
+					ot::math::vector3f const normal = f.get_normal();
+					targets.push_back(transform(ot::math::point3f{ 0.f, 0.f, 0.f } + on_face - normal * dot_product(on_face, normal) + normal * 0.49f, transforms[brush]));
+				}
+			}
+
+			for (ot::math::point3f const target : targets)
+			{
+				auto const brush_part = clip_segment(eye, target, transforms[brush]);
+				float const reached = brush_part ? brush_part->first : 1.f;
+
+				bool blocked = false;
+				for (size_t other = 0; other < transforms.size() && !blocked; ++other)
+				{
+					if (other == brush)
+						continue;
+					auto const other_part = clip_segment(eye, target, transforms[other]);
+					blocked = other_part && other_part->first < reached;
+				}
+
+				if (!blocked)
+				{
+					++line_count;
+					CHECK(std::binary_search(visible.begin(), visible.end(), entity_id(brush + 1)));
+				}
+			}
+		}
+	}
+
+	CHECK(line_count > 0);
+	CHECK(culled_count > 0);
+}
+
+TEST_CASE("brush_visibility only updates the cells around changed brushes", "[dedit]")
+{
+	// The same walls as above, the wall keeping the bounds of the grid
+	auto const cube = make_cube();
+	auto const make_walls = [&cube](brush_visibility& visibility, ot::math::vector3f second_position)
+	{
+		visibility.set_brush(entity_id(1), cube, make_box({ -5.f, 0.f, 0.f }, { 1.f, 1.f, 1.f }));
+		visibility.set_brush(entity_id(2), cube, make_box(second_position, { 1.f, 1.f, 1.f }));
+		visibility.set_brush(entity_id(3), cube, make_box({ 0.f, 0.f, 0.f }, { 2.f, 10.f, 10.f }));
+	};
+	ot::math::point3f const eyes[] = { { -3.f, 0.f, 0.f }, { 3.f, 0.f, 0.f }, { 3.f, 3.f, 3.f }, { -3.f, -4.f, 2.f } };
+
+	brush_visibility visibility(1.f);
+	make_walls(visibility, { 5.f, 0.f, 0.f });
+	CHECK(get_potentially_visible(visibility, eyes[0]) == std::vector<entity_id>{ entity_id(1), entity_id(3) });
+	CHECK(get_potentially_visible(visibility, eyes[1]) == std::vector<entity_id>{ entity_id(2), entity_id(3) });
+	size_t const cell_count = visibility.get_cell_count();
+
+	// The brush is smaller than a cell and blocks nothing, the sets are kept and only learn where it went
+	visibility.set_brush(entity_id(2), cube, make_box({ 5.f, 2.f, 1.f }, { 1.f, 1.f, 1.f }));
+	CHECK(visibility.get_visible_set_count() == 2);
+	CHECK(get_potentially_visible(visibility, eyes[1]) == std::vector<entity_id>{ entity_id(2), entity_id(3) });
+	CHECK(visibility.get_cell_count() == cell_count);
+
+	brush_visibility rebuilt(1.f);
+	make_walls(rebuilt, { 5.f, 2.f, 1.f });
+	rebuilt.update();
+	CHECK(visibility.get_solid_cell_count() == rebuilt.get_solid_cell_count());
+	for (ot::math::point3f const eye : eyes)
+		CHECK(get_potentially_visible(visibility, eye) == get_potentially_visible(rebuilt, eye));
+
+	SECTION("Removing a brush keeps the sets")
+	{
+		size_t const set_count = visibility.get_visible_set_count();
+		visibility.remove_brush(entity_id(1));
+		rebuilt.remove_brush(entity_id(1));
+		CHECK(visibility.get_visible_set_count() == set_count);
+
+		// The wall moved in the place of the removed brush, and is still seen from the kept sets
+		CHECK(get_potentially_visible(visibility, eyes[0]) == std::vector<entity_id>{ entity_id(3) });
+		CHECK(get_potentially_visible(visibility, eyes[1]) == std::vector<entity_id>{ entity_id(2), entity_id(3) });
+		for (ot::math::point3f const eye : eyes)
+			CHECK(get_potentially_visible(visibility, eye) == get_potentially_visible(rebuilt, eye));
+	}
+
+	SECTION("Moving a wall drops the sets which saw it")
+	{
+		size_t const set_count = visibility.get_visible_set_count();
+		visibility.set_brush(entity_id(3), cube, make_box({ 0.f, 0.f, 0.f }, { 2.f, 10.f, 6.f }));
+		rebuilt.set_brush(entity_id(3), cube, make_box({ 0.f, 0.f, 0.f }, { 2.f, 10.f, 6.f }));
+		CHECK(visibility.get_visible_set_count() < set_count);
+		CHECK(visibility.get_solid_cell_count() == rebuilt.get_solid_cell_count());
+		for (ot::math::point3f const eye : eyes)
+			CHECK(get_potentially_visible(visibility, eye) == get_potentially_visible(rebuilt, eye));
+		CHECK(visibility.get_cell_count() == cell_count);
+	}
+
+	SECTION("Lowering the wall opens the view over it")
+	{
+		visibility.set_brush(entity_id(3), cube, make_box({ 0.f, -3.f, 0.f }, { 2.f, 4.f, 10.f }));
+		CHECK(visibility.get_visible_set_count() == 0);
+		CHECK(visibility.get_solid_cell_count() < rebuilt.get_solid_cell_count());
+		CHECK(get_potentially_visible(visibility, eyes[0]) == std::vector<entity_id>{ entity_id(1), entity_id(2), entity_id(3) });
+	}
+}
+
+TEST_CASE("Brush visibility benchmark", "[.][benchmark]")
+{
+	// Rooms of 8x4x8 with 2 thick walls, floors and ceilings, and doorways between neighbours. Each room has a few props
+	size_t const side = 16;
+	float const pitch = 10.f;
+	auto const cube = make_cube();
+
+	brush_visibility visibility;
+	std::vector<ot::math::aabb> boxes;
+	auto const add = [&](ot::math::vector3f center, ot::math::scales size)
+	{
+		boxes.push_back({ destination_from_origin(center), ot::math::vector3f{ size.x, size.y, size.z } * 0.5f });
+		visibility.set_brush(entity_id(boxes.size()), cube, make_box(center, size));
+	};
+
+	for (size_t i = 0; i < side; ++i)
+	{
+		for (size_t j = 0; j < side; ++j)
+		{
+			float const x = float(i) * pitch;
+			float const z = float(j) * pitch;
+			float const center_x = x + pitch / 2.f;
+			float const center_z = z + pitch / 2.f;
+			add({ center_x, -1.f, center_z }, { pitch + 2.f, 2.f, pitch + 2.f });
+			add({ center_x, 5.f, center_z }, { pitch + 2.f, 2.f, pitch + 2.f });
+
+			// Walls toward -X and -Z, with a 2x3 doorway in the middle except on the edges of the map
+			bool const door_x = i > 0;
+			bool const door_z = j > 0;
+			if (door_x)
+			{
+				add({ x, 2.f, z + 2.5f }, { 2.f, 4.f, 3.f });
+				add({ x, 2.f, z + 7.5f }, { 2.f, 4.f, 3.f });
+				add({ x, 3.5f, center_z }, { 2.f, 1.f, 2.f });
+			}
+			else
+			{
+				add({ x, 2.f, center_z }, { 2.f, 4.f, pitch });
+			}
+			if (door_z)
+			{
+				add({ x + 2.5f, 2.f, z }, { 3.f, 4.f, 2.f });
+				add({ x + 7.5f, 2.f, z }, { 3.f, 4.f, 2.f });
+				add({ center_x, 3.5f, z }, { 2.f, 1.f, 2.f });
+			}
+			else
+			{
+				add({ center_x, 2.f, z }, { pitch, 4.f, 2.f });
+			}
+
+			for (int prop = 0; prop < 4; ++prop)
+				add({ x + 3.f + float(prop % 2) * 4.f, 0.5f, z + 3.f + float(prop / 2) * 4.f }, { 1.f, 1.f, 1.f });
+		}
+	}
+	float const far_side = float(side) * pitch;
+	add({ far_side, 2.f, far_side / 2.f }, { 2.f, 4.f, far_side });
+	add({ far_side / 2.f, 2.f, far_side }, { far_side, 4.f, 2.f });
+
+	using clock = std::chrono::steady_clock;
+	auto const build_start = clock::now();
+	visibility.update();
+	double const build_seconds = std::chrono::duration<double>(clock::now() - build_start).count();
+	std::printf("%zu brushes, %zu cells of %.1f (%zu solid), built in %.3f s\n", visibility.size(), visibility.get_cell_count(), visibility.get_cell_size(), visibility.get_solid_cell_count(), build_seconds);
+
+	// Looking along +X from rooms along the diagonal
+	float const fov = std::numbers::pi_v<float> / 3.f;
+	std::vector<entity_id> potentially_visible;
+	std::vector<entity_id> visible;
+	double total_set_ms = 0.;
+	double total_query_ms = 0.;
+	size_t position_count = 0;
+	for (size_t room = 0; room < side; room += 3)
+	{
+		ot::math::point3f const eye{ float(room) * pitch + 1.5f, 1.5f, float(room) * pitch + pitch / 2.f };
+		ot::math::transform_matrix const camera = ot::math::transform_matrix::from_components(vector_from_origin(eye), ot::math::quaternion::y_deg_rotation(-90.f));
+		ot::math::frustum const f = ot::math::make_perspective_frustum(camera, fov, 16.f / 9.f, 0.1f, 1000.f);
+
+		auto const set_start = clock::now();
+		visibility.get_potentially_visible_brushes(eye, potentially_visible);
+		double const set_ms = std::chrono::duration<double, std::milli>(clock::now() - set_start).count();
+
+		auto const query_start = clock::now();
+		visibility.get_visible_brushes(eye, f, visible);
+		double const query_ms = std::chrono::duration<double, std::milli>(clock::now() - query_start).count();
+
+		// What frustum culling alone keeps
+		size_t const in_frustum = static_cast<size_t>(std::count_if(boxes.begin(), boxes.end(), [&f](ot::math::aabb const& box) { return !f.is_outside(box); }));
+
+		total_set_ms += set_ms;
+		total_query_ms += query_ms;
+		++position_count;
+		std::printf("room %2zu: %4zu potentially visible, %4zu of them in the frustum (%4zu with the frustum alone), set computed in %.3f ms, cached query %.4f ms\n", room, potentially_visible.size(), visible.size(), in_frustum, set_ms, query_ms);
+	}
+	std::printf("average: set %.3f ms, cached query %.4f ms, out of %zu brushes\n", total_set_ms / double(position_count), total_query_ms / double(position_count), visibility.size());
+
+	// Dragging a prop of the first room, as the editor does every frame
+	entity_id const prop_id = entity_id(std::distance(boxes.begin(), std::find_if(boxes.begin(), boxes.end(), [](ot::math::aabb const& box) { return box.half_size.x == 0.5f; })) + 1);
+	ot::math::point3f const drag_eye{ 1.5f, 1.5f, pitch / 2.f };
+	double total_move_ms = 0.;
+	size_t const move_count = 60;
+	for (size_t frame = 0; frame < move_count; ++frame)
+	{
+		auto const move_start = clock::now();
+		visibility.set_brush(prop_id, cube, make_box({ 3.f + float(frame) * 0.05f, 0.5f, 3.f }, { 1.f, 1.f, 1.f }));
+		visibility.get_potentially_visible_brushes(drag_eye, potentially_visible);
+		total_move_ms += std::chrono::duration<double, std::milli>(clock::now() - move_start).count();
+	}
+	std::printf("moving a prop: %.3f ms per frame with its set, %zu sets kept\n", total_move_ms / double(move_count), visibility.get_visible_set_count());
+}
@@ -0,0 +1,135 @@
+#include "serialize/byte_stream.h"
+#include "serialize/serialize_math.h"
+#include "serialize/serialize_mesh_definition.h"
+
+#include "egfx/mesh_definition.h"
+#include "egfx/mesh_definition_cache.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	using ot::dedit::serialize::byte_stream;
+}
+
+TEST_CASE("byte_stream reads back what was written", "[dedit]")
+{
+	byte_stream stream;
+	uint64_t const count = 3;
+	float const values[] = { 1.f, 2.f, 3.f };
+	REQUIRE(ot::dedit::serialize::fwrite(&count, sizeof(count), 1, stream) == 1);
+	REQUIRE(ot::dedit::serialize::fwrite(values, sizeof(float), 3, stream) == 3);
+	REQUIRE(stream.size() == sizeof(count) + sizeof(values));
+
+	uint64_t read_count = 0;
+	float read_values[3] = {};
+	REQUIRE(ot::dedit::serialize::fread(&read_count, sizeof(read_count), 1, stream) == 1);
+	REQUIRE(ot::dedit::serialize::fread(read_values, sizeof(float), 3, stream) == 3);
+	CHECK(read_count == count);
+	CHECK(read_values[2] == 3.f);
+
+	SECTION("Reading past the end only reads whole elements")
+	{
+		stream.rewind();
+		float past_end[4] = {};
+		REQUIRE(ot::dedit::serialize::fread(past_end, sizeof(float), 4, stream) == 4);
+		REQUIRE(ot::dedit::serialize::fread(past_end, sizeof(uint64_t), 1, stream) == 0);
+		CHECK(stream.get_read_offset() == 16);
+		REQUIRE(ot::dedit::serialize::fread(past_end, sizeof(float), 4, stream) == 1);
+		CHECK(past_end[0] == 3.f);
+		CHECK(ot::dedit::serialize::fread(past_end, sizeof(float), 1, stream) == 0);
+	}
+
+	SECTION("Clearing empties the stream")
+	{
+		stream.clear();
+		CHECK(stream.size() == 0);
+		CHECK(stream.get_read_offset() == 0);
+		CHECK(ot::dedit::serialize::fread(&read_count, sizeof(read_count), 1, stream) == 0);
+	}
+}
+
+TEST_CASE("byte_stream serializes math types and meshes", "[dedit]")
+{
+	byte_stream stream;
+	ot::math::point3f const p{ 1.f, 2.f, 3.f };
+	ot::math::quaternion const q = ot::math::quaternion::y_deg_rotation(30.f);
+	ot::math::quaternion const qs[] = { q, ot::math::quaternion::identity() };
+	REQUIRE(ot::dedit::serialize::fwrite(p, stream));
+	REQUIRE(ot::dedit::serialize::fwrite(std::span<ot::math::quaternion const>(qs), stream));
+	REQUIRE(ot::dedit::serialize::fwrite(ot::egfx::mesh_definition::get_cube(), stream));
+
+	ot::math::point3f read_p;
+	ot::math::quaternion read_qs[2];
+	ot::egfx::mesh_definition_cache cache;
+	std::shared_ptr<ot::egfx::mesh_definition const> read_mesh;
+	REQUIRE(ot::dedit::serialize::fread(read_p, stream));
+	REQUIRE(ot::dedit::serialize::fread(std::span<ot::math::quaternion>(read_qs), stream));
+	REQUIRE(ot::dedit::serialize::fread(read_mesh, cache, stream));
+	CHECK(stream.get_read_offset() == stream.size());
+
+	CHECK(float_eq(read_p, p));
+	CHECK(float_eq(read_qs[0], q));
+	REQUIRE(read_mesh != nullptr);
+	CHECK(read_mesh->get_faces().size() == 6);
+
+	// Truncated meshes fail to read
+	byte_stream truncated;
+	truncated.write(stream.get_data().data() + sizeof(ot::math::point3f) + sizeof(qs), 20);
+	CHECK(!ot::dedit::serialize::fread(read_mesh, cache, truncated));
+}
+
+TEST_CASE("Delete state benchmark", "[.][benchmark]")
+{
+	// State kept for undoing the delete of each of 5k brushes, as written by brush entities
+	size_t const brush_count = 5000;
+	ot::egfx::mesh_definition const& cube = ot::egfx::mesh_definition::get_cube();
+	ot::math::point3f const position{ 1.f, 2.f, 3.f };
+	ot::math::quaternion const rotation = ot::math::quaternion::identity();
+
+	using clock = std::chrono::steady_clock;
+
+	std::vector<byte_stream> streams(brush_count);
+	auto const stream_start = clock::now();
+	for (byte_stream& stream : streams)
+	{
+		(void)ot::dedit::serialize::fwrite(position, stream);
+		(void)ot::dedit::serialize::fwrite(rotation, stream);
+		(void)ot::dedit::serialize::fwrite(cube, stream);
+		stream.shrink_to_fit();
+	}
+	double const stream_ms = std::chrono::duration<double, std::milli>(clock::now() - stream_start).count();
+
+	// What deletes used to do: one temporary file each
+	std::vector<std::FILE*> files;
+	files.reserve(brush_count);
+	auto const file_start = clock::now();
+	for (size_t i = 0; i < brush_count; ++i)
+	{
+		std::FILE* const f = std::tmpfile();
+		if (f == nullptr)
+			break;
+
+		(void)::fwrite(&position, sizeof(position), 1, f);
+		(void)::fwrite(&rotation, sizeof(rotation), 1, f);
+		size_t const face_count = cube.get_faces().size();
+		(void)::fwrite(&face_count, sizeof(face_count), 1, f);
+		for (ot::egfx::face::cref const face : cube.get_faces())
+		{
+			ot::math::plane const plane = face.get_plane();
+			(void)::fwrite(&plane, sizeof(plane), 1, f);
+		}
+		std::fseek(f, 0, SEEK_SET);
+		files.push_back(f);
+	}
+	double const file_ms = std::chrono::duration<double, std::milli>(clock::now() - file_start).count();
+	for (std::FILE* const f : files)
+		std::fclose(f);
+
+	std::printf("%zu deletes: byte streams %.3f ms (%zu bytes each), temporary files %.3f ms (%zu files)\n", brush_count, stream_ms, streams.front().size(), file_ms, files.size());
+}
@@ -0,0 +1,187 @@
+#include "console.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <format>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace console = ot::dedit::console;
+
+namespace
+{
+	struct console_fixture
+	{
+		console_fixture()
+		{
+			console::initialize();
+		}
+	};
+
+	std::string read_message(uint64_t sequence)
+	{
+		console::log_data log;
+		REQUIRE(console::read_log(sequence, log));
+		return std::string(log.get_message());
+	}
+}
+
+TEST_CASE("console keeps formatted logs in order", "[dedit]")
+{
+	console_fixture const fixture;
+
+	console::log("Created {} {}", "brush", 12);
+	console::warning("plain");
+	console::error("Could not open '{}'", "a.map");
+
+	console::log_range const logs = console::get_logs();
+	REQUIRE(logs.size() == 3);
+	CHECK(read_message(logs.begin) == "Created brush 12");
+	CHECK(read_message(logs.begin + 1) == "plain");
+	CHECK(read_message(logs.begin + 2) == "Could not open 'a.map'");
+
+	console::level_type level;
+	REQUIRE(console::read_log_level(logs.begin + 2, level));
+	CHECK(level == console::level_type::error);
+	CHECK(console::get_log_count(console::level_type::error) == 1);
+
+	SECTION("Clearing")
+	{
+		console::clear();
+		CHECK(console::get_logs().empty());
+		CHECK(console::get_log_count(console::level_type::error) == 0);
+	}
+
+	SECTION("Logs under the filter are dropped")
+	{
+		console::set_level_filter(console::level_type::warning);
+		console::log("dropped {}", 1);
+		console::verbose("dropped");
+		console::warning("kept");
+		CHECK(console::get_logs().size() == 4);
+	}
+}
+
+TEST_CASE("console cuts long messages", "[dedit]")
+{
+	console_fixture const fixture;
+
+	std::string const long_message(console::max_message_length * 2, 'a');
+	console::log(long_message);
+	console::log("{}", long_message);
+
+	console::log_range const logs = console::get_logs();
+	for (uint64_t sequence = logs.begin; sequence != logs.end; ++sequence)
+	{
+		std::string const message = read_message(sequence);
+		CHECK(message.size() == console::max_message_length);
+		CHECK(message.ends_with("aaa..."));
+	}
+}
+
+TEST_CASE("console ring overwrites the oldest logs", "[dedit]")
+{
+	console_fixture const fixture;
+
+	for (size_t i = 0; i < console::max_log_count + 10; ++i)
+		console::log("{}", i);
+
+	console::log_range const logs = console::get_logs();
+	CHECK(logs.size() == console::max_log_count);
+	CHECK(read_message(logs.begin) == "10");
+	CHECK(read_message(logs.end - 1) == std::to_string(console::max_log_count + 9));
+
+	// Overwritten logs can't be read
+	console::log_data log;
+	CHECK(!console::read_log(logs.begin - 1, log));
+	CHECK(console::get_log_count(console::level_type::log) == console::max_log_count + 10);
+}
+
+TEST_CASE("console takes logs from many threads", "[dedit]")
+{
+	console_fixture const fixture;
+
+	size_t const thread_count = 4;
+	size_t const logs_per_thread = 1000;
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < thread_count; ++t)
+	{
+		threads.emplace_back([t, logs_per_thread]
+		{
+			for (size_t i = 0; i < logs_per_thread; ++i)
+				console::log("thread {} log {}", t, i);
+		});
+	}
+
+	// Reading while the threads write only ever gives whole messages
+	for (int pass = 0; pass < 100; ++pass)
+	{
+		console::log_range const logs = console::get_logs();
+		for (uint64_t sequence = logs.begin; sequence != logs.end; ++sequence)
+		{
+			console::log_data log;
+			if (console::read_log(sequence, log))
+				REQUIRE(log.get_message().starts_with("thread "));
+		}
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	console::log_range const logs = console::get_logs();
+	CHECK(logs.size() == thread_count * logs_per_thread);
+	CHECK(console::get_log_count(console::level_type::log) == thread_count * logs_per_thread);
+
+	// Each thread's logs are in its own order
+	std::vector<size_t> next_log(thread_count, 0);
+	for (uint64_t sequence = logs.begin; sequence != logs.end; ++sequence)
+	{
+		std::string const message = read_message(sequence);
+		size_t t = 0;
+		size_t i = 0;
+		REQUIRE(std::sscanf(message.c_str(), "thread %zu log %zu", &t, &i) == 2);
+		REQUIRE(t < thread_count);
+		CHECK(i == next_log[t]);
+		next_log[t] = i + 1;
+	}
+}
+
+TEST_CASE("Console benchmark", "[.][benchmark]")
+{
+	console_fixture const fixture;
+	using clock = std::chrono::steady_clock;
+
+	// A long session of per-action logs, against appending strings to a vector like the console used to
+	size_t const log_count = 1000000;
+
+	auto const ring_start = clock::now();
+	for (size_t i = 0; i < log_count; ++i)
+		console::log("Created brush {} under {}", i, "root");
+	double const ring_ms = std::chrono::duration<double, std::milli>(clock::now() - ring_start).count();
+
+	std::vector<std::string> vector_logs;
+	auto const vector_start = clock::now();
+	for (size_t i = 0; i < log_count; ++i)
+		vector_logs.push_back(std::format("Created brush {} under {}", i, "root"));
+	double const vector_ms = std::chrono::duration<double, std::milli>(clock::now() - vector_start).count();
+
+	// Reading what a window of 40 lines shows
+	console::log_range const logs = console::get_logs();
+	auto const read_start = clock::now();
+	size_t characters = 0;
+	for (uint64_t sequence = logs.end - 40; sequence != logs.end; ++sequence)
+	{
+		console::log_data log;
+		if (console::read_log(sequence, log))
+			characters += log.length;
+	}
+	double const read_ms = std::chrono::duration<double, std::milli>(clock::now() - read_start).count();
+
+	WARN("Ring: " << ring_ms << " ms for " << log_count << " logs, " << logs.size() << " kept");
+	WARN("Vector: " << vector_ms << " ms, " << vector_logs.size() << " kept");
+	WARN("Visible lines read in " << read_ms << " ms, " << characters << " characters");
+}
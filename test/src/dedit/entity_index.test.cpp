@@ -0,0 +1,119 @@
+#include "entity_index.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+using ot::dedit::entity_id;
+using ot::dedit::entity_index;
+
+TEST_CASE("entity_index add and find", "[dedit]")
+{
+	entity_index index;
+	size_t const a = index.add(entity_id(1), entity_id::root);
+	size_t const b = index.add(entity_id(2), entity_id(1));
+	size_t const c = index.add(entity_id(3), entity_id::root);
+
+	REQUIRE(index.size() == 3);
+	REQUIRE(index.find(entity_id(1)) == a);
+	REQUIRE(index.find(entity_id(2)) == b);
+	REQUIRE(index.find(entity_id(3)) == c);
+	REQUIRE(index.find(entity_id(4)) == entity_index::no_slot);
+	REQUIRE(index.find(entity_id::root) == entity_index::no_slot);
+
+	REQUIRE(index.get_parent(a) == entity_id::root);
+	REQUIRE(index.get_parent(b) == entity_id(1));
+
+	REQUIRE_THROWS_AS(index.add(entity_id(2), entity_id::root), std::invalid_argument);
+	REQUIRE_THROWS_AS(index.add(entity_id(5), entity_id(42)), std::invalid_argument);
+	REQUIRE_THROWS_AS(index.add(entity_id::root, entity_id::root), std::invalid_argument);
+	REQUIRE(index.size() == 3);
+}
+
+TEST_CASE("entity_index remove_subtree", "[dedit]")
+{
+	// 1
+	// +- 2
+	// |  +- 4
+	// +- 3
+	// 5
+	entity_index index;
+	index.add(entity_id(1), entity_id::root);
+	index.add(entity_id(2), entity_id(1));
+	index.add(entity_id(3), entity_id(1));
+	index.add(entity_id(4), entity_id(2));
+	index.add(entity_id(5), entity_id::root);
+
+	std::vector<size_t> removed_slots;
+	index.remove_subtree(entity_id(2), removed_slots);
+	REQUIRE(removed_slots.size() == 2);
+	REQUIRE(index.size() == 3);
+	REQUIRE(!index.contains(entity_id(2)));
+	REQUIRE(!index.contains(entity_id(4)));
+	REQUIRE(index.contains(entity_id(3)));
+
+	// Freed slots are reused
+	size_t const reused = index.add(entity_id(6), entity_id(3));
+	REQUIRE(std::find(removed_slots.begin(), removed_slots.end(), reused) != removed_slots.end());
+	REQUIRE(index.get_slot_count() == 5);
+
+	removed_slots.clear();
+	index.remove_subtree(entity_id(1), removed_slots);
+	REQUIRE(removed_slots.size() == 3);
+	REQUIRE(removed_slots.front() == 0); // parents come before their children
+	REQUIRE(index.size() == 1);
+	REQUIRE(index.contains(entity_id(5)));
+
+	removed_slots.clear();
+	index.remove_subtree(entity_id(1), removed_slots);
+	REQUIRE(removed_slots.empty());
+
+	index.clear();
+	REQUIRE(index.size() == 0);
+	REQUIRE(index.get_slot_count() == 0);
+}
+
+TEST_CASE("Entity index benchmark", "[.][benchmark]")
+{
+	size_t const entity_count = 100'000;
+	size_t const lookup_count = 10'000;
+
+	// Groups of a parent with 9 children, like prefabs
+	entity_index index;
+	std::vector<entity_id> linear_ids;
+	for (size_t i = 1; i <= entity_count; ++i)
+	{
+		entity_id const parent = i % 10 == 1 ? entity_id::root : entity_id(i - (i - 1) % 10);
+		index.add(entity_id(i), parent);
+		linear_ids.push_back(entity_id(i));
+	}
+
+	using clock = std::chrono::steady_clock;
+
+	size_t found = 0;
+	auto const index_start = clock::now();
+	for (size_t i = 0; i < lookup_count; ++i)
+		found += index.find(entity_id(1 + i * 7919 % entity_count)) != entity_index::no_slot;
+	double const index_seconds = std::chrono::duration<double>(clock::now() - index_start).count();
+
+	// What map::find_entity used to do
+	auto const linear_start = clock::now();
+	for (size_t i = 0; i < lookup_count; ++i)
+		found += std::find(linear_ids.begin(), linear_ids.end(), entity_id(1 + i * 7919 % entity_count)) != linear_ids.end();
+	double const linear_seconds = std::chrono::duration<double>(clock::now() - linear_start).count();
+
+	REQUIRE(found == 2 * lookup_count);
+
+	std::vector<size_t> removed_slots;
+	auto const remove_start = clock::now();
+	for (size_t i = 1; i <= entity_count; i += 10)
+		index.remove_subtree(entity_id(i), removed_slots);
+	double const remove_seconds = std::chrono::duration<double>(clock::now() - remove_start).count();
+	REQUIRE(removed_slots.size() == entity_count);
+
+	std::printf("%zu lookups in %zu entities: index %.6f s, linear %.6f s\n", lookup_count, entity_count, index_seconds, linear_seconds);
+	std::printf("Deleting %zu groups of 10 entities: %.6f s\n", entity_count / 10, remove_seconds);
+}
@@ -0,0 +1,358 @@
+#include "serialize/map_file.h"
+
+#include "egfx/mesh_definition.h"
+#include "egfx/mesh_definition_cache.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+{
+	using ot::dedit::entity_id;
+	using ot::dedit::entity_type;
+	using ot::dedit::serialize::entity_record;
+	using ot::dedit::serialize::map_records;
+
+	// Boxes of various sizes in rows, 'names' holds the names the records point to
+	map_records make_box_records(size_t brush_count, std::vector<std::string>& names)
+	{
+		names.resize(brush_count);
+
+		map_records records;
+		records.entities.reserve(brush_count);
+		records.planes.reserve(brush_count * 6);
+		for (size_t i = 0; i < brush_count; ++i)
+		{
+			names[i] = "Brush " + std::to_string(i + 1);
+
+			entity_record& brush = records.entities.emplace_back();
+			brush.id = entity_id(i + 1);
+			brush.type = entity_type::brush;
+			brush.name = names[i];
+			brush.position = { float(i % 100), 0.f, float(i / 100) };
+			brush.first_plane = static_cast<uint32_t>(records.planes.size());
+			brush.plane_count = 6;
+
+			float const size = 0.5f + float(i % 7);
+			records.planes.insert(records.planes.end(), {
+				{{0, 0, 1}, size},
+				{{1, 0, 0}, size},
+				{{0, 1, 0}, size},
+				{{-1, 0, 0}, size},
+				{{0, -1, 0}, size},
+				{{0, 0, -1}, size},
+			});
+		}
+		return records;
+	}
+
+	map_records make_test_records()
+	{
+		map_records records;
+
+		entity_record& brush = records.entities.emplace_back();
+		brush.id = entity_id(1);
+		brush.type = entity_type::brush;
+		brush.name = "Brush 1";
+		brush.position = { 1.f, 2.f, 3.f };
+		brush.rotation = ot::math::quaternion::y_deg_rotation(45.f);
+		brush.scale = { 2.f, 2.f, 0.5f };
+		brush.first_plane = 0;
+		brush.plane_count = 6;
+		records.planes = {
+			{{0, 0, 1}, 0.5},
+			{{1, 0, 0}, 0.5},
+			{{0, 1, 0}, 0.5},
+			{{-1, 0, 0}, 0.5},
+			{{0, -1, 0}, 0.5},
+			{{0, 0, -1}, 0.5},
+		};
+
+		entity_record& light = records.entities.emplace_back();
+		light.id = entity_id(4);
+		light.parent_id = entity_id(1);
+		light.type = entity_type::light;
+		light.name = "Light under a brush";
+		light.position = { 0.f, -1.f, 0.f };
+		light.light_type = ot::egfx::light_type::spotlight;
+		light.power_scale = 3.f;
+		light.diffuse = { 0.5f, 0.25f, 1.f };
+
+		return records;
+	}
+
+	void require_equal(entity_record const& lhs, entity_record const& rhs)
+	{
+		REQUIRE(lhs.id == rhs.id);
+		REQUIRE(lhs.parent_id == rhs.parent_id);
+		REQUIRE(lhs.type == rhs.type);
+		REQUIRE(lhs.name == rhs.name);
+		REQUIRE(lhs.position == rhs.position);
+		REQUIRE(lhs.rotation.w == rhs.rotation.w);
+		REQUIRE(lhs.rotation.x == rhs.rotation.x);
+		REQUIRE(lhs.rotation.y == rhs.rotation.y);
+		REQUIRE(lhs.rotation.z == rhs.rotation.z);
+		REQUIRE(lhs.scale.x == rhs.scale.x);
+		REQUIRE(lhs.scale.y == rhs.scale.y);
+		REQUIRE(lhs.scale.z == rhs.scale.z);
+		REQUIRE(lhs.plane_count == rhs.plane_count);
+		if (lhs.type == entity_type::light)
+		{
+			REQUIRE(lhs.light_type == rhs.light_type);
+			REQUIRE(lhs.power_scale == rhs.power_scale);
+			REQUIRE(lhs.diffuse.r == rhs.diffuse.r);
+			REQUIRE(lhs.diffuse.g == rhs.diffuse.g);
+			REQUIRE(lhs.diffuse.b == rhs.diffuse.b);
+		}
+	}
+
+	// Prisms with a varying number of sides, to give brushes a varying cost
+	map_records make_prism_records(size_t brush_count)
+	{
+		map_records records;
+		for (size_t i = 0; i < brush_count; ++i)
+		{
+			size_t const side_count = 3 + i % 30;
+
+			entity_record& brush = records.entities.emplace_back();
+			brush.id = entity_id(i + 1);
+			brush.type = entity_type::brush;
+			brush.first_plane = static_cast<uint32_t>(records.planes.size());
+			brush.plane_count = static_cast<uint32_t>(side_count + 2);
+
+			records.planes.push_back({ {0, 1, 0}, 0.5f });
+			records.planes.push_back({ {0, -1, 0}, 0.5f });
+			for (size_t side = 0; side < side_count; ++side)
+			{
+				float const angle = 2.f * std::numbers::pi_v<float> * float(side) / float(side_count);
+				records.planes.push_back({ {std::cos(angle), 0, std::sin(angle)}, 0.5f });
+			}
+		}
+		return records;
+	}
+
+	template<typename T>
+	void append_raw(std::vector<std::byte>& buffer, T const& value)
+	{
+		std::byte bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+		buffer.insert(buffer.end(), std::begin(bytes), std::end(bytes));
+	}
+
+	// Writes the entity the way version 1 did, field by field in their in-memory layout
+	void append_version_1_entity(std::vector<std::byte>& buffer, map_records const& records, entity_record const& e, uint64_t child_count)
+	{
+		append_raw(buffer, e.id);
+		append_raw(buffer, e.type);
+		append_raw(buffer, uint64_t(e.name.size()));
+		buffer.insert(buffer.end(), reinterpret_cast<std::byte const*>(e.name.data()), reinterpret_cast<std::byte const*>(e.name.data() + e.name.size()));
+		append_raw(buffer, e.position);
+		append_raw(buffer, e.rotation);
+		append_raw(buffer, e.scale);
+		if (e.type == entity_type::brush)
+		{
+			append_raw(buffer, uint64_t(e.plane_count));
+			for (ot::math::plane const& p : records.get_planes(e))
+				append_raw(buffer, p);
+		}
+		else
+		{
+			append_raw(buffer, e.light_type);
+			append_raw(buffer, e.power_scale);
+			append_raw(buffer, e.diffuse.r);
+			append_raw(buffer, e.diffuse.g);
+			append_raw(buffer, e.diffuse.b);
+		}
+		append_raw(buffer, child_count);
+	}
+}
+
+TEST_CASE("map file round-trip", "[dedit]")
+{
+	map_records const records = make_test_records();
+
+	std::vector<std::byte> buffer;
+	ot::dedit::serialize::write(records, buffer);
+
+	// Fixed-width little-endian version
+	REQUIRE(buffer.size() > 8);
+	REQUIRE(buffer[0] == std::byte(2));
+	for (size_t i = 1; i < 8; ++i)
+		REQUIRE(buffer[i] == std::byte(0));
+
+	map_records parsed;
+	REQUIRE(ot::dedit::serialize::parse(buffer, parsed));
+	REQUIRE(parsed.entities.size() == records.entities.size());
+	for (size_t i = 0; i < records.entities.size(); ++i)
+		require_equal(parsed.entities[i], records.entities[i]);
+
+	REQUIRE(parsed.planes.size() == records.planes.size());
+	for (size_t i = 0; i < records.planes.size(); ++i)
+	{
+		REQUIRE(float_eq(parsed.planes[i].normal, records.planes[i].normal));
+		REQUIRE(parsed.planes[i].distance == records.planes[i].distance);
+	}
+
+	// Any truncation must be detected
+	for (size_t size = 0; size < buffer.size(); size += 7)
+	{
+		map_records truncated;
+		REQUIRE(!ot::dedit::serialize::parse(std::span(buffer).first(size), truncated));
+	}
+}
+
+TEST_CASE("map file version 1", "[dedit]")
+{
+	map_records const records = make_test_records();
+
+	std::vector<std::byte> buffer;
+	append_raw(buffer, uint64_t(1)); // version
+	append_raw(buffer, uint64_t(1)); // root entity count
+	append_version_1_entity(buffer, records, records.entities[0], 1);
+	append_version_1_entity(buffer, records, records.entities[1], 0);
+
+	map_records parsed;
+	REQUIRE(ot::dedit::serialize::parse(buffer, parsed));
+	REQUIRE(parsed.entities.size() == 2);
+	require_equal(parsed.entities[0], records.entities[0]);
+	require_equal(parsed.entities[1], records.entities[1]);
+	REQUIRE(parsed.planes.size() == 6);
+	REQUIRE(parsed.get_planes(parsed.entities[0]).size() == 6);
+
+	buffer.pop_back();
+	REQUIRE(!ot::dedit::serialize::parse(buffer, parsed));
+}
+
+TEST_CASE("map file with 50k brushes", "[dedit]")
+{
+	std::vector<std::string> names;
+	map_records const records = make_box_records(50'000, names);
+
+	std::vector<std::byte> buffer;
+	ot::dedit::serialize::write(records, buffer);
+
+	map_records parsed;
+	REQUIRE(ot::dedit::serialize::parse(buffer, parsed));
+	REQUIRE(parsed.entities.size() == records.entities.size());
+	REQUIRE(parsed.planes.size() == records.planes.size());
+	for (size_t i = 0; i < records.entities.size(); i += 997)
+		require_equal(parsed.entities[i], records.entities[i]);
+	REQUIRE(std::memcmp(parsed.planes.data(), records.planes.data(), records.planes.size() * sizeof(ot::math::plane)) == 0);
+}
+
+TEST_CASE("Map file benchmark", "[.][benchmark]")
+{
+	std::vector<std::string> names;
+	map_records const records = make_box_records(50'000, names);
+
+	using clock = std::chrono::steady_clock;
+
+	auto const write_start = clock::now();
+	std::vector<std::byte> buffer;
+	ot::dedit::serialize::write(records, buffer);
+	double const write_seconds = std::chrono::duration<double>(clock::now() - write_start).count();
+
+	map_records parsed;
+	auto const parse_start = clock::now();
+	bool const parse_result = ot::dedit::serialize::parse(buffer, parsed);
+	double const parse_seconds = std::chrono::duration<double>(clock::now() - parse_start).count();
+	REQUIRE(parse_result);
+
+	std::printf("%zu brushes, %zu bytes: write %.6f s, parse %.6f s\n", records.entities.size(), buffer.size(), write_seconds, parse_seconds);
+}
+
+TEST_CASE("build_brush_meshes", "[dedit]")
+{
+	map_records records = make_prism_records(500);
+	entity_record& light = records.entities.emplace_back();
+	light.id = entity_id(1000);
+	light.type = entity_type::light;
+
+	auto const sequential = ot::dedit::serialize::build_brush_meshes(records, 1);
+	auto const parallel = ot::dedit::serialize::build_brush_meshes(records, 4);
+	REQUIRE(sequential.size() == records.entities.size());
+	REQUIRE(parallel.size() == records.entities.size());
+	REQUIRE(sequential.back() == nullptr);
+	REQUIRE(parallel.back() == nullptr);
+
+	for (size_t i = 0; i + 1 < records.entities.size(); ++i)
+	{
+		REQUIRE(sequential[i] != nullptr);
+		REQUIRE(parallel[i] != nullptr);
+		REQUIRE(parallel[i]->get_faces().size() == records.entities[i].plane_count);
+		REQUIRE(parallel[i]->get_vertices().size() == sequential[i]->get_vertices().size());
+		for (ot::egfx::vertex::cref const v : parallel[i]->get_vertices())
+			REQUIRE(v.get_position() == sequential[i]->get_vertex(v.get_id()).get_position());
+	}
+
+	// An open volume fails the whole load
+	entity_record& open_brush = records.entities.emplace_back();
+	open_brush.id = entity_id(1001);
+	open_brush.type = entity_type::brush;
+	open_brush.first_plane = 0;
+	open_brush.plane_count = 4; // top, bottom and two sides of a prism
+	REQUIRE_THROWS_AS(ot::dedit::serialize::build_brush_meshes(records, 4), std::invalid_argument);
+}
+
+TEST_CASE("build_brush_meshes with a cache", "[dedit]")
+{
+	// 30 distinct prisms, repeated
+	map_records const records = make_prism_records(500);
+
+	ot::egfx::mesh_definition_cache cache;
+	auto const meshes = ot::dedit::serialize::build_brush_meshes(records, cache, 4);
+	REQUIRE(meshes.size() == records.entities.size());
+
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		REQUIRE(meshes[i] != nullptr);
+		REQUIRE(meshes[i]->get_faces().size() == records.entities[i].plane_count);
+		if (i >= 30)
+			REQUIRE(meshes[i] == meshes[i % 30]);
+	}
+
+	ot::egfx::mesh_definition_cache::statistics const stats = cache.get_statistics();
+	CHECK(stats.entries == 30);
+	CHECK(stats.hits + stats.misses == 500);
+	CHECK(stats.misses >= 30);
+
+	// Loading the same brushes again only hits the cache
+	cache.reset_statistics();
+	auto const reloaded = ot::dedit::serialize::build_brush_meshes(records, cache, 4);
+	CHECK(cache.get_statistics().misses == 0);
+	CHECK(cache.get_statistics().hits == 500);
+	CHECK(reloaded == meshes);
+}
+
+TEST_CASE("Map load mesh building benchmark", "[.][benchmark]")
+{
+	map_records const records = make_prism_records(20'000);
+
+	using clock = std::chrono::steady_clock;
+	size_t const max_thread_count = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2)
+	{
+		auto const start = clock::now();
+		auto const meshes = ot::dedit::serialize::build_brush_meshes(records, thread_count);
+		double const seconds = std::chrono::duration<double>(clock::now() - start).count();
+		std::printf("%2zu threads: %.3f s for %zu brushes\n", thread_count, seconds, meshes.size());
+	}
+
+	// Every brush is one of 30 prisms, as when a map is made of stamped prefabs
+	for (size_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2)
+	{
+		ot::egfx::mesh_definition_cache cache;
+		auto const start = clock::now();
+		auto const meshes = ot::dedit::serialize::build_brush_meshes(records, cache, thread_count);
+		double const seconds = std::chrono::duration<double>(clock::now() - start).count();
+		ot::egfx::mesh_definition_cache::statistics const stats = cache.get_statistics();
+		std::printf("%2zu threads, cached: %.3f s for %zu brushes, %zu hits, %zu misses\n", thread_count, seconds, meshes.size(), stats.hits, stats.misses);
+	}
+}
@@ -0,0 +1,243 @@
+#include <egfx/chunk_grid.h>
+#include <egfx/mesh_definition.h>
+
+#include "../brush_helpers.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <stdexcept>
+
+namespace
+{
+	using ot::egfx::chunk_grid;
+	using ot::egfx::chunk_coord;
+	using ot::egfx::chunk_part_id;
+
+	using ot::test::make_cube;
+	using ot::test::make_transform;
+
+	bool is_dirty(chunk_grid const& grid, chunk_coord const& key)
+	{
+		auto const dirty = grid.get_dirty_chunks();
+		bool const listed = std::find(dirty.begin(), dirty.end(), key) != dirty.end();
+		CHECK(grid.is_chunk_dirty(key) == listed);
+		return listed;
+	}
+}
+
+TEST_CASE("get_chunk_coord", "[graphics]")
+{
+	CHECK(ot::egfx::get_chunk_coord({ 0.f, 0.f, 0.f }, 10.f) == ot::egfx::chunk_coord{ 0, 0, 0 });
+	CHECK(ot::egfx::get_chunk_coord({ 9.9f, 10.f, 25.f }, 10.f) == ot::egfx::chunk_coord{ 0, 1, 2 });
+	CHECK(ot::egfx::get_chunk_coord({ -0.1f, -10.f, -10.1f }, 10.f) == ot::egfx::chunk_coord{ -1, -1, -2 });
+}
+
+TEST_CASE("chunk_grid groups parts by cell", "[graphics]")
+{
+	chunk_grid grid(10.f);
+	auto const cube = make_cube();
+
+	chunk_part_id const a = grid.add({ cube, make_transform({ 1.f, 1.f, 1.f }), 1 });
+	chunk_part_id const b = grid.add({ cube, make_transform({ 5.f, 2.f, 3.f }), 1 });
+	chunk_part_id const c = grid.add({ cube, make_transform({ 5.f, 2.f, 3.f }), 2 });
+	chunk_part_id const d = grid.add({ cube, make_transform({ -5.f, 2.f, 3.f }), 1 });
+
+	chunk_coord const near_cell{ 0, 0, 0 };
+	chunk_coord const far_cell{ -1, 0, 0 };
+
+	REQUIRE(grid.get_part_count() == 4);
+	REQUIRE(grid.get_chunk_count() == 2);
+	CHECK(grid.get_part_chunk(a) == near_cell);
+	CHECK(grid.get_part_chunk(b) == near_cell);
+	CHECK(grid.get_part_chunk(c) == near_cell);
+	CHECK(grid.get_part_chunk(d) == far_cell);
+	REQUIRE(grid.find_chunk(near_cell) != nullptr);
+	CHECK(grid.find_chunk(near_cell)->parts.size() == 3);
+	CHECK(grid.get_dirty_chunks().size() == 2);
+
+	grid.clear_dirty_chunks();
+	CHECK(grid.get_dirty_chunks().empty());
+	CHECK(!is_dirty(grid, near_cell));
+
+	SECTION("Parts of a chunk are grouped by material")
+	{
+		std::vector<ot::egfx::chunk_submesh> const submeshes = grid.make_submeshes(near_cell);
+		REQUIRE(submeshes.size() == 2);
+		CHECK(submeshes[0].material == 1);
+		CHECK(submeshes[0].parts.size() == 2);
+		CHECK(submeshes[1].material == 2);
+		REQUIRE(submeshes[1].parts.size() == 1);
+		CHECK(submeshes[1].parts[0].mesh == cube.get());
+		REQUIRE(submeshes[1].parts[0].transform.has_value());
+		CHECK(float_eq(*submeshes[1].parts[0].transform, grid.get_part(c).transform));
+	}
+
+	SECTION("Moving a part dirties the chunk it leaves and the chunk it enters")
+	{
+		grid.set(b, { cube, make_transform({ -5.f, 0.f, 0.f }), 1 });
+		CHECK(grid.get_part_chunk(b) == far_cell);
+		CHECK(grid.get_dirty_chunks().size() == 2);
+		CHECK(is_dirty(grid, near_cell));
+		CHECK(is_dirty(grid, far_cell));
+		CHECK(grid.has_lost_parts(near_cell));
+		CHECK(!grid.has_lost_parts(far_cell));
+		CHECK(grid.find_chunk(near_cell)->parts.size() == 2);
+		CHECK(grid.find_chunk(far_cell)->parts.size() == 2);
+	}
+
+	SECTION("Changing the material of a part keeps it in its chunk")
+	{
+		grid.set(a, { cube, make_transform({ 1.f, 1.f, 1.f }), 2 });
+		CHECK(grid.get_part_chunk(a) == near_cell);
+		CHECK(grid.get_dirty_chunks().size() == 1);
+		CHECK(is_dirty(grid, near_cell));
+
+		std::vector<ot::egfx::chunk_submesh> const submeshes = grid.make_submeshes(near_cell);
+		REQUIRE(submeshes.size() == 2);
+		CHECK(submeshes[0].parts.size() == 1);
+		CHECK(submeshes[1].parts.size() == 2);
+	}
+
+	SECTION("Removing the last part of a chunk removes the chunk")
+	{
+		grid.remove(d);
+		CHECK(!grid.contains(d));
+		CHECK(grid.find_chunk(far_cell) == nullptr);
+		CHECK(grid.get_chunk_count() == 1);
+		CHECK(is_dirty(grid, far_cell));
+		CHECK(grid.make_submeshes(far_cell).empty());
+
+		// Ids are reused
+		CHECK(grid.add({ cube, make_transform({ 0.f, 0.f, 0.f }), 3 }) == d);
+	}
+
+	SECTION("Clearing dirties every chunk")
+	{
+		grid.clear();
+		CHECK(grid.get_chunk_count() == 0);
+		CHECK(grid.get_part_count() == 0);
+		CHECK(grid.get_dirty_chunks().size() == 2);
+	}
+
+	SECTION("Unknown parts")
+	{
+		grid.remove(a);
+		CHECK_THROWS_AS(grid.remove(a), std::invalid_argument);
+		CHECK_THROWS_AS(grid.set(a, { cube, make_transform({ 0.f, 0.f, 0.f }), 1 }), std::invalid_argument);
+		CHECK_THROWS_AS(grid.add({ nullptr, make_transform({ 0.f, 0.f, 0.f }), 1 }), std::invalid_argument);
+	}
+}
+
+TEST_CASE("chunk_build_queue builds the chunks which lost parts first", "[graphics]")
+{
+	chunk_grid grid(10.f);
+	auto const cube = make_cube();
+
+	// One part per chunk, in a row
+	size_t const chunk_count = 20;
+	std::vector<chunk_part_id> ids;
+	for (size_t i = 0; i < chunk_count; ++i)
+		ids.push_back(grid.add({ cube, make_transform({ float(i) * 10.f + 5.f, 5.f, 5.f }), 1 }));
+
+	// The parts each chunk would draw, as of its last build
+	std::unordered_map<chunk_coord, std::vector<chunk_part_id>, ot::egfx::chunk_coord_hash> built;
+	ot::egfx::chunk_build_queue queue;
+	auto const build_next = [&]
+	{
+		std::optional<chunk_coord> const key = queue.pop();
+		REQUIRE(key.has_value());
+		chunk_grid::chunk const* const c = grid.find_chunk(*key);
+		if (c != nullptr)
+			built[*key] = c->parts;
+		else
+			built.erase(*key);
+	};
+
+	queue.take_dirty_chunks(grid);
+	CHECK(grid.get_dirty_chunks().empty());
+	CHECK(queue.size() == chunk_count);
+	CHECK(!queue.is_next_urgent());
+
+	// Part of the backlog is built, then parts of built chunks and of waiting chunks change
+	for (size_t i = 0; i < 5; ++i)
+		build_next();
+	REQUIRE(built.size() == 5);
+
+	chunk_coord const removed_key = grid.get_part_chunk(ids[0]);
+	grid.remove(ids[0]);
+	grid.set(ids[1], { cube, make_transform({ 500.f, 5.f, 5.f }), 1 });
+	grid.remove(ids[10]);
+	(void)grid.add({ cube, make_transform({ 2.f * 10.f + 5.f, 5.f, 5.f }), 1 });
+	queue.take_dirty_chunks(grid);
+	CHECK(queue.size() == chunk_count - 5 + 4);
+
+	// An update with the smallest budget: the urgent chunks, then a single other one
+	CHECK(queue.is_next_urgent());
+	while (queue.is_next_urgent())
+		build_next();
+	build_next();
+
+	// No chunk draws a part which is gone or moved to another chunk
+	for (auto const& [key, parts] : built)
+	{
+		for (chunk_part_id const id : parts)
+		{
+			REQUIRE(grid.contains(id));
+			REQUIRE(grid.get_part_chunk(id) == key);
+		}
+	}
+	CHECK(!built.contains(removed_key));
+
+	// The rest of the backlog is built in order, each chunk once
+	size_t remaining = queue.size();
+	while (!queue.empty())
+	{
+		build_next();
+		--remaining;
+		REQUIRE(queue.size() == remaining);
+	}
+	CHECK(!queue.pop().has_value());
+	CHECK(built.size() == grid.get_chunk_count());
+}
+
+TEST_CASE("chunk_grid places the parts of a chunk in world space", "[graphics]")
+{
+	chunk_grid grid(10.f);
+	auto const cube = make_cube();
+
+	// A unit cube at (2, 2, 2), and one rotated a quarter turn around Y at (4, 2, 2)
+	ot::math::transform_matrix const rotated = ot::math::transform_matrix::from_components({ 4.f, 2.f, 2.f }, ot::math::quaternion::y_deg_rotation(90.f));
+	(void)grid.add({ cube, make_transform({ 2.f, 2.f, 2.f }), 1 });
+	(void)grid.add({ cube, rotated, 1 });
+
+	std::vector<ot::egfx::chunk_submesh> const submeshes = grid.make_submeshes({ 0, 0, 0 });
+	REQUIRE(submeshes.size() == 1);
+	ot::egfx::triangle_list const list = ot::egfx::make_welded_triangle_list(submeshes[0].parts);
+
+	// Corners are only shared within a face, as faces have their own normal
+	REQUIRE(list.vertices.size() == 2 * 24);
+	REQUIRE(list.indices.size() == 2 * 36);
+	for (uint32_t const index : list.indices)
+		REQUIRE(index < list.vertices.size());
+
+	ot::math::aabb const bounds = ot::egfx::get_triangle_bounds(list);
+	CHECK(float_eq(bounds.position, ot::math::point3f{ 3.f, 2.f, 2.f }));
+	CHECK(float_eq(bounds.half_size, ot::math::vector3f{ 1.5f, 0.5f, 0.5f }));
+
+	ot::egfx::submesh_definition const definition{ submeshes[0].parts };
+	ot::math::aabb const submesh_bounds = ot::egfx::get_submesh_bounds(std::span(&definition, 1));
+	CHECK(float_eq(submesh_bounds.position, bounds.position));
+	CHECK(float_eq(submesh_bounds.half_size, bounds.half_size));
+
+	// Normals follow the rotation of their part, and face away from the center of their part
+	for (ot::egfx::render_vertex const& v : list.vertices)
+	{
+		REQUIRE(ot::float_eq(v.normal.norm(), 1.f));
+		ot::math::point3f const center = v.position.x > 3.f ? ot::math::point3f{ 4.f, 2.f, 2.f } : ot::math::point3f{ 2.f, 2.f, 2.f };
+		REQUIRE(dot_product(v.position - center, v.normal) > 0.f);
+	}
+}
@@ -0,0 +1,359 @@
+#include <egfx/csg.h>
+#include <egfx/mesh_definition.h>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+	using ot::egfx::csg::brush;
+	using ot::egfx::csg::brush_id;
+	using ot::egfx::csg::operation;
+	using ot::egfx::csg::polygon;
+
+	std::shared_ptr<ot::egfx::mesh_definition const> get_cube()
+	{
+		static auto const cube = std::make_shared<ot::egfx::mesh_definition const>(ot::egfx::mesh_definition::get_cube());
+		return cube;
+	}
+
+	brush make_cube(ot::math::vector3f position, operation op = operation::add)
+	{
+		return { get_cube(), ot::math::transform_matrix::from_components(position, ot::math::quaternion::identity()), op };
+	}
+
+	// Area-weighted normal of the polygon, from its winding
+	ot::math::vector3f get_area_vector(polygon const& p)
+	{
+		ot::math::vector3f sum{};
+		for (size_t k = 1; k + 1 < p.vertices.size(); ++k)
+			sum = sum + cross_product(p.vertices[k] - p.vertices[0], p.vertices[k + 1] - p.vertices[0]) * 0.5f;
+		return sum;
+	}
+
+	float get_total_area(std::span<polygon const> polygons)
+	{
+		float area = 0.f;
+		for (polygon const& p : polygons)
+			area += get_area_vector(p).norm();
+		return area;
+	}
+
+	// Every polygon is wound around its normal, lies on its plane, and together they close the volume
+	void require_closed_surface(std::span<polygon const> polygons)
+	{
+		ot::math::vector3f total{};
+		for (polygon const& p : polygons)
+		{
+			ot::math::vector3f const area = get_area_vector(p);
+			REQUIRE(dot_product(area, p.plane.normal) > 0.f);
+			for (ot::math::point3f const& v : p.vertices)
+				REQUIRE(std::abs(p.plane.distance_to(v)) < 1e-4f);
+			total = total + area;
+		}
+		REQUIRE(total.norm() < 1e-4f);
+	}
+
+	size_t count_facing(std::span<polygon const> polygons, ot::math::vector3f normal)
+	{
+		return std::count_if(polygons.begin(), polygons.end(), [normal](polygon const& p) { return float_eq(p.plane.normal, normal); });
+	}
+
+	// Compares the result of an incremental evaluation with the one of 'evaluate', where the brush at index i has the id ids[i]
+	void require_same_result(std::span<polygon const> incremental, std::span<polygon const> full, std::span<brush_id const> ids)
+	{
+		REQUIRE(incremental.size() == full.size());
+		for (size_t i = 0; i < full.size(); ++i)
+		{
+			CAPTURE(i);
+			REQUIRE(incremental[i].brush == static_cast<size_t>(ids[full[i].brush]));
+			REQUIRE(incremental[i].face == full[i].face);
+			REQUIRE(incremental[i].vertices.size() == full[i].vertices.size());
+			for (size_t v = 0; v < full[i].vertices.size(); ++v)
+				REQUIRE(float_eq(incremental[i].vertices[v], full[i].vertices[v]));
+		}
+	}
+
+	std::vector<brush> make_grid_scene(size_t count)
+	{
+		std::vector<brush> brushes;
+		for (size_t i = 0; i < count; ++i)
+			brushes.push_back(make_cube({ float(i % 20) * 0.75f, 0, float(i / 20) * 0.75f }, i % 3 == 2 ? operation::subtract : operation::add));
+		return brushes;
+	}
+}
+
+TEST_CASE("csg single brush", "[graphics]")
+{
+	brush const brushes[] = { make_cube({ 0, 0, 0 }) };
+	auto const result = ot::egfx::csg::evaluate(brushes);
+
+	REQUIRE(result.size() == 6);
+	REQUIRE(get_total_area(result) == Approx(6.f));
+	require_closed_surface(result);
+	for (polygon const& p : result)
+	{
+		REQUIRE(p.brush == 0);
+		REQUIRE(p.vertices.size() == 4);
+	}
+
+	// Subtracting from nothing leaves nothing
+	brush const subtracted[] = { make_cube({ 0, 0, 0 }, operation::subtract) };
+	REQUIRE(ot::egfx::csg::evaluate(subtracted).empty());
+}
+
+TEST_CASE("csg union of overlapping brushes", "[graphics]")
+{
+	brush const brushes[] = { make_cube({ 0, 0, 0 }), make_cube({ 0.5f, 0, 0 }) };
+	auto const result = ot::egfx::csg::evaluate(brushes);
+
+	// Outer faces of each cube, and the 4 sides of each split where the cubes overlap. Parts of sides shared by both cubes come from the last one
+	// Fragments are not merged back together
+	REQUIRE(result.size() == 14);
+	REQUIRE(get_total_area(result) == Approx(8.f));
+	require_closed_surface(result);
+	REQUIRE(std::count_if(result.begin(), result.end(), [](polygon const& p) { return p.brush == 0; }) == 5);
+	REQUIRE(count_facing(result, { 1, 0, 0 }) == 1);
+	REQUIRE(count_facing(result, { -1, 0, 0 }) == 1);
+	REQUIRE(count_facing(result, { 0, 1, 0 }) == 3);
+}
+
+TEST_CASE("csg union of touching brushes", "[graphics]")
+{
+	brush const brushes[] = { make_cube({ 0, 0, 0 }), make_cube({ 1, 0, 0 }) };
+	auto const result = ot::egfx::csg::evaluate(brushes);
+
+	// The two faces between the cubes disappear
+	REQUIRE(result.size() == 10);
+	REQUIRE(get_total_area(result) == Approx(10.f));
+	require_closed_surface(result);
+	REQUIRE(count_facing(result, { 1, 0, 0 }) == 1);
+	REQUIRE(count_facing(result, { -1, 0, 0 }) == 1);
+}
+
+TEST_CASE("csg subtraction", "[graphics]")
+{
+	brush const brushes[] = { make_cube({ 0, 0, 0 }), make_cube({ 0.5f, 0, 0 }, operation::subtract) };
+	auto const result = ot::egfx::csg::evaluate(brushes);
+
+	// Half a cube: the carved face comes from the subtracted brush, facing out of the remaining solid
+	REQUIRE(result.size() == 6);
+	REQUIRE(get_total_area(result) == Approx(4.f));
+	require_closed_surface(result);
+
+	auto const carved = std::find_if(result.begin(), result.end(), [](polygon const& p) { return p.brush == 1; });
+	REQUIRE(carved != result.end());
+	REQUIRE(float_eq(carved->plane.normal, { 1, 0, 0 }));
+	REQUIRE(carved->plane.distance == Approx(0.f).margin(1e-5));
+	REQUIRE(std::count_if(result.begin(), result.end(), [](polygon const& p) { return p.brush == 1; }) == 1);
+
+	// Order matters: adding after subtracting restores the solid
+	brush const restored[] = { make_cube({ 0, 0, 0 }), make_cube({ 0.5f, 0, 0 }, operation::subtract), make_cube({ 0, 0, 0 }) };
+	auto const restored_result = ot::egfx::csg::evaluate(restored);
+	REQUIRE(restored_result.size() == 10); // the sides of the last cube are split where the subtracted brush touches them
+	REQUIRE(std::all_of(restored_result.begin(), restored_result.end(), [](polygon const& p) { return p.brush == 2; }));
+	REQUIRE(get_total_area(restored_result) == Approx(6.f));
+	require_closed_surface(restored_result);
+
+	// A hole through the middle of a cube
+	brush const tunnel[] = {
+		make_cube({ 0, 0, 0 }),
+		{ get_cube(), ot::math::transform_matrix::from_components({ 0, 0, 0 }, ot::math::quaternion::identity(), ot::math::scales{ 2.f, 0.5f, 0.5f }), operation::subtract },
+	};
+	auto const tunnel_result = ot::egfx::csg::evaluate(tunnel);
+	require_closed_surface(tunnel_result);
+	REQUIRE(get_total_area(tunnel_result) == Approx(6.f - 2.f * 0.25f + 4.f * 0.5f));
+	REQUIRE(std::count_if(tunnel_result.begin(), tunnel_result.end(), [](polygon const& p) { return p.brush == 1; }) == 4);
+}
+
+TEST_CASE("csg intersection", "[graphics]")
+{
+	brush const brushes[] = { make_cube({ 0, 0, 0 }), make_cube({ 0.5f, 0, 0 }, operation::intersect) };
+	auto const result = ot::egfx::csg::evaluate(brushes);
+
+	REQUIRE(result.size() == 6);
+	REQUIRE(get_total_area(result) == Approx(4.f));
+	require_closed_surface(result);
+	for (polygon const& p : result)
+	{
+		for (ot::math::point3f const& v : p.vertices)
+		{
+			REQUIRE(v.x >= -1e-5f);
+			REQUIRE(v.x <= 0.5f + 1e-5f);
+		}
+	}
+
+	// An intersection elsewhere empties everything
+	brush const elsewhere[] = { make_cube({ 0, 0, 0 }), make_cube({ 5, 0, 0 }, operation::intersect) };
+	REQUIRE(ot::egfx::csg::evaluate(elsewhere).empty());
+}
+
+TEST_CASE("csg results do not depend on threads", "[graphics]")
+{
+	std::vector<brush> brushes;
+	for (size_t i = 0; i < 200; ++i)
+		brushes.push_back(make_cube({ float(i % 20) * 0.75f, 0, float(i / 20) * 0.75f }, i % 3 == 2 ? operation::subtract : operation::add));
+
+	auto const sequential = ot::egfx::csg::evaluate(brushes, 1);
+	auto const parallel = ot::egfx::csg::evaluate(brushes, 4);
+	require_closed_surface(sequential);
+
+	REQUIRE(sequential.size() == parallel.size());
+	for (size_t i = 0; i < sequential.size(); ++i)
+	{
+		REQUIRE(sequential[i].brush == parallel[i].brush);
+		REQUIRE(sequential[i].face == parallel[i].face);
+		REQUIRE(sequential[i].vertices.size() == parallel[i].vertices.size());
+	}
+}
+
+TEST_CASE("csg incremental evaluation matches full evaluation", "[graphics]")
+{
+	std::vector<brush> brushes = make_grid_scene(100);
+	std::vector<brush_id> ids;
+	ot::egfx::csg::incremental_evaluator evaluator(2.f);
+	for (size_t i = 0; i < brushes.size(); ++i)
+	{
+		ids.push_back(brush_id(i));
+		evaluator.set_brush(ids.back(), brushes[i]);
+	}
+
+	REQUIRE(evaluator.size() == brushes.size());
+	REQUIRE(evaluator.get_dirty_count() == brushes.size());
+	REQUIRE(evaluator.update());
+	REQUIRE(evaluator.is_up_to_date());
+	require_same_result(evaluator.get_result(), ot::egfx::csg::evaluate(brushes, 1), ids);
+
+	// Moving brushes, far enough to change their neighbours
+	for (size_t i : { 3, 42, 77 })
+	{
+		brushes[i] = make_cube({ float(i % 7) * 1.3f, 0.4f, float(i % 5) * 1.1f }, brushes[i].op);
+		evaluator.set_brush(ids[i], brushes[i]);
+	}
+	REQUIRE(evaluator.get_dirty_count() < brushes.size());
+	evaluator.update();
+	require_same_result(evaluator.get_result(), ot::egfx::csg::evaluate(brushes, 1), ids);
+
+	// Removing a brush and adding an intersection
+	evaluator.remove_brush(ids[50]);
+	brushes.erase(brushes.begin() + 50);
+	ids.erase(ids.begin() + 50);
+	brushes.push_back({ get_cube(), ot::math::transform_matrix::from_components({ 5, 0, 1 }, ot::math::quaternion::identity(), 6.f), operation::intersect });
+	ids.push_back(brush_id(1000));
+	evaluator.set_brush(ids.back(), brushes.back());
+	REQUIRE(evaluator.get_dirty_count() == brushes.size());
+	evaluator.update();
+	require_same_result(evaluator.get_result(), ot::egfx::csg::evaluate(brushes, 1), ids);
+
+	REQUIRE_THROWS_AS(evaluator.remove_brush(brush_id(50)), std::invalid_argument);
+	evaluator.clear();
+	REQUIRE(evaluator.size() == 0);
+	REQUIRE(evaluator.get_result().empty());
+}
+
+TEST_CASE("csg incremental evaluation only re-evaluates overlapping brushes", "[graphics]")
+{
+	// A row of separate cubes, and one cube overlapping the first one
+	ot::egfx::csg::incremental_evaluator evaluator;
+	for (size_t i = 0; i < 10; ++i)
+		evaluator.set_brush(brush_id(i), make_cube({ float(i) * 3.f, 0, 0 }));
+	evaluator.set_brush(brush_id(10), make_cube({ 0.5f, 0, 0 }));
+	evaluator.update();
+	evaluator.clear_updated_brushes();
+
+	REQUIRE(evaluator.get_neighbours(brush_id(0)).size() == 1);
+	REQUIRE(evaluator.get_neighbours(brush_id(0))[0] == brush_id(10));
+	REQUIRE(evaluator.get_neighbours(brush_id(5)).empty());
+	REQUIRE(evaluator.get_polygons(brush_id(5)).size() == 6);
+
+	// Moving the overlapping cube from the first to the fourth one re-evaluates these 3 brushes only
+	evaluator.set_brush(brush_id(10), make_cube({ 9.5f, 0, 0 }));
+	REQUIRE(evaluator.get_dirty_count() == 3);
+	REQUIRE(evaluator.get_neighbours(brush_id(0)).empty());
+	REQUIRE(evaluator.get_neighbours(brush_id(3)).size() == 1);
+
+	// A zero budget still makes progress
+	REQUIRE(!evaluator.update(ot::math::milliseconds(0.f)));
+	REQUIRE(evaluator.get_dirty_count() == 2);
+	REQUIRE(evaluator.update());
+
+	auto updated = std::vector<brush_id>(evaluator.get_updated_brushes().begin(), evaluator.get_updated_brushes().end());
+	std::sort(updated.begin(), updated.end());
+	REQUIRE(updated == std::vector<brush_id>{ brush_id(0), brush_id(3), brush_id(10) });
+	REQUIRE(evaluator.get_polygons(brush_id(0)).size() == 6);
+	REQUIRE(get_total_area(evaluator.get_polygons(brush_id(3))) + get_total_area(evaluator.get_polygons(brush_id(10))) == Approx(8.f));
+
+	// Removing it frees its neighbours again
+	evaluator.clear_updated_brushes();
+	evaluator.remove_brush(brush_id(10));
+	REQUIRE(evaluator.get_dirty_count() == 1);
+	REQUIRE(evaluator.get_updated_brushes().size() == 1);
+	REQUIRE_THROWS_AS(evaluator.get_polygons(brush_id(10)), std::invalid_argument);
+}
+
+TEST_CASE("CSG evaluation benchmark", "[.][benchmark]")
+{
+	// Rows of overlapping rooms with a doorway carved between each pair
+	size_t const side = 100;
+	std::vector<brush> brushes;
+	for (size_t i = 0; i < side * side; ++i)
+	{
+		float const x = float(i % side) * 1.8f;
+		float const z = float(i / side) * 1.8f;
+		brushes.push_back({ get_cube(), ot::math::transform_matrix::from_components({ x, 0, z }, ot::math::quaternion::identity(), 2.f), operation::add });
+		brushes.push_back({ get_cube(), ot::math::transform_matrix::from_components({ x + 0.9f, 0, z }, ot::math::quaternion::identity(), 0.5f), operation::subtract });
+	}
+
+	using clock = std::chrono::steady_clock;
+	size_t const max_thread_count = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2)
+	{
+		auto const start = clock::now();
+		auto const result = ot::egfx::csg::evaluate(brushes, thread_count);
+		double const seconds = std::chrono::duration<double>(clock::now() - start).count();
+		std::printf("%2zu threads: %.3f s for %zu brushes, %zu polygons\n", thread_count, seconds, brushes.size(), result.size());
+	}
+}
+
+TEST_CASE("Incremental CSG benchmark", "[.][benchmark]")
+{
+	// Same rooms as the evaluation benchmark, about 10k brushes, with one room dragged around as with a gizmo
+	size_t const side = 71;
+	ot::egfx::csg::incremental_evaluator evaluator(4.f);
+	for (size_t i = 0; i < side * side; ++i)
+	{
+		float const x = float(i % side) * 1.8f;
+		float const z = float(i / side) * 1.8f;
+		evaluator.set_brush(brush_id(2 * i), { get_cube(), ot::math::transform_matrix::from_components({ x, 0, z }, ot::math::quaternion::identity(), 2.f), operation::add });
+		evaluator.set_brush(brush_id(2 * i + 1), { get_cube(), ot::math::transform_matrix::from_components({ x + 0.9f, 0, z }, ot::math::quaternion::identity(), 0.5f), operation::subtract });
+	}
+
+	using clock = std::chrono::steady_clock;
+	auto const start = clock::now();
+	evaluator.update();
+	std::printf("initial evaluation: %.3f s for %zu brushes\n", std::chrono::duration<double>(clock::now() - start).count(), evaluator.size());
+
+	size_t const frame_count = 200;
+	double total = 0.;
+	double worst = 0.;
+	size_t evaluated = 0;
+	for (size_t frame = 0; frame < frame_count; ++frame)
+	{
+		evaluator.clear_updated_brushes();
+		auto const frame_start = clock::now();
+		ot::math::vector3f const position{ 10.f + float(frame) * 0.05f, 0.3f, 10.f };
+		evaluator.set_brush(brush_id(2 * (side * 5 + 5)), { get_cube(), ot::math::transform_matrix::from_components(position, ot::math::quaternion::identity(), 2.f), operation::add });
+		evaluator.update();
+		double const ms = std::chrono::duration<double, std::milli>(clock::now() - frame_start).count();
+		total += ms;
+		worst = std::max(worst, ms);
+		evaluated += evaluator.get_updated_brushes().size();
+	}
+	std::printf("dragging: %.3f ms per frame on average, %.3f ms at worst, %.1f brushes evaluated per frame\n", total / frame_count, worst, double(evaluated) / frame_count);
+}
@@ -0,0 +1,450 @@
+#include <egfx/mesh_buffer.h>
+#include <egfx/mesh_definition.h>
+
+#include "application/basic_mesh_repo.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	template<typename Index>
+	std::vector<Index> read_indices(std::vector<std::byte> const& buffer)
+	{
+		std::vector<Index> indices(buffer.size() / sizeof(Index));
+		std::memcpy(indices.data(), buffer.data(), buffer.size());
+		return indices;
+	}
+
+	// Rotates each triangle to start at its lowest index and sorts them, so that lists can be compared regardless of triangle order
+	std::vector<std::array<uint32_t, 3>> get_canonical_triangles(std::span<uint32_t const> indices)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			std::array<uint32_t, 3> t{ indices[i], indices[i + 1], indices[i + 2] };
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	// Triangulated grid of quads, with its triangles in random order
+	std::vector<uint32_t> make_shuffled_grid(uint32_t size, std::mt19937& rng)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				uint32_t const v = y * (size + 1) + x;
+				triangles.push_back({ v, v + 1, v + size + 1 });
+				triangles.push_back({ v + 1, v + size + 2, v + size + 1 });
+			}
+		}
+		std::shuffle(triangles.begin(), triangles.end(), rng);
+
+		std::vector<uint32_t> indices;
+		for (auto const& t : triangles)
+			indices.insert(indices.end(), t.begin(), t.end());
+		return indices;
+	}
+
+	// Convex brush from planes tangent to the unit sphere. The axis planes keep the volume closed
+	ot::egfx::mesh_definition make_random_brush(size_t extra_plane_count, std::mt19937& rng)
+	{
+		std::vector<ot::math::plane> planes{
+			{{1, 0, 0}, 1},
+			{{-1, 0, 0}, 1},
+			{{0, 1, 0}, 1},
+			{{0, -1, 0}, 1},
+			{{0, 0, 1}, 1},
+			{{0, 0, -1}, 1},
+		};
+
+		std::normal_distribution<float> distribution;
+		for (size_t i = 0; i < extra_plane_count; ++i)
+		{
+			ot::math::vector3f const n{ distribution(rng), distribution(rng), distribution(rng) };
+			planes.push_back({ normalized(n), 1 });
+		}
+
+		return ot::egfx::mesh_definition(planes);
+	}
+}
+
+TEST_CASE("get_submesh_buffer_layout", "[graphics]")
+{
+	ot::egfx::mesh_definition const& cube = ot::egfx::mesh_definition::get_cube();
+
+	SECTION("Single part")
+	{
+		ot::egfx::submesh_part const parts[] = { &cube };
+		ot::egfx::submesh_buffer_layout const layout = ot::egfx::get_submesh_buffer_layout(parts);
+		REQUIRE(layout.vertex_count == 24);
+		REQUIRE(layout.index_count == 36);
+		REQUIRE(layout.format == ot::egfx::index_format::uint16);
+		REQUIRE(layout.get_index_buffer_size() == 36 * sizeof(uint16_t));
+	}
+
+	SECTION("Parts over the 16-bit limit")
+	{
+		size_t const part_count = ot::egfx::max_16bit_vertex_count / 24 + 1;
+		std::vector<ot::egfx::submesh_part> const parts(part_count, &cube);
+		ot::egfx::submesh_buffer_layout const layout = ot::egfx::get_submesh_buffer_layout(parts);
+		REQUIRE(layout.vertex_count == part_count * 24);
+		REQUIRE(layout.format == ot::egfx::index_format::uint32);
+		REQUIRE(layout.get_index_buffer_size() == part_count * 36 * sizeof(uint32_t));
+	}
+}
+
+TEST_CASE("write_submesh_buffers", "[graphics]")
+{
+	ot::egfx::mesh_definition const& cube = ot::egfx::mesh_definition::get_cube();
+
+	SECTION("16-bit indices")
+	{
+		ot::egfx::submesh_part const parts[] = { &cube, &cube };
+		ot::egfx::submesh_buffer_layout const layout = ot::egfx::get_submesh_buffer_layout(parts);
+
+		std::vector<ot::egfx::render_vertex> vertices(layout.vertex_count);
+		std::vector<std::byte> index_buffer(layout.get_index_buffer_size());
+		ot::egfx::write_submesh_buffers(parts, layout, vertices, index_buffer);
+
+		auto const indices = read_indices<uint16_t>(index_buffer);
+		REQUIRE(indices.size() == 72);
+		REQUIRE(*std::max_element(indices.begin(), indices.end()) == 47);
+
+		// Every triangle of a face uses the normal of the face, and lies on its plane
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			ot::egfx::render_vertex const& a = vertices[indices[i]];
+			ot::egfx::render_vertex const& b = vertices[indices[i + 1]];
+			ot::egfx::render_vertex const& c = vertices[indices[i + 2]];
+			REQUIRE(float_eq(a.normal, b.normal));
+			REQUIRE(float_eq(a.normal, c.normal));
+			REQUIRE(float_eq(normalized(cross_product(b.position - a.position, c.position - a.position)), a.normal));
+		}
+	}
+
+	SECTION("32-bit indices")
+	{
+		size_t const part_count = ot::egfx::max_16bit_vertex_count / 24 + 1;
+		std::vector<ot::egfx::submesh_part> const parts(part_count, &cube);
+		ot::egfx::submesh_buffer_layout const layout = ot::egfx::get_submesh_buffer_layout(parts);
+
+		std::vector<ot::egfx::render_vertex> vertices(layout.vertex_count);
+		std::vector<std::byte> index_buffer(layout.get_index_buffer_size());
+		ot::egfx::write_submesh_buffers(parts, layout, vertices, index_buffer);
+
+		// Indices past the 16-bit range must not wrap around
+		auto const indices = read_indices<uint32_t>(index_buffer);
+		REQUIRE(indices.size() == layout.index_count);
+		REQUIRE(*std::max_element(indices.begin(), indices.end()) == layout.vertex_count - 1);
+		REQUIRE(indices[indices.size() - 36] == layout.vertex_count - 24);
+	}
+
+	SECTION("Mismatched buffers")
+	{
+		ot::egfx::submesh_part const parts[] = { &cube };
+		ot::egfx::submesh_buffer_layout const layout = ot::egfx::get_submesh_buffer_layout(parts);
+
+		std::vector<ot::egfx::render_vertex> vertices(layout.vertex_count);
+		std::vector<std::byte> index_buffer(layout.get_index_buffer_size() - 1);
+		REQUIRE_THROWS_AS(ot::egfx::write_submesh_buffers(parts, layout, vertices, index_buffer), std::invalid_argument);
+	}
+}
+
+TEST_CASE("get_submesh_bounds", "[graphics]")
+{
+	ot::egfx::mesh_definition const& cube = ot::egfx::mesh_definition::get_cube();
+
+	ot::math::plane const far_cube_planes[6] = {
+		{{0, 0, 1}, 10.5},
+		{{1, 0, 0}, 0.5},
+		{{0, 1, 0}, 0.5},
+		{{-1, 0, 0}, 0.5},
+		{{0, -1, 0}, 0.5},
+		{{0, 0, -1}, -9.5},
+	};
+	ot::egfx::mesh_definition const far_cube(far_cube_planes);
+
+	ot::egfx::submesh_definition const submeshes[] = {
+		{ { &cube } },
+		{ { &far_cube } },
+	};
+
+	ot::math::aabb const bounds = ot::egfx::get_submesh_bounds(submeshes);
+	REQUIRE(float_eq(bounds.min(), { -0.5f, -0.5f, -0.5f }));
+	REQUIRE(float_eq(bounds.max(), { 0.5f, 0.5f, 10.5f }));
+}
+
+namespace
+{
+	// Positions of the non-degenerate triangles, so that buffers can be compared regardless of their layout
+	template<typename Index>
+	std::vector<std::array<float, 9>> get_rendered_triangles(std::span<ot::egfx::render_vertex const> vertices, std::span<Index const> indices)
+	{
+		std::vector<std::array<float, 9>> triangles;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			if (indices[i] == indices[i + 1] && indices[i] == indices[i + 2])
+				continue;
+
+			std::array<float, 9> t;
+			for (size_t corner = 0; corner < 3; ++corner)
+			{
+				ot::math::point3f const p = vertices[indices[i + corner]].position;
+				t[corner * 3] = p.x;
+				t[corner * 3 + 1] = p.y;
+				t[corner * 3 + 2] = p.z;
+			}
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+TEST_CASE("face_buffer_map", "[graphics]")
+{
+	ot::egfx::mesh_definition cube = ot::egfx::mesh_definition::get_cube();
+	ot::egfx::face_buffer_map map(cube);
+
+	ot::egfx::submesh_buffer_layout const layout = map.get_layout();
+	REQUIRE(map.get_face_count() == 6);
+	REQUIRE(layout.vertex_count >= 24 + 6 * ot::egfx::face_buffer_map::face_vertex_slack);
+	REQUIRE(layout.format == ot::egfx::index_format::uint16);
+
+	std::vector<ot::egfx::render_vertex> vertices(layout.vertex_count);
+	std::vector<std::byte> index_buffer(layout.get_index_buffer_size());
+	ot::egfx::write_submesh_buffers(cube, map, vertices, index_buffer);
+
+	SECTION("Patch dirty faces")
+	{
+		ot::egfx::face::ref const top_face = cube.get_faces()[0];
+		REQUIRE(top_face.split(ot::math::plane{ {1, 0, 0}, 0.f }));
+		top_face.get_first_half_edge().split_at({ 0.f, 0.f, 0.5f });
+
+		REQUIRE(map.update(cube, cube.get_dirty_faces()));
+		REQUIRE(map.get_face_count() == 7);
+
+		// Rewrite only the dirty faces in the existing buffers
+		for (ot::egfx::face::id const f : cube.get_dirty_faces())
+		{
+			ot::egfx::face_buffer_range const& range = map.get_range(f);
+			ot::egfx::write_face_buffers(cube.get_face(f), range, layout.format
+				, std::span(vertices).subspan(range.vertex_start, range.vertex_capacity)
+				, std::span(index_buffer).subspan(range.index_start * sizeof(uint16_t), range.index_capacity * sizeof(uint16_t))
+			);
+		}
+
+		// Same triangles as a full rewrite of the edited mesh
+		ot::egfx::submesh_part const parts[] = { &cube };
+		ot::egfx::submesh_buffer_layout const full_layout = ot::egfx::get_submesh_buffer_layout(parts);
+		std::vector<ot::egfx::render_vertex> full_vertices(full_layout.vertex_count);
+		std::vector<std::byte> full_index_buffer(full_layout.get_index_buffer_size());
+		ot::egfx::write_submesh_buffers(parts, full_layout, full_vertices, full_index_buffer);
+
+		auto const patched_indices = read_indices<uint16_t>(index_buffer);
+		auto const full_indices = read_indices<uint16_t>(full_index_buffer);
+		REQUIRE(get_rendered_triangles<uint16_t>(vertices, patched_indices) == get_rendered_triangles<uint16_t>(full_vertices, full_indices));
+	}
+
+	SECTION("Face outgrows its range")
+	{
+		ot::egfx::face::ref const top_face = cube.get_faces()[0];
+		for (size_t i = 0; i <= ot::egfx::face_buffer_map::face_vertex_slack; ++i)
+			top_face.get_first_half_edge().split_at({ 0.5f - 0.1f * static_cast<float>(i + 1), 0.5f, 0.5f });
+
+		REQUIRE(!map.update(cube, cube.get_dirty_faces()));
+	}
+}
+
+TEST_CASE("get_acmr", "[graphics]")
+{
+	uint32_t const single[] = { 0, 1, 2 };
+	REQUIRE(ot::egfx::get_acmr(single, 16) == 3.f);
+
+	uint32_t const quad[] = { 0, 1, 2, 0, 2, 3 };
+	REQUIRE(ot::egfx::get_acmr(quad, 16) == 2.f);
+
+	// A cache of 1 only hits on consecutive repeats
+	REQUIRE(ot::egfx::get_acmr(quad, 1) == 3.f);
+}
+
+TEST_CASE("optimize_vertex_cache", "[graphics]")
+{
+	std::mt19937 rng(42);
+	uint32_t const grid_size = 32;
+	std::vector<uint32_t> indices = make_shuffled_grid(grid_size, rng);
+	size_t const vertex_count = (grid_size + 1) * (grid_size + 1);
+
+	auto const triangles_before = get_canonical_triangles(indices);
+	float const acmr_before = ot::egfx::get_acmr(indices, 32);
+
+	ot::egfx::optimize_vertex_cache(indices, vertex_count);
+
+	// Same triangles, same winding
+	REQUIRE(get_canonical_triangles(indices) == triangles_before);
+
+	// A random order misses almost every vertex. The ideal for a large grid is 0.5
+	float const acmr_after = ot::egfx::get_acmr(indices, 32);
+	REQUIRE(acmr_before > 2.f);
+	REQUIRE(acmr_after < 0.8f);
+}
+
+TEST_CASE("make_welded_triangle_list", "[graphics]")
+{
+	ot::egfx::mesh_definition const& cube = ot::egfx::mesh_definition::get_cube();
+
+	SECTION("Single cube")
+	{
+		// Every corner of a cube has a different normal per face
+		ot::egfx::submesh_part const parts[] = { &cube };
+		ot::egfx::triangle_list const list = ot::egfx::make_welded_triangle_list(parts);
+		REQUIRE(list.vertices.size() == 24);
+		REQUIRE(list.indices.size() == 36);
+	}
+
+	SECTION("Adjacent cubes")
+	{
+		ot::math::plane const next_cube_planes[6] = {
+			{{0, 0, 1}, 0.5},
+			{{1, 0, 0}, 1.5},
+			{{0, 1, 0}, 0.5},
+			{{-1, 0, 0}, -0.5},
+			{{0, -1, 0}, 0.5},
+			{{0, 0, -1}, 0.5},
+		};
+		ot::egfx::mesh_definition const next_cube(next_cube_planes);
+
+		// The 4 faces parallel to X share an edge with the same face of the other cube
+		ot::egfx::submesh_part const parts[] = { &cube, &next_cube };
+		ot::egfx::triangle_list const list = ot::egfx::make_welded_triangle_list(parts);
+		REQUIRE(list.vertices.size() == 40);
+		REQUIRE(list.indices.size() == 72);
+
+		ot::egfx::submesh_buffer_layout const layout = ot::egfx::get_submesh_buffer_layout(list);
+		std::vector<ot::egfx::render_vertex> vertices(layout.vertex_count);
+		std::vector<std::byte> index_buffer(layout.get_index_buffer_size());
+		ot::egfx::write_submesh_buffers(list, layout, vertices, index_buffer);
+
+		auto const indices = read_indices<uint16_t>(index_buffer);
+		REQUIRE(std::equal(indices.begin(), indices.end(), list.indices.begin(), list.indices.end()));
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			ot::egfx::render_vertex const& a = vertices[indices[i]];
+			ot::egfx::render_vertex const& b = vertices[indices[i + 1]];
+			ot::egfx::render_vertex const& c = vertices[indices[i + 2]];
+			REQUIRE(float_eq(normalized(cross_product(b.position - a.position, c.position - a.position)), a.normal));
+		}
+	}
+}
+
+TEST_CASE("Transformed submesh parts", "[graphics]")
+{
+	ot::egfx::mesh_definition const& cube = ot::egfx::mesh_definition::get_cube();
+
+	SECTION("Parts are moved by their transform, with their uvs")
+	{
+		ot::egfx::submesh_part const in_place[] = { &cube };
+		ot::egfx::submesh_part const moved[] = { { &cube, ot::math::transform_matrix::from_components({ 1.f, 2.f, 3.f }, ot::math::quaternion::identity()) } };
+		ot::egfx::triangle_list const in_place_list = ot::egfx::make_welded_triangle_list(in_place);
+		ot::egfx::triangle_list const moved_list = ot::egfx::make_welded_triangle_list(moved);
+		REQUIRE(moved_list.vertices.size() == in_place_list.vertices.size());
+		REQUIRE(moved_list.indices == in_place_list.indices);
+		for (size_t i = 0; i < moved_list.vertices.size(); ++i)
+		{
+			ot::egfx::render_vertex const& v = moved_list.vertices[i];
+			ot::egfx::render_vertex const& expected = in_place_list.vertices[i];
+			REQUIRE(float_eq(v.position, expected.position + ot::math::vector3f{ 1.f, 2.f, 3.f }));
+			REQUIRE(float_eq(v.normal, expected.normal));
+			REQUIRE(float_eq(v.uv, expected.uv));
+		}
+	}
+
+	SECTION("Normals stay perpendicular to scaled faces")
+	{
+		// Scaled and turned an eighth around Y: the side faces are no longer at 45 degrees of the axes
+		ot::math::transform_matrix const t = ot::math::transform_matrix::from_components({ 0.f, 0.f, 0.f }, ot::math::quaternion::y_deg_rotation(45.f), ot::math::scales{ 4.f, 1.f, 1.f });
+		ot::egfx::submesh_part const parts[] = { { &cube, t } };
+		ot::egfx::submesh_buffer_layout const layout = ot::egfx::get_submesh_buffer_layout(parts);
+		std::vector<ot::egfx::render_vertex> vertices(layout.vertex_count);
+		std::vector<std::byte> index_buffer(layout.get_index_buffer_size());
+		ot::egfx::write_submesh_buffers(parts, layout, vertices, index_buffer);
+
+		auto const indices = read_indices<uint16_t>(index_buffer);
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			ot::egfx::render_vertex const& a = vertices[indices[i]];
+			ot::egfx::render_vertex const& b = vertices[indices[i + 1]];
+			ot::egfx::render_vertex const& c = vertices[indices[i + 2]];
+			REQUIRE(float_eq(normalized(cross_product(b.position - a.position, c.position - a.position)), a.normal));
+		}
+
+		ot::egfx::submesh_definition const submesh{ { parts[0] } };
+		ot::math::aabb const bounds = ot::egfx::get_submesh_bounds(std::span(&submesh, 1));
+		ot::math::aabb const expected = ot::egfx::get_triangle_bounds({ vertices, {} });
+		REQUIRE(float_eq(bounds.position, expected.position));
+		REQUIRE(float_eq(bounds.half_size, expected.half_size));
+	}
+}
+
+TEST_CASE("Vertex cache benchmark", "[.][benchmark]")
+{
+	size_t const cache_size = 16;
+
+	auto const report = [cache_size](char const* name, std::span<ot::egfx::submesh_part const> parts)
+	{
+		ot::egfx::submesh_buffer_layout const layout = ot::egfx::get_submesh_buffer_layout(parts);
+		std::vector<ot::egfx::render_vertex> vertices(layout.vertex_count);
+		std::vector<std::byte> index_buffer(layout.index_count * sizeof(uint32_t));
+		ot::egfx::submesh_buffer_layout corner_layout = layout;
+		corner_layout.format = ot::egfx::index_format::uint32;
+		ot::egfx::write_submesh_buffers(parts, corner_layout, vertices, index_buffer);
+		auto const corner_indices = read_indices<uint32_t>(index_buffer);
+
+		ot::egfx::triangle_list const welded = ot::egfx::make_welded_triangle_list(parts);
+
+		std::printf("%-24s vertices %7zu -> %7zu, ACMR %.3f -> %.3f\n", name
+			, layout.vertex_count, welded.vertices.size()
+			, ot::egfx::get_acmr(corner_indices, cache_size), ot::egfx::get_acmr(welded.indices, cache_size)
+		);
+	};
+
+	ot::dedit::basic_mesh_repo const repo;
+	std::pair<char const*, ot::egfx::mesh_definition const*> const shapes[] = {
+		{ "cube", repo.get_cube().get() },
+		{ "octagonal prism", repo.get_octagonal_prism().get() },
+		{ "hex prism", repo.get_hex_prism().get() },
+		{ "tri prism", repo.get_tri_prism().get() },
+		{ "square pyramid", repo.get_square_pyramid().get() },
+	};
+
+	std::vector<ot::egfx::submesh_part> all_shapes;
+	for (auto const& [name, shape] : shapes)
+	{
+		ot::egfx::submesh_part const part = shape;
+		report(name, std::span(&part, 1));
+		all_shapes.push_back(shape);
+	}
+	report("all shapes", all_shapes);
+
+	std::mt19937 rng(1234);
+	std::vector<ot::egfx::mesh_definition> random_brushes;
+	for (size_t i = 0; i < 256; ++i)
+		random_brushes.push_back(make_random_brush(4 + i % 28, rng));
+
+	std::vector<ot::egfx::submesh_part> random_parts;
+	for (ot::egfx::mesh_definition const& brush : random_brushes)
+		random_parts.push_back(&brush);
+	report("256 random brushes", random_parts);
+}
@@ -2,6 +2,17 @@
 
 #include <catch2/catch.hpp>
 
+#include <chrono>
+#include <limits>
+#include <cmath>
+#include <numbers>
+#include <vector>
+#include <memory>
+#include <random>
+#include <unordered_set>
+#include <algorithm>
+#include <tuple>
+
 ot::math::plane const cube_planes[6] = {
 	{{0, 0, 1}, 0.5},
 	{{1, 0, 0}, 0.5},
@@ -102,6 +113,15 @@ TEST_CASE("half_edge::ref::split", "[graphics
 
 	auto const new_face_edges = cube.get_faces()[0].get_half_edges();
 	REQUIRE(std::distance(new_face_edges.begin(), new_face_edges.end()) == 5);
+
+	// Both faces of the edge gained a vertex
+	auto const dirty_faces = cube.get_dirty_faces();
+	REQUIRE(dirty_faces.size() == 2);
+	REQUIRE(std::find(dirty_faces.begin(), dirty_faces.end(), current_edge.get_face().get_id()) != dirty_faces.end());
+	REQUIRE(std::find(dirty_faces.begin(), dirty_faces.end(), current_twin.get_face().get_id()) != dirty_faces.end());
+
+	cube.clear_dirty_faces();
+	REQUIRE(cube.get_dirty_faces().empty());
 }
 
 TEST_CASE("face::ref::split", "[graphics]")
@@ -109,10 +129,370 @@ TEST_CASE("face::ref::split", "[graphics]")
 	ot::egfx::mesh_definition cube(cube_planes);
 	ot::egfx::face::ref const top_face = cube.get_faces()[0];
 
+	REQUIRE(cube.get_dirty_faces().empty());
+
 	ot::math::plane const cutting_plane{ {1, 0, 0}, 0.f };
 	top_face.split(cutting_plane);
 
+	// The split face, the new face, and the two neighbours whose edges got split
+	auto const dirty_faces = cube.get_dirty_faces();
+	REQUIRE(dirty_faces.size() == 4);
+	REQUIRE(std::find(dirty_faces.begin(), dirty_faces.end(), top_face.get_id()) != dirty_faces.end());
+	REQUIRE(dirty_faces.back() == ot::egfx::face::id(6));
+
 	REQUIRE(cube.get_faces().size() == 7);
 	REQUIRE(cube.get_half_edges().size() == 30);
 	REQUIRE(cube.get_vertices().size() == 10);
+
+	// Every vertex of a face must lie on the plane of the face
+	for (ot::egfx::face::cref const face : cube.get_faces())
+	{
+		ot::math::plane const plane = face.get_plane();
+		REQUIRE(float_eq(plane.normal, face.get_normal()));
+		for (ot::egfx::vertex::cref const vertex : face.get_vertices())
+		{
+			REQUIRE(ot::float_eq(plane.distance_to(vertex.get_position()) + 1.f, 1.f));
+		}
+	}
+}
+
+TEST_CASE("mesh_definition undo history memory", "[graphics]")
+{
+	// Each edit of a brush keeps the previous version of the mesh alive in the undo history
+	std::vector<std::shared_ptr<ot::egfx::mesh_definition const>> history;
+	history.push_back(std::make_shared<ot::egfx::mesh_definition const>(cube_planes));
+
+	std::mt19937 rng(42);
+	size_t const edit_count = 10'000;
+	for (size_t i = 0; i < edit_count; ++i)
+	{
+		auto new_mesh = std::make_shared<ot::egfx::mesh_definition>(*history.back());
+		std::uniform_int_distribution<size_t> edge_distribution(0, new_mesh->get_half_edges().size() - 1);
+		ot::egfx::half_edge::ref const edge = new_mesh->get_half_edge(ot::egfx::half_edge::id(edge_distribution(rng)));
+		ot::math::line const line = edge.get_line();
+		edge.split_at(line.a + (line.b - line.a) * 0.5f);
+		new_mesh->clear_dirty_faces();
+		history.push_back(std::move(new_mesh));
+	}
+
+	ot::egfx::mesh_definition const& last = *history.back();
+	REQUIRE(last.get_half_edges().size() == 24 + 2 * edit_count);
+	REQUIRE(last.get_vertices().size() == 8 + edit_count);
+
+	std::unordered_set<void const*> counted_chunks;
+	size_t const last_bytes = last.count_bytes(counted_chunks);
+	size_t total_bytes = last_bytes;
+	for (auto const& mesh : history)
+		total_bytes += mesh->count_bytes(counted_chunks);
+
+	// Full copies would cost the size of the last mesh times half the number of edits
+	// Shared chunks should leave each edit with a small constant cost
+	size_t const bytes_per_edit = (total_bytes - last_bytes) / edit_count;
+	CAPTURE(last_bytes, total_bytes, bytes_per_edit);
+	REQUIRE(bytes_per_edit < 32 * 1024);
+	REQUIRE(total_bytes < last_bytes * edit_count / 20);
+}
+
+TEST_CASE("mesh_definition attribute streams", "[graphics]")
+{
+	ot::egfx::mesh_definition const cube(cube_planes);
+
+	auto const positions = cube.get_vertex_positions();
+	REQUIRE(positions.size() == cube.get_vertices().size());
+	for (ot::egfx::vertex::cref const vertex : cube.get_vertices())
+	{
+		REQUIRE(float_eq(positions[static_cast<size_t>(vertex.get_id())], vertex.get_position()));
+	}
+
+	auto const normals = cube.get_face_normals();
+	REQUIRE(normals.size() == cube.get_faces().size());
+	for (ot::egfx::face::cref const face : cube.get_faces())
+	{
+		REQUIRE(float_eq(normals[static_cast<size_t>(face.get_id())], face.get_normal()));
+	}
+}
+
+namespace
+{
+	// Prism with a regular polygon base, the way cylinder brushes are built
+	std::vector<ot::math::plane> make_cylinder_planes(size_t side_count)
+	{
+		std::vector<ot::math::plane> planes{
+			{{0, 1, 0}, 0.5},
+			{{0, -1, 0}, 0.5},
+		};
+
+		for (size_t i = 0; i < side_count; ++i)
+		{
+			float const angle = 2.f * std::numbers::pi_v<float> * static_cast<float>(i) / static_cast<float>(side_count);
+			planes.push_back({ {std::cos(angle), 0, std::sin(angle)}, 0.5 });
+		}
+
+		return planes;
+	}
+
+	double get_construction_seconds(std::span<ot::math::plane const> planes)
+	{
+		// Best of a few runs, to keep scheduling noise out of the measurement
+		double best = std::numeric_limits<double>::max();
+		for (int run = 0; run < 5; ++run)
+		{
+			auto const start = std::chrono::steady_clock::now();
+			ot::egfx::mesh_definition const mesh(planes);
+			auto const end = std::chrono::steady_clock::now();
+			REQUIRE(mesh.get_faces().size() == planes.size());
+			best = std::min(best, std::chrono::duration<double>(end - start).count());
+		}
+		return best;
+	}
+}
+
+TEST_CASE("mesh::make_cylinder", "[graphics]")
+{
+	size_t const side_count = 64;
+	std::vector<ot::math::plane> const planes = make_cylinder_planes(side_count);
+	ot::egfx::mesh_definition const cylinder(planes);
+
+	REQUIRE(cylinder.get_faces().size() == side_count + 2);
+	REQUIRE(cylinder.get_vertices().size() == side_count * 2);
+	REQUIRE(cylinder.get_half_edges().size() == side_count * 6);
+
+	for (ot::egfx::face::cref const face : cylinder.get_faces())
+	{
+		size_t const face_index = static_cast<size_t>(face.get_id());
+		REQUIRE(face.get_vertex_count() == (face_index < 2 ? side_count : 4));
+		ot::math::plane const face_plane = face.get_plane();
+		REQUIRE(float_eq(face_plane.normal, planes[face_index].normal));
+		REQUIRE(ot::float_eq(face_plane.distance, planes[face_index].distance, 4));
+
+		for (ot::egfx::half_edge::cref const he : face.get_half_edges())
+		{
+			REQUIRE(he.get_face() == face);
+			REQUIRE(he.get_twin().get_twin() == he);
+			REQUIRE(he.get_twin().get_face() != face);
+			REQUIRE(he.get_twin().get_target_vertex() == he.get_source_vertex());
+		}
+	}
+
+	for (ot::egfx::vertex::cref const vertex : cylinder.get_vertices())
+	{
+		auto const half_edges = vertex.get_half_edges();
+		REQUIRE(std::distance(half_edges.begin(), half_edges.end()) == 3);
+	}
+}
+
+TEST_CASE("mesh_definition construction scaling", "[.][benchmark]")
+{
+	std::vector<ot::math::plane> const small_planes = make_cylinder_planes(64);
+	std::vector<ot::math::plane> const large_planes = make_cylinder_planes(256);
+
+	double const small_time = get_construction_seconds(small_planes);
+	double const large_time = get_construction_seconds(large_planes);
+
+	// 4x the faces should cost around 16x for quadratic construction, and 256x for the old quartic one
+	// Leave room for noise, but fail anything close to cubic
+	CAPTURE(small_time, large_time);
+	REQUIRE(large_time < small_time * 40.0);
+}
+
+namespace
+{
+	std::vector<ot::math::point3f> get_sorted_positions(ot::egfx::mesh_definition const& mesh)
+	{
+		std::vector<ot::math::point3f> positions;
+		for (ot::egfx::vertex::cref const vertex : mesh.get_vertices())
+			positions.push_back(vertex.get_position());
+		std::sort(positions.begin(), positions.end(), [](ot::math::point3f const& lhs, ot::math::point3f const& rhs)
+		{
+			return std::tie(lhs.x, lhs.y, lhs.z) < std::tie(rhs.x, rhs.y, rhs.z);
+		});
+		return positions;
+	}
+}
+
+TEST_CASE("mesh_definition snapped construction", "[graphics]")
+{
+	using ot::egfx::vertex_precision;
+
+	// The same cube, once directly and once through a rotation and back, which leaves rounding errors in the planes
+	ot::math::transform_matrix const there = ot::math::transform_matrix::from_components({ 3.1f, -2.7f, 0.9f }, ot::math::quaternion::y_deg_rotation(37.f));
+	ot::math::transform_matrix const back = invert(there);
+	std::vector<ot::math::plane> round_trip_planes;
+	for (ot::math::plane const& p : cube_planes)
+		round_trip_planes.push_back(transform(transform(p, there), back));
+
+	ot::egfx::mesh_definition const snapped(cube_planes, vertex_precision::snapped);
+	ot::egfx::mesh_definition const snapped_round_trip(round_trip_planes, vertex_precision::snapped);
+	REQUIRE(snapped.get_vertices().size() == 8);
+	REQUIRE(snapped.get_half_edges().size() == 24);
+	REQUIRE(get_sorted_positions(snapped) == get_sorted_positions(snapped_round_trip));
+	for (ot::egfx::vertex::cref const vertex : snapped.get_vertices())
+		REQUIRE(ot::math::to_point(ot::math::snap(vertex.get_position())) == vertex.get_position());
+
+	// Vertices where 4 faces meet are merged exactly
+	ot::math::plane const pyramid_planes[] = {
+		{ {0, -1, 0}, 0 },
+		{ normalized(ot::math::vector3f{ 1, 1, 0 }), std::sqrt(0.5f) },
+		{ normalized(ot::math::vector3f{ -1, 1, 0 }), std::sqrt(0.5f) },
+		{ normalized(ot::math::vector3f{ 0, 1, 1 }), std::sqrt(0.5f) },
+		{ normalized(ot::math::vector3f{ 0, 1, -1 }), std::sqrt(0.5f) },
+	};
+	ot::egfx::mesh_definition const pyramid(pyramid_planes, vertex_precision::snapped);
+	REQUIRE(pyramid.get_vertices().size() == 5);
+	REQUIRE(pyramid.get_half_edges().size() == 16);
+
+	// Same topology as the floating construction
+	std::vector<ot::math::plane> const cylinder_planes = make_cylinder_planes(64);
+	ot::egfx::mesh_definition const cylinder(cylinder_planes, vertex_precision::snapped);
+	REQUIRE(cylinder.get_faces().size() == 66);
+	REQUIRE(cylinder.get_vertices().size() == 128);
+	REQUIRE(cylinder.get_half_edges().size() == 64 * 6);
+	for (ot::egfx::half_edge::cref const he : cylinder.get_half_edges())
+		REQUIRE(he.get_twin().get_target_vertex() == he.get_source_vertex());
+}
+
+TEST_CASE("mesh_definition rebuilt from the planes of a split face", "[graphics]")
+{
+	using ot::egfx::vertex_precision;
+
+	// Both halves of a split face keep the plane of the face, which is all that is saved of a brush
+	ot::egfx::mesh_definition split_cube(cube_planes);
+	REQUIRE(split_cube.get_faces()[0].split({ {1, 0, 0}, 0.1f }));
+
+	std::vector<ot::math::plane> planes;
+	for (ot::egfx::face::cref const face : split_cube.get_faces())
+		planes.push_back(face.get_plane());
+	REQUIRE(planes.size() == 7);
+
+	for (vertex_precision const precision : { vertex_precision::floating, vertex_precision::snapped })
+	{
+		// The halves merge back into one face
+		ot::egfx::mesh_definition const rebuilt(planes, precision);
+		REQUIRE(rebuilt.get_faces().size() == 6);
+		REQUIRE(rebuilt.get_half_edges().size() == 24);
+
+		std::vector<ot::math::point3f> const positions = get_sorted_positions(rebuilt);
+		std::vector<ot::math::point3f> const expected_positions = get_sorted_positions(ot::egfx::mesh_definition(cube_planes));
+		REQUIRE(positions.size() == expected_positions.size());
+		for (size_t i = 0; i < positions.size(); ++i)
+			REQUIRE(float_eq(positions[i], expected_positions[i]));
+	}
+}
+
+namespace
+{
+	// Every corner must have the uv the mapping of its face gives its position
+	void check_uvs(ot::egfx::mesh_definition const& m)
+	{
+		for (ot::egfx::half_edge::cref const he : m.get_half_edges())
+		{
+			ot::egfx::face::cref const face = he.get_face();
+			ot::math::point2f const expected = face.get_uv_mapping().project(he.get_source_vertex().get_position(), face.get_normal());
+			REQUIRE(ot::float_eq(he.get_uv().x, expected.x));
+			REQUIRE(ot::float_eq(he.get_uv().y, expected.y));
+		}
+	}
+}
+
+TEST_CASE("mesh_definition face uvs", "[graphics]")
+{
+	ot::egfx::mesh_definition cube(cube_planes);
+	check_uvs(cube);
+
+	SECTION("Cubic projection on axis-aligned faces")
+	{
+		// Front face: u along +X, v down
+		for (ot::egfx::half_edge::cref const he : cube.get_faces()[0].get_half_edges())
+		{
+			ot::math::point3f const p = he.get_source_vertex().get_position();
+			CHECK(ot::float_eq(he.get_uv().x, p.x));
+			CHECK(ot::float_eq(he.get_uv().y, -p.y));
+		}
+
+		// Right face: u along -Z, so that it continues the front face around their shared edge
+		for (ot::egfx::half_edge::cref const he : cube.get_faces()[1].get_half_edges())
+		{
+			ot::math::point3f const p = he.get_source_vertex().get_position();
+			CHECK(ot::float_eq(he.get_uv().x, -p.z));
+			CHECK(ot::float_eq(he.get_uv().y, -p.y));
+		}
+	}
+
+	SECTION("Splits give new corners their uvs")
+	{
+		ot::egfx::half_edge::ref const edge = cube.get_faces()[0].get_first_half_edge();
+		ot::math::line const l = edge.get_line();
+		(void)edge.split_at(l.a + (l.b - l.a) * 0.25f);
+		check_uvs(cube);
+
+		ot::egfx::uv_mapping mapping;
+		mapping.offset = { 0.5f, 0.25f };
+		cube.get_faces()[2].set_uv_mapping(mapping);
+
+		// The new face takes the mapping of the split face
+		REQUIRE(cube.get_faces()[2].split({ { 1, 0, 0 }, 0.f }).has_value());
+		check_uvs(cube);
+		CHECK(cube.get_faces()[6].get_uv_mapping().offset.x == 0.5f);
+		CHECK(cube.get_faces()[6].get_uv_mapping().offset.y == 0.25f);
+	}
+
+	SECTION("Changing the mapping of a face")
+	{
+		ot::egfx::face::ref const front = cube.get_faces()[0];
+		std::vector<ot::math::point2f> before;
+		for (ot::egfx::half_edge::cref const he : front.get_half_edges())
+			before.push_back(he.get_uv());
+
+		ot::egfx::uv_mapping mapping;
+		mapping.rotation = std::numbers::pi_v<float> / 2.f;
+		mapping.scale = { 2.f, 2.f };
+		mapping.offset = { 1.f, 0.f };
+		front.set_uv_mapping(mapping);
+		check_uvs(cube);
+
+		// Rotated a quarter turn, then scaled, then offset
+		size_t i = 0;
+		for (ot::egfx::half_edge::cref const he : front.get_half_edges())
+		{
+			CHECK(ot::float_eq(he.get_uv().x + 1.f, -before[i].y * 2.f + 2.f, 4));
+			CHECK(ot::float_eq(he.get_uv().y + 1.f, before[i].x * 2.f + 1.f, 4));
+			++i;
+		}
+
+		auto const dirty_faces = cube.get_dirty_faces();
+		REQUIRE(dirty_faces.size() == 1);
+		CHECK(dirty_faces[0] == front.get_id());
+
+		// Copies keep their own mappings
+		ot::egfx::mesh_definition const copy = cube;
+		front.set_uv_mapping({});
+		CHECK(copy.get_faces()[0].get_uv_mapping().scale.x == 2.f);
+		CHECK(cube.get_faces()[0].get_uv_mapping().scale.x == 1.f);
+	}
+
+	SECTION("Planar projection keeps lengths on sloped faces")
+	{
+		ot::math::plane const wedge_planes[] = {
+			{ {0, -1, 0}, 0.5f },
+			{ {0, 0, -1}, 0.5f },
+			{ {1, 0, 0}, 0.5f },
+			{ {-1, 0, 0}, 0.5f },
+			{ normalized(ot::math::vector3f{ 0, 1, 1 }), 0.f },
+		};
+		ot::egfx::mesh_definition wedge(wedge_planes);
+		ot::egfx::face::ref const slope = wedge.get_faces()[4];
+
+		ot::egfx::uv_mapping mapping;
+		mapping.projection = ot::egfx::uv_projection::planar;
+		slope.set_uv_mapping(mapping);
+		check_uvs(wedge);
+
+		for (ot::egfx::half_edge::cref const he : slope.get_half_edges())
+		{
+			ot::math::point2f const a = he.get_uv();
+			ot::math::point2f const b = he.get_next().get_uv();
+			float const uv_length = std::hypot(b.x - a.x, b.y - a.y);
+			CHECK(ot::float_eq(uv_length, (he.get_line().b - he.get_line().a).norm(), 4));
+		}
+	}
 }
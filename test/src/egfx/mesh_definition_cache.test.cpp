@@ -0,0 +1,155 @@
+#include <egfx/mesh_definition_cache.h>
+#include <egfx/mesh_definition.h>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	std::vector<ot::math::plane> make_box_planes(float half_size)
+	{
+		return {
+			{{0, 0, 1}, half_size},
+			{{1, 0, 0}, half_size},
+			{{0, 1, 0}, half_size},
+			{{-1, 0, 0}, half_size},
+			{{0, -1, 0}, half_size},
+			{{0, 0, -1}, half_size},
+		};
+	}
+}
+
+TEST_CASE("mesh_definition_cache shares definitions of the same planes", "[graphics]")
+{
+	ot::egfx::mesh_definition_cache cache;
+
+	auto const planes = make_box_planes(0.5f);
+	auto const first = cache.get(planes);
+	REQUIRE(first != nullptr);
+	CHECK(first->get_faces().size() == 6);
+	CHECK(first->get_vertices().size() == 8);
+
+	SECTION("Same planes")
+	{
+		auto const second = cache.get(planes);
+		CHECK(second == first);
+		CHECK(cache.get_statistics().hits == 1);
+		CHECK(cache.get_statistics().misses == 1);
+	}
+
+	SECTION("Same planes in another order")
+	{
+		auto reversed = planes;
+		std::reverse(reversed.begin(), reversed.end());
+		CHECK(cache.get(reversed) == first);
+		CHECK(cache.get_statistics().hits == 1);
+	}
+
+	SECTION("Faces do not depend on the order of the first planes")
+	{
+		ot::egfx::mesh_definition_cache other_cache;
+		auto reversed = planes;
+		std::reverse(reversed.begin(), reversed.end());
+		auto const other = other_cache.get(reversed);
+		REQUIRE(other->get_faces().size() == first->get_faces().size());
+		for (size_t i = 0; i < first->get_faces().size(); ++i)
+		{
+			ot::math::plane const expected = first->get_face(ot::egfx::face::id(i)).get_plane();
+			ot::math::plane const actual = other->get_face(ot::egfx::face::id(i)).get_plane();
+			CHECK(actual.normal.x == expected.normal.x);
+			CHECK(actual.normal.y == expected.normal.y);
+			CHECK(actual.normal.z == expected.normal.z);
+			CHECK(actual.distance == expected.distance);
+		}
+	}
+
+	SECTION("Negative zeroes")
+	{
+		auto signed_zeroes = planes;
+		signed_zeroes[0].normal.x = -0.f;
+		signed_zeroes[0].normal.y = -0.f;
+		CHECK(cache.get(signed_zeroes) == first);
+	}
+
+	SECTION("Different planes")
+	{
+		auto const other = cache.get(make_box_planes(0.25f));
+		CHECK(other != first);
+		CHECK(cache.get_statistics().hits == 0);
+		CHECK(cache.get_statistics().misses == 2);
+		CHECK(cache.get_statistics().entries == 2);
+	}
+
+	SECTION("Destroyed definitions are rebuilt")
+	{
+		cache.reset_statistics();
+		{
+			auto discarded = cache.get(make_box_planes(2.f));
+			CHECK(cache.get_statistics().misses == 1);
+		}
+		auto const rebuilt = cache.get(make_box_planes(2.f));
+		CHECK(cache.get_statistics().misses == 2);
+		CHECK(cache.get_statistics().hits == 0);
+	}
+
+	SECTION("Invalid planes")
+	{
+		std::vector<ot::math::plane> const open_planes(planes.begin(), planes.begin() + 3);
+		CHECK_THROWS_AS(cache.get(open_planes), std::invalid_argument);
+		CHECK(cache.get_statistics().entries == 1);
+	}
+}
+
+TEST_CASE("mesh_definition_cache prunes destroyed definitions", "[graphics]")
+{
+	ot::egfx::mesh_definition_cache cache;
+
+	auto const kept = cache.get(make_box_planes(0.5f));
+	for (int i = 1; i <= 1000; ++i)
+	{
+		auto const discarded = cache.get(make_box_planes(1.f + i * 0.01f));
+	}
+
+	ot::egfx::mesh_definition_cache::statistics const stats = cache.get_statistics();
+	CHECK(stats.misses == 1001);
+	CHECK(stats.entries < 1001);
+	CHECK(cache.get(make_box_planes(0.5f)) == kept);
+}
+
+TEST_CASE("mesh_definition_cache from several threads", "[graphics]")
+{
+	ot::egfx::mesh_definition_cache cache;
+
+	size_t const thread_count = 4;
+	size_t const shape_count = 16;
+	std::vector<std::vector<std::shared_ptr<ot::egfx::mesh_definition const>>> results(thread_count);
+	{
+		std::vector<std::jthread> threads;
+		for (size_t t = 0; t < thread_count; ++t)
+		{
+			threads.emplace_back([&cache, &results, t]
+			{
+				for (size_t round = 0; round < 8; ++round)
+					for (size_t s = 0; s < shape_count; ++s)
+						results[t].push_back(cache.get(make_box_planes(1.f + float(s))));
+			});
+		}
+	}
+
+	// Every thread ends up with the same definition for each shape
+	for (size_t t = 0; t < thread_count; ++t)
+	{
+		REQUIRE(results[t].size() == 8 * shape_count);
+		for (size_t i = 0; i < results[t].size(); ++i)
+			CHECK(results[t][i] == results[0][i % shape_count]);
+	}
+
+	ot::egfx::mesh_definition_cache::statistics const stats = cache.get_statistics();
+	CHECK(stats.hits + stats.misses == thread_count * 8 * shape_count);
+	CHECK(stats.entries == shape_count);
+}
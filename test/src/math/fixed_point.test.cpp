@@ -0,0 +1,86 @@
+#include <math/fixed_point.h>
+
+#include <catch2/catch.hpp>
+
+#include <stdexcept>
+#include <unordered_set>
+
+TEST_CASE("snap round trip", "[math]")
+{
+	ot::math::fixed_point3 const p = ot::math::snap(ot::math::point3f{ 1.5f, -2.25f, 100.f });
+	REQUIRE(p == ot::math::fixed_point3{ 98304, -147456, 6553600 });
+	REQUIRE(ot::math::to_point(p) == ot::math::point3f{ 1.5f, -2.25f, 100.f });
+
+	// Close positions snap to the same point, which does not move when snapped again
+	ot::math::fixed_point3 const q = ot::math::snap(ot::math::point3f{ 0.1f, 0.1f + 1e-6f, 0.1f - 1e-6f });
+	REQUIRE(q.x == q.y);
+	REQUIRE(q.x == q.z);
+	REQUIRE(ot::math::snap(ot::math::to_point(q)) == q);
+
+	REQUIRE_THROWS_AS(ot::math::snap(ot::math::point3f{ 1e20f, 0.f, 0.f }), std::invalid_argument);
+	REQUIRE_THROWS_AS(ot::math::snap(ot::math::plane{ { 0.f, 0.f, 0.f }, 1.f }), std::invalid_argument);
+}
+
+TEST_CASE("fixed get_plane_side is exact", "[math]")
+{
+	ot::math::fixed_plane const p = ot::math::snap(ot::math::plane{ { 1, 0, 0 }, 1 });
+	REQUIRE(ot::math::to_plane(p).distance == 1.f);
+
+	REQUIRE(get_plane_side(p, ot::math::snap(ot::math::point3f{ 1.f, 5.f, -3.f })) == ot::math::plane_side_result::on_plane);
+	REQUIRE(get_plane_side(p, ot::math::fixed_point3{ 65537, 0, 0 }) == ot::math::plane_side_result::outside);
+	REQUIRE(get_plane_side(p, ot::math::fixed_point3{ 65535, 0, 0 }) == ot::math::plane_side_result::inside);
+
+	// Points snapped from positions on a slanted plane are within the snapping tolerance
+	ot::math::plane const slanted{ normalized(ot::math::vector3f{ 1.f, 2.f, 3.f }), 2.f };
+	ot::math::fixed_plane const fixed_slanted = ot::math::snap(slanted);
+	ot::math::plane const snapped_slanted = ot::math::to_plane(fixed_slanted);
+	int64_t const tolerance = get_snapping_tolerance(fixed_slanted);
+	ot::math::vector3f const along = normalized(cross_product(snapped_slanted.normal, ot::math::vector3f::unit_x()));
+	for (float u = -5.f; u <= 5.f; u += 0.37f)
+	{
+		ot::math::point3f const on_plane = snapped_slanted.get_point() + along * u;
+		CAPTURE(u);
+		REQUIRE(get_plane_side(fixed_slanted, ot::math::snap(on_plane), tolerance) == ot::math::plane_side_result::on_plane);
+		REQUIRE(get_plane_side(fixed_slanted, ot::math::snap(on_plane + snapped_slanted.normal * 0.001f), tolerance) == ot::math::plane_side_result::outside);
+	}
+}
+
+TEST_CASE("fixed find_intersection", "[math]")
+{
+	ot::math::fixed_plane const x = ot::math::snap(ot::math::plane{ { 1, 0, 0 }, 1 });
+	ot::math::fixed_plane const y = ot::math::snap(ot::math::plane{ { 0, 1, 0 }, 2 });
+	ot::math::fixed_plane const z = ot::math::snap(ot::math::plane{ { 0, 0, 1 }, 3 });
+	auto const corner = ot::math::find_intersection(x, y, z);
+	REQUIRE(corner);
+	REQUIRE(ot::math::to_point(*corner) == ot::math::point3f{ 1, 2, 3 });
+	REQUIRE(!ot::math::find_intersection(x, y, x));
+
+	// Any order gives the same point
+	ot::math::fixed_plane const a = ot::math::snap(ot::math::plane{ normalized(ot::math::vector3f{ 1.f, 2.f, 3.f }), 2.f });
+	ot::math::fixed_plane const b = ot::math::snap(ot::math::plane{ normalized(ot::math::vector3f{ -2.f, 1.f, 0.5f }), 1.3f });
+	ot::math::fixed_plane const c = ot::math::snap(ot::math::plane{ normalized(ot::math::vector3f{ 0.3f, -1.f, 2.f }), -0.7f });
+	auto const abc = ot::math::find_intersection(a, b, c);
+	REQUIRE(abc);
+	REQUIRE(ot::math::find_intersection(b, c, a) == abc);
+	REQUIRE(ot::math::find_intersection(c, a, b) == abc);
+	REQUIRE(ot::math::find_intersection(c, b, a) == abc);
+	REQUIRE(ot::math::find_intersection(a, c, b) == abc);
+	REQUIRE(ot::math::find_intersection(b, a, c) == abc);
+
+	auto const expected = find_intersection(ot::math::to_plane(a), ot::math::to_plane(b), ot::math::to_plane(c));
+	REQUIRE(expected);
+	ot::math::point3f const result = ot::math::to_point(*abc);
+	REQUIRE(std::abs(result.x - expected->x) <= 1.f / 256.f);
+	REQUIRE(std::abs(result.y - expected->y) <= 1.f / 256.f);
+	REQUIRE(std::abs(result.z - expected->z) <= 1.f / 256.f);
+}
+
+TEST_CASE("fixed points hash", "[math]")
+{
+	std::unordered_set<ot::math::fixed_point3> points;
+	points.insert(ot::math::snap(ot::math::point3f{ 1.f, 2.f, 3.f }));
+	points.insert(ot::math::snap(ot::math::point3f{ 1.f, 2.f, 3.f + 1e-6f }));
+	points.insert(ot::math::snap(ot::math::point3f{ 3.f, 2.f, 1.f }));
+	REQUIRE(points.size() == 2);
+	REQUIRE(points.contains(ot::math::fixed_point3{ 65536, 131072, 196608 }));
+}
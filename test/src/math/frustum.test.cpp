@@ -0,0 +1,50 @@
+#include <math/frustum.h>
+
+#include <catch2/catch.hpp>
+
+#include <numbers>
+
+namespace
+{
+	float const quarter_turn = std::numbers::pi_v<float> / 2.f;
+}
+
+TEST_CASE("make_perspective_frustum", "[math]")
+{
+	// 90 degrees both ways, so the sides are at 45 degrees
+	ot::math::frustum const f = ot::math::make_perspective_frustum(ot::math::transform_matrix::identity(), quarter_turn, 1.f, 1.f, 100.f);
+
+	CHECK(f.contains({ 0.f, 0.f, -10.f }));
+	CHECK(f.contains({ 9.f, -9.f, -10.f }));
+	CHECK(!f.contains({ 11.f, 0.f, -10.f }));
+	CHECK(!f.contains({ 0.f, -11.f, -10.f }));
+	CHECK(!f.contains({ 0.f, 0.f, 10.f }));
+	CHECK(!f.contains({ 0.f, 0.f, -0.5f }));
+	CHECK(!f.contains({ 0.f, 0.f, -101.f }));
+
+	// The aspect ratio widens the horizontal field of view only
+	ot::math::frustum const wide = ot::math::make_perspective_frustum(ot::math::transform_matrix::identity(), quarter_turn, 2.f, 1.f, 100.f);
+	CHECK(wide.contains({ 19.f, 0.f, -10.f }));
+	CHECK(!wide.contains({ 0.f, 11.f, -10.f }));
+
+	// Turned around and moved
+	ot::math::transform_matrix const camera = ot::math::transform_matrix::from_components({ 5.f, 0.f, 0.f }, ot::math::quaternion::y_deg_rotation(180.f));
+	ot::math::frustum const turned = ot::math::make_perspective_frustum(camera, quarter_turn, 1.f, 1.f, 100.f);
+	CHECK(turned.contains({ 5.f, 0.f, 10.f }));
+	CHECK(!turned.contains({ 5.f, 0.f, -10.f }));
+	CHECK(!turned.contains({ 20.f, 0.f, 10.f }));
+}
+
+TEST_CASE("frustum::is_outside", "[math]")
+{
+	ot::math::frustum const f = ot::math::make_perspective_frustum(ot::math::transform_matrix::identity(), quarter_turn, 1.f, 1.f, 100.f);
+
+	CHECK(!f.is_outside({ { 0.f, 0.f, -10.f }, { 1.f, 1.f, 1.f } }));
+	// Partly in
+	CHECK(!f.is_outside({ { 11.f, 0.f, -10.f }, { 2.f, 1.f, 1.f } }));
+	CHECK(!f.is_outside({ { 0.f, 0.f, 0.f }, { 2.f, 2.f, 2.f } }));
+	// Out of a single plane
+	CHECK(f.is_outside({ { 15.f, 0.f, -10.f }, { 2.f, 1.f, 1.f } }));
+	CHECK(f.is_outside({ { 0.f, 0.f, 5.f }, { 1.f, 1.f, 1.f } }));
+	CHECK(f.is_outside({ { 0.f, 0.f, -110.f }, { 1.f, 1.f, 1.f } }));
+}
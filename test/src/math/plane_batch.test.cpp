@@ -0,0 +1,166 @@
+#include <math/plane_batch.h>
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	using ot::math::plane;
+	using ot::math::point3f;
+
+	// Deterministic values spread over [-10, 10]
+	float make_value(size_t i)
+	{
+		return std::fmod(float(i) * 7.31f, 20.f) - 10.f;
+	}
+
+	std::vector<point3f> make_points(size_t count)
+	{
+		std::vector<point3f> points;
+		for (size_t i = 0; i < count; ++i)
+			points.push_back({ make_value(3 * i), make_value(3 * i + 1), make_value(3 * i + 2) });
+		return points;
+	}
+
+	plane make_plane(size_t i)
+	{
+		return { normalized(ot::math::vector3f{ make_value(4 * i + 1), make_value(4 * i + 2), make_value(4 * i + 3) }), make_value(4 * i) };
+	}
+
+	std::vector<plane> make_planes(size_t count)
+	{
+		std::vector<plane> planes;
+		for (size_t i = 0; i < count; ++i)
+			planes.push_back(make_plane(i));
+		return planes;
+	}
+}
+
+TEST_CASE("distances_to and get_plane_sides match the scalar functions", "[math]")
+{
+	plane const p = make_plane(3);
+
+	// Sizes around the vector widths, to go through the tails
+	for (size_t count : { 0, 1, 3, 4, 5, 8, 11, 17, 64 })
+	{
+		std::vector<point3f> points = make_points(count);
+		if (count > 2)
+			points[2] = p.get_point(); // on the plane
+
+		std::vector<float> distances(count);
+		std::vector<ot::math::plane_side_result> sides(count);
+		std::vector<ot::math::plane_side_result> sides_from_distances(count);
+		ot::math::distances_to(p, points, distances);
+		ot::math::get_plane_sides(p, points, sides);
+		ot::math::distances_to_plane_sides(distances, sides_from_distances);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			CAPTURE(count, i);
+			REQUIRE(distances[i] == p.distance_to(points[i]));
+			REQUIRE(sides[i] == get_plane_side(p, points[i]));
+			REQUIRE(sides_from_distances[i] == sides[i]);
+		}
+
+		if (count > 2)
+			REQUIRE(sides[2] == ot::math::plane_side_result::on_plane);
+	}
+}
+
+TEST_CASE("intersect_distances matches ray::intersects", "[math]")
+{
+	ot::math::ray const r{ { 1.f, 2.f, 3.f }, normalized(ot::math::vector3f{ 1.f, -2.f, 0.5f }) };
+
+	std::vector<plane> planes = make_planes(19);
+	planes[5] = { normalized(ot::math::vector3f{ 2.f, 1.f, 0.f }), 4.f }; // parallel to the ray
+
+	std::vector<float> distances(planes.size());
+	ot::math::intersect_distances(r, planes, distances);
+
+	for (size_t i = 0; i < planes.size(); ++i)
+	{
+		CAPTURE(i);
+		auto const intersection = r.intersects(planes[i]);
+		REQUIRE(intersection.has_value() == !std::isnan(distances[i]));
+		if (intersection)
+			REQUIRE(float_eq(r.origin + r.direction * distances[i], *intersection, 8));
+	}
+	REQUIRE(std::isnan(distances[5]));
+}
+
+TEST_CASE("find_intersections matches find_intersection", "[math]")
+{
+	std::vector<ot::math::plane_triple> triples;
+	for (size_t i = 0; i < 23; ++i)
+		triples.push_back({ make_plane(i), make_plane(i + 100), make_plane(i + 200) });
+	triples[6].p3 = triples[6].p1; // no single intersection
+	triples[13] = { { {1, 0, 0}, 1 }, { {0, 1, 0}, 2 }, { {0, 0, 1}, 3 } };
+
+	std::vector<std::optional<point3f>> points(triples.size());
+	ot::math::find_intersections(triples, points);
+
+	for (size_t i = 0; i < triples.size(); ++i)
+	{
+		CAPTURE(i);
+		auto const expected = find_intersection(triples[i].p1, triples[i].p2, triples[i].p3);
+		REQUIRE(points[i].has_value() == expected.has_value());
+		if (expected)
+			REQUIRE(float_eq(*points[i], *expected));
+	}
+	REQUIRE(!points[6]);
+	REQUIRE(float_eq(*points[13], { 1, 2, 3 }));
+}
+
+TEST_CASE("Plane batch benchmark", "[.][benchmark]")
+{
+	size_t const count = 1'000'000;
+	size_t const repeat_count = 20;
+	std::vector<point3f> const points = make_points(count);
+	std::vector<plane> const planes = make_planes(count);
+	plane const p = make_plane(1);
+	ot::math::ray const r{ { 1.f, 2.f, 3.f }, normalized(ot::math::vector3f{ 1.f, -2.f, 0.5f }) };
+
+	using clock = std::chrono::steady_clock;
+	auto const measure = [](auto&& f)
+	{
+		auto const start = clock::now();
+		for (size_t k = 0; k < repeat_count; ++k)
+			f();
+		return std::chrono::duration<double>(clock::now() - start).count();
+	};
+
+	std::vector<ot::math::plane_side_result> sides(count);
+	double const scalar_sides = measure([&] { for (size_t i = 0; i < count; ++i) sides[i] = get_plane_side(p, points[i]); });
+	double const batch_sides = measure([&] { ot::math::get_plane_sides(p, points, sides); });
+
+	std::vector<float> distances(count);
+	double const scalar_rays = measure([&]
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto const intersection = r.intersects(planes[i]);
+			distances[i] = intersection ? intersection->x : 0.f;
+		}
+	});
+	double const batch_rays = measure([&] { ot::math::intersect_distances(r, planes, distances); });
+
+	std::vector<ot::math::plane_triple> triples;
+	for (size_t i = 0; i + 2 < count; i += 3)
+		triples.push_back({ planes[i], planes[i + 1], planes[i + 2] });
+	std::vector<std::optional<point3f>> intersections(triples.size());
+	double const scalar_triples = measure([&] { for (size_t i = 0; i < triples.size(); ++i) intersections[i] = find_intersection(triples[i].p1, triples[i].p2, triples[i].p3); });
+	double const batch_triples = measure([&] { ot::math::find_intersections(triples, intersections); });
+
+	auto const print = [](char const* name, size_t n, double scalar, double batch)
+	{
+		double const total = double(n * repeat_count);
+		std::printf("%-20s scalar %7.1f M/s, batch %7.1f M/s (x%.1f)\n", name, total / scalar / 1e6, total / batch / 1e6, scalar / batch);
+	};
+	print("point sides", count, scalar_sides, batch_sides);
+	print("ray/plane", count, scalar_rays, batch_rays);
+	print("plane triples", triples.size(), scalar_triples, batch_triples);
+}